@@ -5,19 +5,76 @@
 #include "JadeBreaker/Display/GLFWDisplay.h"
 #include "Soul/GlobalContext/GlobalContext.h"
 
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
 namespace Sherphy 
 {
 	GameEngine::GameEngine() {
 		m_world_data = new WorldDataBase;
 	}
 
+	namespace
+	{
+		// binary ppm, the headless target renders rgba8 so the alpha channel is dropped
+		void writeHeadlessFrame(const std::string& directory, const HeadlessFrame& frame)
+		{
+			char file_name[32];
+			snprintf(file_name, sizeof(file_name), "frame_%05llu.ppm", static_cast<unsigned long long>(frame.frame_number));
+			std::string path = (std::filesystem::path(directory) / file_name).string();
+			std::ofstream file(path, std::ios::binary);
+			if (!file.is_open())
+			{
+				LogMessage(ERROR_MARK("failed to write headless frame " + path), WarningStage::Medium);
+				return;
+			}
+			file << "P6\n" << frame.width << " " << frame.height << "\n255\n";
+			std::vector<uint8_t> row(static_cast<size_t>(frame.width) * 3);
+			for (uint32_t y = 0; y < frame.height; y++)
+			{
+				const uint8_t* source = frame.pixels + static_cast<size_t>(y) * frame.width * 4;
+				for (uint32_t x = 0; x < frame.width; x++)
+				{
+					row[x * 3 + 0] = source[x * 4 + 0];
+					row[x * 3 + 1] = source[x * 4 + 1];
+					row[x * 3 + 2] = source[x * 4 + 2];
+				}
+				file.write(reinterpret_cast<const char*>(row.data()), row.size());
+			}
+		}
+	}
+
 	const uint32_t WIDTH = 800, HEIGHT = 600;
-	void GameEngine::init() 
+	void GameEngine::init(bool headless, uint32_t frame_count, const FramePacingSettings& frame_pacing, const std::string& headless_output) 
 	{
+		m_headless = headless;
+		m_headless_frame_count = frame_count;
+		m_headless_output = headless_output;
 		m_world_data->addOne();
 		SceneLoader::LoadScene(m_world_data->getSceneAt(0));
 		g_miracle_global_context.startSystem();
-		g_miracle_global_context.m_display_system->init(WIDTH, HEIGHT);
+		if (m_headless)
+		{
+			g_miracle_global_context.m_rendering_system->enableHeadless(WIDTH, HEIGHT);
+			if (!m_headless_output.empty())
+			{
+				std::error_code error;
+				std::filesystem::create_directories(m_headless_output, error);
+				SHERPHY_EXCEPTION_IF_FALSE((!error), "failed to create headless output directory " + m_headless_output);
+				std::string directory = m_headless_output;
+				g_miracle_global_context.m_rendering_system->setHeadlessFrameCallback([directory](const HeadlessFrame& frame) {
+					writeHeadlessFrame(directory, frame);
+				});
+			}
+		}
+		else
+		{
+			g_miracle_global_context.m_display_system->init(WIDTH, HEIGHT);
+		}
+		g_miracle_global_context.m_rendering_system->setFramePacing(frame_pacing);
 		swapData();
 		g_miracle_global_context.m_rendering_system->initVulkan(PipeLineType::Normal);
 		return;
@@ -25,37 +82,104 @@ namespace Sherphy
 
 	void GameEngine::start() 
 	{
+		if (m_headless)
+		{
+			runHeadless();
+			return;
+		}
+
 		std::shared_ptr<GLFWDisplay> display_system = g_miracle_global_context.m_display_system;
 		std::shared_ptr<VulkanRHI> renderning_system = g_miracle_global_context.m_rendering_system;
 		while (display_system->shouldClose())
 		{
 			swapData();
+			renderning_system->waitForInputSampling();
 			glfwPollEvents();
 			renderning_system->drawFrame();
 		}
+		logFramePacing();
+	}
+
+	// fixed frame count without window events, reports the average cpu frame time for benchmarking
+	void GameEngine::runHeadless()
+	{
+		std::shared_ptr<VulkanRHI> renderning_system = g_miracle_global_context.m_rendering_system;
+		auto start_time = std::chrono::high_resolution_clock::now();
+		for (uint32_t frame = 0; frame < m_headless_frame_count; frame++)
+		{
+			swapData();
+			renderning_system->waitForInputSampling();
+			renderning_system->drawFrame();
+		}
+		float seconds = std::chrono::duration<float, std::chrono::seconds::period>(std::chrono::high_resolution_clock::now() - start_time).count();
+		// the last frames in flight are still on the gpu, their images are handed out here
+		renderning_system->finishHeadless();
+		if (m_headless_frame_count > 0)
+		{
+			SHERPHY_LOG("headless frames " + std::to_string(m_headless_frame_count) + ", average " + std::to_string(seconds * 1000.0f / m_headless_frame_count) + " ms");
+		}
+		logFramePacing();
+		for (const GPUPassStats& stats : renderning_system->getGPUPassStats())
+		{
+			SHERPHY_LOG("gpu " + stats.name + " min " + std::to_string(stats.min_ms) + " avg " + std::to_string(stats.avg_ms) + " p99 " + std::to_string(stats.p99_ms) + " ms");
+		}
+	}
+
+	void GameEngine::logFramePacing()
+	{
+		const FramePacingSettings& settings = g_miracle_global_context.m_rendering_system->getFramePacing();
+		FramePacingStats stats = g_miracle_global_context.m_rendering_system->getFramePacingStats();
+		SHERPHY_LOG("frames in flight " + std::to_string(settings.frames_in_flight) + (settings.low_latency ? ", low latency" : "")
+			+ ", frame avg " + std::to_string(stats.frame_avg_ms) + " p99 " + std::to_string(stats.frame_p99_ms) + " ms"
+			+ ", input latency avg " + std::to_string(stats.input_latency_avg_ms) + " p99 " + std::to_string(stats.input_latency_p99_ms) + " ms");
 	}
 
 	void GameEngine::swapData() 
 	{
+		SceneID id = 0;
+		auto data_base = m_world_data->getSceneAt(id);
+		std::shared_ptr<VulkanRHI> renderning_system = g_miracle_global_context.m_rendering_system;
+		auto views = data_base->view(ComponentType::position, ComponentType::rotation, ComponentType::rendermesh);
+		const auto& objects = std::get<0>(views);
+		const auto& components = std::get<1>(views);
+		auto light_views = data_base->view(ComponentType::position, ComponentType::light);
+		const auto& light_objects = std::get<0>(light_views);
+		const auto& light_components = std::get<1>(light_views);
 		if (m_is_new_world) 
 		{
-			SceneID id = 0;
-			auto data_base = m_world_data->getSceneAt(id);
-			auto* ren_comp = Function::GetObjectComponent<RenderMeshComponent>(id, data_base->getComponentDataBase(ComponentType::rendermesh));
-
-			std::vector<VkVertex>& vertices_buffer = g_miracle_global_context.m_rendering_system->getVerticesWrite();
-			std::vector<uint32_t>& indices_buffer = g_miracle_global_context.m_rendering_system->getIndicesWrite();
-			vertices_buffer.clear();
-			for (Vertex vert : ren_comp->m_vertices) 
+			// every object with a mesh becomes one mesh and one instance of it
+			m_object_instances.clear();
+			for (SOBJ_ID object_id : objects)
 			{
-				vertices_buffer.emplace_back(static_cast<VkVertex>(vert));
+				auto* ren_comp = Function::GetObjectComponent<RenderMeshComponent>(object_id, components[2]);
+				uint32_t mesh_id = renderning_system->addMesh(ren_comp->m_vertices, ren_comp->m_indices, ren_comp->m_meshlets);
+				m_object_instances.push_back({ object_id, renderning_system->addMeshInstance(mesh_id, Mat4x4(1.0f)) });
 			}
-			indices_buffer.clear();
-			for (uint32_t index : ren_comp->m_indices) {
-				indices_buffer.emplace_back(index);
+			m_object_lights.clear();
+			for (SOBJ_ID object_id : light_objects)
+			{
+				auto* pos_comp = Function::GetObjectComponent<PositionComponent>(object_id, light_components[0]);
+				auto* light_comp = Function::GetObjectComponent<LightComponent>(object_id, light_components[1]);
+				m_object_lights.push_back({ object_id, renderning_system->addLight(*light_comp, pos_comp->pos) });
 			}
 			m_is_new_world = false;
 		}
+
+		// transforms follow the components every frame
+		for (const auto& object_instance : m_object_instances)
+		{
+			auto* pos_comp = Function::GetObjectComponent<PositionComponent>(object_instance.first, components[0]);
+			auto* rot_comp = Function::GetObjectComponent<RotationComponent>(object_instance.first, components[1]);
+			Mat4x4 model = glm::mat4_cast(rot_comp->qua);
+			model[3] = Vec4(pos_comp->pos, 1.0f);
+			renderning_system->setMeshInstanceTransform(object_instance.second, model);
+		}
+		for (const auto& object_light : m_object_lights)
+		{
+			auto* pos_comp = Function::GetObjectComponent<PositionComponent>(object_light.first, light_components[0]);
+			auto* light_comp = Function::GetObjectComponent<LightComponent>(object_light.first, light_components[1]);
+			renderning_system->setLight(object_light.second, *light_comp, pos_comp->pos);
+		}
 		return;
 	}
 
@@ -1,4 +1,10 @@
 #pragma once
+#include "JadeBreaker/RHI/VulkanFramePacing.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace Sherphy 
 {
@@ -8,13 +14,24 @@ namespace Sherphy
 	{
 	public:
 		GameEngine();
-		void init();
+		// headless renders frame_count offscreen frames without opening a window,
+		// with headless_output set every frame is written there as a ppm image
+		void init(bool headless = false, uint32_t frame_count = 0, const FramePacingSettings& frame_pacing = {}, const std::string& headless_output = "");
 		void start();
 		void shutdown();
 	private:
 		void swapData();
+		void runHeadless();
+		void logFramePacing();
 		bool m_is_new_world { true };
+		bool m_headless { false };
+		uint32_t m_headless_frame_count { 0 };
+		std::string m_headless_output;
 		WorldDataBase* m_world_data;
+		// scene object and the rendering instance that follows its transform
+		std::vector<std::pair<size_t, uint32_t>> m_object_instances;
+		// scene object and the light it places
+		std::vector<std::pair<size_t, uint32_t>> m_object_lights;
 	};
 
 }
\ No newline at end of file
@@ -1,8 +1,13 @@
 #include "JadeBreaker/RHI/VulkanRHI.h"
 #include "JadeBreaker/Display/GLFWDisplay.h"
 #include "GameEngine.h"
+#include "Resource/TextureCooker.h"
 #define VulkanBackEnd
 
+#include <cctype>
+#include <stdexcept>
+#include <string>
+
 //namespace Sherphy{
 //    class Application 
 //    {
@@ -16,14 +21,114 @@
 //        GLFWDisplay display;
 //    };
 //}
-int main()
+// --headless [frame count] renders offscreen without a window, for farm and ci nodes
+// --headless-output <dir> writes every headless frame to dir as a ppm image
+// --frames-in-flight <1-3>, --present-mode <fifo|mailbox|immediate> and --low-latency set the frame pacing
+// --cook-textures <source dir> <cook dir> cooks the textures to KTX2 and exits, the CookTextures target runs it
+namespace
+{
+    const char* k_usage = "usage: Miracle_Runtime [--headless [frame count]] [--headless-output <dir>] [--frames-in-flight <1-3>]"
+                          " [--present-mode <fifo|mailbox|immediate>] [--low-latency] | --cook-textures <source dir> <cook dir>";
+
+    // false for anything but a whole unsigned number in range
+    bool parseCount(const std::string& value, uint32_t& count)
+    {
+        try
+        {
+            size_t end = 0;
+            unsigned long parsed = std::stoul(value, &end);
+            if (end != value.size() || parsed > UINT32_MAX)
+            {
+                return false;
+            }
+            count = static_cast<uint32_t>(parsed);
+            return true;
+        }
+        catch(const std::exception&)
+        {
+            return false;
+        }
+    }
+}
+
+int main(int argc, char** argv)
 {
     Sherphy::GameEngine engine;
     //Sherphy::GLFWDisplay display;
+    bool headless = false;
+    uint32_t headless_frames = 300;
+    std::string headless_output;
+    Sherphy::FramePacingSettings frame_pacing;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--cook-textures" && i + 2 < argc)
+        {
+            try
+            {
+                uint32_t texture_count = Sherphy::TextureCooker::cookDirectory(argv[i + 1], argv[i + 2]);
+                SHERPHY_LOG("cooked " + std::to_string(texture_count) + " textures");
+            } catch(const std::exception& e){
+                std::cerr << e.what() << std::endl;
+                return EXIT_FAILURE;
+            }
+            return EXIT_SUCCESS;
+        }
+        else if (std::string(argv[i]) == "--headless")
+        {
+            headless = true;
+            if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+            {
+                if (!parseCount(argv[++i], headless_frames))
+                {
+                    std::cerr << "invalid frame count " << argv[i] << "\n" << k_usage << std::endl;
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+        else if (std::string(argv[i]) == "--headless-output" && i + 1 < argc)
+        {
+            headless_output = argv[++i];
+        }
+        else if (std::string(argv[i]) == "--frames-in-flight" && i + 1 < argc)
+        {
+            uint32_t frames_in_flight = 0;
+            if (!parseCount(argv[++i], frames_in_flight) || frames_in_flight < 1 || frames_in_flight > 3)
+            {
+                std::cerr << "invalid frames in flight " << argv[i] << "\n" << k_usage << std::endl;
+                return EXIT_FAILURE;
+            }
+            frame_pacing.frames_in_flight = frames_in_flight;
+        }
+        else if (std::string(argv[i]) == "--present-mode" && i + 1 < argc)
+        {
+            std::string mode = argv[++i];
+            if (mode == "fifo")
+            {
+                frame_pacing.present_mode = Sherphy::PresentMode::Fifo;
+            }
+            else if (mode == "immediate")
+            {
+                frame_pacing.present_mode = Sherphy::PresentMode::Immediate;
+            }
+            else if (mode == "mailbox")
+            {
+                frame_pacing.present_mode = Sherphy::PresentMode::Mailbox;
+            }
+            else
+            {
+                std::cerr << "invalid present mode " << mode << "\n" << k_usage << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::string(argv[i]) == "--low-latency")
+        {
+            frame_pacing.low_latency = true;
+        }
+    }
         
     try
     {
-        engine.init();
+        engine.init(headless, headless_frames, frame_pacing, headless_output);
         engine.start();
         engine.shutdown();
     } catch(const std::exception& e){
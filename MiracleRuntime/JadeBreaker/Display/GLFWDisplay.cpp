@@ -14,6 +14,11 @@ namespace Sherphy
 
 	void GLFWDisplay::distroy() 
 	{
+		// headless runs never open a window
+		if (m_window == nullptr)
+		{
+			return;
+		}
 		glfwDestroyWindow(m_window);
 		glfwTerminate();
 	}
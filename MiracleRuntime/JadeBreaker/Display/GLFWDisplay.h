@@ -32,7 +32,7 @@ namespace Sherphy
 									VkSurfaceKHR* surface);
 			void tick();
 		private:
-			GLFWwindow* m_window;
+			GLFWwindow* m_window = nullptr;
 #if defined(DirectX12BackEnd)
 			BackEnd m_backend{ BackEnd::DirectX12 };
 #else
@@ -9,46 +9,21 @@
 
 namespace Sherphy 
 {
-	struct VkVertex : public Vertex
-	{
-		static VkVertexInputBindingDescription getBindingDescription() {
-			VkVertexInputBindingDescription bindingDescription{};
-			bindingDescription.binding = 0;
-			bindingDescription.stride = sizeof(VkVertex);
-			bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-			return bindingDescription;
-		}
-
-		static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
-			std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
-			attributeDescriptions[0].binding = 0;
-			attributeDescriptions[0].location = 0;
-			attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-			attributeDescriptions[0].offset = offsetof(VkVertex, pos);
-
-			attributeDescriptions[1].binding = 0;
-			attributeDescriptions[1].location = 1;
-			attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-			attributeDescriptions[1].offset = offsetof(VkVertex, color);
-
-			attributeDescriptions[2].binding = 0;
-			attributeDescriptions[2].location = 2;
-			attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-			attributeDescriptions[2].offset = offsetof(VkVertex, tex_coord);
-
-			return attributeDescriptions;
-		}
-
-		bool operator==(const VkVertex& other) const {
-			return pos == other.pos && color == other.color && tex_coord == other.tex_coord;
-		}
-	};
-
-	struct VkUniformBufferObject {
-		Mat4x4 model;
+	// per frame block, std140, allocated once per frame from the frame allocator
+	struct VkViewUniformObject {
 		Mat4x4 view;
 		Mat4x4 proj;
-		Vec3 light_pos;
+		Mat4x4 view_proj;
+		Vec4 camera_position;
+		// light cluster grid, see VulkanClusteredLights
+		Vec4 cluster_depth;       // x near plane, y far plane, z slice scale, w slice bias
+		Vec4 cluster_tile;        // xy pixels per cluster, zw screen size
+		uint32_t cluster_grid[4]; // cluster count in x, y and z, w light count
+	};
+
+	// per frame block of the path tracer, std140
+	struct VkRayTracingViewObject {
+		Mat4x4 view_inverse;
+		Mat4x4 proj_inverse;
 	};
 }
@@ -0,0 +1,260 @@
+#include "VulkanBindlessTable.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <volk.h>
+#include <algorithm>
+
+namespace Sherphy
+{
+    void VulkanBindlessTable::enableRequiredFeatures(VkPhysicalDeviceVulkan12Features& features)
+    {
+        features.descriptorIndexing = VK_TRUE;
+        features.runtimeDescriptorArray = VK_TRUE;
+        features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        features.descriptorBindingPartiallyBound = VK_TRUE;
+        features.descriptorBindingVariableDescriptorCount = VK_TRUE;
+        features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    }
+
+    bool VulkanBindlessTable::isCompatible(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+    {
+        for (const VkDescriptorSetLayoutBinding& binding : bindings)
+        {
+            bool material = binding.binding == k_material_binding && binding.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bool texture = binding.binding == k_texture_binding && binding.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            if ((!material && !texture) || (binding.stageFlags & ~VK_SHADER_STAGE_FRAGMENT_BIT) != 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool VulkanBindlessTable::isSupported(const VkPhysicalDeviceVulkan12Features& features)
+    {
+        return features.descriptorIndexing &&
+               features.runtimeDescriptorArray &&
+               features.shaderSampledImageArrayNonUniformIndexing &&
+               features.descriptorBindingPartiallyBound &&
+               features.descriptorBindingVariableDescriptorCount &&
+               features.descriptorBindingSampledImageUpdateAfterBind &&
+               features.descriptorBindingUpdateUnusedWhilePending;
+    }
+
+    void VulkanBindlessTable::init(VulkanDevice* device, uint32_t max_textures, uint32_t max_materials, uint32_t frame_count)
+    {
+        m_device = device;
+        m_max_materials = max_materials;
+        m_frame_count = frame_count;
+
+        VkPhysicalDeviceVulkan12Properties vulkan12_properties{};
+        vulkan12_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+        VkPhysicalDeviceProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &vulkan12_properties;
+        vkGetPhysicalDeviceProperties2(m_device->m_physical_device, &properties2);
+        m_max_textures = std::min({ max_textures,
+                                    vulkan12_properties.maxDescriptorSetUpdateAfterBindSampledImages,
+                                    vulkan12_properties.maxPerStageDescriptorUpdateAfterBindSampledImages });
+
+        // texture array is the highest binding so its size can be chosen at allocation time
+        std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+        bindings[0].binding = k_material_binding;
+        bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[0].descriptorCount = 1;
+        bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        bindings[1].binding = k_texture_binding;
+        bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[1].descriptorCount = m_max_textures;
+        bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        std::array<VkDescriptorBindingFlags, 2> binding_flags{};
+        binding_flags[0] = 0;
+        binding_flags[1] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                           VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                           VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT |
+                           VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info{};
+        binding_flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        binding_flags_info.bindingCount = static_cast<uint32_t>(binding_flags.size());
+        binding_flags_info.pBindingFlags = binding_flags.data();
+
+        VkDescriptorSetLayoutCreateInfo layout_info{};
+        layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout_info.pNext = &binding_flags_info;
+        layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+        layout_info.pBindings = bindings.data();
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateDescriptorSetLayout(m_device->m_logical_device, &layout_info, nullptr, &m_descriptor_set_layout) == VK_SUCCESS, "failed to create bindless descriptor set layout!");
+
+        std::array<VkDescriptorPoolSize, 2> pool_size{};
+        pool_size[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        pool_size[0].descriptorCount = m_max_textures * m_frame_count;
+        pool_size[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        pool_size[1].descriptorCount = m_frame_count;
+
+        VkDescriptorPoolCreateInfo pool_info{};
+        pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        pool_info.poolSizeCount = static_cast<uint32_t>(pool_size.size());
+        pool_info.pPoolSizes = pool_size.data();
+        pool_info.maxSets = m_frame_count;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateDescriptorPool(m_device->m_logical_device, &pool_info, nullptr, &m_descriptor_pool) == VK_SUCCESS, "failed to create bindless descriptor pool!");
+
+        std::vector<uint32_t> variable_counts(m_frame_count, m_max_textures);
+        VkDescriptorSetVariableDescriptorCountAllocateInfo variable_count_info{};
+        variable_count_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+        variable_count_info.descriptorSetCount = m_frame_count;
+        variable_count_info.pDescriptorCounts = variable_counts.data();
+
+        std::vector<VkDescriptorSetLayout> layouts(m_frame_count, m_descriptor_set_layout);
+        VkDescriptorSetAllocateInfo alloc_info{};
+        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.pNext = &variable_count_info;
+        alloc_info.descriptorPool = m_descriptor_pool;
+        alloc_info.descriptorSetCount = m_frame_count;
+        alloc_info.pSetLayouts = layouts.data();
+        m_descriptor_sets.resize(m_frame_count);
+        m_pending_texture_writes.resize(m_frame_count);
+        SHERPHY_EXCEPTION_IF_FALSE(vkAllocateDescriptorSets(m_device->m_logical_device, &alloc_info, m_descriptor_sets.data()) == VK_SUCCESS, "failed to allocate bindless descriptor set!");
+
+        // materials are written in place, the buffer stays mapped for the lifetime of the table
+        SHERPHY_ASSERT(m_device->createBuffer(sizeof(GPUMaterialRecord) * m_max_materials,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            m_material_buffer), VK_SUCCESS, "");
+        SHERPHY_ASSERT(m_material_buffer.map(), VK_SUCCESS, "");
+        if (!m_materials.empty())
+        {
+            SHERPHY_MEMCPY(m_material_buffer.mapped, m_materials.data(), sizeof(GPUMaterialRecord) * m_materials.size());
+        }
+
+        VkDescriptorBufferInfo material_buffer_info{ m_material_buffer.buffer, 0, VK_WHOLE_SIZE };
+        for (VkDescriptorSet descriptor_set : m_descriptor_sets)
+        {
+            VkWriteDescriptorSet descriptor_write{};
+            descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptor_write.dstSet = descriptor_set;
+            descriptor_write.dstBinding = k_material_binding;
+            descriptor_write.dstArrayElement = 0;
+            descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptor_write.descriptorCount = 1;
+            descriptor_write.pBufferInfo = &material_buffer_info;
+            vkUpdateDescriptorSets(m_device->m_logical_device, 1, &descriptor_write, 0, nullptr);
+        }
+    }
+
+    uint32_t VulkanBindlessTable::registerTexture(VkImageView image_view, VkSampler sampler)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE(isInitialized(), "bindless table is not initialized");
+        SHERPHY_EXCEPTION_IF_FALSE((m_texture_count < m_max_textures || !m_free_texture_ids.empty()), "bindless texture capacity exceeded");
+
+        // a fresh or released slot is not read by in flight work, so every copy may be written now (update unused while pending)
+        uint32_t texture_id = 0;
+        if (!m_free_texture_ids.empty())
+        {
+            texture_id = m_free_texture_ids.back();
+            m_free_texture_ids.pop_back();
+        }
+        else
+        {
+            texture_id = m_texture_count++;
+        }
+        for (VkDescriptorSet descriptor_set : m_descriptor_sets)
+        {
+            writeTexture(descriptor_set, { texture_id, image_view, sampler });
+        }
+        return texture_id;
+    }
+
+    void VulkanBindlessTable::updateTexture(uint32_t texture_id, VkImageView image_view, VkSampler sampler)
+    {
+        // only the newest image of a slot is kept, older ones may be destroyed before the frame begins
+        for (std::vector<TextureWrite>& pending_writes : m_pending_texture_writes)
+        {
+            auto pending = std::find_if(pending_writes.begin(), pending_writes.end(), [texture_id](const TextureWrite& write) {
+                return write.texture_id == texture_id;
+            });
+            if (pending != pending_writes.end())
+            {
+                *pending = { texture_id, image_view, sampler };
+            }
+            else
+            {
+                pending_writes.push_back({ texture_id, image_view, sampler });
+            }
+        }
+    }
+
+    void VulkanBindlessTable::releaseTexture(uint32_t texture_id)
+    {
+        for (std::vector<TextureWrite>& pending_writes : m_pending_texture_writes)
+        {
+            pending_writes.erase(std::remove_if(pending_writes.begin(), pending_writes.end(), [texture_id](const TextureWrite& write) {
+                return write.texture_id == texture_id;
+            }), pending_writes.end());
+        }
+        m_free_texture_ids.push_back(texture_id);
+    }
+
+    void VulkanBindlessTable::beginFrame(uint32_t current_frame)
+    {
+        for (const TextureWrite& texture : m_pending_texture_writes[current_frame])
+        {
+            writeTexture(m_descriptor_sets[current_frame], texture);
+        }
+        m_pending_texture_writes[current_frame].clear();
+    }
+
+    void VulkanBindlessTable::writeTexture(VkDescriptorSet descriptor_set, const TextureWrite& texture)
+    {
+        VkDescriptorImageInfo image_info{};
+        image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        image_info.imageView = texture.image_view;
+        image_info.sampler = texture.sampler;
+
+        VkWriteDescriptorSet descriptor_write{};
+        descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptor_write.dstSet = descriptor_set;
+        descriptor_write.dstBinding = k_texture_binding;
+        descriptor_write.dstArrayElement = texture.texture_id;
+        descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptor_write.descriptorCount = 1;
+        descriptor_write.pImageInfo = &image_info;
+        vkUpdateDescriptorSets(m_device->m_logical_device, 1, &descriptor_write, 0, nullptr);
+    }
+
+    uint32_t VulkanBindlessTable::registerMaterial(const GPUMaterialRecord& material)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE((m_max_materials == 0 || m_materials.size() < m_max_materials), "bindless material capacity exceeded");
+
+        m_materials.push_back(material);
+        if (isInitialized())
+        {
+            GPUMaterialRecord* materials = static_cast<GPUMaterialRecord*>(m_material_buffer.mapped);
+            materials[m_materials.size() - 1] = material;
+        }
+        return static_cast<uint32_t>(m_materials.size() - 1);
+    }
+
+    void VulkanBindlessTable::bind(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, uint32_t set_index, uint32_t current_frame)
+    {
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+            pipeline_layout, set_index, 1, &m_descriptor_sets[current_frame], 0, nullptr);
+    }
+
+    void VulkanBindlessTable::destroy()
+    {
+        if (!isInitialized())
+        {
+            return;
+        }
+        vkDestroyDescriptorPool(m_device->m_logical_device, m_descriptor_pool, nullptr);
+        vkDestroyDescriptorSetLayout(m_device->m_logical_device, m_descriptor_set_layout, nullptr);
+        m_material_buffer.unmap();
+        m_material_buffer.destroy();
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "RenderingMath.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+
+#include <vector>
+
+namespace Sherphy
+{
+	// mirrors GPUMaterial in NormalBindlessColorOutput.frag, std430
+	struct GPUMaterialRecord
+	{
+		Vec4 base_color_factor{ 1.0f };
+		uint32_t base_color_texture = 0;
+		uint32_t padding[3]{};
+	};
+
+	// One descriptor set holding every texture of the renderer in a single sampled
+	// image array plus a buffer with all materials. It is bound once per command
+	// buffer, shaders pick textures through the material index of the instance,
+	// so draws never switch descriptor sets and can be batched freely.
+	// There is one copy of the set per frame in flight: replacing the image of a
+	// slot that pending frames still sample is deferred until each frame begins.
+	struct VulkanBindlessTable
+	{
+		struct TextureWrite
+		{
+			uint32_t texture_id;
+			VkImageView image_view;
+			VkSampler sampler;
+		};
+
+		static const uint32_t k_material_binding = 0;
+		static const uint32_t k_texture_binding = 1;
+
+		VulkanDevice* m_device = nullptr;
+		uint32_t m_max_textures = 0;
+		uint32_t m_max_materials = 0;
+		uint32_t m_frame_count = 1;
+
+		uint32_t m_texture_count = 0;
+		std::vector<uint32_t> m_free_texture_ids;
+		std::vector<GPUMaterialRecord> m_materials;
+		VulkanBuffer m_material_buffer;
+
+		VkDescriptorSetLayout m_descriptor_set_layout = VK_NULL_HANDLE;
+		VkDescriptorPool m_descriptor_pool = VK_NULL_HANDLE;
+		std::vector<VkDescriptorSet> m_descriptor_sets;
+		std::vector<std::vector<TextureWrite>> m_pending_texture_writes;
+
+		bool isInitialized() const { return m_device != nullptr; }
+		void init(VulkanDevice* device, uint32_t max_textures, uint32_t max_materials, uint32_t frame_count = 1);
+		uint32_t registerTexture(VkImageView image_view, VkSampler sampler);
+		// the new image is visible to a frame once beginFrame ran for it
+		void updateTexture(uint32_t texture_id, VkImageView image_view, VkSampler sampler);
+		// only once no frame in flight reads the slot, the id is handed out again
+		void releaseTexture(uint32_t texture_id);
+		uint32_t registerMaterial(const GPUMaterialRecord& material);
+		// call after the frame slot was waited on
+		void beginFrame(uint32_t current_frame);
+		void bind(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, uint32_t set_index, uint32_t current_frame);
+		void destroy();
+
+		void writeTexture(VkDescriptorSet descriptor_set, const TextureWrite& texture);
+
+		static void enableRequiredFeatures(VkPhysicalDeviceVulkan12Features& features);
+		static bool isSupported(const VkPhysicalDeviceVulkan12Features& features);
+		// whether a set declared by shaders can be bound with the table's sets
+		static bool isCompatible(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+	};
+}
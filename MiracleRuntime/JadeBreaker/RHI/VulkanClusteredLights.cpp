@@ -0,0 +1,148 @@
+#include "VulkanClusteredLights.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <volk.h>
+
+#include <cmath>
+
+namespace Sherphy
+{
+    GPULightRecord VulkanClusteredLights::makeLightRecord(const LightComponent& light, const Vec3& position)
+    {
+        GPULightRecord record{};
+        record.position_range = Vec4(position, light.m_range);
+        record.color_intensity = Vec4(light.m_color, light.m_intensity);
+        // point lights leave the direction unused
+        Vec3 direction = light.m_type == LightType::Spot ? glm::normalize(light.m_direction) : light.m_direction;
+        record.direction_type = Vec4(direction, static_cast<float>(light.m_type));
+        record.cone = Vec4(std::cos(light.m_outer_cone_angle), std::cos(light.m_inner_cone_angle), 0.0f, 0.0f);
+        return record;
+    }
+
+    // slice k of the grid starts at near * (far / near) ^ (k / slices), so
+    // slice = log(depth) * scale - bias with the scale and bias below
+    void VulkanClusteredLights::setClusterView(VkViewUniformObject& view_block, float near_plane, float far_plane, VkExtent2D extent, uint32_t light_count)
+    {
+        float log_depth_ratio = std::log(far_plane / near_plane);
+        view_block.cluster_depth = Vec4(near_plane,
+            far_plane,
+            static_cast<float>(k_cluster_z) / log_depth_ratio,
+            static_cast<float>(k_cluster_z) * std::log(near_plane) / log_depth_ratio);
+        // the last tile of a row or column may reach past the screen
+        view_block.cluster_tile = Vec4(std::ceil(static_cast<float>(extent.width) / k_cluster_x),
+            std::ceil(static_cast<float>(extent.height) / k_cluster_y),
+            static_cast<float>(extent.width),
+            static_cast<float>(extent.height));
+        view_block.cluster_grid[0] = k_cluster_x;
+        view_block.cluster_grid[1] = k_cluster_y;
+        view_block.cluster_grid[2] = k_cluster_z;
+        view_block.cluster_grid[3] = light_count;
+    }
+
+    uint32_t VulkanClusteredLights::addLight(const GPULightRecord& light)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE((m_max_lights == 0 || m_lights.size() < m_max_lights), "light capacity exceeded");
+        m_lights.push_back(light);
+        return static_cast<uint32_t>(m_lights.size() - 1);
+    }
+
+    void VulkanClusteredLights::setLight(uint32_t light_id, const GPULightRecord& light)
+    {
+        m_lights[light_id] = light;
+    }
+
+    void VulkanClusteredLights::init(VulkanDevice* device,
+                                     VulkanFrameAllocator* frame_allocator,
+                                     VulkanDescriptorAllocator* descriptor_allocator,
+                                     uint32_t frame_count,
+                                     uint32_t max_lights)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE((m_lights.size() <= max_lights), "more lights than the clustered light capacity");
+        m_device = device;
+        m_frame_allocator = frame_allocator;
+        m_descriptor_allocator = descriptor_allocator;
+        m_frame_count = frame_count;
+        m_max_lights = max_lights;
+
+        m_light_count_buffers.resize(m_frame_count);
+        m_light_index_buffers.resize(m_frame_count);
+        for (uint32_t i = 0; i < m_frame_count; i++)
+        {
+            // every cluster is written each frame, nothing needs clearing
+            SHERPHY_ASSERT(m_device->createBuffer(sizeof(uint32_t) * k_cluster_count,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                m_light_count_buffers[i]), VK_SUCCESS, "");
+
+            SHERPHY_ASSERT(m_device->createBuffer(sizeof(uint32_t) * k_cluster_count * k_max_lights_per_cluster,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                m_light_index_buffers[i]), VK_SUCCESS, "");
+        }
+    }
+
+    void VulkanClusteredLights::createPipeline(const VkPipelineShaderStageCreateInfo& assign_shader_stage,
+                                               VkDescriptorSetLayout assign_set_layout,
+                                               VkPipelineLayout assign_pipeline_layout)
+    {
+        m_assign_set_layout = assign_set_layout;
+        m_assign_pipeline_layout = assign_pipeline_layout;
+
+        VkComputePipelineCreateInfo pipeline_info{};
+        pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipeline_info.stage = assign_shader_stage;
+        pipeline_info.layout = m_assign_pipeline_layout;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateComputePipelines(m_device->m_logical_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &m_assign_pipeline) == VK_SUCCESS, "failed to create light assignment pipeline!");
+    }
+
+    void VulkanClusteredLights::uploadLights(uint32_t current_frame)
+    {
+        // the dynamic range always spans max lights, reserve all of it
+        FrameAllocation allocation = m_frame_allocator->allocate(getLightRange());
+        if (!m_lights.empty())
+        {
+            SHERPHY_MEMCPY(allocation.mapped, m_lights.data(), sizeof(GPULightRecord) * m_lights.size());
+        }
+        m_light_offset = allocation.offset;
+    }
+
+    void VulkanClusteredLights::recordAssignment(VkCommandBuffer command_buffer, uint32_t current_frame, uint32_t view_offset)
+    {
+        std::vector<DescriptorWrite> writes(4);
+        writes[0].binding = 0;
+        writes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        writes[0].buffer_info = { m_frame_allocator->m_buffer.buffer, view_offset, sizeof(VkViewUniformObject) };
+        writes[1].binding = 1;
+        writes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[1].buffer_info = { m_frame_allocator->m_buffer.buffer, m_light_offset, getLightRange() };
+        writes[2].binding = 2;
+        writes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[2].buffer_info = { m_light_count_buffers[current_frame].buffer, 0, VK_WHOLE_SIZE };
+        writes[3].binding = 3;
+        writes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[3].buffer_info = { m_light_index_buffers[current_frame].buffer, 0, VK_WHOLE_SIZE };
+        VkDescriptorSet descriptor_set = m_descriptor_allocator->allocateFrame(current_frame, m_assign_set_layout, writes);
+
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_assign_pipeline);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_assign_pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
+        vkCmdDispatch(command_buffer, (k_cluster_count + k_group_size - 1) / k_group_size, 1, 1);
+        // the render graph orders the fragment reads of the cluster lists after this
+    }
+
+    void VulkanClusteredLights::destroy()
+    {
+        if (!isInitialized())
+        {
+            return;
+        }
+        vkDestroyPipeline(m_device->m_logical_device, m_assign_pipeline, nullptr);
+        for (uint32_t i = 0; i < m_frame_count; i++)
+        {
+            m_light_count_buffers[i].destroy();
+            m_light_index_buffers[i].destroy();
+        }
+        m_light_count_buffers.clear();
+        m_light_index_buffers.clear();
+        m_device = nullptr;
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "RenderingMath.h"
+#include "VulkanBuffer.h"
+#include "VulkanDescriptorAllocator.h"
+#include "VulkanDevice.h"
+#include "VulkanFrameAllocator.h"
+#include "Soul/Component.h"
+
+#include <vector>
+
+namespace Sherphy
+{
+	// mirrors GPULight in ClusteredLights.glsl, std430
+	struct GPULightRecord
+	{
+		Vec4 position_range;  // xyz world position, w range
+		Vec4 color_intensity; // xyz color, w intensity
+		Vec4 direction_type;  // xyz spot direction, w LightType
+		Vec4 cone;            // x cos of the outer half angle, y cos of the inner half angle
+	};
+
+	// Point and spot lights of the scene, assigned every frame to a grid of view
+	// space froxels: tiles of the screen split into depth slices that grow
+	// exponentially with distance. A compute pass tests every light against the
+	// bounds of every froxel and writes the light indices of each froxel into a
+	// fixed size list, the forward shader then only walks the list of the froxel
+	// its fragment falls in, so shading cost follows the local light density
+	// rather than the light count of the scene.
+	struct VulkanClusteredLights
+	{
+		// matches MAX_LIGHTS_PER_CLUSTER in ClusteredLights.glsl, further lights are dropped
+		static const uint32_t k_max_lights_per_cluster = 128;
+		static const uint32_t k_cluster_x = 16;
+		static const uint32_t k_cluster_y = 9;
+		static const uint32_t k_cluster_z = 24;
+		static const uint32_t k_cluster_count = k_cluster_x * k_cluster_y * k_cluster_z;
+		// one thread per cluster, matches local_size_x of ClusterLightCulling.comp
+		static const uint32_t k_group_size = 64;
+
+		VulkanDevice* m_device = nullptr;
+		VulkanFrameAllocator* m_frame_allocator = nullptr;
+		VulkanDescriptorAllocator* m_descriptor_allocator = nullptr;
+		uint32_t m_frame_count = 0;
+		uint32_t m_max_lights = 0;
+
+		std::vector<GPULightRecord> m_lights;
+		// dynamic offset of this frame's light records in the frame allocator
+		uint32_t m_light_offset = 0;
+
+		// per frame in flight, written by the assignment pass and read by the forward shader
+		std::vector<VulkanBuffer> m_light_count_buffers; // one count per cluster
+		std::vector<VulkanBuffer> m_light_index_buffers; // k_max_lights_per_cluster indices per cluster
+
+		VkDescriptorSetLayout m_assign_set_layout = VK_NULL_HANDLE;    // owned by the layout cache
+		VkPipelineLayout m_assign_pipeline_layout = VK_NULL_HANDLE;    // owned by the layout cache
+		VkPipeline m_assign_pipeline = VK_NULL_HANDLE;
+
+		static GPULightRecord makeLightRecord(const LightComponent& light, const Vec3& position);
+		// fills the cluster block of the view, proj has to be set already
+		static void setClusterView(VkViewUniformObject& view_block, float near_plane, float far_plane, VkExtent2D extent, uint32_t light_count);
+
+		// lights can be added before init, ids are indices into the light records
+		uint32_t addLight(const GPULightRecord& light);
+		void setLight(uint32_t light_id, const GPULightRecord& light);
+		uint32_t getLightCount() const { return static_cast<uint32_t>(m_lights.size()); }
+		// the dynamic range of the light records always spans max lights
+		VkDeviceSize getLightRange() const { return sizeof(GPULightRecord) * m_max_lights; }
+
+		bool isInitialized() const { return m_device != nullptr; }
+		void init(VulkanDevice* device,
+				  VulkanFrameAllocator* frame_allocator,
+				  VulkanDescriptorAllocator* descriptor_allocator,
+				  uint32_t frame_count,
+				  uint32_t max_lights);
+		void createPipeline(const VkPipelineShaderStageCreateInfo& assign_shader_stage,
+							VkDescriptorSetLayout assign_set_layout,
+							VkPipelineLayout assign_pipeline_layout);
+		// copies the light records into this frame's region of the frame allocator
+		void uploadLights(uint32_t current_frame);
+		// view_offset locates this frame's view block in the frame allocator
+		void recordAssignment(VkCommandBuffer command_buffer, uint32_t current_frame, uint32_t view_offset);
+		void destroy();
+	};
+}
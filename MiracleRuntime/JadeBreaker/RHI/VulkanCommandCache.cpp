@@ -0,0 +1,97 @@
+#include "VulkanCommandCache.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <volk.h>
+
+namespace Sherphy
+{
+    void VulkanCommandCache::init(VulkanDevice* device, uint32_t frame_count)
+    {
+        m_device = device;
+        m_frame_count = frame_count;
+        m_replays = 0;
+        m_recordings = 0;
+    }
+
+    VkCommandBuffer VulkanCommandCache::get(const std::string& name,
+                                            uint32_t current_frame,
+                                            VkRenderPass render_pass,
+                                            uint32_t subpass,
+                                            const CommandSignature& signature,
+                                            const RecordFunction& record)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE(isInitialized(), "command cache is not initialized");
+        std::vector<Entry>& entries = m_entries[name];
+        if (entries.empty())
+        {
+            entries.resize(m_frame_count);
+        }
+
+        Entry& entry = entries[current_frame];
+        if (entry.valid && entry.signature == signature)
+        {
+            m_replays++;
+            return entry.command_buffer;
+        }
+
+        if (entry.command_buffer == VK_NULL_HANDLE)
+        {
+            entry.command_buffer = m_device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+        }
+        else
+        {
+            // the frame slot was waited on, its last submission is done with the recording
+            vkResetCommandBuffer(entry.command_buffer, 0);
+        }
+
+        VkCommandBufferInheritanceInfo inheritance_info{};
+        inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance_info.renderPass = render_pass;
+        inheritance_info.subpass = subpass;
+        inheritance_info.framebuffer = VK_NULL_HANDLE;
+
+        VkCommandBufferBeginInfo begin_info{};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        begin_info.pInheritanceInfo = &inheritance_info;
+        SHERPHY_EXCEPTION_IF_FALSE(vkBeginCommandBuffer(entry.command_buffer, &begin_info) == VK_SUCCESS, "failed to begin recording secondary command buffer!");
+        record(entry.command_buffer);
+        SHERPHY_EXCEPTION_IF_FALSE(vkEndCommandBuffer(entry.command_buffer) == VK_SUCCESS, "failed to record secondary command buffer!");
+
+        entry.signature = signature;
+        entry.valid = true;
+        m_recordings++;
+        return entry.command_buffer;
+    }
+
+    void VulkanCommandCache::invalidate()
+    {
+        for (auto& named_entries : m_entries)
+        {
+            for (Entry& entry : named_entries.second)
+            {
+                entry.valid = false;
+            }
+        }
+    }
+
+    void VulkanCommandCache::destroy()
+    {
+        if (!isInitialized())
+        {
+            return;
+        }
+        for (auto& named_entries : m_entries)
+        {
+            for (Entry& entry : named_entries.second)
+            {
+                if (entry.command_buffer != VK_NULL_HANDLE)
+                {
+                    vkFreeCommandBuffers(m_device->m_logical_device, m_device->m_command_pool, 1, &entry.command_buffer);
+                }
+            }
+        }
+        m_entries.clear();
+        m_device = nullptr;
+    }
+}
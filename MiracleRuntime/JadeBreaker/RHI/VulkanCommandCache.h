@@ -0,0 +1,49 @@
+#pragma once
+#include "VulkanDevice.h"
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Sherphy
+{
+	// everything a recording depends on, handles and values flattened to 64 bit
+	using CommandSignature = std::vector<uint64_t>;
+
+	// Secondary command buffers recorded once and replayed every frame while their
+	// inputs stay the same. The caller describes the inputs of a recording as a
+	// signature; a different signature records again, invalidate() drops every
+	// recording. Each frame slot keeps its own copy, so re-recording never touches
+	// a command buffer that is still pending. Recordings inherit the render pass
+	// without a framebuffer and replay into any framebuffer of a compatible pass.
+	struct VulkanCommandCache
+	{
+		using RecordFunction = std::function<void(VkCommandBuffer)>;
+
+		struct Entry
+		{
+			VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+			CommandSignature signature;
+			bool valid = false;
+		};
+
+		VulkanDevice* m_device = nullptr;
+		uint32_t m_frame_count = 0;
+		std::unordered_map<std::string, std::vector<Entry>> m_entries; // one per frame slot
+		uint64_t m_replays = 0;
+		uint64_t m_recordings = 0;
+
+		bool isInitialized() const { return m_device != nullptr; }
+		void init(VulkanDevice* device, uint32_t frame_count);
+		// the cached recording for the frame slot, recorded first if missing or stale
+		VkCommandBuffer get(const std::string& name,
+							uint32_t current_frame,
+							VkRenderPass render_pass,
+							uint32_t subpass,
+							const CommandSignature& signature,
+							const RecordFunction& record);
+		void invalidate();
+		void destroy();
+	};
+}
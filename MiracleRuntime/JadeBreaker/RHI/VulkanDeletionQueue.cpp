@@ -0,0 +1,108 @@
+#include "VulkanDeletionQueue.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <volk.h>
+
+#include <algorithm>
+#include <iterator>
+
+namespace Sherphy
+{
+    void VulkanDeletionQueue::init(VulkanDevice* device)
+    {
+        m_device = device;
+        m_frame_number = 0;
+        m_completed_frames = 0;
+    }
+
+    void VulkanDeletionQueue::pushAfterFrame(uint64_t last_use_frame, std::function<void()> release)
+    {
+        m_entries.push_back({ true, last_use_frame, TimelinePoint{}, std::move(release) });
+    }
+
+    void VulkanDeletionQueue::push(std::function<void()> release)
+    {
+        pushAfterFrame(m_frame_number, std::move(release));
+    }
+
+    void VulkanDeletionQueue::pushAfterPoint(const TimelinePoint& point, std::function<void()> release)
+    {
+        m_entries.push_back({ false, 0, point, std::move(release) });
+    }
+
+    void VulkanDeletionQueue::destroyBuffer(const VulkanBuffer& buffer, uint64_t last_use_frame)
+    {
+        VulkanBuffer released_buffer = buffer;
+        pushAfterFrame(last_use_frame, [released_buffer]() mutable {
+            if (released_buffer.mapped != nullptr)
+            {
+                released_buffer.unmap();
+            }
+            released_buffer.destroy();
+        });
+    }
+
+    void VulkanDeletionQueue::destroyImage(VkImage image, VkDeviceMemory memory, VkImageView image_view, uint64_t last_use_frame)
+    {
+        VkDevice logical_device = m_device->m_logical_device;
+        pushAfterFrame(last_use_frame, [logical_device, image, memory, image_view]() {
+            vkDestroyImageView(logical_device, image_view, nullptr);
+            vkDestroyImage(logical_device, image, nullptr);
+            vkFreeMemory(logical_device, memory, nullptr);
+        });
+    }
+
+    void VulkanDeletionQueue::endFrame(const TimelinePoint& submitted)
+    {
+        m_submitted_frames.push_back({ m_frame_number, submitted });
+        m_frame_number++;
+    }
+
+    void VulkanDeletionQueue::collect()
+    {
+        VulkanTimelineSync& timeline_sync = m_device->m_timeline_sync;
+        while (!m_submitted_frames.empty() && timeline_sync.isComplete(m_submitted_frames.front().point))
+        {
+            m_completed_frames = m_submitted_frames.front().frame + 1;
+            m_submitted_frames.pop_front();
+        }
+
+        // released entries are moved out first, a release may push new entries
+        std::vector<Entry> released;
+        auto kept = std::partition(m_entries.begin(), m_entries.end(), [this, &timeline_sync](const Entry& entry) {
+            return entry.frame_tagged ? entry.frame >= m_completed_frames : !timeline_sync.isComplete(entry.point);
+        });
+        std::move(kept, m_entries.end(), std::back_inserter(released));
+        m_entries.erase(kept, m_entries.end());
+        for (Entry& entry : released)
+        {
+            entry.release();
+        }
+    }
+
+    void VulkanDeletionQueue::flush()
+    {
+        if (!isInitialized())
+        {
+            return;
+        }
+        m_device->m_timeline_sync.waitIdle();
+        m_submitted_frames.clear();
+        m_completed_frames = m_frame_number;
+        while (!m_entries.empty())
+        {
+            std::vector<Entry> released = std::move(m_entries);
+            m_entries.clear();
+            for (Entry& entry : released)
+            {
+                entry.release();
+            }
+        }
+    }
+
+    void VulkanDeletionQueue::destroy()
+    {
+        flush();
+        m_device = nullptr;
+    }
+}
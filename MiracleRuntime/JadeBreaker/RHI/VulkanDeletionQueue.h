@@ -0,0 +1,57 @@
+#pragma once
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace Sherphy
+{
+	// Defers releasing gpu resources until the gpu is done with them, so buffers and
+	// images can go away mid-run without idling the device. An entry is tagged with
+	// the last frame that may use it, or with a timeline point for work outside the
+	// frame loop. Frames are numbered by the order they are submitted in; each submit
+	// reports its graphics timeline point, and once that point is reached every
+	// entry tagged with the frame or an earlier one is released.
+	struct VulkanDeletionQueue
+	{
+		struct Entry
+		{
+			bool frame_tagged;
+			uint64_t frame;
+			TimelinePoint point;
+			std::function<void()> release;
+		};
+
+		struct SubmittedFrame
+		{
+			uint64_t frame;
+			TimelinePoint point;
+		};
+
+		VulkanDevice* m_device = nullptr;
+		uint64_t m_frame_number = 0;    // frame being recorded, not submitted yet
+		uint64_t m_completed_frames = 0; // frames below this finished on the gpu
+		std::deque<SubmittedFrame> m_submitted_frames;
+		std::vector<Entry> m_entries;
+
+		bool isInitialized() const { return m_device != nullptr; }
+		void init(VulkanDevice* device);
+		uint64_t getFrameNumber() const { return m_frame_number; }
+		// released once the given frame finished
+		void pushAfterFrame(uint64_t last_use_frame, std::function<void()> release);
+		// released once the frame being recorded and everything before it finished
+		void push(std::function<void()> release);
+		void pushAfterPoint(const TimelinePoint& point, std::function<void()> release);
+		void destroyBuffer(const VulkanBuffer& buffer, uint64_t last_use_frame);
+		void destroyImage(VkImage image, VkDeviceMemory memory, VkImageView image_view, uint64_t last_use_frame);
+		// call after the frame was submitted with the point its submit signals
+		void endFrame(const TimelinePoint& submitted);
+		// releases every entry the gpu is done with, never waits
+		void collect();
+		// waits for all queues and releases everything, for shutdown
+		void flush();
+		void destroy();
+	};
+}
@@ -0,0 +1,215 @@
+#include "VulkanDescriptorAllocator.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <volk.h>
+
+#include <algorithm>
+
+namespace Sherphy
+{
+    void VulkanDescriptorAllocator::init(VulkanDevice* device, VulkanLayoutCache* layout_cache, uint32_t frame_count)
+    {
+        m_device = device;
+        m_layout_cache = layout_cache;
+        m_frame_pools.resize(frame_count);
+    }
+
+    VkDescriptorSet VulkanDescriptorAllocator::allocatePersistent(VkDescriptorSetLayout layout)
+    {
+        return allocate(m_persistent_pools[layout], layout);
+    }
+
+    VkDescriptorSet VulkanDescriptorAllocator::allocateFrame(uint32_t frame, VkDescriptorSetLayout layout, const std::vector<DescriptorWrite>& writes)
+    {
+        VkDescriptorSet descriptor_set = allocate(m_frame_pools[frame][layout], layout);
+        write(descriptor_set, writes);
+        return descriptor_set;
+    }
+
+    VkDescriptorSet VulkanDescriptorAllocator::getPersistentSet(VkDescriptorSetLayout layout, const std::vector<DescriptorWrite>& writes)
+    {
+        m_set_requests++;
+        std::vector<uint64_t> signature;
+        signature.push_back(reinterpret_cast<uint64_t>(layout));
+        for (const DescriptorWrite& descriptor_write : writes)
+        {
+            signature.push_back(descriptor_write.binding);
+            signature.push_back(descriptor_write.type);
+            signature.push_back(reinterpret_cast<uint64_t>(descriptor_write.buffer_info.buffer));
+            signature.push_back(descriptor_write.buffer_info.offset);
+            signature.push_back(descriptor_write.buffer_info.range);
+            signature.push_back(reinterpret_cast<uint64_t>(descriptor_write.image_info.sampler));
+            signature.push_back(reinterpret_cast<uint64_t>(descriptor_write.image_info.imageView));
+            signature.push_back(descriptor_write.image_info.imageLayout);
+            signature.push_back(reinterpret_cast<uint64_t>(descriptor_write.acceleration_structure));
+        }
+
+        std::vector<CachedSet>& bucket = m_cached_sets[VulkanLayoutCache::hashSignature(signature)];
+        for (const CachedSet& cached : bucket)
+        {
+            if (cached.signature == signature)
+            {
+                return cached.set;
+            }
+        }
+
+        VkDescriptorSet descriptor_set = allocatePersistent(layout);
+        write(descriptor_set, writes);
+        bucket.push_back({ signature, descriptor_set });
+        return descriptor_set;
+    }
+
+    // pools are only reset, a frame that needed many sets will need them again
+    void VulkanDescriptorAllocator::resetFrame(uint32_t frame)
+    {
+        for (auto& layout_pools : m_frame_pools[frame])
+        {
+            PoolList& pools = layout_pools.second;
+            pools.ready.insert(pools.ready.end(), pools.full.begin(), pools.full.end());
+            pools.full.clear();
+            for (VkDescriptorPool pool : pools.ready)
+            {
+                vkResetDescriptorPool(m_device->m_logical_device, pool, 0);
+            }
+        }
+    }
+
+    void VulkanDescriptorAllocator::destroy()
+    {
+        if (!isInitialized())
+        {
+            return;
+        }
+        for (auto& layout_pools : m_persistent_pools)
+        {
+            destroyPools(layout_pools.second);
+        }
+        for (auto& frame_pools : m_frame_pools)
+        {
+            for (auto& layout_pools : frame_pools)
+            {
+                destroyPools(layout_pools.second);
+            }
+        }
+        m_persistent_pools.clear();
+        m_frame_pools.clear();
+        m_cached_sets.clear();
+        m_device = nullptr;
+    }
+
+    // a failed allocation retires the pool and retries from a bigger one
+    VkDescriptorSet VulkanDescriptorAllocator::allocate(PoolList& pools, VkDescriptorSetLayout layout)
+    {
+        if (pools.sizes_per_set.empty())
+        {
+            for (const VkDescriptorSetLayoutBinding& binding : m_layout_cache->getSetBindings(layout))
+            {
+                auto pool_size = std::find_if(pools.sizes_per_set.begin(), pools.sizes_per_set.end(), [&binding](const VkDescriptorPoolSize& size) {
+                    return size.type == binding.descriptorType;
+                });
+                if (pool_size == pools.sizes_per_set.end())
+                {
+                    pools.sizes_per_set.push_back({ binding.descriptorType, 0 });
+                    pool_size = pools.sizes_per_set.end() - 1;
+                }
+                pool_size->descriptorCount += binding.descriptorCount;
+            }
+        }
+
+        VkDescriptorSetAllocateInfo alloc_info{};
+        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.descriptorSetCount = 1;
+        alloc_info.pSetLayouts = &layout;
+
+        while (true)
+        {
+            if (pools.ready.empty())
+            {
+                pools.ready.push_back(createPool(pools));
+                pools.sets_per_pool = std::min(pools.sets_per_pool * 2, k_max_sets_per_pool);
+            }
+            alloc_info.descriptorPool = pools.ready.back();
+
+            VkDescriptorSet descriptor_set;
+            VkResult result = vkAllocateDescriptorSets(m_device->m_logical_device, &alloc_info, &descriptor_set);
+            if (result == VK_SUCCESS)
+            {
+                m_set_allocations++;
+                return descriptor_set;
+            }
+            SHERPHY_EXCEPTION_IF_FALSE((result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL), "failed to allocate descriptor set!");
+            pools.full.push_back(pools.ready.back());
+            pools.ready.pop_back();
+        }
+    }
+
+    VkDescriptorPool VulkanDescriptorAllocator::createPool(const PoolList& pools)
+    {
+        std::vector<VkDescriptorPoolSize> pool_sizes = pools.sizes_per_set;
+        for (VkDescriptorPoolSize& pool_size : pool_sizes)
+        {
+            pool_size.descriptorCount *= pools.sets_per_pool;
+        }
+
+        VkDescriptorPoolCreateInfo pool_info{};
+        pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+        pool_info.pPoolSizes = pool_sizes.data();
+        pool_info.maxSets = pools.sets_per_pool;
+
+        VkDescriptorPool pool;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateDescriptorPool(m_device->m_logical_device, &pool_info, nullptr, &pool) == VK_SUCCESS, "failed to create descriptor pool!");
+        m_pool_count++;
+        return pool;
+    }
+
+    void VulkanDescriptorAllocator::destroyPools(PoolList& pools)
+    {
+        for (VkDescriptorPool pool : pools.ready)
+        {
+            vkDestroyDescriptorPool(m_device->m_logical_device, pool, nullptr);
+        }
+        for (VkDescriptorPool pool : pools.full)
+        {
+            vkDestroyDescriptorPool(m_device->m_logical_device, pool, nullptr);
+        }
+        pools.ready.clear();
+        pools.full.clear();
+    }
+
+    void VulkanDescriptorAllocator::write(VkDescriptorSet descriptor_set, const std::vector<DescriptorWrite>& writes)
+    {
+        // the infos are referenced by pointer until the update
+        std::vector<VkWriteDescriptorSetAccelerationStructureKHR> acceleration_structure_infos(writes.size());
+        std::vector<VkWriteDescriptorSet> descriptor_writes(writes.size());
+        for (size_t i = 0; i < writes.size(); i++)
+        {
+            VkWriteDescriptorSet& descriptor_write = descriptor_writes[i];
+            descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptor_write.dstSet = descriptor_set;
+            descriptor_write.dstBinding = writes[i].binding;
+            descriptor_write.dstArrayElement = 0;
+            descriptor_write.descriptorType = writes[i].type;
+            descriptor_write.descriptorCount = 1;
+            switch (writes[i].type)
+            {
+            case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR:
+                acceleration_structure_infos[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
+                acceleration_structure_infos[i].accelerationStructureCount = 1;
+                acceleration_structure_infos[i].pAccelerationStructures = &writes[i].acceleration_structure;
+                descriptor_write.pNext = &acceleration_structure_infos[i];
+                break;
+            case VK_DESCRIPTOR_TYPE_SAMPLER:
+            case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+            case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+            case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+                descriptor_write.pImageInfo = &writes[i].image_info;
+                break;
+            default:
+                descriptor_write.pBufferInfo = &writes[i].buffer_info;
+                break;
+            }
+        }
+        vkUpdateDescriptorSets(m_device->m_logical_device, static_cast<uint32_t>(descriptor_writes.size()), descriptor_writes.data(), 0, nullptr);
+    }
+}
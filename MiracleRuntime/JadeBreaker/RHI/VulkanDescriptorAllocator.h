@@ -0,0 +1,73 @@
+#pragma once
+#include "VulkanDevice.h"
+#include "VulkanLayoutCache.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace Sherphy
+{
+	// one binding of a descriptor set write, only the info matching the type is read
+	struct DescriptorWrite
+	{
+		uint32_t binding = 0;
+		VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		VkDescriptorBufferInfo buffer_info{};
+		VkDescriptorImageInfo image_info{};
+		VkAccelerationStructureKHR acceleration_structure = VK_NULL_HANDLE;
+	};
+
+	// Descriptor sets of layouts from the layout cache. Every layout has its own list
+	// of pools sized from its bindings; when a pool runs out the next one is created
+	// with twice the sets, up to k_max_sets_per_pool. Frame sets come from the pools of
+	// a frame slot and are released together by resetFrame once the slot is free
+	// again, so per frame allocation is a pointer bump in the driver. Persistent sets
+	// are cached by the hash of their layout and writes, the same writes give back
+	// the same set.
+	struct VulkanDescriptorAllocator
+	{
+		static const uint32_t k_initial_sets_per_pool = 16;
+		static const uint32_t k_max_sets_per_pool = 4096;
+
+		struct PoolList
+		{
+			std::vector<VkDescriptorPoolSize> sizes_per_set;
+			std::vector<VkDescriptorPool> ready;
+			std::vector<VkDescriptorPool> full;
+			uint32_t sets_per_pool = k_initial_sets_per_pool;
+		};
+
+		struct CachedSet
+		{
+			std::vector<uint64_t> signature;
+			VkDescriptorSet set;
+		};
+
+		VulkanDevice* m_device = nullptr;
+		VulkanLayoutCache* m_layout_cache = nullptr;
+		std::unordered_map<VkDescriptorSetLayout, PoolList> m_persistent_pools;
+		std::vector<std::unordered_map<VkDescriptorSetLayout, PoolList>> m_frame_pools;
+		// buckets by hash, the signature tells collisions apart
+		std::unordered_map<uint64_t, std::vector<CachedSet>> m_cached_sets;
+
+		uint32_t m_pool_count = 0;
+		uint32_t m_set_requests = 0;
+		uint32_t m_set_allocations = 0;
+
+		bool isInitialized() const { return m_device != nullptr; }
+		void init(VulkanDevice* device, VulkanLayoutCache* layout_cache, uint32_t frame_count);
+		// lives until destroy, written by the caller
+		VkDescriptorSet allocatePersistent(VkDescriptorSetLayout layout);
+		// valid until the next resetFrame of the slot
+		VkDescriptorSet allocateFrame(uint32_t frame, VkDescriptorSetLayout layout, const std::vector<DescriptorWrite>& writes);
+		VkDescriptorSet getPersistentSet(VkDescriptorSetLayout layout, const std::vector<DescriptorWrite>& writes);
+		// the frame slot finished on the gpu, its sets are released in bulk
+		void resetFrame(uint32_t frame);
+		void destroy();
+
+		VkDescriptorSet allocate(PoolList& pools, VkDescriptorSetLayout layout);
+		VkDescriptorPool createPool(const PoolList& pools);
+		void destroyPools(PoolList& pools);
+		void write(VkDescriptorSet descriptor_set, const std::vector<DescriptorWrite>& writes);
+	};
+}
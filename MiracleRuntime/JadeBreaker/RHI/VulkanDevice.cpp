@@ -2,6 +2,7 @@
 #include "VulkanInitializer.h"
 
 #include <volk.h>
+#include <algorithm>
 #include <set>
 
 namespace Sherphy 
@@ -12,12 +13,20 @@ namespace Sherphy
 
         std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
         std::set<uint32_t> unique_queue_families = { m_queue_family_indices.graphics_family.value(), m_queue_family_indices.present_family.value() };
+        if (m_queue_family_indices.compute_family.has_value())
+        {
+            unique_queue_families.insert(m_queue_family_indices.compute_family.value());
+        }
+        if (m_queue_family_indices.transfer_family.has_value())
+        {
+            unique_queue_families.insert(m_queue_family_indices.transfer_family.value());
+        }
 
         for (uint32_t queue_family : unique_queue_families)
         {
             VkDeviceQueueCreateInfo queue_create_info{};
             queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-            queue_create_info.queueFamilyIndex = m_queue_family_indices.graphics_family.value();
+            queue_create_info.queueFamilyIndex = queue_family;
             queue_create_info.queueCount = 1;
             queue_create_info.pQueuePriorities = &m_queue_priority;
             queue_create_infos.push_back(queue_create_info);
@@ -50,7 +59,72 @@ namespace Sherphy
 
 
         SHERPHY_EXCEPTION_IF_FALSE((vkCreateDevice(m_physical_device, &create_info, nullptr, &m_logical_device) == VK_SUCCESS), "faild to create logical device");
-        m_command_pool = createCommandPool();
+        m_command_pool = createCommandPool(getQueueFamily(QueueType::Graphics));
+        if (hasDedicatedQueue(QueueType::Compute))
+        {
+            m_compute_command_pool = createCommandPool(getQueueFamily(QueueType::Compute));
+        }
+        if (hasDedicatedQueue(QueueType::Transfer))
+        {
+            m_transfer_command_pool = createCommandPool(getQueueFamily(QueueType::Transfer));
+        }
+
+        m_buffer_queue_families.clear();
+        for (uint32_t queue_type = 0; queue_type < static_cast<uint32_t>(QueueType::Count); queue_type++)
+        {
+            uint32_t queue_family = getQueueFamily(static_cast<QueueType>(queue_type));
+            if (std::find(m_buffer_queue_families.begin(), m_buffer_queue_families.end(), queue_family) == m_buffer_queue_families.end())
+            {
+                m_buffer_queue_families.push_back(queue_family);
+            }
+        }
+    }
+
+    bool VulkanDevice::hasDedicatedQueue(QueueType queue_type) const
+    {
+        switch (queue_type)
+        {
+        case QueueType::Compute:
+            return m_queue_family_indices.compute_family.has_value();
+        case QueueType::Transfer:
+            return m_queue_family_indices.transfer_family.has_value();
+        default:
+            return true;
+        }
+    }
+
+    uint32_t VulkanDevice::getQueueFamily(QueueType queue_type) const
+    {
+        if (!hasDedicatedQueue(queue_type))
+        {
+            return m_queue_family_indices.graphics_family.value();
+        }
+        switch (queue_type)
+        {
+        case QueueType::Compute:
+            return m_queue_family_indices.compute_family.value();
+        case QueueType::Transfer:
+            return m_queue_family_indices.transfer_family.value();
+        default:
+            return m_queue_family_indices.graphics_family.value();
+        }
+    }
+
+    VkCommandPool VulkanDevice::getCommandPool(QueueType queue_type) const
+    {
+        if (!hasDedicatedQueue(queue_type))
+        {
+            return m_command_pool;
+        }
+        switch (queue_type)
+        {
+        case QueueType::Compute:
+            return m_compute_command_pool;
+        case QueueType::Transfer:
+            return m_transfer_command_pool;
+        default:
+            return m_command_pool;
+        }
     }
 
 
@@ -71,10 +145,18 @@ namespace Sherphy
                 indices.graphics_family = i;
             }
 
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
-            if (present_support)
+            // without a surface nothing is presented, the graphics queue stands in
+            if (surface == VK_NULL_HANDLE)
             {
-                indices.present_family = i;
+                indices.present_family = indices.graphics_family;
+            }
+            else
+            {
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
+                if (present_support)
+                {
+                    indices.present_family = i;
+                }
             }
 
             if (indices.isComplete())
@@ -83,6 +165,21 @@ namespace Sherphy
             }
         }
 
+        // a compute family without graphics runs async next to it, a transfer family with
+        // neither is usually a copy engine that streams without taking shader time
+        for (size_t i = 0; i < m_device_queue_families.size(); i++)
+        {
+            VkQueueFlags flags = m_device_queue_families[i].queueFlags;
+            if (!indices.compute_family.has_value() && (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+            {
+                indices.compute_family = static_cast<uint32_t>(i);
+            }
+            if (!indices.transfer_family.has_value() && (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+            {
+                indices.transfer_family = static_cast<uint32_t>(i);
+            }
+        }
+
         return indices;
     }
 
@@ -96,7 +193,17 @@ namespace Sherphy
         buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         buffer_info.size = size;
         buffer_info.usage = usage;
-        buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        // shared between the queue families so async compute and transfer need no ownership transfers
+        if (m_buffer_queue_families.size() > 1)
+        {
+            buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            buffer_info.queueFamilyIndexCount = static_cast<uint32_t>(m_buffer_queue_families.size());
+            buffer_info.pQueueFamilyIndices = m_buffer_queue_families.data();
+        }
+        else
+        {
+            buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        }
 
         SHERPHY_EXCEPTION_IF_FALSE(vkCreateBuffer(m_logical_device, &buffer_info, nullptr, &buffer.buffer) == VK_SUCCESS, "failed to create vertex buffer!");
 
@@ -128,9 +235,9 @@ namespace Sherphy
         return buffer.bind();
     }
 
-    VkCommandBuffer VulkanDevice::createCommandBuffer(VkCommandBufferLevel level, bool begin, VkCommandBufferUsageFlags flags)
+    VkCommandBuffer VulkanDevice::createCommandBuffer(VkCommandBufferLevel level, bool begin, VkCommandBufferUsageFlags flags, QueueType queue_type)
     {
-        VkCommandBufferAllocateInfo alloc_info = vki::commandBufferAllocateInfo(m_command_pool, level, 1);
+        VkCommandBufferAllocateInfo alloc_info = vki::commandBufferAllocateInfo(getCommandPool(queue_type), level, 1);
 
         VkCommandBuffer command_buffer;
         vkAllocateCommandBuffers(m_logical_device, &alloc_info, &command_buffer);
@@ -147,22 +254,41 @@ namespace Sherphy
 
     void VulkanDevice::createCommandBuffers(uint32_t frame_count)
     {
-        m_command_buffers.resize(frame_count);
-        VkCommandBufferAllocateInfo alloc_info{};
-        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        alloc_info.commandPool = m_command_pool;
-        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        alloc_info.commandBufferCount = static_cast<uint32_t>(m_command_buffers.size());
+        for (auto& frame_command_buffers : m_frame_command_buffers)
+        {
+            frame_command_buffers.resize(frame_count);
+        }
+        for (uint32_t frame = 0; frame < frame_count; frame++)
+        {
+            getFrameCommandBuffer(QueueType::Graphics, frame, 0);
+        }
+    }
 
-        SHERPHY_EXCEPTION_IF_FALSE(vkAllocateCommandBuffers(m_logical_device, &alloc_info, m_command_buffers.data()) == VK_SUCCESS, "failed to allocate command buffers!");
+    // allocated on first use, a frame usually submits a single batch per queue
+    VkCommandBuffer VulkanDevice::getFrameCommandBuffer(QueueType queue_type, uint32_t frame, uint32_t index)
+    {
+        std::vector<VkCommandBuffer>& command_buffers = m_frame_command_buffers[static_cast<uint32_t>(queue_type)][frame];
+        while (command_buffers.size() <= index)
+        {
+            VkCommandBufferAllocateInfo alloc_info{};
+            alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            alloc_info.commandPool = getCommandPool(queue_type);
+            alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            alloc_info.commandBufferCount = 1;
+
+            VkCommandBuffer command_buffer;
+            SHERPHY_EXCEPTION_IF_FALSE(vkAllocateCommandBuffers(m_logical_device, &alloc_info, &command_buffer) == VK_SUCCESS, "failed to allocate command buffers!");
+            command_buffers.push_back(command_buffer);
+        }
+        return command_buffers[index];
     }
 
-    VkCommandPool VulkanDevice::createCommandPool()
+    VkCommandPool VulkanDevice::createCommandPool(uint32_t queue_family)
     {
         VkCommandPoolCreateInfo pool_info{};
         pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
         pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-        pool_info.queueFamilyIndex = m_queue_family_indices.graphics_family.value();
+        pool_info.queueFamilyIndex = queue_family;
 
         VkCommandPool pool;
         SHERPHY_EXCEPTION_IF_FALSE(vkCreateCommandPool(m_logical_device, &pool_info, nullptr, &pool) == VK_SUCCESS, "failed to create command pool!");
@@ -170,6 +296,24 @@ namespace Sherphy
 
     }
 
+    // frame command buffers go with their pools
+    void VulkanDevice::destroyCommandPools()
+    {
+        vkDestroyCommandPool(m_logical_device, m_command_pool, nullptr);
+        if (m_compute_command_pool != VK_NULL_HANDLE)
+        {
+            vkDestroyCommandPool(m_logical_device, m_compute_command_pool, nullptr);
+        }
+        if (m_transfer_command_pool != VK_NULL_HANDLE)
+        {
+            vkDestroyCommandPool(m_logical_device, m_transfer_command_pool, nullptr);
+        }
+        for (auto& frame_command_buffers : m_frame_command_buffers)
+        {
+            frame_command_buffers.clear();
+        }
+    }
+
     uint32_t VulkanDevice::findMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties)
     {
         for (uint32_t i = 0; i < m_physical_device_memory_properties.memoryTypeCount; i++) {
@@ -190,28 +334,19 @@ namespace Sherphy
         return;
     }
 
-    VkCommandBuffer VulkanDevice::beginSingleTimeCommands()
+    VkCommandBuffer VulkanDevice::beginSingleTimeCommands(QueueType queue_type)
     {
-        return createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, true);
+        return createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, true, queue_type);
     }
 
-    void VulkanDevice::endSingleTimeCommands(VkCommandBuffer command_buffer, VkQueue queue)
+    void VulkanDevice::endSingleTimeCommands(VkCommandBuffer command_buffer, QueueType queue_type)
     {
         vkEndCommandBuffer(command_buffer);
 
-        VkSubmitInfo submit_info = vki::submitInfo();
-        submit_info.commandBufferCount = 1;
-        submit_info.pCommandBuffers = &command_buffer;
-
-        VkFenceCreateInfo fence_info = vki::fenceCreateInfo(VK_FLAGS_NONE);
-        VkFence fence;
-        SHERPHY_ASSERT(vkCreateFence(m_logical_device, &fence_info, nullptr, &fence), VK_SUCCESS, "Vk Single Time Command Fence Creation Failed");
-        SHERPHY_ASSERT(vkQueueSubmit(queue, 1, &submit_info, fence), VK_SUCCESS, "Queue Submit Failure");
-        SHERPHY_ASSERT(vkWaitForFences(m_logical_device, 1, &fence, VK_TRUE, UINT64_MAX), VK_SUCCESS, "Fence Wait Time Out");
-
-        vkDestroyFence(m_logical_device, fence, nullptr);
+        TimelinePoint point = m_timeline_sync.submit(queue_type, { command_buffer });
+        m_timeline_sync.wait(point);
 
-        vkFreeCommandBuffers(m_logical_device, m_command_pool, 1, &command_buffer);
+        vkFreeCommandBuffers(m_logical_device, getCommandPool(queue_type), 1, &command_buffer);
     }
 
     uint64_t VulkanDevice::getBufferDeviceAddress(VulkanBuffer buffer)
@@ -1,5 +1,6 @@
 #pragma once
 #include "VulkanBuffer.h"
+#include "VulkanTimelineSync.h"
 #include <vulkan/vulkan.h>
 
 #include <vector>
@@ -10,6 +11,9 @@ namespace Sherphy
 	struct QueueFamilyIndices {
 		std::optional<uint32_t> graphics_family;
 		std::optional<uint32_t> present_family;
+		// families without graphics, left empty when the device has none and the work shares graphics
+		std::optional<uint32_t> compute_family;
+		std::optional<uint32_t> transfer_family;
 
 		bool isComplete() {
 			return graphics_family.has_value() && present_family.has_value();
@@ -23,11 +27,18 @@ namespace Sherphy
 		VkDevice m_logical_device;
 		//------------------ Command Buffer ----------------------------------
 		VkCommandPool m_command_pool;
-		std::vector<VkCommandBuffer> m_command_buffers;
+		VkCommandPool m_compute_command_pool = VK_NULL_HANDLE;
+		VkCommandPool m_transfer_command_pool = VK_NULL_HANDLE;
+		// per queue type and frame slot, one command buffer per batch the frame submits to the queue
+		std::vector<std::vector<VkCommandBuffer>> m_frame_command_buffers[static_cast<uint32_t>(QueueType::Count)];
+		// families buffers are shared between, buffers go concurrent once there is more than one
+		std::vector<uint32_t> m_buffer_queue_families;
 		//queue properties
 		float m_queue_priority = 1.0f;
 		QueueFamilyIndices m_queue_family_indices;
 		std::vector<VkQueueFamilyProperties> m_device_queue_families;
+		// cpu and cross queue synchronization, initialized once the queues are known
+		VulkanTimelineSync m_timeline_sync;
 
 
 		// physical device have this properties
@@ -44,12 +55,18 @@ namespace Sherphy
 								 VkPhysicalDeviceFeatures enabled_features,
 								 const std::vector<const char*>& enabled_extensions,
 								 void* pNext_chain, bool use_swap_chain = true);
-		VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, bool begin = false, VkCommandBufferUsageFlags flags = 0);
-		VkCommandBuffer beginSingleTimeCommands();
-		void endSingleTimeCommands(VkCommandBuffer commandBuffer, VkQueue queue);
+		VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, bool begin = false, VkCommandBufferUsageFlags flags = 0, QueueType queue_type = QueueType::Graphics);
+		VkCommandBuffer beginSingleTimeCommands(QueueType queue_type = QueueType::Graphics);
+		// submits on the timeline of the queue type and waits for that point
+		void endSingleTimeCommands(VkCommandBuffer commandBuffer, QueueType queue_type = QueueType::Graphics);
 
 		void createCommandBuffers(uint32_t frame_count);
-		VkCommandPool createCommandPool();
+		VkCommandBuffer getFrameCommandBuffer(QueueType queue_type, uint32_t frame, uint32_t index);
+		VkCommandPool createCommandPool(uint32_t queue_family);
+		void destroyCommandPools();
+		bool hasDedicatedQueue(QueueType queue_type) const;
+		uint32_t getQueueFamily(QueueType queue_type) const;
+		VkCommandPool getCommandPool(QueueType queue_type) const;
 		uint32_t findMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties);
 		QueueFamilyIndices findQueueFamilies(VkPhysicalDevice& physical_device, VkSurfaceKHR surface);
 		VkResult createBuffer(VkDeviceSize size,
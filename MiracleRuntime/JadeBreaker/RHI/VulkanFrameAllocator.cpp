@@ -0,0 +1,55 @@
+#include "VulkanFrameAllocator.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <volk.h>
+#include <algorithm>
+
+namespace Sherphy
+{
+    void VulkanFrameAllocator::init(VulkanDevice* device, uint32_t frame_count, VkDeviceSize frame_capacity)
+    {
+        m_device = device;
+        m_frame_count = frame_count;
+
+        // a single alignment that satisfies both uniform and storage dynamic offsets
+        const VkPhysicalDeviceLimits& limits = m_device->m_physical_device_properties.limits;
+        m_alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+        m_frame_capacity = (frame_capacity + m_alignment - 1) & ~(m_alignment - 1);
+
+        SHERPHY_ASSERT(m_device->createBuffer(m_frame_capacity * m_frame_count,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            m_buffer), VK_SUCCESS, "");
+        SHERPHY_ASSERT(m_buffer.map(), VK_SUCCESS, "");
+    }
+
+    void VulkanFrameAllocator::beginFrame(uint32_t current_frame)
+    {
+        m_current_frame = current_frame;
+        m_head = 0;
+    }
+
+    FrameAllocation VulkanFrameAllocator::allocate(VkDeviceSize size)
+    {
+        VkDeviceSize aligned_size = (size + m_alignment - 1) & ~(m_alignment - 1);
+        SHERPHY_EXCEPTION_IF_FALSE((m_head + aligned_size <= m_frame_capacity), "frame allocator is out of memory for this frame");
+
+        VkDeviceSize offset = m_frame_capacity * m_current_frame + m_head;
+        m_head += aligned_size;
+
+        FrameAllocation allocation{};
+        allocation.offset = static_cast<uint32_t>(offset);
+        allocation.mapped = static_cast<char*>(m_buffer.mapped) + offset;
+        return allocation;
+    }
+
+    void VulkanFrameAllocator::destroy()
+    {
+        if (!isInitialized())
+        {
+            return;
+        }
+        m_buffer.unmap();
+        m_buffer.destroy();
+    }
+}
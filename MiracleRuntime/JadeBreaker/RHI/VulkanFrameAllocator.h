@@ -0,0 +1,43 @@
+#pragma once
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+namespace Sherphy
+{
+	struct FrameAllocation
+	{
+		uint32_t offset = 0; // dynamic offset into the allocator buffer
+		void* mapped = nullptr;
+	};
+
+	// Linear allocator over one persistently mapped buffer split into a region per
+	// frame in flight. Per frame data (view block, instance transforms, per object
+	// constants) is bumped into the region of the current frame and bound through
+	// dynamic offsets, the region is rewound when its frame comes around again.
+	struct VulkanFrameAllocator
+	{
+		VulkanDevice* m_device = nullptr;
+		VulkanBuffer m_buffer;
+		uint32_t m_frame_count = 0;
+		VkDeviceSize m_frame_capacity = 0;
+		VkDeviceSize m_alignment = 0;
+
+		uint32_t m_current_frame = 0;
+		VkDeviceSize m_head = 0;
+
+		bool isInitialized() const { return m_device != nullptr; }
+		void init(VulkanDevice* device, uint32_t frame_count, VkDeviceSize frame_capacity);
+		// only call once this frame slot has been waited on
+		void beginFrame(uint32_t current_frame);
+		FrameAllocation allocate(VkDeviceSize size);
+		template<typename T>
+		uint32_t push(const T& data)
+		{
+			FrameAllocation allocation = allocate(sizeof(T));
+			SHERPHY_MEMCPY(allocation.mapped, &data, sizeof(T));
+			return allocation.offset;
+		}
+		void destroy();
+	};
+}
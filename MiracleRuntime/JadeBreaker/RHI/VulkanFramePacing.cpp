@@ -0,0 +1,86 @@
+#include "VulkanFramePacing.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <algorithm>
+
+namespace Sherphy
+{
+    void FrameTelemetry::History::add(float ms)
+    {
+        if (samples.size() < k_history)
+        {
+            samples.push_back(ms);
+        }
+        else
+        {
+            samples[count % k_history] = ms;
+        }
+        count++;
+    }
+
+    void FrameTelemetry::History::compute(float& avg_ms, float& p99_ms) const
+    {
+        if (samples.empty())
+        {
+            avg_ms = 0.0f;
+            p99_ms = 0.0f;
+            return;
+        }
+        std::vector<float> sorted = samples;
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for (float ms : sorted)
+        {
+            sum += ms;
+        }
+        avg_ms = static_cast<float>(sum / sorted.size());
+        p99_ms = sorted[std::min(sorted.size() - 1, (sorted.size() * 99) / 100)];
+    }
+
+    void FrameTelemetry::init(uint32_t slot_count)
+    {
+        m_slot_input_times.assign(slot_count, Clock::now());
+        m_slot_pending.assign(slot_count, false);
+    }
+
+    void FrameTelemetry::markInputSampled()
+    {
+        m_input_sample_time = Clock::now();
+    }
+
+    void FrameTelemetry::markFrameStart()
+    {
+        Clock::time_point now = Clock::now();
+        if (m_has_last_frame)
+        {
+            m_frame_times.add(std::chrono::duration<float, std::chrono::milliseconds::period>(now - m_last_frame_start).count());
+        }
+        m_last_frame_start = now;
+        m_has_last_frame = true;
+    }
+
+    void FrameTelemetry::markSubmitted(uint32_t slot)
+    {
+        m_slot_input_times[slot] = m_input_sample_time;
+        m_slot_pending[slot] = true;
+    }
+
+    void FrameTelemetry::markCompleted(uint32_t slot)
+    {
+        if (!m_slot_pending[slot])
+        {
+            return;
+        }
+        m_slot_pending[slot] = false;
+        m_input_latencies.add(std::chrono::duration<float, std::chrono::milliseconds::period>(Clock::now() - m_slot_input_times[slot]).count());
+    }
+
+    FramePacingStats FrameTelemetry::getStats() const
+    {
+        FramePacingStats stats;
+        m_frame_times.compute(stats.frame_avg_ms, stats.frame_p99_ms);
+        m_input_latencies.compute(stats.input_latency_avg_ms, stats.input_latency_p99_ms);
+        stats.frame_count = m_frame_times.count;
+        return stats;
+    }
+}
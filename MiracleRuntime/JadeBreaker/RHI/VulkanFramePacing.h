@@ -0,0 +1,67 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace Sherphy
+{
+	enum class PresentMode
+	{
+		Fifo,      // vsync, never tears, adds up to a frame of queueing
+		Mailbox,   // vsync with the newest frame replacing a queued one, falls back to fifo
+		Immediate, // no vsync, lowest latency, may tear, falls back to fifo
+	};
+
+	struct FramePacingSettings
+	{
+		uint32_t frames_in_flight = 2; // 1 to 3, more frames trade latency for throughput
+		PresentMode present_mode = PresentMode::Mailbox;
+		// wait for the gpu to finish the previous frame right before input is sampled,
+		// so the cpu never runs ahead and the sampled input is as fresh as possible
+		bool low_latency = false;
+	};
+
+	// averages and 99th percentiles over the recent history, in milliseconds
+	struct FramePacingStats
+	{
+		float frame_avg_ms = 0.0f;
+		float frame_p99_ms = 0.0f;
+		float input_latency_avg_ms = 0.0f;
+		float input_latency_p99_ms = 0.0f;
+		uint32_t frame_count = 0;
+	};
+
+	// Frame time is measured between the starts of consecutive frames. Input latency
+	// runs from input sampling to the moment the cpu first sees the frame that used
+	// it finished on the gpu, so it resolves to about one cpu frame.
+	struct FrameTelemetry
+	{
+		using Clock = std::chrono::high_resolution_clock;
+		static const uint32_t k_history = 256;
+
+		struct History
+		{
+			std::vector<float> samples;
+			uint32_t count = 0;
+			void add(float ms);
+			void compute(float& avg_ms, float& p99_ms) const;
+		};
+
+		History m_frame_times;
+		History m_input_latencies;
+		Clock::time_point m_last_frame_start{};
+		bool m_has_last_frame = false;
+		Clock::time_point m_input_sample_time = Clock::now();
+
+		std::vector<Clock::time_point> m_slot_input_times; // input sample time of the frame in each slot
+		std::vector<bool> m_slot_pending;
+
+		void init(uint32_t slot_count);
+		void markInputSampled();
+		void markFrameStart();
+		void markSubmitted(uint32_t slot);
+		// called with the slot whose timeline point was observed reached
+		void markCompleted(uint32_t slot);
+		FramePacingStats getStats() const;
+	};
+}
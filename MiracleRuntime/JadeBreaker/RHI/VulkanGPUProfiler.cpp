@@ -0,0 +1,241 @@
+#include "VulkanGPUProfiler.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <volk.h>
+
+#include <algorithm>
+
+namespace Sherphy
+{
+    void VulkanGPUProfiler::init(VulkanDevice* device, uint32_t frame_count, uint32_t queue_family_index, const std::string& frame_scope)
+    {
+        m_device = device;
+        m_frame_count = frame_count;
+        m_current_frame = 0;
+        m_frame_scope = frame_scope;
+
+        // timestamps are only meaningful if the queue writes them, the valid bits mask off the wrapped high part
+        uint32_t valid_bits = m_device->m_device_queue_families[queue_family_index].timestampValidBits;
+        m_supported = valid_bits > 0;
+        m_timestamp_mask = valid_bits >= 64 ? UINT64_MAX : ((uint64_t(1) << valid_bits) - 1);
+        m_timestamp_period = m_device->m_physical_device_properties.limits.timestampPeriod;
+        if (!m_supported)
+        {
+            return;
+        }
+
+        m_query_pools.resize(m_frame_count);
+        m_query_counts.assign(m_frame_count, 0);
+        m_frame_scopes.resize(m_frame_count);
+        for (uint32_t i = 0; i < m_frame_count; i++)
+        {
+            VkQueryPoolCreateInfo pool_info{};
+            pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            pool_info.queryCount = k_max_queries;
+            SHERPHY_EXCEPTION_IF_FALSE(vkCreateQueryPool(m_device->m_logical_device, &pool_info, nullptr, &m_query_pools[i]) == VK_SUCCESS, "failed to create timestamp query pool!");
+        }
+    }
+
+    void VulkanGPUProfiler::beginFrame(VkCommandBuffer command_buffer, uint32_t current_frame)
+    {
+        if (!m_supported)
+        {
+            return;
+        }
+        m_current_frame = current_frame;
+        collectResults(current_frame);
+
+        m_query_counts[current_frame] = 0;
+        m_frame_scopes[current_frame].clear();
+        m_open_scopes.clear();
+        vkCmdResetQueryPool(command_buffer, m_query_pools[current_frame], 0, k_max_queries);
+        if (!m_frame_scope.empty())
+        {
+            beginScope(command_buffer, m_frame_scope);
+        }
+    }
+
+    void VulkanGPUProfiler::endFrame(VkCommandBuffer command_buffer)
+    {
+        if (!m_supported)
+        {
+            return;
+        }
+        SHERPHY_EXCEPTION_IF_FALSE((m_open_scopes.size() == (m_frame_scope.empty() ? 0u : 1u)), "gpu profile scopes are not balanced!");
+        if (!m_frame_scope.empty())
+        {
+            endScope(command_buffer);
+        }
+    }
+
+    void VulkanGPUProfiler::beginScope(VkCommandBuffer command_buffer, const std::string& name, VkPipelineStageFlagBits stage)
+    {
+        if (!m_supported)
+        {
+            return;
+        }
+        // out of queries, the scope is dropped for this frame
+        uint32_t& query_count = m_query_counts[m_current_frame];
+        if (query_count + 2 > k_max_queries)
+        {
+            m_open_scopes.push_back(UINT32_MAX);
+            return;
+        }
+
+        std::vector<ScopeRecord>& scopes = m_frame_scopes[m_current_frame];
+        ScopeRecord record{};
+        record.pass_id = getPassId(name);
+        record.begin_query = query_count++;
+        record.end_query = query_count++;
+        m_open_scopes.push_back(static_cast<uint32_t>(scopes.size()));
+        scopes.push_back(record);
+        vkCmdWriteTimestamp(command_buffer, stage, m_query_pools[m_current_frame], record.begin_query);
+    }
+
+    void VulkanGPUProfiler::endScope(VkCommandBuffer command_buffer, VkPipelineStageFlagBits stage)
+    {
+        if (!m_supported)
+        {
+            return;
+        }
+        SHERPHY_EXCEPTION_IF_FALSE(!m_open_scopes.empty(), "gpu profile scope ended without a begin!");
+        uint32_t scope_index = m_open_scopes.back();
+        m_open_scopes.pop_back();
+        if (scope_index == UINT32_MAX)
+        {
+            return;
+        }
+        const ScopeRecord& record = m_frame_scopes[m_current_frame][scope_index];
+        vkCmdWriteTimestamp(command_buffer, stage, m_query_pools[m_current_frame], record.end_query);
+    }
+
+    uint32_t VulkanGPUProfiler::getPassId(const std::string& name)
+    {
+        auto found = m_pass_ids.find(name);
+        if (found != m_pass_ids.end())
+        {
+            return found->second;
+        }
+        uint32_t pass_id = static_cast<uint32_t>(m_pass_names.size());
+        m_pass_ids.emplace(name, pass_id);
+        m_pass_names.push_back(name);
+        m_history.emplace_back();
+        m_history.back().reserve(k_history);
+        m_history_counts.push_back(0);
+        return pass_id;
+    }
+
+    // the frame slot was waited on, every query written into its pool is available
+    void VulkanGPUProfiler::collectResults(uint32_t frame)
+    {
+        uint32_t query_count = m_query_counts[frame];
+        if (query_count == 0)
+        {
+            return;
+        }
+
+        std::vector<uint64_t> timestamps(query_count);
+        VkResult result = vkGetQueryPoolResults(m_device->m_logical_device, m_query_pools[frame], 0, query_count,
+            timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (result != VK_SUCCESS)
+        {
+            return;
+        }
+
+        // scopes opened several times in the frame add up to one sample
+        std::vector<float> frame_ms(m_pass_names.size(), -1.0f);
+        for (const ScopeRecord& record : m_frame_scopes[frame])
+        {
+            uint64_t begin = timestamps[record.begin_query] & m_timestamp_mask;
+            uint64_t end = timestamps[record.end_query] & m_timestamp_mask;
+            uint64_t ticks = (end - begin) & m_timestamp_mask;
+            float ms = static_cast<float>(static_cast<double>(ticks) * m_timestamp_period * 1e-6);
+            frame_ms[record.pass_id] = std::max(frame_ms[record.pass_id], 0.0f) + ms;
+        }
+
+        for (uint32_t pass_id = 0; pass_id < frame_ms.size(); pass_id++)
+        {
+            if (frame_ms[pass_id] < 0.0f)
+            {
+                continue;
+            }
+            std::vector<float>& history = m_history[pass_id];
+            uint32_t& count = m_history_counts[pass_id];
+            if (history.size() < k_history)
+            {
+                history.push_back(frame_ms[pass_id]);
+            }
+            else
+            {
+                history[count % k_history] = frame_ms[pass_id];
+            }
+            count++;
+        }
+        m_query_counts[frame] = 0;
+    }
+
+    GPUPassStats VulkanGPUProfiler::computeStats(uint32_t pass_id) const
+    {
+        GPUPassStats stats;
+        stats.name = m_pass_names[pass_id];
+        const std::vector<float>& history = m_history[pass_id];
+        if (history.empty())
+        {
+            return stats;
+        }
+
+        uint32_t count = m_history_counts[pass_id];
+        stats.last_ms = history[(count - 1) % k_history];
+        stats.sample_count = static_cast<uint32_t>(history.size());
+
+        std::vector<float> sorted = history;
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for (float ms : sorted)
+        {
+            sum += ms;
+        }
+        stats.min_ms = sorted.front();
+        stats.avg_ms = static_cast<float>(sum / sorted.size());
+        size_t p99_index = std::min(sorted.size() - 1, (sorted.size() * 99) / 100);
+        stats.p99_ms = sorted[p99_index];
+        return stats;
+    }
+
+    bool VulkanGPUProfiler::getStats(const std::string& name, GPUPassStats& stats) const
+    {
+        auto found = m_pass_ids.find(name);
+        if (found == m_pass_ids.end())
+        {
+            return false;
+        }
+        stats = computeStats(found->second);
+        return stats.sample_count > 0;
+    }
+
+    std::vector<GPUPassStats> VulkanGPUProfiler::getAllStats() const
+    {
+        std::vector<GPUPassStats> all_stats;
+        all_stats.reserve(m_pass_names.size());
+        for (uint32_t pass_id = 0; pass_id < m_pass_names.size(); pass_id++)
+        {
+            all_stats.push_back(computeStats(pass_id));
+        }
+        return all_stats;
+    }
+
+    void VulkanGPUProfiler::destroy()
+    {
+        if (!isInitialized())
+        {
+            return;
+        }
+        for (VkQueryPool query_pool : m_query_pools)
+        {
+            vkDestroyQueryPool(m_device->m_logical_device, query_pool, nullptr);
+        }
+        m_query_pools.clear();
+        m_device = nullptr;
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "VulkanDevice.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Sherphy
+{
+	// gpu time of one named scope over the recent history, in milliseconds
+	struct GPUPassStats
+	{
+		std::string name;
+		float last_ms = 0.0f;
+		float min_ms = 0.0f;
+		float avg_ms = 0.0f;
+		float p99_ms = 0.0f;
+		uint32_t sample_count = 0;
+	};
+
+	// Timestamp queries around named scopes of the frame on one queue family. Every
+	// frame in flight owns a query pool; its results are read when the frame slot
+	// is reused, so the numbers are frames-in-flight frames old and reading them
+	// never waits on the gpu. Scopes may nest, a scope that is opened several times
+	// in one frame accumulates its time.
+	struct VulkanGPUProfiler
+	{
+		static const uint32_t k_max_queries = 128;
+		static const uint32_t k_history = 256;
+
+		struct ScopeRecord
+		{
+			uint32_t pass_id;
+			uint32_t begin_query;
+			uint32_t end_query;
+		};
+
+		VulkanDevice* m_device = nullptr;
+		bool m_supported = false;
+		float m_timestamp_period = 1.0f; // nanoseconds per tick
+		uint64_t m_timestamp_mask = UINT64_MAX;
+		uint32_t m_frame_count = 0;
+		uint32_t m_current_frame = 0;
+		std::string m_frame_scope; // wraps every frame, empty for none
+
+		std::vector<VkQueryPool> m_query_pools;
+		std::vector<uint32_t> m_query_counts;
+		std::vector<std::vector<ScopeRecord>> m_frame_scopes;
+		std::vector<uint32_t> m_open_scopes; // indices into the scopes of the current frame
+
+		std::vector<std::string> m_pass_names;
+		std::unordered_map<std::string, uint32_t> m_pass_ids;
+		std::vector<std::vector<float>> m_history; // ring of the last k_history samples per pass
+		std::vector<uint32_t> m_history_counts;
+
+		bool isInitialized() const { return m_device != nullptr; }
+		void init(VulkanDevice* device, uint32_t frame_count, uint32_t queue_family_index, const std::string& frame_scope = "Frame");
+		// call first in the first command buffer of the frame on the queue, after its slot was waited on
+		void beginFrame(VkCommandBuffer command_buffer, uint32_t current_frame);
+		// call last in the last command buffer of the frame on the queue
+		void endFrame(VkCommandBuffer command_buffer);
+		void beginScope(VkCommandBuffer command_buffer, const std::string& name, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+		void endScope(VkCommandBuffer command_buffer, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+		bool getStats(const std::string& name, GPUPassStats& stats) const;
+		std::vector<GPUPassStats> getAllStats() const;
+		void destroy();
+
+		uint32_t getPassId(const std::string& name);
+		void collectResults(uint32_t frame);
+		GPUPassStats computeStats(uint32_t pass_id) const;
+	};
+
+	// writes a begin timestamp now and the end timestamp when it goes out of scope
+	struct GPUProfileScope
+	{
+		VulkanGPUProfiler* profiler;
+		VkCommandBuffer command_buffer;
+
+		GPUProfileScope(VulkanGPUProfiler& gpu_profiler, VkCommandBuffer command, const std::string& name)
+			: profiler(&gpu_profiler), command_buffer(command)
+		{
+			profiler->beginScope(command_buffer, name);
+		}
+		~GPUProfileScope()
+		{
+			profiler->endScope(command_buffer);
+		}
+	};
+}
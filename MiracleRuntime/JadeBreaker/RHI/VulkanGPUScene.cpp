@@ -0,0 +1,541 @@
+#include "VulkanGPUScene.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <volk.h>
+#include <algorithm>
+#include <string>
+
+namespace Sherphy
+{
+    namespace
+    {
+        void setModel(GPUInstanceRecord& instance, const Mat4x4& model)
+        {
+            instance.model = model;
+            instance.normal_model = Mat4x4(glm::transpose(glm::inverse(Mat3x3(model))));
+        }
+    }
+
+    uint32_t VulkanGPUScene::registerMesh(const std::vector<Vertex>& vertices,
+                                          uint32_t first_vertex,
+                                          uint32_t vertex_count,
+                                          uint32_t first_index,
+                                          uint32_t index_count,
+                                          const VertexQuantization& quantization,
+                                          const std::vector<Meshlet>& meshlets)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE((vertex_count > 0 && first_vertex + vertex_count <= vertices.size()), "gpu scene mesh vertex range out of bound");
+
+        // bounding sphere around the aabb center, loose but cheap and stable
+        Vec3 min_pos = vertices[first_vertex].pos;
+        Vec3 max_pos = vertices[first_vertex].pos;
+        for (uint32_t i = first_vertex; i < first_vertex + vertex_count; i++)
+        {
+            min_pos = glm::min(min_pos, vertices[i].pos);
+            max_pos = glm::max(max_pos, vertices[i].pos);
+        }
+        Vec3 center = (min_pos + max_pos) * 0.5f;
+        float radius = 0.0f;
+        for (uint32_t i = first_vertex; i < first_vertex + vertex_count; i++)
+        {
+            radius = std::max(radius, glm::length(vertices[i].pos - center));
+        }
+
+        GPUMeshRecord mesh{};
+        mesh.index_count = index_count;
+        mesh.first_index = first_index;
+        mesh.vertex_offset = static_cast<int32_t>(first_vertex);
+        mesh.first_meshlet = static_cast<uint32_t>(m_meshlets.size());
+        mesh.bounding_sphere = Vec4(center, radius);
+        mesh.quantization = quantization;
+
+        if (meshlets.empty())
+        {
+            // mesh imported without clusters is drawn as one cluster that is never backface culled
+            Meshlet whole_mesh{};
+            whole_mesh.bounding_sphere = mesh.bounding_sphere;
+            whole_mesh.cone_axis_cutoff = Vec4(0.0f, 0.0f, 1.0f, 1.0f);
+            whole_mesh.first_index = 0;
+            whole_mesh.index_count = index_count;
+            whole_mesh.vertex_count = vertex_count;
+            m_meshlets.push_back(whole_mesh);
+        }
+        else
+        {
+            m_meshlets.insert(m_meshlets.end(), meshlets.begin(), meshlets.end());
+        }
+        mesh.meshlet_count = static_cast<uint32_t>(m_meshlets.size()) - mesh.first_meshlet;
+        m_meshes.push_back(mesh);
+        return static_cast<uint32_t>(m_meshes.size() - 1);
+    }
+
+    uint32_t VulkanGPUScene::addInstance(uint32_t mesh_id, const Mat4x4& model, uint32_t material_id, uint32_t pipeline_id)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE((mesh_id < m_meshes.size()), "gpu scene instance refers to unknown mesh");
+        SHERPHY_EXCEPTION_IF_FALSE((pipeline_id < k_max_pipelines), "gpu scene instance refers to unknown pipeline");
+        SHERPHY_EXCEPTION_IF_FALSE((m_max_instances == 0 || m_instances.size() < m_max_instances),
+            "gpu scene holds at most " + std::to_string(m_max_instances) + " instances, the culling dispatches one workgroup per instance");
+
+        GPUInstanceRecord instance{};
+        setModel(instance, model);
+        instance.mesh_id = mesh_id;
+        instance.material_id = material_id;
+        m_instances.push_back(instance);
+        m_instance_pipelines.push_back(pipeline_id);
+
+        // batches are rebuilt before the next upload
+        m_batch_version++;
+        return static_cast<uint32_t>(m_instances.size() - 1);
+    }
+
+    void VulkanGPUScene::setInstanceTransform(uint32_t instance_id, const Mat4x4& model)
+    {
+        setModel(m_instances[instance_id], model);
+    }
+
+    void VulkanGPUScene::setInstance(uint32_t instance_id, uint32_t mesh_id, const Mat4x4& model, uint32_t material_id, uint32_t pipeline_id)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE((instance_id < m_instances.size()), "gpu scene instance does not exist");
+        SHERPHY_EXCEPTION_IF_FALSE((mesh_id < m_meshes.size()), "gpu scene instance refers to unknown mesh");
+        SHERPHY_EXCEPTION_IF_FALSE((pipeline_id < k_max_pipelines), "gpu scene instance refers to unknown pipeline");
+
+        setModel(m_instances[instance_id], model);
+        m_instances[instance_id].mesh_id = mesh_id;
+        m_instances[instance_id].material_id = material_id;
+        m_instance_pipelines[instance_id] = pipeline_id;
+        m_batch_version++;
+    }
+
+    // sort instance ids by pipeline, material and mesh, each run of equal keys is one batch;
+    // instance ids themselves never move so transforms stay where the cpu wrote them
+    void VulkanGPUScene::buildBatches()
+    {
+        std::vector<uint32_t> order(m_instances.size());
+        for (uint32_t i = 0; i < order.size(); i++)
+        {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [this](uint32_t lhs, uint32_t rhs) {
+            if (m_instance_pipelines[lhs] != m_instance_pipelines[rhs]) return m_instance_pipelines[lhs] < m_instance_pipelines[rhs];
+            if (m_instances[lhs].material_id != m_instances[rhs].material_id) return m_instances[lhs].material_id < m_instances[rhs].material_id;
+            return m_instances[lhs].mesh_id < m_instances[rhs].mesh_id;
+        });
+
+        m_batches.clear();
+        m_draw_slots.clear();
+        for (uint32_t pipeline_id = 0; pipeline_id < k_max_pipelines; pipeline_id++)
+        {
+            m_pipeline_draw_ranges[pipeline_id][0] = 0;
+            m_pipeline_draw_ranges[pipeline_id][1] = 0;
+        }
+
+        uint32_t visible_instance_offset = 0;
+        for (uint32_t begin = 0; begin < order.size();)
+        {
+            const GPUInstanceRecord& first = m_instances[order[begin]];
+            uint32_t pipeline_id = m_instance_pipelines[order[begin]];
+            uint32_t end = begin + 1;
+            while (end < order.size() &&
+                   m_instance_pipelines[order[end]] == pipeline_id &&
+                   m_instances[order[end]].material_id == first.material_id &&
+                   m_instances[order[end]].mesh_id == first.mesh_id)
+            {
+                end++;
+            }
+
+            const GPUMeshRecord& mesh = m_meshes[first.mesh_id];
+            GPUBatchRecord batch{};
+            batch.first_draw = static_cast<uint32_t>(m_draw_slots.size());
+            batch.instance_count = end - begin;
+            batch.pipeline_id = pipeline_id;
+
+            if (m_pipeline_draw_ranges[pipeline_id][1] == 0)
+            {
+                m_pipeline_draw_ranges[pipeline_id][0] = batch.first_draw;
+            }
+            m_pipeline_draw_ranges[pipeline_id][1] += mesh.meshlet_count;
+
+            // every meshlet may be visible for every instance of the batch
+            for (uint32_t i = 0; i < mesh.meshlet_count; i++)
+            {
+                const Meshlet& meshlet = m_meshlets[mesh.first_meshlet + i];
+                GPUDrawRecord draw{};
+                draw.command.indexCount = meshlet.index_count;
+                draw.command.instanceCount = 0;
+                draw.command.firstIndex = mesh.first_index + meshlet.first_index;
+                draw.command.vertexOffset = mesh.vertex_offset;
+                draw.command.firstInstance = visible_instance_offset;
+                draw.pipeline_id = pipeline_id;
+                draw.compact_base = m_pipeline_draw_ranges[pipeline_id][0];
+                m_draw_slots.push_back(draw);
+                visible_instance_offset += batch.instance_count;
+            }
+
+            for (uint32_t i = begin; i < end; i++)
+            {
+                m_instances[order[i]].batch_id = static_cast<uint32_t>(m_batches.size());
+            }
+            m_batches.push_back(batch);
+            begin = end;
+        }
+
+        SHERPHY_EXCEPTION_IF_FALSE((m_draw_slots.size() <= m_max_draws && visible_instance_offset <= m_max_draws), "gpu scene draw capacity exceeded");
+    }
+
+    void VulkanGPUScene::init(VulkanDevice* device, VulkanFrameAllocator* frame_allocator, uint32_t frame_count, uint32_t max_instances, uint32_t max_draws)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE((m_meshes.size() > 0), "gpu scene has no mesh registered");
+        m_device = device;
+        m_frame_allocator = frame_allocator;
+        m_frame_count = frame_count;
+        // the culling dispatches one workgroup per instance along x
+        SHERPHY_EXCEPTION_IF_FALSE((max_instances <= m_device->m_physical_device_properties.limits.maxComputeWorkGroupCount[0]),
+            "gpu scene instance capacity exceeds the compute workgroup count limit");
+        SHERPHY_EXCEPTION_IF_FALSE((m_instances.size() <= max_instances),
+            "gpu scene holds " + std::to_string(m_instances.size()) + " instances, at most " + std::to_string(max_instances) + " are supported");
+        m_max_instances = max_instances;
+        m_max_draws = max_draws;
+
+        SHERPHY_ASSERT(m_device->createBuffer(sizeof(GPUMeshRecord) * m_meshes.size(),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            m_mesh_buffer, m_meshes.data()), VK_SUCCESS, "");
+
+        SHERPHY_ASSERT(m_device->createBuffer(sizeof(Meshlet) * m_meshlets.size(),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            m_meshlet_buffer, m_meshlets.data()), VK_SUCCESS, "");
+
+        m_batch_buffers.resize(m_frame_count);
+        m_draw_template_buffers.resize(m_frame_count);
+        m_draw_slot_buffers.resize(m_frame_count);
+        m_visible_instance_buffers.resize(m_frame_count);
+        m_draw_command_buffers.resize(m_frame_count);
+        m_draw_count_buffers.resize(m_frame_count);
+        m_occluded_buffers.resize(m_frame_count);
+        buildBatches();
+        m_built_batch_version = m_batch_version;
+        // every frame in flight still needs its first upload
+        m_frame_batch_versions.assign(m_frame_count, m_batch_version - 1);
+        for (uint32_t i = 0; i < m_frame_count; i++)
+        {
+            // there are never more batches than instances
+            SHERPHY_ASSERT(m_device->createBuffer(sizeof(GPUBatchRecord) * m_max_instances,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                m_batch_buffers[i]), VK_SUCCESS, "");
+            SHERPHY_ASSERT(m_batch_buffers[i].map(), VK_SUCCESS, "");
+
+            // draw slots with zero instances, copied over the slots at the start of every frame
+            SHERPHY_ASSERT(m_device->createBuffer(sizeof(GPUDrawRecord) * m_max_draws,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                m_draw_template_buffers[i]), VK_SUCCESS, "");
+            SHERPHY_ASSERT(m_draw_template_buffers[i].map(), VK_SUCCESS, "");
+
+            SHERPHY_ASSERT(m_device->createBuffer(sizeof(GPUDrawRecord) * m_max_draws,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                m_draw_slot_buffers[i]), VK_SUCCESS, "");
+
+            // one entry per meshlet of every instance, read by the vertex shader through gl_InstanceIndex
+            SHERPHY_ASSERT(m_device->createBuffer(sizeof(uint32_t) * m_max_draws,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                m_visible_instance_buffers[i]), VK_SUCCESS, "");
+
+            // non empty slots packed per pipeline, the final draws first and the pre-pass draws behind them
+            SHERPHY_ASSERT(m_device->createBuffer(sizeof(GPUDrawRecord) * m_max_draws * 2,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                m_draw_command_buffers[i]), VK_SUCCESS, "");
+
+            SHERPHY_ASSERT(m_device->createBuffer(sizeof(uint32_t) * k_max_pipelines * 2,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                m_draw_count_buffers[i]), VK_SUCCESS, "");
+
+            // written by the early phase before the late phase reads it, never reset
+            SHERPHY_ASSERT(m_device->createBuffer(sizeof(uint32_t) * m_max_instances,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                m_occluded_buffers[i]), VK_SUCCESS, "");
+        }
+
+        createCullDescriptorSets();
+    }
+
+    void VulkanGPUScene::createCullDescriptorSets()
+    {
+        std::array<VkDescriptorSetLayoutBinding, 9> bindings{};
+        for (uint32_t i = 0; i < bindings.size(); i++)
+        {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+
+        VkDescriptorSetLayoutCreateInfo layout_info{};
+        layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+        layout_info.pBindings = bindings.data();
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateDescriptorSetLayout(m_device->m_logical_device, &layout_info, nullptr, &m_cull_descriptor_set_layout) == VK_SUCCESS, "failed to create culling descriptor set layout!");
+
+        std::array<VkDescriptorPoolSize, 2> pool_size{};
+        pool_size[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        pool_size[0].descriptorCount = static_cast<uint32_t>(bindings.size() - 1) * m_frame_count;
+        pool_size[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        pool_size[1].descriptorCount = m_frame_count;
+
+        VkDescriptorPoolCreateInfo pool_info{};
+        pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        pool_info.poolSizeCount = static_cast<uint32_t>(pool_size.size());
+        pool_info.pPoolSizes = pool_size.data();
+        pool_info.maxSets = m_frame_count;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateDescriptorPool(m_device->m_logical_device, &pool_info, nullptr, &m_cull_descriptor_pool) == VK_SUCCESS, "failed to create culling descriptor pool!");
+
+        std::vector<VkDescriptorSetLayout> layouts(m_frame_count, m_cull_descriptor_set_layout);
+        VkDescriptorSetAllocateInfo alloc_info{};
+        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.descriptorPool = m_cull_descriptor_pool;
+        alloc_info.descriptorSetCount = m_frame_count;
+        alloc_info.pSetLayouts = layouts.data();
+
+        m_cull_descriptor_sets.resize(m_frame_count);
+        SHERPHY_EXCEPTION_IF_FALSE(vkAllocateDescriptorSets(m_device->m_logical_device, &alloc_info, m_cull_descriptor_sets.data()) == VK_SUCCESS, "failed to allocate culling descriptor sets!");
+
+        for (uint32_t i = 0; i < m_frame_count; i++)
+        {
+            std::array<VkDescriptorBufferInfo, 9> buffer_infos{};
+            buffer_infos[0] = { m_mesh_buffer.buffer, 0, VK_WHOLE_SIZE };
+            buffer_infos[1] = { m_frame_allocator->m_buffer.buffer, 0, getInstanceRange() };
+            buffer_infos[2] = { m_draw_command_buffers[i].buffer, 0, VK_WHOLE_SIZE };
+            buffer_infos[3] = { m_draw_count_buffers[i].buffer, 0, VK_WHOLE_SIZE };
+            buffer_infos[4] = { m_meshlet_buffer.buffer, 0, VK_WHOLE_SIZE };
+            buffer_infos[5] = { m_batch_buffers[i].buffer, 0, VK_WHOLE_SIZE };
+            buffer_infos[6] = { m_draw_slot_buffers[i].buffer, 0, VK_WHOLE_SIZE };
+            buffer_infos[7] = { m_visible_instance_buffers[i].buffer, 0, VK_WHOLE_SIZE };
+            buffer_infos[8] = { m_occluded_buffers[i].buffer, 0, VK_WHOLE_SIZE };
+
+            std::array<VkWriteDescriptorSet, 9> descriptor_write{};
+            for (uint32_t binding = 0; binding < descriptor_write.size(); binding++)
+            {
+                descriptor_write[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptor_write[binding].dstSet = m_cull_descriptor_sets[i];
+                descriptor_write[binding].dstBinding = binding;
+                descriptor_write[binding].dstArrayElement = 0;
+                descriptor_write[binding].descriptorType = bindings[binding].descriptorType;
+                descriptor_write[binding].descriptorCount = 1;
+                descriptor_write[binding].pBufferInfo = &buffer_infos[binding];
+            }
+            vkUpdateDescriptorSets(m_device->m_logical_device, static_cast<uint32_t>(descriptor_write.size()), descriptor_write.data(), 0, nullptr);
+        }
+    }
+
+    void VulkanGPUScene::createCullingPipeline(const VkPipelineShaderStageCreateInfo& cull_shader_stage,
+                                               const VkPipelineShaderStageCreateInfo& compact_shader_stage,
+                                               const VkPipelineShaderStageCreateInfo* occlusion_cull_shader_stage,
+                                               VkDescriptorSetLayout occlusion_set_layout)
+    {
+        VkPushConstantRange push_constant_range{};
+        push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        push_constant_range.offset = 0;
+        push_constant_range.size = sizeof(GPUCullPushConstant);
+
+        // all passes share one layout and one descriptor set per frame, set 1 is only read by occlusion culling
+        std::vector<VkDescriptorSetLayout> set_layouts = { m_cull_descriptor_set_layout };
+        if (occlusion_cull_shader_stage != nullptr)
+        {
+            set_layouts.push_back(occlusion_set_layout);
+        }
+        VkPipelineLayoutCreateInfo pipeline_layout_info{};
+        pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipeline_layout_info.setLayoutCount = static_cast<uint32_t>(set_layouts.size());
+        pipeline_layout_info.pSetLayouts = set_layouts.data();
+        pipeline_layout_info.pushConstantRangeCount = 1;
+        pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreatePipelineLayout(m_device->m_logical_device, &pipeline_layout_info, nullptr, &m_cull_pipeline_layout) == VK_SUCCESS, "failed to create culling pipeline layout!");
+
+        VkComputePipelineCreateInfo pipeline_info{};
+        pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipeline_info.stage = cull_shader_stage;
+        pipeline_info.layout = m_cull_pipeline_layout;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateComputePipelines(m_device->m_logical_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &m_cull_pipeline) == VK_SUCCESS, "failed to create culling pipeline!");
+
+        pipeline_info.stage = compact_shader_stage;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateComputePipelines(m_device->m_logical_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &m_compact_pipeline) == VK_SUCCESS, "failed to create draw compaction pipeline!");
+
+        if (occlusion_cull_shader_stage != nullptr)
+        {
+            pipeline_info.stage = *occlusion_cull_shader_stage;
+            SHERPHY_EXCEPTION_IF_FALSE(vkCreateComputePipelines(m_device->m_logical_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &m_occlusion_cull_pipeline) == VK_SUCCESS, "failed to create occlusion culling pipeline!");
+        }
+    }
+
+    void VulkanGPUScene::uploadInstances(uint32_t current_frame)
+    {
+        if (m_frame_batch_versions[current_frame] != m_batch_version)
+        {
+            if (m_built_batch_version != m_batch_version)
+            {
+                buildBatches();
+                m_built_batch_version = m_batch_version;
+            }
+            SHERPHY_MEMCPY(m_batch_buffers[current_frame].mapped, m_batches.data(), sizeof(GPUBatchRecord) * m_batches.size());
+            SHERPHY_MEMCPY(m_draw_template_buffers[current_frame].mapped, m_draw_slots.data(), sizeof(GPUDrawRecord) * m_draw_slots.size());
+            m_frame_batch_versions[current_frame] = m_batch_version;
+        }
+        // the dynamic range always spans max instances, reserve all of it
+        FrameAllocation allocation = m_frame_allocator->allocate(getInstanceRange());
+        SHERPHY_MEMCPY(allocation.mapped, m_instances.data(), sizeof(GPUInstanceRecord) * m_instances.size());
+        m_instance_offset = allocation.offset;
+    }
+
+    void VulkanGPUScene::recordCulling(VkCommandBuffer command_buffer, uint32_t current_frame, const Mat4x4& view_proj, const Vec3& camera_position)
+    {
+        recordReset(command_buffer, current_frame);
+        recordCullDispatch(command_buffer, current_frame, m_cull_pipeline, getPushConstant(view_proj, camera_position, GPUCullPhase::All));
+        // the render graph orders the indirect and vertex reads of the results after this
+    }
+
+    void VulkanGPUScene::recordOcclusionCulling(VkCommandBuffer command_buffer,
+                                                uint32_t current_frame,
+                                                const Mat4x4& view_proj,
+                                                const Vec3& camera_position,
+                                                GPUCullPhase phase,
+                                                VkDescriptorSet occlusion_set)
+    {
+        if (phase == GPUCullPhase::Early)
+        {
+            recordReset(command_buffer, current_frame);
+        }
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+            m_cull_pipeline_layout, 1, 1, &occlusion_set, 0, nullptr);
+        // the late phase appends to the slots the early phase filled and packs all of them into the final draws
+        recordCullDispatch(command_buffer, current_frame, m_occlusion_cull_pipeline, getPushConstant(view_proj, camera_position, phase));
+    }
+
+    // slots go back to zero instances and both count regions to zero
+    void VulkanGPUScene::recordReset(VkCommandBuffer command_buffer, uint32_t current_frame)
+    {
+        uint32_t draw_slot_count = static_cast<uint32_t>(m_draw_slots.size());
+        if (draw_slot_count > 0)
+        {
+            VkBufferCopy reset_region{ 0, 0, sizeof(GPUDrawRecord) * draw_slot_count };
+            vkCmdCopyBuffer(command_buffer, m_draw_template_buffers[current_frame].buffer, m_draw_slot_buffers[current_frame].buffer, 1, &reset_region);
+        }
+        vkCmdFillBuffer(command_buffer, m_draw_count_buffers[current_frame].buffer, 0, sizeof(uint32_t) * k_max_pipelines * 2, 0);
+
+        VkMemoryBarrier clear_barrier{};
+        clear_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        clear_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        clear_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &clear_barrier, 0, nullptr, 0, nullptr);
+    }
+
+    void VulkanGPUScene::recordCullDispatch(VkCommandBuffer command_buffer, uint32_t current_frame, VkPipeline cull_pipeline, const GPUCullPushConstant& push_constant)
+    {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+            m_cull_pipeline_layout, 0, 1, &m_cull_descriptor_sets[current_frame], 1, &m_instance_offset);
+        vkCmdPushConstants(command_buffer, m_cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUCullPushConstant), &push_constant);
+        // one workgroup per instance, its 64 threads walk the meshlets of the instance
+        vkCmdDispatch(command_buffer, push_constant.instance_count, 1, 1);
+
+        VkMemoryBarrier slot_barrier{};
+        slot_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        slot_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        slot_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(command_buffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &slot_barrier, 0, nullptr, 0, nullptr);
+
+        // one thread per draw slot
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_compact_pipeline);
+        vkCmdDispatch(command_buffer, (push_constant.draw_slot_count + 63) / 64, 1, 1);
+    }
+
+    GPUCullPushConstant VulkanGPUScene::getPushConstant(const Mat4x4& view_proj, const Vec3& camera_position, GPUCullPhase phase) const
+    {
+        GPUCullPushConstant push_constant{};
+        extractFrustumPlanes(view_proj, push_constant.frustum_planes);
+        push_constant.camera_position = Vec4(camera_position, 1.0f);
+        push_constant.instance_count = static_cast<uint32_t>(m_instances.size());
+        push_constant.draw_slot_count = static_cast<uint32_t>(m_draw_slots.size());
+        push_constant.phase = static_cast<uint32_t>(phase);
+        return push_constant;
+    }
+
+    void VulkanGPUScene::recordDraw(VkCommandBuffer command_buffer, uint32_t current_frame, uint32_t pipeline_id, bool pre_pass)
+    {
+        uint32_t first_draw = m_pipeline_draw_ranges[pipeline_id][0];
+        uint32_t draw_count = m_pipeline_draw_ranges[pipeline_id][1];
+        if (draw_count == 0)
+        {
+            return;
+        }
+        // the pre-pass region starts one slot count behind the final one, see GPUDrawCompaction.comp
+        uint32_t draw_offset = pre_pass ? static_cast<uint32_t>(m_draw_slots.size()) + first_draw : first_draw;
+        uint32_t count_offset = pre_pass ? k_max_pipelines + pipeline_id : pipeline_id;
+        vkCmdDrawIndexedIndirectCount(command_buffer,
+            m_draw_command_buffers[current_frame].buffer, sizeof(GPUDrawRecord) * draw_offset,
+            m_draw_count_buffers[current_frame].buffer, sizeof(uint32_t) * count_offset,
+            draw_count,
+            sizeof(GPUDrawRecord));
+    }
+
+    void VulkanGPUScene::destroy()
+    {
+        if (!isInitialized())
+        {
+            return;
+        }
+        vkDestroyPipeline(m_device->m_logical_device, m_cull_pipeline, nullptr);
+        vkDestroyPipeline(m_device->m_logical_device, m_compact_pipeline, nullptr);
+        vkDestroyPipeline(m_device->m_logical_device, m_occlusion_cull_pipeline, nullptr);
+        vkDestroyPipelineLayout(m_device->m_logical_device, m_cull_pipeline_layout, nullptr);
+        vkDestroyDescriptorPool(m_device->m_logical_device, m_cull_descriptor_pool, nullptr);
+        vkDestroyDescriptorSetLayout(m_device->m_logical_device, m_cull_descriptor_set_layout, nullptr);
+
+        m_mesh_buffer.destroy();
+        m_meshlet_buffer.destroy();
+        for (uint32_t i = 0; i < m_frame_count; i++)
+        {
+            m_batch_buffers[i].unmap();
+            m_batch_buffers[i].destroy();
+            m_draw_template_buffers[i].unmap();
+            m_draw_template_buffers[i].destroy();
+            m_draw_slot_buffers[i].destroy();
+            m_visible_instance_buffers[i].destroy();
+            m_draw_command_buffers[i].destroy();
+            m_draw_count_buffers[i].destroy();
+            m_occluded_buffers[i].destroy();
+        }
+    }
+
+    // Gribb-Hartmann, depth range is zero to one (GLM_FORCE_DEPTH_ZERO_TO_ONE)
+    void VulkanGPUScene::extractFrustumPlanes(const Mat4x4& view_proj, Vec4 planes[6])
+    {
+        Vec4 row[4];
+        for (int i = 0; i < 4; i++)
+        {
+            row[i] = Vec4(view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i]);
+        }
+
+        planes[0] = row[3] + row[0]; // left
+        planes[1] = row[3] - row[0]; // right
+        planes[2] = row[3] + row[1]; // bottom
+        planes[3] = row[3] - row[1]; // top
+        planes[4] = row[2];          // near
+        planes[5] = row[3] - row[2]; // far
+
+        for (int i = 0; i < 6; i++)
+        {
+            planes[i] /= glm::length(Vec3(planes[i]));
+        }
+    }
+}
@@ -0,0 +1,174 @@
+#pragma once
+#include "RenderingMath.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanFrameAllocator.h"
+#include "VulkanVertexFormat.h"
+
+#include <vector>
+
+namespace Sherphy
+{
+	// mirrors GPUMesh in GPUCulling.comp and NormalShaderGPUDriven.vert, std430
+	struct GPUMeshRecord
+	{
+		uint32_t index_count;
+		uint32_t first_index;
+		int32_t vertex_offset;
+		uint32_t first_meshlet;
+		uint32_t meshlet_count;
+		uint32_t padding[3];
+		Vec4 bounding_sphere; // xyz center in mesh space, w radius
+		VertexQuantization quantization;
+	};
+
+	// mirrors GPUInstance in GPUCulling.comp and NormalShaderGPUDriven.vert, std430
+	struct GPUInstanceRecord
+	{
+		Mat4x4 model;
+		Mat4x4 normal_model; // inverse transpose of model, for normals and meshlet cone axes
+		uint32_t mesh_id;
+		uint32_t material_id; // index into the bindless material buffer
+		uint32_t batch_id;
+		uint32_t padding;
+	};
+
+	// instances sharing mesh, material and pipeline, mirrors GPUBatch in GPUCulling.comp
+	struct GPUBatchRecord
+	{
+		uint32_t first_draw;   // first draw slot, one slot per meshlet of the mesh
+		uint32_t instance_count;
+		uint32_t pipeline_id;
+		uint32_t padding;
+	};
+
+	// an instanced indexed indirect draw followed by the data the compaction pass needs, 32 bytes
+	struct GPUDrawRecord
+	{
+		VkDrawIndexedIndirectCommand command; // first_instance points into the visible instance list
+		uint32_t pipeline_id;
+		uint32_t compact_base; // first compacted slot of the pipeline
+		uint32_t padding;
+	};
+
+	// push constant of the culling and compaction passes, 128 bytes
+	struct GPUCullPushConstant
+	{
+		Vec4 frustum_planes[6];
+		Vec4 camera_position;
+		uint32_t instance_count;
+		uint32_t draw_slot_count;
+		uint32_t phase; // GPUCullPhase
+		uint32_t padding;
+	};
+
+	// which instances a culling dispatch tests, and against what
+	enum class GPUCullPhase : uint32_t
+	{
+		All = 0,   // frustum only, fills the final draws
+		Early = 1, // against the pyramid of the previous frame, fills the pre-pass draws
+		Late = 2,  // what the early phase occluded, against the pyramid of this frame's pre-pass
+	};
+
+	// Holds every mesh, meshlet and mesh instance of the scene in gpu buffers.
+	// Instances are grouped on the cpu into batches of the same mesh, material and
+	// pipeline, and every meshlet of a batch owns one instanced draw slot. A compute
+	// pass frustum culls the instances, then frustum and normal cone culls their
+	// meshlets and appends each surviving instance to the slot of the meshlet. A second
+	// pass packs the non empty slots per pipeline into an indirect argument buffer,
+	// so the cpu records the same few commands no matter how many instances there are.
+	// With occlusion culling the instances are culled twice: the early phase tests
+	// them against the last frame's depth pyramid and its survivors go to the depth
+	// pre-pass; the late phase retests the rejected ones against a pyramid of the
+	// pre-pass depth. The final draws cover the survivors of both phases, the pre-pass
+	// draws are packed behind them in the same buffers.
+	struct VulkanGPUScene
+	{
+		static const uint32_t k_max_pipelines = 16;
+
+		VulkanDevice* m_device = nullptr;
+		uint32_t m_frame_count = 0;
+		uint32_t m_max_instances = 0;
+		uint32_t m_max_draws = 0;
+
+		std::vector<GPUMeshRecord> m_meshes;
+		std::vector<Meshlet> m_meshlets;
+		std::vector<GPUInstanceRecord> m_instances;
+		std::vector<uint32_t> m_instance_pipelines;
+
+		// rebuilt whenever instances are added, uploaded lazily to each frame in flight
+		std::vector<GPUBatchRecord> m_batches;
+		std::vector<GPUDrawRecord> m_draw_slots;
+		uint32_t m_pipeline_draw_ranges[k_max_pipelines][2]{}; // first slot, slot count
+		uint32_t m_batch_version = 0;
+		uint32_t m_built_batch_version = 0;
+		std::vector<uint32_t> m_frame_batch_versions;
+
+		VulkanBuffer m_mesh_buffer;
+		VulkanBuffer m_meshlet_buffer;
+		// instances are rewritten every frame into the frame allocator and bound with a dynamic offset
+		VulkanFrameAllocator* m_frame_allocator = nullptr;
+		uint32_t m_instance_offset = 0;
+		// written by cpu when batches change, so one copy per frame in flight
+		std::vector<VulkanBuffer> m_batch_buffers;
+		std::vector<VulkanBuffer> m_draw_template_buffers;
+		// written by gpu each frame
+		std::vector<VulkanBuffer> m_draw_slot_buffers;
+		std::vector<VulkanBuffer> m_visible_instance_buffers;
+		std::vector<VulkanBuffer> m_draw_command_buffers;
+		std::vector<VulkanBuffer> m_draw_count_buffers;
+		// one flag per instance, set when only the early occlusion test rejected it
+		std::vector<VulkanBuffer> m_occluded_buffers;
+
+		VkDescriptorSetLayout m_cull_descriptor_set_layout = VK_NULL_HANDLE;
+		VkDescriptorPool m_cull_descriptor_pool = VK_NULL_HANDLE;
+		std::vector<VkDescriptorSet> m_cull_descriptor_sets;
+		VkPipelineLayout m_cull_pipeline_layout = VK_NULL_HANDLE;
+		VkPipeline m_cull_pipeline = VK_NULL_HANDLE;
+		VkPipeline m_compact_pipeline = VK_NULL_HANDLE;
+		// left null without an occlusion shader, set 1 then holds the pyramid
+		VkPipeline m_occlusion_cull_pipeline = VK_NULL_HANDLE;
+
+		// the bounds come from the source vertices, quantization locates the encoded positions in them
+		uint32_t registerMesh(const std::vector<Vertex>& vertices,
+							  uint32_t first_vertex,
+							  uint32_t vertex_count,
+							  uint32_t first_index,
+							  uint32_t index_count,
+							  const VertexQuantization& quantization = {},
+							  const std::vector<Meshlet>& meshlets = {});
+		uint32_t addInstance(uint32_t mesh_id, const Mat4x4& model, uint32_t material_id = 0, uint32_t pipeline_id = 0);
+		void setInstanceTransform(uint32_t instance_id, const Mat4x4& model);
+		// replaces an instance in place, its id stays the same
+		void setInstance(uint32_t instance_id, uint32_t mesh_id, const Mat4x4& model, uint32_t material_id = 0, uint32_t pipeline_id = 0);
+
+		bool isInitialized() const { return m_device != nullptr; }
+		void init(VulkanDevice* device, VulkanFrameAllocator* frame_allocator, uint32_t frame_count, uint32_t max_instances, uint32_t max_draws);
+		VkDeviceSize getInstanceRange() const { return sizeof(GPUInstanceRecord) * m_max_instances; }
+		void createCullingPipeline(const VkPipelineShaderStageCreateInfo& cull_shader_stage,
+								   const VkPipelineShaderStageCreateInfo& compact_shader_stage,
+								   const VkPipelineShaderStageCreateInfo* occlusion_cull_shader_stage = nullptr,
+								   VkDescriptorSetLayout occlusion_set_layout = VK_NULL_HANDLE);
+		bool hasOcclusionCulling() const { return m_occlusion_cull_pipeline != VK_NULL_HANDLE; }
+		void uploadInstances(uint32_t current_frame);
+		void recordCulling(VkCommandBuffer command_buffer, uint32_t current_frame, const Mat4x4& view_proj, const Vec3& camera_position);
+		// the early phase resets the draws, the late phase adds to them; occlusion_set is set 1 of the occlusion shader
+		void recordOcclusionCulling(VkCommandBuffer command_buffer,
+									uint32_t current_frame,
+									const Mat4x4& view_proj,
+									const Vec3& camera_position,
+									GPUCullPhase phase,
+									VkDescriptorSet occlusion_set);
+		// pre_pass draws what the early phase kept
+		void recordDraw(VkCommandBuffer command_buffer, uint32_t current_frame, uint32_t pipeline_id = 0, bool pre_pass = false);
+		void destroy();
+
+		void buildBatches();
+		void createCullDescriptorSets();
+		void recordReset(VkCommandBuffer command_buffer, uint32_t current_frame);
+		void recordCullDispatch(VkCommandBuffer command_buffer, uint32_t current_frame, VkPipeline cull_pipeline, const GPUCullPushConstant& push_constant);
+		GPUCullPushConstant getPushConstant(const Mat4x4& view_proj, const Vec3& camera_position, GPUCullPhase phase) const;
+
+		static void extractFrustumPlanes(const Mat4x4& view_proj, Vec4 planes[6]);
+	};
+}
@@ -0,0 +1,144 @@
+#include "VulkanHeadlessTarget.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <volk.h>
+
+namespace Sherphy
+{
+    void VulkanHeadlessTarget::init(VulkanDevice* device, VkExtent2D extent, VkFormat format, uint32_t frame_count)
+    {
+        m_device = device;
+        m_extent = extent;
+        m_format = format;
+        m_frame_count = frame_count;
+
+        m_images.resize(m_frame_count);
+        m_image_memories.resize(m_frame_count);
+        m_image_views.resize(m_frame_count);
+        for (uint32_t i = 0; i < m_frame_count; i++)
+        {
+            VkImageCreateInfo image_info{};
+            image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            image_info.imageType = VK_IMAGE_TYPE_2D;
+            image_info.extent = { m_extent.width, m_extent.height, 1 };
+            image_info.mipLevels = 1;
+            image_info.arrayLayers = 1;
+            image_info.format = m_format;
+            image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+            image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+            image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+            image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            SHERPHY_EXCEPTION_IF_FALSE(vkCreateImage(m_device->m_logical_device, &image_info, nullptr, &m_images[i]) == VK_SUCCESS, "failed to create offscreen image!");
+
+            VkMemoryRequirements mem_requirements;
+            vkGetImageMemoryRequirements(m_device->m_logical_device, m_images[i], &mem_requirements);
+
+            VkMemoryAllocateInfo alloc_info{};
+            alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            alloc_info.allocationSize = mem_requirements.size;
+            alloc_info.memoryTypeIndex = m_device->findMemoryType(mem_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            SHERPHY_EXCEPTION_IF_FALSE(vkAllocateMemory(m_device->m_logical_device, &alloc_info, nullptr, &m_image_memories[i]) == VK_SUCCESS, "failed to allocate offscreen image memory!");
+            vkBindImageMemory(m_device->m_logical_device, m_images[i], m_image_memories[i], 0);
+
+            VkImageViewCreateInfo view_info{};
+            view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            view_info.image = m_images[i];
+            view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            view_info.format = m_format;
+            view_info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+            SHERPHY_EXCEPTION_IF_FALSE(vkCreateImageView(m_device->m_logical_device, &view_info, nullptr, &m_image_views[i]) == VK_SUCCESS, "failed to create offscreen image view!");
+        }
+
+        // cached memory makes cpu reads fast, it is usually not coherent and gets invalidated per frame
+        m_frame_bytes = static_cast<VkDeviceSize>(m_extent.width) * m_extent.height * 4;
+        VkMemoryPropertyFlags readback_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        bool has_cached_memory = false;
+        const VkPhysicalDeviceMemoryProperties& memory_properties = m_device->m_physical_device_memory_properties;
+        for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+        {
+            has_cached_memory |= (memory_properties.memoryTypes[i].propertyFlags & readback_properties) == readback_properties;
+        }
+        if (!has_cached_memory)
+        {
+            readback_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        }
+        SHERPHY_ASSERT(m_device->createBuffer(m_frame_bytes * m_frame_count,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            readback_properties,
+            m_readback_buffer), VK_SUCCESS, "");
+        SHERPHY_ASSERT(m_readback_buffer.map(), VK_SUCCESS, "");
+        m_readback_coherent = (readback_properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+        m_frame_numbers.assign(m_frame_count, UINT64_MAX);
+    }
+
+    void VulkanHeadlessTarget::recordReadback(VkCommandBuffer command_buffer, uint32_t current_frame)
+    {
+        VkBufferImageCopy region{};
+        region.bufferOffset = m_frame_bytes * current_frame;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { m_extent.width, m_extent.height, 1 };
+        vkCmdCopyImageToBuffer(command_buffer, m_images[current_frame], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_readback_buffer.buffer, 1, &region);
+
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = m_readback_buffer.buffer;
+        barrier.offset = region.bufferOffset;
+        barrier.size = m_frame_bytes;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+            0, 0, nullptr, 1, &barrier, 0, nullptr);
+    }
+
+    void VulkanHeadlessTarget::markSubmitted(uint32_t current_frame, uint64_t frame_number)
+    {
+        m_frame_numbers[current_frame] = frame_number;
+    }
+
+    bool VulkanHeadlessTarget::acquireFrame(uint32_t current_frame, HeadlessFrame& frame)
+    {
+        if (m_frame_numbers[current_frame] == UINT64_MAX)
+        {
+            return false;
+        }
+
+        if (!m_readback_coherent)
+        {
+            VkMappedMemoryRange range{};
+            range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+            range.memory = m_readback_buffer.memory;
+            range.offset = 0;
+            range.size = VK_WHOLE_SIZE;
+            vkInvalidateMappedMemoryRanges(m_device->m_logical_device, 1, &range);
+        }
+
+        frame.pixels = static_cast<const uint8_t*>(m_readback_buffer.mapped) + m_frame_bytes * current_frame;
+        frame.width = m_extent.width;
+        frame.height = m_extent.height;
+        frame.frame_number = m_frame_numbers[current_frame];
+        return true;
+    }
+
+    void VulkanHeadlessTarget::destroy()
+    {
+        if (!isInitialized())
+        {
+            return;
+        }
+        for (uint32_t i = 0; i < m_frame_count; i++)
+        {
+            vkDestroyImageView(m_device->m_logical_device, m_image_views[i], nullptr);
+            vkDestroyImage(m_device->m_logical_device, m_images[i], nullptr);
+            vkFreeMemory(m_device->m_logical_device, m_image_memories[i], nullptr);
+        }
+        m_readback_buffer.unmap();
+        m_readback_buffer.destroy();
+        m_device = nullptr;
+    }
+}
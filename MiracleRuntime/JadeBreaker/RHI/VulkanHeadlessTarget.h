@@ -0,0 +1,51 @@
+#pragma once
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+
+#include <functional>
+#include <vector>
+
+namespace Sherphy
+{
+	// a finished frame in the readback ring, valid until the same frame slot is rendered again
+	struct HeadlessFrame
+	{
+		const uint8_t* pixels = nullptr; // tightly packed rows of the color format
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint64_t frame_number = 0;
+	};
+
+	using HeadlessFrameCallback = std::function<void(const HeadlessFrame&)>;
+
+	// Render target for running without a window or swapchain. Every frame in
+	// flight renders into its own offscreen color image which is copied at the
+	// end of the frame into its region of one persistently mapped host buffer.
+	// A region is handed out once its frame slot was waited on again, so
+	// reading frames back never stalls the gpu.
+	struct VulkanHeadlessTarget
+	{
+		VulkanDevice* m_device = nullptr;
+		VkExtent2D m_extent{};
+		VkFormat m_format = VK_FORMAT_UNDEFINED;
+		uint32_t m_frame_count = 0;
+
+		std::vector<VkImage> m_images;
+		std::vector<VkDeviceMemory> m_image_memories;
+		std::vector<VkImageView> m_image_views;
+
+		VulkanBuffer m_readback_buffer;
+		bool m_readback_coherent = true;
+		VkDeviceSize m_frame_bytes = 0;
+		std::vector<uint64_t> m_frame_numbers; // frame rendered into each region, UINT64_MAX when empty
+
+		bool isInitialized() const { return m_device != nullptr; }
+		void init(VulkanDevice* device, VkExtent2D extent, VkFormat format, uint32_t frame_count);
+		// after the render pass, which leaves the image in transfer src layout
+		void recordReadback(VkCommandBuffer command_buffer, uint32_t current_frame);
+		void markSubmitted(uint32_t current_frame, uint64_t frame_number);
+		// call after the frame slot was waited on, returns false if the slot is empty
+		bool acquireFrame(uint32_t current_frame, HeadlessFrame& frame);
+		void destroy();
+	};
+}
@@ -0,0 +1,223 @@
+#include "VulkanHiZPyramid.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <volk.h>
+
+#include <algorithm>
+
+namespace Sherphy
+{
+    namespace
+    {
+        uint32_t previousPowerOfTwo(uint32_t value)
+        {
+            uint32_t power = 1;
+            while (power <= value / 2)
+            {
+                power <<= 1;
+            }
+            return power;
+        }
+    }
+
+    void VulkanHiZPyramid::init(VulkanDevice* device,
+                                VulkanDeletionQueue* deletion_queue,
+                                VulkanDescriptorAllocator* descriptor_allocator,
+                                VulkanFrameAllocator* frame_allocator,
+                                VkExtent2D depth_extent)
+    {
+        m_device = device;
+        m_deletion_queue = deletion_queue;
+        m_descriptor_allocator = descriptor_allocator;
+        m_frame_allocator = frame_allocator;
+        m_depth_extent = depth_extent;
+
+        VkSamplerCreateInfo sampler_info{};
+        sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        sampler_info.magFilter = VK_FILTER_NEAREST;
+        sampler_info.minFilter = VK_FILTER_NEAREST;
+        sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        sampler_info.minLod = 0.0f;
+        sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateSampler(m_device->m_logical_device, &sampler_info, nullptr, &m_sampler) == VK_SUCCESS, "failed to create hiz sampler!");
+
+        createImage();
+    }
+
+    void VulkanHiZPyramid::resize(VkExtent2D depth_extent)
+    {
+        if (depth_extent.width == m_depth_extent.width && depth_extent.height == m_depth_extent.height)
+        {
+            return;
+        }
+        // the per level views go first, destroyImage takes the full view with the image
+        uint64_t last_use_frame = m_deletion_queue->getFrameNumber();
+        VkDevice logical_device = m_device->m_logical_device;
+        std::vector<VkImageView> mip_views = std::move(m_mip_views);
+        m_deletion_queue->pushAfterFrame(last_use_frame, [logical_device, mip_views]() {
+            for (VkImageView mip_view : mip_views)
+            {
+                vkDestroyImageView(logical_device, mip_view, nullptr);
+            }
+        });
+        m_deletion_queue->destroyImage(m_image, m_memory, m_image_view, last_use_frame);
+        m_depth_extent = depth_extent;
+        createImage();
+    }
+
+    void VulkanHiZPyramid::createPipeline(const VkPipelineShaderStageCreateInfo& reduce_shader_stage,
+                                          VkDescriptorSetLayout reduce_set_layout,
+                                          VkPipelineLayout reduce_pipeline_layout)
+    {
+        m_reduce_set_layout = reduce_set_layout;
+        m_reduce_pipeline_layout = reduce_pipeline_layout;
+
+        VkComputePipelineCreateInfo pipeline_info{};
+        pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipeline_info.stage = reduce_shader_stage;
+        pipeline_info.layout = m_reduce_pipeline_layout;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateComputePipelines(m_device->m_logical_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &m_reduce_pipeline) == VK_SUCCESS, "failed to create hiz reduce pipeline!");
+    }
+
+    VkDescriptorSet VulkanHiZPyramid::getOcclusionSet(uint32_t current_frame, VkDescriptorSetLayout layout, const Mat4x4& view_proj, bool valid)
+    {
+        HiZOcclusionView occlusion_view{};
+        occlusion_view.view_proj = view_proj;
+        occlusion_view.hiz_size = Vec4(static_cast<float>(m_extent.width), static_cast<float>(m_extent.height), static_cast<float>(m_mip_count), valid ? 1.0f : 0.0f);
+        uint32_t view_offset = m_frame_allocator->push(occlusion_view);
+
+        std::vector<DescriptorWrite> writes(2);
+        writes[0].binding = 0;
+        writes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[0].image_info = { m_sampler, m_image_view, VK_IMAGE_LAYOUT_GENERAL };
+        writes[1].binding = 1;
+        writes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        writes[1].buffer_info = { m_frame_allocator->m_buffer.buffer, view_offset, sizeof(HiZOcclusionView) };
+        return m_descriptor_allocator->allocateFrame(current_frame, layout, writes);
+    }
+
+    // one dispatch per level, each reads the level below it; level 0 reduces the depth buffer
+    void VulkanHiZPyramid::recordBuild(VkCommandBuffer command_buffer, uint32_t current_frame, VkImageView depth_view)
+    {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_reduce_pipeline);
+
+        VkExtent2D source_extent = m_depth_extent;
+        for (uint32_t mip = 0; mip < m_mip_count; mip++)
+        {
+            VkExtent2D destination_extent = { std::max(m_extent.width >> mip, 1u), std::max(m_extent.height >> mip, 1u) };
+
+            std::vector<DescriptorWrite> writes(2);
+            writes[0].binding = 0;
+            writes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writes[0].image_info = mip == 0 ?
+                VkDescriptorImageInfo{ m_sampler, depth_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL } :
+                VkDescriptorImageInfo{ m_sampler, m_mip_views[mip - 1], VK_IMAGE_LAYOUT_GENERAL };
+            writes[1].binding = 1;
+            writes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            writes[1].image_info = { VK_NULL_HANDLE, m_mip_views[mip], VK_IMAGE_LAYOUT_GENERAL };
+            VkDescriptorSet descriptor_set = m_descriptor_allocator->allocateFrame(current_frame, m_reduce_set_layout, writes);
+
+            HiZReducePushConstant push_constant{};
+            push_constant.source_size[0] = source_extent.width;
+            push_constant.source_size[1] = source_extent.height;
+            push_constant.destination_size[0] = destination_extent.width;
+            push_constant.destination_size[1] = destination_extent.height;
+
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_reduce_pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
+            vkCmdPushConstants(command_buffer, m_reduce_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(HiZReducePushConstant), &push_constant);
+            vkCmdDispatch(command_buffer, (destination_extent.width + 7) / 8, (destination_extent.height + 7) / 8, 1);
+
+            // the next level reads this one; the render graph orders the last level before its readers
+            VkImageMemoryBarrier level_barrier{};
+            level_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            level_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            level_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            level_barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            level_barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            level_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            level_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            level_barrier.image = m_image;
+            level_barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 1, 0, 1 };
+            vkCmdPipelineBarrier(command_buffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 0, nullptr, 0, nullptr, 1, &level_barrier);
+
+            source_extent = destination_extent;
+        }
+    }
+
+    void VulkanHiZPyramid::destroy()
+    {
+        if (!isInitialized())
+        {
+            return;
+        }
+        vkDestroyPipeline(m_device->m_logical_device, m_reduce_pipeline, nullptr);
+        for (VkImageView mip_view : m_mip_views)
+        {
+            vkDestroyImageView(m_device->m_logical_device, mip_view, nullptr);
+        }
+        m_mip_views.clear();
+        vkDestroyImageView(m_device->m_logical_device, m_image_view, nullptr);
+        vkDestroyImage(m_device->m_logical_device, m_image, nullptr);
+        vkFreeMemory(m_device->m_logical_device, m_memory, nullptr);
+        vkDestroySampler(m_device->m_logical_device, m_sampler, nullptr);
+        m_device = nullptr;
+    }
+
+    void VulkanHiZPyramid::createImage()
+    {
+        // power of two sizes halve exactly down the chain, so every level covers the whole
+        // level below it and a uv maps to the same footprint at every level
+        m_extent = { previousPowerOfTwo(std::max(m_depth_extent.width, 1u)), previousPowerOfTwo(std::max(m_depth_extent.height, 1u)) };
+        m_mip_count = 1;
+        while ((std::max(m_extent.width, m_extent.height) >> m_mip_count) > 0)
+        {
+            m_mip_count++;
+        }
+
+        VkImageCreateInfo image_info{};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.extent = { m_extent.width, m_extent.height, 1 };
+        image_info.mipLevels = m_mip_count;
+        image_info.arrayLayers = 1;
+        image_info.format = k_format;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        image_info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateImage(m_device->m_logical_device, &image_info, nullptr, &m_image) == VK_SUCCESS, "failed to create hiz image!");
+
+        VkMemoryRequirements mem_requirements;
+        vkGetImageMemoryRequirements(m_device->m_logical_device, m_image, &mem_requirements);
+
+        VkMemoryAllocateInfo alloc_info{};
+        alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        alloc_info.allocationSize = mem_requirements.size;
+        alloc_info.memoryTypeIndex = m_device->findMemoryType(mem_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        SHERPHY_EXCEPTION_IF_FALSE(vkAllocateMemory(m_device->m_logical_device, &alloc_info, nullptr, &m_memory) == VK_SUCCESS, "failed to allocate hiz image memory!");
+        vkBindImageMemory(m_device->m_logical_device, m_image, m_memory, 0);
+
+        VkImageViewCreateInfo view_info{};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = m_image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = k_format;
+        view_info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, m_mip_count, 0, 1 };
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateImageView(m_device->m_logical_device, &view_info, nullptr, &m_image_view) == VK_SUCCESS, "failed to create hiz image view!");
+
+        m_mip_views.resize(m_mip_count);
+        for (uint32_t mip = 0; mip < m_mip_count; mip++)
+        {
+            view_info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 1, 0, 1 };
+            SHERPHY_EXCEPTION_IF_FALSE(vkCreateImageView(m_device->m_logical_device, &view_info, nullptr, &m_mip_views[mip]) == VK_SUCCESS, "failed to create hiz level view!");
+        }
+
+        m_history_valid = false;
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "RenderingMath.h"
+#include "VulkanDeletionQueue.h"
+#include "VulkanDescriptorAllocator.h"
+#include "VulkanDevice.h"
+#include "VulkanFrameAllocator.h"
+
+#include <vector>
+
+namespace Sherphy
+{
+	// push constant of HiZReduce.comp
+	struct HiZReducePushConstant
+	{
+		uint32_t source_size[2];
+		uint32_t destination_size[2];
+	};
+
+	// mirrors OcclusionView in GPUCulling.comp
+	struct HiZOcclusionView
+	{
+		Mat4x4 view_proj;
+		Vec4 hiz_size; // level 0 width and height, level count, 0 while the pyramid holds no depth yet
+	};
+
+	// Hierarchical depth pyramid for occlusion culling. Level 0 is the depth resolution
+	// rounded down to a power of two and every texel keeps the farthest depth of the
+	// depth texels its uv footprint touches, so a bounding volume whose nearest depth
+	// lies behind a texel is hidden. The pyramid is
+	// built twice a frame: from the depth pre-pass for the second culling phase, and
+	// from the final depth as history, which the first culling phase of the next frame
+	// tests against together with the view it was rendered with.
+	struct VulkanHiZPyramid
+	{
+		static const VkFormat k_format = VK_FORMAT_R32_SFLOAT;
+
+		VulkanDevice* m_device = nullptr;
+		VulkanDeletionQueue* m_deletion_queue = nullptr;
+		VulkanDescriptorAllocator* m_descriptor_allocator = nullptr;
+		VulkanFrameAllocator* m_frame_allocator = nullptr;
+
+		VkExtent2D m_depth_extent{};
+		VkExtent2D m_extent{};
+		uint32_t m_mip_count = 0;
+		VkImage m_image = VK_NULL_HANDLE;
+		VkDeviceMemory m_memory = VK_NULL_HANDLE;
+		VkImageView m_image_view = VK_NULL_HANDLE; // every level, read by the culling shader
+		std::vector<VkImageView> m_mip_views;
+		VkSampler m_sampler = VK_NULL_HANDLE; // nearest, the reduction is done by hand
+
+		VkDescriptorSetLayout m_reduce_set_layout = VK_NULL_HANDLE; // owned by the layout cache
+		VkPipelineLayout m_reduce_pipeline_layout = VK_NULL_HANDLE; // owned by the layout cache
+		VkPipeline m_reduce_pipeline = VK_NULL_HANDLE;
+
+		// the image holds the final depth of the last frame
+		bool m_history_valid = false;
+		Mat4x4 m_history_view_proj{ 1.0f };
+
+		bool isInitialized() const { return m_device != nullptr; }
+		void init(VulkanDevice* device,
+				  VulkanDeletionQueue* deletion_queue,
+				  VulkanDescriptorAllocator* descriptor_allocator,
+				  VulkanFrameAllocator* frame_allocator,
+				  VkExtent2D depth_extent);
+		// the old image is released once no frame in flight uses it, the history starts over
+		void resize(VkExtent2D depth_extent);
+		void createPipeline(const VkPipelineShaderStageCreateInfo& reduce_shader_stage,
+							VkDescriptorSetLayout reduce_set_layout,
+							VkPipelineLayout reduce_pipeline_layout);
+		// the pyramid and the view it is tested with, for set 1 of the occlusion culling shader
+		VkDescriptorSet getOcclusionSet(uint32_t current_frame, VkDescriptorSetLayout layout, const Mat4x4& view_proj, bool valid);
+		// the depth is in shader read only layout, the pyramid in general layout
+		void recordBuild(VkCommandBuffer command_buffer, uint32_t current_frame, VkImageView depth_view);
+		void destroy();
+
+		void createImage();
+	};
+}
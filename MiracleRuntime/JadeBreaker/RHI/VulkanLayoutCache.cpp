@@ -0,0 +1,123 @@
+#include "VulkanLayoutCache.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+#include "JadeBreaker/Shader/ShaderCompiler.h"
+
+#include <volk.h>
+
+namespace Sherphy
+{
+    void VulkanLayoutCache::init(VulkanDevice* device)
+    {
+        m_device = device;
+    }
+
+    VkDescriptorSetLayout VulkanLayoutCache::getSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+    {
+        m_requests++;
+        std::vector<uint64_t> signature;
+        for (const VkDescriptorSetLayoutBinding& binding : bindings)
+        {
+            SHERPHY_EXCEPTION_IF_FALSE((binding.pImmutableSamplers == nullptr), "immutable samplers are not cached");
+            signature.push_back(binding.binding);
+            signature.push_back(binding.descriptorType);
+            signature.push_back(binding.descriptorCount);
+            signature.push_back(binding.stageFlags);
+        }
+
+        std::vector<CachedSetLayout>& bucket = m_set_layouts[hashSignature(signature)];
+        for (const CachedSetLayout& cached : bucket)
+        {
+            if (cached.signature == signature)
+            {
+                return cached.layout;
+            }
+        }
+
+        VkDescriptorSetLayoutCreateInfo layout_info{};
+        layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+        layout_info.pBindings = bindings.data();
+        VkDescriptorSetLayout layout;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateDescriptorSetLayout(m_device->m_logical_device, &layout_info, nullptr, &layout) == VK_SUCCESS, "failed to create descriptor set layout!");
+        bucket.push_back({ signature, layout });
+        m_set_bindings[layout] = bindings;
+        m_created++;
+        return layout;
+    }
+
+    const std::vector<VkDescriptorSetLayoutBinding>& VulkanLayoutCache::getSetBindings(VkDescriptorSetLayout layout) const
+    {
+        auto bindings = m_set_bindings.find(layout);
+        SHERPHY_EXCEPTION_IF_FALSE((bindings != m_set_bindings.end()), "descriptor set layout was not created by the layout cache");
+        return bindings->second;
+    }
+
+    VkPipelineLayout VulkanLayoutCache::getPipelineLayout(const std::vector<VkDescriptorSetLayout>& set_layouts,
+                                                          const std::vector<VkPushConstantRange>& push_constant_ranges)
+    {
+        m_requests++;
+        std::vector<uint64_t> signature;
+        for (VkDescriptorSetLayout set_layout : set_layouts)
+        {
+            signature.push_back(reinterpret_cast<uint64_t>(set_layout));
+        }
+        for (const VkPushConstantRange& range : push_constant_ranges)
+        {
+            signature.push_back(range.stageFlags);
+            signature.push_back(range.offset);
+            signature.push_back(range.size);
+        }
+
+        std::vector<CachedPipelineLayout>& bucket = m_pipeline_layouts[hashSignature(signature)];
+        for (const CachedPipelineLayout& cached : bucket)
+        {
+            if (cached.signature == signature)
+            {
+                return cached.layout;
+            }
+        }
+
+        VkPipelineLayoutCreateInfo pipeline_layout_info{};
+        pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipeline_layout_info.setLayoutCount = static_cast<uint32_t>(set_layouts.size());
+        pipeline_layout_info.pSetLayouts = set_layouts.data();
+        pipeline_layout_info.pushConstantRangeCount = static_cast<uint32_t>(push_constant_ranges.size());
+        pipeline_layout_info.pPushConstantRanges = push_constant_ranges.data();
+        VkPipelineLayout layout;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreatePipelineLayout(m_device->m_logical_device, &pipeline_layout_info, nullptr, &layout) == VK_SUCCESS, "failed to create pipeline layout!");
+        bucket.push_back({ signature, layout });
+        m_created++;
+        return layout;
+    }
+
+    void VulkanLayoutCache::destroy()
+    {
+        if (!isInitialized())
+        {
+            return;
+        }
+        for (auto& bucket : m_pipeline_layouts)
+        {
+            for (CachedPipelineLayout& cached : bucket.second)
+            {
+                vkDestroyPipelineLayout(m_device->m_logical_device, cached.layout, nullptr);
+            }
+        }
+        for (auto& bucket : m_set_layouts)
+        {
+            for (CachedSetLayout& cached : bucket.second)
+            {
+                vkDestroyDescriptorSetLayout(m_device->m_logical_device, cached.layout, nullptr);
+            }
+        }
+        m_pipeline_layouts.clear();
+        m_set_layouts.clear();
+        m_set_bindings.clear();
+        m_device = nullptr;
+    }
+
+    uint64_t VulkanLayoutCache::hashSignature(const std::vector<uint64_t>& signature)
+    {
+        return ShaderCompiler::hash(signature.data(), signature.size() * sizeof(uint64_t));
+    }
+}
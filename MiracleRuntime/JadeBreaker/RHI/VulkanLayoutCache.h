@@ -0,0 +1,48 @@
+#pragma once
+#include "VulkanDevice.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace Sherphy
+{
+	// Descriptor set layouts and pipeline layouts shared by every pipeline. A layout is
+	// looked up by the hash of its description and created on the first request, so
+	// pipelines with the same interface get the same handles and stay compatible for
+	// descriptor set binding. The cache owns every layout it hands out.
+	struct VulkanLayoutCache
+	{
+		struct CachedSetLayout
+		{
+			std::vector<uint64_t> signature;
+			VkDescriptorSetLayout layout;
+		};
+
+		struct CachedPipelineLayout
+		{
+			std::vector<uint64_t> signature;
+			VkPipelineLayout layout;
+		};
+
+		VulkanDevice* m_device = nullptr;
+		// buckets by hash, the signature tells collisions apart
+		std::unordered_map<uint64_t, std::vector<CachedSetLayout>> m_set_layouts;
+		std::unordered_map<uint64_t, std::vector<CachedPipelineLayout>> m_pipeline_layouts;
+		// descriptor pools are sized from the bindings of a layout
+		std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSetLayoutBinding>> m_set_bindings;
+
+		uint32_t m_requests = 0;
+		uint32_t m_created = 0;
+
+		bool isInitialized() const { return m_device != nullptr; }
+		void init(VulkanDevice* device);
+		VkDescriptorSetLayout getSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+		// only layouts handed out by the cache are known
+		const std::vector<VkDescriptorSetLayoutBinding>& getSetBindings(VkDescriptorSetLayout layout) const;
+		VkPipelineLayout getPipelineLayout(const std::vector<VkDescriptorSetLayout>& set_layouts,
+										   const std::vector<VkPushConstantRange>& push_constant_ranges);
+		void destroy();
+
+		static uint64_t hashSignature(const std::vector<uint64_t>& signature);
+	};
+}
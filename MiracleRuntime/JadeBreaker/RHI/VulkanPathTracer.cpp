@@ -0,0 +1,122 @@
+#include "VulkanPathTracer.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <volk.h>
+
+namespace Sherphy
+{
+    void VulkanPathTracer::init(VulkanDevice* device, VulkanDeletionQueue* deletion_queue, VkExtent2D extent)
+    {
+        m_device = device;
+        m_deletion_queue = deletion_queue;
+        m_extent = extent;
+        m_shader_binding_table.init(m_device, m_deletion_queue);
+        createAccumulationImage();
+    }
+
+    void VulkanPathTracer::resize(VkExtent2D extent)
+    {
+        if (extent.width == m_extent.width && extent.height == m_extent.height)
+        {
+            return;
+        }
+        m_deletion_queue->destroyImage(m_accumulation_image, m_accumulation_memory, m_accumulation_image_view, m_deletion_queue->getFrameNumber());
+        m_extent = extent;
+        createAccumulationImage();
+    }
+
+    void VulkanPathTracer::setViewProj(const Mat4x4& view_proj)
+    {
+        if (view_proj != m_view_proj)
+        {
+            m_view_proj = view_proj;
+            reset();
+        }
+    }
+
+    void VulkanPathTracer::recordTrace(VkCommandBuffer command_buffer, VkPipeline pipeline, VkPipelineLayout pipeline_layout, VkDescriptorSet descriptor_set, uint32_t view_offset)
+    {
+        PathTracePushConstant push_constant{};
+        push_constant.sample_index = m_sample_count;
+        push_constant.max_bounces = k_max_bounces;
+        push_constant.frame_seed = m_frame_seed++;
+
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipeline);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipeline_layout, 0, 1, &descriptor_set, 1, &view_offset);
+        vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_RAYGEN_BIT_KHR, 0, sizeof(PathTracePushConstant), &push_constant);
+        vkCmdTraceRaysKHR(command_buffer,
+            &m_shader_binding_table.m_raygen_region,
+            &m_shader_binding_table.m_miss_region,
+            &m_shader_binding_table.m_hit_region,
+            &m_shader_binding_table.m_callable_region,
+            m_extent.width, m_extent.height, 1);
+
+        m_sample_count++;
+        m_accumulation_defined = true;
+    }
+
+    // the blit converts the linear float average to the target format, srgb encoding included
+    void VulkanPathTracer::recordResolve(VkCommandBuffer command_buffer, VkImage target_image)
+    {
+        VkImageBlit region{};
+        region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.srcOffsets[1] = { static_cast<int32_t>(m_extent.width), static_cast<int32_t>(m_extent.height), 1 };
+        region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.dstOffsets[1] = { static_cast<int32_t>(m_extent.width), static_cast<int32_t>(m_extent.height), 1 };
+        vkCmdBlitImage(command_buffer,
+            m_accumulation_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            target_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &region, VK_FILTER_NEAREST);
+    }
+
+    void VulkanPathTracer::destroy()
+    {
+        if (!isInitialized())
+        {
+            return;
+        }
+        m_shader_binding_table.destroy();
+        vkDestroyImageView(m_device->m_logical_device, m_accumulation_image_view, nullptr);
+        vkDestroyImage(m_device->m_logical_device, m_accumulation_image, nullptr);
+        vkFreeMemory(m_device->m_logical_device, m_accumulation_memory, nullptr);
+        m_device = nullptr;
+    }
+
+    void VulkanPathTracer::createAccumulationImage()
+    {
+        VkImageCreateInfo image_info{};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.extent = { m_extent.width, m_extent.height, 1 };
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.format = k_accumulation_format;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        image_info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateImage(m_device->m_logical_device, &image_info, nullptr, &m_accumulation_image) == VK_SUCCESS, "failed to create accumulation image!");
+
+        VkMemoryRequirements mem_requirements;
+        vkGetImageMemoryRequirements(m_device->m_logical_device, m_accumulation_image, &mem_requirements);
+
+        VkMemoryAllocateInfo alloc_info{};
+        alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        alloc_info.allocationSize = mem_requirements.size;
+        alloc_info.memoryTypeIndex = m_device->findMemoryType(mem_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        SHERPHY_EXCEPTION_IF_FALSE(vkAllocateMemory(m_device->m_logical_device, &alloc_info, nullptr, &m_accumulation_memory) == VK_SUCCESS, "failed to allocate accumulation image memory!");
+        vkBindImageMemory(m_device->m_logical_device, m_accumulation_image, m_accumulation_memory, 0);
+
+        VkImageViewCreateInfo view_info{};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = m_accumulation_image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = k_accumulation_format;
+        view_info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateImageView(m_device->m_logical_device, &view_info, nullptr, &m_accumulation_image_view) == VK_SUCCESS, "failed to create accumulation image view!");
+
+        m_accumulation_defined = false;
+        reset();
+    }
+}
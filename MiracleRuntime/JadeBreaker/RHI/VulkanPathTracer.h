@@ -0,0 +1,60 @@
+#pragma once
+#include "RenderingMath.h"
+#include "VulkanDeletionQueue.h"
+#include "VulkanDevice.h"
+#include "VulkanShaderBindingTable.h"
+
+#include <vector>
+
+namespace Sherphy
+{
+	// push constant of PathTrace.rgen
+	struct PathTracePushConstant
+	{
+		uint32_t sample_index; // samples already in the accumulation image
+		uint32_t max_bounces;
+		uint32_t frame_seed;
+		uint32_t padding;
+	};
+
+	// Progressive path tracing into a float accumulation image. Every frame traces
+	// one more sample per pixel and blends it into the running average, the average
+	// is blitted into the backbuffer. A camera or scene change resets the average
+	// to the next sample; once k_max_samples are in the image it is converged and
+	// tracing stops until the next reset.
+	struct VulkanPathTracer
+	{
+		static const uint32_t k_max_samples = 4096;
+		static const uint32_t k_max_bounces = 4;
+		static const VkFormat k_accumulation_format = VK_FORMAT_R32G32B32A32_SFLOAT;
+
+		VulkanDevice* m_device = nullptr;
+		VulkanDeletionQueue* m_deletion_queue = nullptr;
+		VulkanShaderBindingTable m_shader_binding_table;
+
+		VkExtent2D m_extent{};
+		VkImage m_accumulation_image = VK_NULL_HANDLE;
+		VkDeviceMemory m_accumulation_memory = VK_NULL_HANDLE;
+		VkImageView m_accumulation_image_view = VK_NULL_HANDLE;
+		bool m_accumulation_defined = false; // contents and layout are undefined until the first trace
+
+		uint32_t m_sample_count = 0;
+		uint32_t m_frame_seed = 0;
+		Mat4x4 m_view_proj{ 0.0f };
+
+		bool isInitialized() const { return m_device != nullptr; }
+		void init(VulkanDevice* device, VulkanDeletionQueue* deletion_queue, VkExtent2D extent);
+		// the old image is released once no frame in flight uses it
+		void resize(VkExtent2D extent);
+		// the camera or the scene changed, the next sample starts a new average
+		void reset() { m_sample_count = 0; }
+		void setViewProj(const Mat4x4& view_proj);
+		bool isConverged() const { return m_sample_count >= k_max_samples; }
+		void recordTrace(VkCommandBuffer command_buffer, VkPipeline pipeline, VkPipelineLayout pipeline_layout, VkDescriptorSet descriptor_set, uint32_t view_offset);
+		// the accumulation image is in transfer src layout, the target in transfer dst layout
+		void recordResolve(VkCommandBuffer command_buffer, VkImage target_image);
+		void destroy();
+
+		void createAccumulationImage();
+	};
+}
@@ -1,6 +1,7 @@
 #include "VulkanRHI.h"
 #include "Soul/Object.h"
 #include "Resource/FileSystem.h"
+#include "Resource/TextureCooker.h"
 #include "JadeBreaker/Display/GLFWDisplay.h"
 #include "Soul/GlobalContext/GlobalContext.h"
 
@@ -11,7 +12,18 @@
 #include <chrono>
 #include <set>
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
+// frame slots allocated up front, the frame pacing settings pick how many are used
+const int MAX_FRAMES_IN_FLIGHT = 3;
+const uint32_t MAX_GPU_SCENE_INSTANCES = 4096;
+const uint32_t MAX_GPU_SCENE_DRAWS = 65536;
+const uint32_t MAX_CLUSTERED_LIGHTS = 1024;
+const uint32_t MAX_RAY_TRACING_INSTANCES = 4096;
+const uint32_t MAX_BINDLESS_TEXTURES = 4096;
+const uint32_t MAX_BINDLESS_MATERIALS = 1024;
+const VkDeviceSize FRAME_ALLOCATOR_CAPACITY = 4 * 1024 * 1024;
+const VkDeviceSize TEXTURE_STREAMING_BUDGET = 256 * 1024 * 1024;
+const VkDeviceSize TEXTURE_STREAMING_UPLOAD_PER_FRAME = 16 * 1024 * 1024;
+const VkDeviceSize TEXTURE_STREAMING_STAGING = 64 * 1024 * 1024;
 
 namespace Sherphy{
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData) {
@@ -41,7 +53,8 @@ namespace Sherphy{
         vk_app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         vk_app_info.pEngineName = "No Engine";
         vk_app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        vk_app_info.apiVersion = VK_API_VERSION_1_0;
+        // 1.2 for vkCmdDrawIndexedIndirectCount used by the gpu driven path
+        vk_app_info.apiVersion = VK_API_VERSION_1_2;
 
         // Not Optional
         VkInstanceCreateInfo create_info{};
@@ -101,10 +114,14 @@ namespace Sherphy{
 
     std::vector<const char*> VulkanRHI::getRequiredExtensions()
     {
-        uint32_t display_extensions_count = 0;
-        const char** displayVkExtensions = g_miracle_global_context.m_display_system->getVkExtensions(display_extensions_count);;
-
-        std::vector<const char*> extensions(displayVkExtensions, displayVkExtensions + display_extensions_count);
+        std::vector<const char*> extensions;
+        // headless runs without glfw, so no surface extensions
+        if (!m_headless)
+        {
+            uint32_t display_extensions_count = 0;
+            const char** displayVkExtensions = g_miracle_global_context.m_display_system->getVkExtensions(display_extensions_count);
+            extensions.assign(displayVkExtensions, displayVkExtensions + display_extensions_count);
+        }
 
         if(m_enable_validation_layer)
         {
@@ -145,27 +162,72 @@ namespace Sherphy{
         createInstance();
         setupDebugMessenger();
         setupRequiredDeviceExtensions(type);
-        createSurface();
+        if (!m_headless)
+        {
+            createSurface();
+        }
         pickPhysicalDevice();
         m_device.getPhysicalDeviceProperties();
         getEnabledFeatures(type);
-        m_device.createLogicalDevice(m_surface, m_device_features, m_device_extensions, m_logical_device_create_pNext_chain);
+        m_device.createLogicalDevice(m_surface, m_device_features, m_device_extensions, m_logical_device_create_pNext_chain, !m_headless);
         vkGetDeviceQueue(m_device.m_logical_device, m_device.m_queue_family_indices.graphics_family.value(), 0, &m_graphics_queue);
         vkGetDeviceQueue(m_device.m_logical_device, m_device.m_queue_family_indices.present_family.value(), 0, &m_present_queue);
+        // queue types without a dedicated family submit to the graphics queue on their own timeline
+        vkGetDeviceQueue(m_device.m_logical_device, m_device.getQueueFamily(QueueType::Compute), 0, &m_compute_queue);
+        vkGetDeviceQueue(m_device.m_logical_device, m_device.getQueueFamily(QueueType::Transfer), 0, &m_transfer_queue);
+        m_device.m_timeline_sync.init(m_device.m_logical_device, m_graphics_queue, m_compute_queue, m_transfer_queue);
+        SHERPHY_LOG("queues: compute " + std::string(m_device.hasDedicatedQueue(QueueType::Compute) ? "async" : "shared with graphics") +
+            ", transfer " + std::string(m_device.hasDedicatedQueue(QueueType::Transfer) ? "dedicated" : "shared with graphics"));
+        m_deletion_queue.init(&m_device);
+        if (m_headless)
+        {
+            createHeadlessTarget();
+            return;
+        }
         createSwapChain(m_device.m_physical_device);
         createImageViews();
     }
 
+    void VulkanRHI::enableHeadless(uint32_t width, uint32_t height)
+    {
+        m_headless = true;
+        m_extent = { width, height };
+    }
+
+    void VulkanRHI::setHeadlessFrameCallback(HeadlessFrameCallback callback)
+    {
+        m_headless_frame_callback = callback;
+    }
+
+    void VulkanRHI::finishHeadless()
+    {
+        m_device.m_timeline_sync.wait(m_frame_points);
+        pollCompletedFrames();
+        flushHeadlessFrames();
+    }
+
+    void VulkanRHI::createHeadlessTarget()
+    {
+        m_swap_chain_image_format = VK_FORMAT_R8G8B8A8_SRGB;
+        m_headless_target.init(&m_device, m_extent, m_swap_chain_image_format, MAX_FRAMES_IN_FLIGHT);
+        // framebuffers are built from these like from swapchain views, the target owns them
+        m_swap_chain_image_views = m_headless_target.m_image_views;
+    }
+
     void VulkanRHI::setupRequiredDeviceExtensions(PipeLineType type) 
     {
+        if (m_headless)
+        {
+            m_device_extensions.erase(std::remove_if(m_device_extensions.begin(), m_device_extensions.end(), [](const char* extension) {
+                return strcmp(extension, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0;
+            }), m_device_extensions.end());
+        }
         switch (type)
         {
         case Sherphy::PipeLineType::TriangleTest:
             break;
         case Sherphy::PipeLineType::Normal:
             break;
-        case Sherphy::PipeLineType::Uniform:
-            break;
         case Sherphy::PipeLineType::RayTracing:
             // Ray tracing related extensions required by raytracing
             m_device_extensions.push_back(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME);
@@ -189,12 +251,25 @@ namespace Sherphy{
 
     void VulkanRHI::getEnabledFeatures(PipeLineType type) 
     {
+        m_enabled_vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        m_logical_device_create_pNext_chain = &m_enabled_vulkan12_features;
+        // cpu waits and cross queue dependencies go through timeline semaphores
+        m_enabled_vulkan12_features.timelineSemaphore = VK_TRUE;
+
         switch (type)
         {
         case Sherphy::PipeLineType::RayTracing:
             getEnabledFeaturesRayTracing();
             break;
         default:
+            // gpu driven scene: compacted indirect draws, one draw per visible instance
+            m_enabled_vulkan12_features.drawIndirectCount = VK_TRUE;
+            m_device_features.multiDrawIndirect = VK_TRUE;
+            m_device_features.drawIndirectFirstInstance = VK_TRUE;
+            // bindless textures and materials
+            VulkanBindlessTable::enableRequiredFeatures(m_enabled_vulkan12_features);
+            // cooked textures are bc compressed when the device can sample them, rgba8 otherwise
+            m_device_features.textureCompressionBC = m_device.m_physical_device_features.textureCompressionBC;
             break;
         }
     }
@@ -202,12 +277,12 @@ namespace Sherphy{
     void VulkanRHI::getEnabledFeaturesRayTracing()
     {
         // Enable features required for ray tracing using feature chaining via pNext		
-        m_enabled_buffer_device_addres_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
-        m_enabled_buffer_device_addres_features.bufferDeviceAddress = VK_TRUE;
+        // buffer device address is core in 1.2 and must live in the 1.2 feature struct once that is chained
+        m_enabled_vulkan12_features.bufferDeviceAddress = VK_TRUE;
 
         m_enabled_ray_tracing_pipeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
         m_enabled_ray_tracing_pipeline_features.rayTracingPipeline = VK_TRUE;
-        m_enabled_ray_tracing_pipeline_features.pNext = &m_enabled_buffer_device_addres_features;
+        m_enabled_ray_tracing_pipeline_features.pNext = &m_enabled_vulkan12_features;
 
         m_enabled_acceleration_structure_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
         m_enabled_acceleration_structure_features.accelerationStructure = VK_TRUE;
@@ -216,28 +291,185 @@ namespace Sherphy{
         m_logical_device_create_pNext_chain = &m_enabled_acceleration_structure_features;
     }
 
+    void VulkanRHI::loadPipelineShaders(PipeLineType type)
+    {
+        m_pipeline_type = type;
+        // every shader of the pipeline compiles in parallel
+        if (type == PipeLineType::RayTracing)
+        {
+            // raygen, miss and closest hit of the progressive path tracer
+            m_pipeline_shaders = {
+                m_shader_library.load("RayTracing/PathTrace.rgen"),
+                m_shader_library.load("RayTracing/PathTrace.rmiss"),
+                m_shader_library.load("RayTracing/PathTrace.rchit")
+            };
+            // the closest hit shader reads float vertices through their address
+            m_vertex_format = VulkanVertexFormat::createFloat();
+            // the view block
+            m_dynamic_frame_bindings = { 2 };
+        }
+        else
+        {
+            m_pipeline_shaders = {
+                m_shader_library.load("Normal/NormalShaderGPUDriven.vert"),
+                m_shader_library.load("Normal/NormalBindlessColorOutput.frag")
+            };
+            if (m_vertex_format.isEmpty())
+            {
+                m_vertex_format = VulkanVertexFormat::createCompressed();
+            }
+            // the view block, the instance records and the light records
+            m_dynamic_frame_bindings = { 0, 1, 3 };
+            // frustum culling, compaction, the two phase occlusion variant, the depth pyramid reduction
+            // and the light assignment to clusters
+            m_culling_shaders = {
+                m_shader_library.load("Compute/GPUCulling.comp"),
+                m_shader_library.load("Compute/GPUDrawCompaction.comp"),
+                m_shader_library.load("Compute/GPUCulling.comp", { { "OCCLUSION_CULLING", "1" } }),
+                m_shader_library.load("Compute/HiZReduce.comp"),
+                m_shader_library.load("Compute/ClusterLightCulling.comp")
+            };
+        }
+        m_shader_library.wait();
+    }
+
     void VulkanRHI::createRenderingStructure(PipeLineType type) 
     {
-        std::vector<char> vertex_shader = g_miracle_global_context.m_file_system->readBinaryFile("I:/SherphyEngine/resource/public/SherphyShaderLib/SPV/Normal/NormalShader_vert.spv");
-        std::vector<char> fragment_shader = g_miracle_global_context.m_file_system->readBinaryFile("I:/SherphyEngine/resource/public/SherphyShaderLib/SPV/Normal/NormalColorOutput_frag.spv");
-        std::vector<char> closet_shader = g_miracle_global_context.m_file_system->readBinaryFile("I:/SherphyEngine/resource/public/SherphyShaderLib/SPV/Normal/NormalColorOutput_frag.spv");
-        createGraphicsPipeline(type, vertex_shader, fragment_shader);
+        createMainPipeline();
+        if (!m_culling_shaders.empty())
+        {
+            createCullingPipeline();
+        }
+        cleanShader();
+    }
+
+    void VulkanRHI::createShaderLibrary()
+    {
+        m_shader_library.init(Miracle_SHADER_ROOT, Miracle_SHADER_CACHE_PATH);
+    }
+
+    void VulkanRHI::createMainPipeline()
+    {
+        std::vector<char> closest_hit_shader;
+        if (m_pipeline_shaders.size() > 2)
+        {
+            closest_hit_shader = m_shader_library.getSpirv(m_pipeline_shaders[2]);
+        }
+        createGraphicsPipeline(m_pipeline_type,
+            m_shader_library.getSpirv(m_pipeline_shaders[0]),
+            m_shader_library.getSpirv(m_pipeline_shaders[1]),
+            closest_hit_shader);
+    }
+
+    void VulkanRHI::createCullingPipeline()
+    {
+        // set 1 of the occlusion variant holds the depth pyramid and the view it was rendered with
+        VkPipelineShaderStageCreateInfo occlusion_cull_stage = loadShader(m_shader_library.getSpirv(m_culling_shaders[2]), VK_SHADER_STAGE_COMPUTE_BIT);
+        m_occlusion_set_layout = m_layout_cache.getSetLayout(m_shader_library.getReflection(m_culling_shaders[2]).getSetBindings(1));
+        m_gpu_scene.createCullingPipeline(loadShader(m_shader_library.getSpirv(m_culling_shaders[0]), VK_SHADER_STAGE_COMPUTE_BIT),
+            loadShader(m_shader_library.getSpirv(m_culling_shaders[1]), VK_SHADER_STAGE_COMPUTE_BIT),
+            &occlusion_cull_stage,
+            m_occlusion_set_layout);
+
+        if (m_hiz_pyramid.isInitialized())
+        {
+            const ShaderReflection& reduce_reflection = m_shader_library.getReflection(m_culling_shaders[3]);
+            VkDescriptorSetLayout reduce_set_layout = m_layout_cache.getSetLayout(reduce_reflection.getSetBindings(0));
+            VkPipelineLayout reduce_pipeline_layout = m_layout_cache.getPipelineLayout({ reduce_set_layout },
+                { { reduce_reflection.push_constant_stages, 0, reduce_reflection.push_constant_size } });
+            m_hiz_pyramid.createPipeline(loadShader(m_shader_library.getSpirv(m_culling_shaders[3]), VK_SHADER_STAGE_COMPUTE_BIT),
+                reduce_set_layout,
+                reduce_pipeline_layout);
+        }
+
+        if (m_clustered_lights.isInitialized())
+        {
+            VkDescriptorSetLayout assign_set_layout = m_layout_cache.getSetLayout(m_shader_library.getReflection(m_culling_shaders[4]).getSetBindings(0));
+            m_clustered_lights.createPipeline(loadShader(m_shader_library.getSpirv(m_culling_shaders[4]), VK_SHADER_STAGE_COMPUTE_BIT),
+                assign_set_layout,
+                m_layout_cache.getPipelineLayout({ assign_set_layout }, {}));
+        }
+    }
+
+    void VulkanRHI::setOcclusionCulling(bool enabled)
+    {
+        m_occlusion_culling = enabled;
+        // the pyramid stops being rebuilt while disabled, it is stale when culling comes back
+        m_hiz_pyramid.m_history_valid = false;
+    }
+
+    // called at frame start, nothing is being recorded yet
+    void VulkanRHI::reloadShaders()
+    {
+        std::vector<ShaderHandle> changed = m_shader_library.update();
+        auto uses_changed = [&changed](const std::vector<ShaderHandle>& shaders) {
+            return std::any_of(shaders.begin(), shaders.end(), [&changed](ShaderHandle shader) {
+                return std::find(changed.begin(), changed.end(), shader) != changed.end();
+            });
+        };
+
+        VkDevice device = m_device.m_logical_device;
+        if (uses_changed(m_pipeline_shaders) && !isFrameSetCompatible(m_shader_library.getReflection(m_pipeline_shaders)))
+        {
+            LogMessage("set 0 of the reloaded shaders changed, restart to apply it", WarningStage::Medium);
+        }
+        else if (uses_changed(m_pipeline_shaders))
+        {
+            // the layout belongs to the layout cache
+            VkPipeline old_pipeline = m_graphics_pipeline;
+            VkPipeline old_depth_pipeline = m_depth_pipeline;
+            m_deletion_queue.push([device, old_pipeline, old_depth_pipeline]() {
+                vkDestroyPipeline(device, old_pipeline, nullptr);
+                vkDestroyPipeline(device, old_depth_pipeline, nullptr);
+            });
+            createMainPipeline();
+            // recorded scene draws bind the old pipeline
+            m_command_cache.invalidate();
+            if (m_path_tracer.isInitialized())
+            {
+                m_path_tracer.reset();
+            }
+        }
+        if (uses_changed(m_culling_shaders))
+        {
+            VkPipeline old_cull_pipeline = m_gpu_scene.m_cull_pipeline;
+            VkPipeline old_compact_pipeline = m_gpu_scene.m_compact_pipeline;
+            VkPipeline old_occlusion_cull_pipeline = m_gpu_scene.m_occlusion_cull_pipeline;
+            VkPipeline old_reduce_pipeline = m_hiz_pyramid.m_reduce_pipeline;
+            VkPipeline old_assign_pipeline = m_clustered_lights.m_assign_pipeline;
+            VkPipelineLayout old_layout = m_gpu_scene.m_cull_pipeline_layout;
+            m_deletion_queue.push([device, old_cull_pipeline, old_compact_pipeline, old_occlusion_cull_pipeline, old_reduce_pipeline, old_assign_pipeline, old_layout]() {
+                vkDestroyPipeline(device, old_cull_pipeline, nullptr);
+                vkDestroyPipeline(device, old_compact_pipeline, nullptr);
+                vkDestroyPipeline(device, old_occlusion_cull_pipeline, nullptr);
+                vkDestroyPipeline(device, old_reduce_pipeline, nullptr);
+                vkDestroyPipeline(device, old_assign_pipeline, nullptr);
+                vkDestroyPipelineLayout(device, old_layout, nullptr);
+            });
+            createCullingPipeline();
+        }
+        cleanShader();
     }
 
     void VulkanRHI::allocRenderingMemory(PipeLineType type)
     {
         m_device.createCommandBuffers(MAX_FRAMES_IN_FLIGHT);
-        createDepthResources();
-        createFrameBuffers();
-        createTextureImage();
-        createTextureImageView();
+        createGPUProfiler();
+        createRenderGraph();
         createTextureSampler();
+        createTextureStreamer(type);
+        createMaterials(type);
         createVertexBuffer(type);
         createIndexBuffer(type);
         createTransformBuffer(type);
-        createUniformBuffers();
-        createDescriptorPool(type);
+        createFrameAllocator();
+        createGPUScene(type);
+        createClusteredLights(type);
+        createRayTracingScene(type);
+        createPathTracer(type);
+        createDescriptorAllocator();
         createDescriptorSets(type);
+        createHiZPyramid(type);
     }
 
     void VulkanRHI::initVulkan(PipeLineType type)
@@ -245,13 +477,21 @@ namespace Sherphy{
         volkInitialize();
         initBasic(type);
         createRenderPass();
+        createShaderLibrary();
+        loadPipelineShaders(type);
         createDescriptorSetLayout(type);
         allocRenderingMemory(type);
         createRenderingStructure(type);
         createSyncObjects();
     }
 
-    std::vector<VkVertex>& VulkanRHI::getVerticesWrite()
+    void VulkanRHI::setVertexFormat(const VulkanVertexFormat& vertex_format)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE((m_vertex_buffer.buffer == VK_NULL_HANDLE), "the vertex format is fixed once the vertex buffer exists");
+        m_vertex_format = vertex_format;
+    }
+
+    std::vector<Vertex>& VulkanRHI::getVerticesWrite()
     {
         return m_vertices;
     }
@@ -261,125 +501,271 @@ namespace Sherphy{
         return m_indices;
     }
 
-    void VulkanRHI::createDescriptorSets(PipeLineType type)
+    std::vector<Meshlet>& VulkanRHI::getMeshletsWrite()
     {
-        switch (type)
+        return m_meshlets;
+    }
+
+    uint32_t VulkanRHI::addMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<Meshlet>& meshlets)
+    {
+        MeshRange range{};
+        range.first_vertex = static_cast<uint32_t>(m_vertices.size());
+        range.vertex_count = static_cast<uint32_t>(vertices.size());
+        range.first_index = static_cast<uint32_t>(m_indices.size());
+        range.index_count = static_cast<uint32_t>(indices.size());
+        range.first_meshlet = static_cast<uint32_t>(m_meshlets.size());
+        range.meshlet_count = static_cast<uint32_t>(meshlets.size());
+        m_vertices.insert(m_vertices.end(), vertices.begin(), vertices.end());
+        m_indices.insert(m_indices.end(), indices.begin(), indices.end());
+        m_meshlets.insert(m_meshlets.end(), meshlets.begin(), meshlets.end());
+        m_mesh_ranges.push_back(range);
+        return static_cast<uint32_t>(m_mesh_ranges.size() - 1);
+    }
+
+    // ids index m_mesh_instances and the scenes alike: a scene created without instances holds the
+    // default instance at 0, the first instance added afterwards takes its place
+    uint32_t VulkanRHI::addMeshInstance(uint32_t mesh_id, const Mat4x4& model, uint32_t material_id)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE((m_mesh_instances.size() < MAX_GPU_SCENE_INSTANCES),
+            "at most " + std::to_string(MAX_GPU_SCENE_INSTANCES) + " mesh instances are supported, raise MAX_GPU_SCENE_INSTANCES");
+        bool replaces_default = m_mesh_instances.empty();
+        m_mesh_instances.push_back({ mesh_id, model, material_id });
+        uint32_t instance_id = static_cast<uint32_t>(m_mesh_instances.size() - 1);
+        if (m_gpu_scene.isInitialized())
         {
-        case PipeLineType::RayTracing:
+            if (replaces_default)
+            {
+                m_gpu_scene.setInstance(instance_id, mesh_id, model, material_id);
+            }
+            else
+            {
+                m_gpu_scene.addInstance(mesh_id, model, material_id);
+            }
+        }
+        if (m_ray_tracing_scene.isInitialized())
+        {
+            if (replaces_default)
+            {
+                m_ray_tracing_scene.setInstance(instance_id, mesh_id, model, mesh_id);
+                // same record count, the hit record of instance 0 still has to be rewritten
+                m_path_tracer.m_shader_binding_table.clearHitRecords();
+            }
+            else
+            {
+                m_ray_tracing_scene.addInstance(mesh_id, model, mesh_id);
+            }
+            m_path_tracer.reset();
+        }
+        return instance_id;
+    }
 
-            break;
-        default:
-            createDescriptorSetsNormal();
-            break;
+    void VulkanRHI::setMeshInstanceTransform(uint32_t instance_id, const Mat4x4& model)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE((instance_id < m_mesh_instances.size()), "mesh instance does not exist");
+        // the application sets every transform every frame, only a real move restarts the accumulation
+        if (m_path_tracer.isInitialized() && m_mesh_instances[instance_id].model != model)
+        {
+            m_path_tracer.reset();
+        }
+        m_mesh_instances[instance_id].model = model;
+        if (m_gpu_scene.isInitialized())
+        {
+            m_gpu_scene.setInstanceTransform(instance_id, model);
+        }
+        if (m_ray_tracing_scene.isInitialized())
+        {
+            m_ray_tracing_scene.setInstanceTransform(instance_id, model);
         }
     }
 
-    void VulkanRHI::createDescriptorSetsNormal() 
+    uint32_t VulkanRHI::addLight(const LightComponent& light, const Vec3& position)
     {
-        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, m_descriptor_set_layout);
-        VkDescriptorSetAllocateInfo alloc_info{};
-        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        alloc_info.descriptorPool = m_descriptor_pool;
-        alloc_info.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-        alloc_info.pSetLayouts = layouts.data();
+        return m_clustered_lights.addLight(VulkanClusteredLights::makeLightRecord(light, position));
+    }
 
-        m_descriptor_sets.resize(MAX_FRAMES_IN_FLIGHT);
-        SHERPHY_EXCEPTION_IF_FALSE(vkAllocateDescriptorSets(m_device.m_logical_device, &alloc_info, m_descriptor_sets.data()) == VK_SUCCESS, "failed to allocate descriptor sets!");
+    void VulkanRHI::setLight(uint32_t light_id, const LightComponent& light, const Vec3& position)
+    {
+        m_clustered_lights.setLight(light_id, VulkanClusteredLights::makeLightRecord(light, position));
+    }
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            VkDescriptorBufferInfo buffer_info{};
-            buffer_info.buffer = m_uniform_buffers[i].buffer;
-            buffer_info.offset = 0;
-            buffer_info.range = sizeof(VkUniformBufferObject);
-
-            VkDescriptorImageInfo image_info{};
-            image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            image_info.imageView = m_texture_image_view;
-            image_info.sampler = m_sampler;
-
-            std::array<VkWriteDescriptorSet, 2> descriptor_write{};
-            descriptor_write[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptor_write[0].dstSet = m_descriptor_sets[i];
-            descriptor_write[0].dstBinding = 0;
-            descriptor_write[0].dstArrayElement = 0;
-            descriptor_write[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            descriptor_write[0].descriptorCount = 1;
-            descriptor_write[0].pBufferInfo = &buffer_info;
-
-            descriptor_write[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptor_write[1].dstSet = m_descriptor_sets[i];
-            descriptor_write[1].dstBinding = 1;
-            descriptor_write[1].dstArrayElement = 0;
-            descriptor_write[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            descriptor_write[1].descriptorCount = 1;
-            descriptor_write[1].pImageInfo = &image_info;
-
-            vkUpdateDescriptorSets(m_device.m_logical_device, static_cast<uint32_t>(descriptor_write.size()), descriptor_write.data(), 0, nullptr);
+    void VulkanRHI::createGPUScene(PipeLineType type)
+    {
+        SHERPHY_RETURN_IF_FALSE((type != PipeLineType::RayTracing), "RayTracing pipeline does not use gpu scene");
+
+        if (m_mesh_ranges.empty())
+        {
+            // everything written through getVerticesWrite is one mesh
+            m_gpu_scene.registerMesh(m_vertices, 0, static_cast<uint32_t>(m_vertices.size()), 0, static_cast<uint32_t>(m_indices.size()), m_mesh_quantizations[0], m_meshlets);
         }
-        return;
+        for (size_t i = 0; i < m_mesh_ranges.size(); i++)
+        {
+            const MeshRange& range = m_mesh_ranges[i];
+            std::vector<Meshlet> meshlets(m_meshlets.begin() + range.first_meshlet, m_meshlets.begin() + range.first_meshlet + range.meshlet_count);
+            m_gpu_scene.registerMesh(m_vertices, range.first_vertex, range.vertex_count, range.first_index, range.index_count, m_mesh_quantizations[i], meshlets);
+        }
+        for (const MeshInstance& instance : m_mesh_instances)
+        {
+            m_gpu_scene.addInstance(instance.mesh_id, instance.model, instance.material_id);
+        }
+        if (m_mesh_instances.empty())
+        {
+            m_gpu_scene.addInstance(0, Mat4x4(1.0f));
+        }
+        m_gpu_scene.init(&m_device, &m_frame_allocator, MAX_FRAMES_IN_FLIGHT, MAX_GPU_SCENE_INSTANCES, MAX_GPU_SCENE_DRAWS);
     }
 
-    void VulkanRHI::createDescriptorSetsRayTracing() 
+    void VulkanRHI::createHiZPyramid(PipeLineType type)
     {
+        SHERPHY_RETURN_IF_FALSE((m_gpu_scene.isInitialized()), "only the gpu scene culls against the depth pyramid");
+        findDepthFormat();
+        SHERPHY_RETURN_IF_FALSE((m_depth_sampled), "no depth format can be sampled, occlusion culling is disabled");
+        m_hiz_pyramid.init(&m_device, &m_deletion_queue, &m_descriptor_allocator, &m_frame_allocator, m_extent);
+    }
 
+    void VulkanRHI::createClusteredLights(PipeLineType type)
+    {
+        SHERPHY_RETURN_IF_FALSE((type != PipeLineType::RayTracing), "the path tracer does not shade with clustered lights");
+        m_clustered_lights.init(&m_device, &m_frame_allocator, &m_descriptor_allocator, MAX_FRAMES_IN_FLIGHT, MAX_CLUSTERED_LIGHTS);
     }
 
-    void VulkanRHI::createDescriptorPool(PipeLineType type) 
+    void VulkanRHI::createRayTracingScene(PipeLineType type)
+    {
+        SHERPHY_RETURN_IF_FALSE((type == PipeLineType::RayTracing), "only the RayTracing pipeline builds acceleration structures");
+
+        if (m_mesh_ranges.empty())
+        {
+            m_ray_tracing_scene.registerMesh(0, static_cast<uint32_t>(m_vertices.size()), 0, static_cast<uint32_t>(m_indices.size()));
+        }
+        for (const MeshRange& range : m_mesh_ranges)
+        {
+            m_ray_tracing_scene.registerMesh(range.first_vertex, range.vertex_count, range.first_index, range.index_count);
+        }
+        // the custom index lets hit shaders find the mesh of an instance
+        for (const MeshInstance& instance : m_mesh_instances)
+        {
+            m_ray_tracing_scene.addInstance(instance.mesh_id, instance.model, instance.mesh_id);
+        }
+        if (m_mesh_instances.empty())
+        {
+            m_ray_tracing_scene.addInstance(0, Mat4x4(1.0f));
+        }
+        m_ray_tracing_scene.init(&m_device, m_vertex_buffer.buffer, m_vertex_format.m_stride, m_index_buffer.buffer, MAX_FRAMES_IN_FLIGHT, MAX_RAY_TRACING_INSTANCES);
+    }
+
+    void VulkanRHI::createPathTracer(PipeLineType type)
+    {
+        SHERPHY_RETURN_IF_FALSE((type == PipeLineType::RayTracing), "only the RayTracing pipeline path traces");
+        m_path_tracer.init(&m_device, &m_deletion_queue, m_extent);
+        m_path_tracer.m_shader_binding_table.setRayGen(0);
+        m_path_tracer.m_shader_binding_table.addMiss(1);
+    }
+
+    void VulkanRHI::updateShaderBindingTable()
+    {
+        VulkanShaderBindingTable& shader_binding_table = m_path_tracer.m_shader_binding_table;
+        uint32_t instance_count = m_ray_tracing_scene.getInstanceCount();
+        if (shader_binding_table.getHitRecordCount() != instance_count)
+        {
+            shader_binding_table.clearHitRecords();
+            for (uint32_t i = 0; i < instance_count; i++)
+            {
+                RayTracingHitRecord hit_record = m_ray_tracing_scene.getHitRecord(i);
+                shader_binding_table.addHitRecord(2, &hit_record, sizeof(RayTracingHitRecord));
+            }
+        }
+        // groups are raygen, miss, closest hit, see createGraphicsPipelineRayTracing
+        shader_binding_table.build(m_graphics_pipeline, 3);
+    }
+
+    void VulkanRHI::createDescriptorSets(PipeLineType type)
     {
         switch (type)
         {
-        case Sherphy::PipeLineType::TriangleTest:
-            createDescriptorPoolNormal();
-            break;
-        case Sherphy::PipeLineType::Normal:
-            createDescriptorPoolNormal();
-            break;
-        case Sherphy::PipeLineType::Uniform:
-            createDescriptorPoolNormal();
-            break;
-        case Sherphy::PipeLineType::RayTracing:
-            createDescriptorPoolRayTracing();
+        case PipeLineType::RayTracing:
+            createDescriptorSetsRayTracing();
             break;
         default:
-            createDescriptorPoolNormal();
+            createDescriptorSetsNormal();
             break;
         }
     }
 
-    void VulkanRHI::createDescriptorPoolRayTracing() 
+    void VulkanRHI::createDescriptorSetsNormal() 
     {
+        m_descriptor_sets.resize(MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            // view block, instances and lights come from the frame allocator, located by dynamic offsets at bind time
+            std::vector<DescriptorWrite> writes(7);
+            writes[0].binding = 0;
+            writes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            writes[0].buffer_info = { m_frame_allocator.m_buffer.buffer, 0, sizeof(VkViewUniformObject) };
+
+            writes[1].binding = 1;
+            writes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            writes[1].buffer_info = { m_frame_allocator.m_buffer.buffer, 0, m_gpu_scene.getInstanceRange() };
+
+            writes[2].binding = 2;
+            writes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[2].buffer_info = { m_gpu_scene.m_visible_instance_buffers[i].buffer, 0, VK_WHOLE_SIZE };
+
+            writes[3].binding = 3;
+            writes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            writes[3].buffer_info = { m_frame_allocator.m_buffer.buffer, 0, m_clustered_lights.getLightRange() };
+
+            // the light lists of each cluster, written by the light assignment pass
+            writes[4].binding = 4;
+            writes[4].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[4].buffer_info = { m_clustered_lights.m_light_count_buffers[i].buffer, 0, VK_WHOLE_SIZE };
+
+            writes[5].binding = 5;
+            writes[5].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[5].buffer_info = { m_clustered_lights.m_light_index_buffers[i].buffer, 0, VK_WHOLE_SIZE };
+
+            // the mesh records hold the bounds quantized positions are relative to
+            writes[6].binding = 6;
+            writes[6].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[6].buffer_info = { m_gpu_scene.m_mesh_buffer.buffer, 0, VK_WHOLE_SIZE };
+
+            // textures live in the bindless table, set 1
+            m_descriptor_sets[i] = m_descriptor_allocator.getPersistentSet(m_descriptor_set_layout, writes);
+        }
+        return;
+    }
 
+    // the sets are allocated every frame, see updateRayTracingDescriptorSet
+    void VulkanRHI::createDescriptorSetsRayTracing() 
+    {
+        m_descriptor_sets.assign(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
     }
 
-    void VulkanRHI::createDescriptorPoolNormal() 
+    // a fresh set from the pools of the frame slot follows the resized accumulation image and the top level structure of the slot
+    void VulkanRHI::updateRayTracingDescriptorSet(uint32_t current_frame)
     {
-        std::array<VkDescriptorPoolSize, 2> pool_size{};
-        pool_size[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        pool_size[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-        pool_size[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        pool_size[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        std::vector<DescriptorWrite> writes(3);
+        writes[0].binding = 0;
+        writes[0].type = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+        writes[0].acceleration_structure = m_ray_tracing_scene.getTopLevel(current_frame).handle;
+
+        writes[1].binding = 1;
+        writes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[1].image_info = { VK_NULL_HANDLE, m_path_tracer.m_accumulation_image_view, VK_IMAGE_LAYOUT_GENERAL };
 
-        VkDescriptorPoolCreateInfo pool_info{};
-        pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        pool_info.poolSizeCount = static_cast<uint32_t>(pool_size.size());
-        pool_info.pPoolSizes = pool_size.data();
-        pool_info.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        writes[2].binding = 2;
+        writes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        writes[2].buffer_info = { m_frame_allocator.m_buffer.buffer, 0, sizeof(VkRayTracingViewObject) };
 
-        SHERPHY_EXCEPTION_IF_FALSE(vkCreateDescriptorPool(m_device.m_logical_device, &pool_info, nullptr, &m_descriptor_pool) == VK_SUCCESS, "failed to create descriptor pool!");
+        m_descriptor_sets[current_frame] = m_descriptor_allocator.allocateFrame(current_frame, m_descriptor_set_layout, writes);
     }
 
-    void VulkanRHI::createUniformBuffers()
+    // set 0 of every frame slot and the per frame sets, pools grow on demand
+    void VulkanRHI::createDescriptorAllocator()
     {
-        VkDeviceSize buffer_size = sizeof(VkUniformBufferObject);
-
-        m_uniform_buffers.resize(MAX_FRAMES_IN_FLIGHT);
-
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            SHERPHY_ASSERT(m_device.createBuffer(buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                m_uniform_buffers[i]), VK_SUCCESS, "");
+        m_descriptor_allocator.init(&m_device, &m_layout_cache, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+    }
 
-            vkMapMemory(m_device.m_logical_device, m_uniform_buffers[i].memory, 0, buffer_size, 0, &m_uniform_buffers[i].mapped);
-        }
+    void VulkanRHI::createFrameAllocator()
+    {
+        m_frame_allocator.init(&m_device, MAX_FRAMES_IN_FLIGHT, FRAME_ALLOCATOR_CAPACITY);
     }
 
 
@@ -391,95 +777,206 @@ namespace Sherphy{
         auto current_time = std::chrono::high_resolution_clock::now();
         float time = std::chrono::duration<float, std::chrono::seconds::period>(current_time - start_time).count();
 
-        Vec3 camera_pos = {};
+        Vec3 camera_pos = { 2.0f, 2.0f, 2.0f };
+
+        // this frame slot was waited on, its region of the allocator is free again
+        m_frame_allocator.beginFrame(current_image);
+
+        Mat4x4 model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 
-        VkUniformBufferObject ubo{};
-        ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.proj = glm::perspective(glm::radians(45.0f), m_extent.width / (float)m_extent.height, 0.1f, 10.0f);
-        ubo.proj[1][1] *= -1;
+        const float near_plane = 0.1f;
+        const float far_plane = 10.0f;
+
+        VkViewUniformObject view_block{};
+        view_block.view = glm::lookAt(camera_pos, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        view_block.proj = glm::perspective(glm::radians(45.0f), m_extent.width / (float)m_extent.height, near_plane, far_plane);
+        view_block.proj[1][1] *= -1;
+        view_block.view_proj = view_block.proj * view_block.view;
+        view_block.camera_position = Vec4(camera_pos, 1.0f);
+        m_view_proj = view_block.view_proj;
+        m_camera_position = camera_pos;
+        if (m_clustered_lights.isInitialized())
+        {
+            VulkanClusteredLights::setClusterView(view_block, near_plane, far_plane, m_extent, m_clustered_lights.getLightCount());
+            m_clustered_lights.uploadLights(current_image);
+        }
+
+        m_view_offset = m_frame_allocator.push(view_block);
+        if (m_path_tracer.isInitialized())
+        {
+            VkRayTracingViewObject ray_tracing_view{};
+            ray_tracing_view.view_inverse = glm::inverse(view_block.view);
+            ray_tracing_view.proj_inverse = glm::inverse(view_block.proj);
+            m_ray_tracing_view_offset = m_frame_allocator.push(ray_tracing_view);
+            m_path_tracer.setViewProj(m_view_proj);
+        }
+
+        // per object data, one record per instance
+        // without instances from the application the single default instance spins
+        if (m_mesh_instances.empty())
+        {
+            if (m_gpu_scene.isInitialized())
+            {
+                m_gpu_scene.setInstanceTransform(0, model);
+            }
+            if (m_ray_tracing_scene.isInitialized())
+            {
+                m_ray_tracing_scene.setInstanceTransform(0, model);
+                m_path_tracer.reset();
+            }
+        }
+        if (m_gpu_scene.isInitialized())
+        {
+            m_gpu_scene.uploadInstances(current_image);
+        }
 
-        SHERPHY_MEMCPY(m_uniform_buffers[current_image].mapped, &ubo, sizeof(ubo));
+        // residency changes rewrite bindless slots, which reach this frame's set in beginFrame
+        if (m_texture_streamer.isInitialized())
+        {
+            updateTextureStreaming(view_block);
+        }
+        if (m_bindless_table.isInitialized())
+        {
+            m_bindless_table.beginFrame(current_image);
+        }
+        if (m_path_tracer.isInitialized())
+        {
+            updateShaderBindingTable();
+            updateRayTracingDescriptorSet(current_image);
+        }
     }
 
+    // set 0 holds the per frame data, its bindings come from the shaders of the pipeline
     void VulkanRHI::createDescriptorSetLayout(PipeLineType type)
     {
-        switch (type)
+        m_layout_cache.init(&m_device);
+        m_frame_set_bindings = getFrameSetBindings(m_shader_library.getReflection(m_pipeline_shaders));
+        m_descriptor_set_layout = m_layout_cache.getSetLayout(m_frame_set_bindings);
+        if (type != PipeLineType::RayTracing)
         {
-            case PipeLineType::RayTracing:
-                createDescriptorSetLayoutRayTracing();
-                break;
-            default:
-                createDescriptorSetLayoutNormal();
-                break;
+            createBindlessTable();
         }
-        return;
     }
 
-    void VulkanRHI::createDescriptorSetLayoutRayTracing()
+    // reflection cannot tell dynamic buffers apart, the frame allocator bindings are listed per pipeline type
+    std::vector<VkDescriptorSetLayoutBinding> VulkanRHI::getFrameSetBindings(const ShaderReflection& reflection)
     {
-        VkDescriptorSetLayoutBinding acceleration_structure_layout_binding{};
-        acceleration_structure_layout_binding.binding = 0;
-        acceleration_structure_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
-        acceleration_structure_layout_binding.descriptorCount = 1;
-        acceleration_structure_layout_binding.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+        std::vector<VkDescriptorSetLayoutBinding> bindings = reflection.getSetBindings(0);
+        for (VkDescriptorSetLayoutBinding& binding : bindings)
+        {
+            if (std::find(m_dynamic_frame_bindings.begin(), m_dynamic_frame_bindings.end(), binding.binding) == m_dynamic_frame_bindings.end())
+            {
+                continue;
+            }
+            if (binding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+            {
+                binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            }
+            else if (binding.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+            {
+                binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            }
+        }
+        return bindings;
+    }
 
-        VkDescriptorSetLayoutBinding result_image_layout_binding{};
-        result_image_layout_binding.binding = 1;
-        result_image_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-        result_image_layout_binding.descriptorCount = 1;
-        result_image_layout_binding.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+    // the descriptor sets of set 0 are allocated once, a pipeline has to declare the same bindings
+    bool VulkanRHI::isFrameSetCompatible(const ShaderReflection& reflection)
+    {
+        std::vector<VkDescriptorSetLayoutBinding> bindings = getFrameSetBindings(reflection);
+        if (bindings.size() != m_frame_set_bindings.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < bindings.size(); i++)
+        {
+            if (bindings[i].binding != m_frame_set_bindings[i].binding ||
+                bindings[i].descriptorType != m_frame_set_bindings[i].descriptorType ||
+                bindings[i].descriptorCount != m_frame_set_bindings[i].descriptorCount ||
+                bindings[i].stageFlags != m_frame_set_bindings[i].stageFlags)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
 
-        VkDescriptorSetLayoutBinding uniform_buffer_binding{};
-        uniform_buffer_binding.binding = 2;
-        uniform_buffer_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        uniform_buffer_binding.descriptorCount = 1;
-        uniform_buffer_binding.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+    // set 0 is the frame set, set 1 the bindless table when there is one, others come from the cache
+    VkPipelineLayout VulkanRHI::createPipelineLayout(const ShaderReflection& reflection)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE(isFrameSetCompatible(reflection), "set 0 of the pipeline does not match the frame descriptor sets");
+        std::vector<VkDescriptorSetLayout> set_layouts;
+        for (uint32_t set = 0; set < reflection.getSetCount(); set++)
+        {
+            if (set == 0)
+            {
+                set_layouts.push_back(m_descriptor_set_layout);
+            }
+            else if (set == 1 && m_bindless_table.isInitialized())
+            {
+                SHERPHY_EXCEPTION_IF_FALSE(VulkanBindlessTable::isCompatible(reflection.getSetBindings(set)), "set 1 of the pipeline does not match the bindless table");
+                set_layouts.push_back(m_bindless_table.m_descriptor_set_layout);
+            }
+            else
+            {
+                set_layouts.push_back(m_layout_cache.getSetLayout(reflection.getSetBindings(set)));
+            }
+        }
 
-        std::vector<VkDescriptorSetLayoutBinding> bindings({
-            acceleration_structure_layout_binding,
-            result_image_layout_binding,
-            uniform_buffer_binding
-            });
+        // one range for every stage, the blocks overlap from offset 0
+        std::vector<VkPushConstantRange> push_constant_ranges;
+        if (reflection.push_constant_size > 0)
+        {
+            push_constant_ranges.push_back({ reflection.push_constant_stages, 0, reflection.push_constant_size });
+        }
+        return m_layout_cache.getPipelineLayout(set_layouts, push_constant_ranges);
+    }
 
-        VkDescriptorSetLayoutCreateInfo create_info{};
-        create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        create_info.bindingCount = static_cast<uint32_t>(bindings.size());
-        create_info.pBindings = bindings.data();
-        SHERPHY_EXCEPTION_IF_FALSE(vkCreateDescriptorSetLayout(m_device.m_logical_device, &create_info, nullptr, &m_descriptor_set_layout) == VK_SUCCESS, "RayTracing Descriptor Layout Creation Failed");
-    }
-
-    void VulkanRHI::createDescriptorSetLayoutNormal() 
-    {
-        VkDescriptorSetLayoutBinding ubo_layout_binding{};
-        ubo_layout_binding.binding = 0;
-        ubo_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        ubo_layout_binding.descriptorCount = 1;
-        ubo_layout_binding.pImmutableSamplers = nullptr;
-        ubo_layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-        VkDescriptorSetLayoutBinding sampler_layout_binding{};
-        sampler_layout_binding.binding = 1;
-        sampler_layout_binding.descriptorCount = 1;
-        sampler_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        sampler_layout_binding.pImmutableSamplers = nullptr;
-        sampler_layout_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-        std::array<VkDescriptorSetLayoutBinding, 2> bindings = { ubo_layout_binding, sampler_layout_binding };
-        VkDescriptorSetLayoutCreateInfo layout_info{};
-        layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        layout_info.bindingCount = bindings.size();
-        layout_info.pBindings = bindings.data();
-
-        SHERPHY_EXCEPTION_IF_FALSE(vkCreateDescriptorSetLayout(m_device.m_logical_device, &layout_info, nullptr, &m_descriptor_set_layout) == VK_SUCCESS,
-            "failed to create descriptor set layout!");
-        return;
+    // the shader picks the attributes it reads by input location, the vertex format says where they are
+    // and how they are encoded; elements the shader does not read are stepped over
+    void VulkanRHI::getVertexInputState(const ShaderReflection& reflection,
+                                        VkVertexInputBindingDescription& binding_description,
+                                        std::vector<VkVertexInputAttributeDescription>& attribute_descriptions)
+    {
+        attribute_descriptions.clear();
+        for (const ReflectedInput& input : reflection.inputs)
+        {
+            const VertexElement* element = m_vertex_format.find(static_cast<VertexAttribute>(input.location));
+            SHERPHY_EXCEPTION_IF_FALSE((element != nullptr), "vertex input " + std::to_string(input.location) + " of the shader is missing from the vertex format");
+
+            VkVertexInputAttributeDescription attribute_description{};
+            attribute_description.binding = 0;
+            attribute_description.location = input.location;
+            attribute_description.format = VulkanVertexFormat::getFormat(element->encoding);
+            attribute_description.offset = element->offset;
+            attribute_descriptions.push_back(attribute_description);
+        }
+
+        binding_description = {};
+        binding_description.binding = 0;
+        binding_description.stride = m_vertex_format.m_stride;
+        binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
     }
 
     void VulkanRHI::createVertexBuffer(PipeLineType type) 
     {
         SHERPHY_EXCEPTION_IF_FALSE(m_vertices.size() != 0, "no vertices input\n");
-        VkDeviceSize buffer_size = sizeof(m_vertices[0]) * m_vertices.size();
+        // every mesh is quantized against its own bounds, the gpu scene hands them to the vertex shader
+        std::vector<uint8_t> vertex_data(static_cast<size_t>(m_vertex_format.m_stride) * m_vertices.size());
+        m_mesh_quantizations.clear();
+        if (m_mesh_ranges.empty())
+        {
+            m_mesh_quantizations.push_back(m_vertex_format.getQuantization(m_vertices.data(), m_vertices.size()));
+            m_vertex_format.encode(m_vertices.data(), m_vertices.size(), m_mesh_quantizations[0], vertex_data.data());
+        }
+        for (const MeshRange& range : m_mesh_ranges)
+        {
+            const Vertex* vertices = m_vertices.data() + range.first_vertex;
+            m_mesh_quantizations.push_back(m_vertex_format.getQuantization(vertices, range.vertex_count));
+            m_vertex_format.encode(vertices, range.vertex_count, m_mesh_quantizations.back(), vertex_data.data() + static_cast<size_t>(m_vertex_format.m_stride) * range.first_vertex);
+        }
+
+        VkDeviceSize buffer_size = vertex_data.size();
         switch (type)
         {
         case Sherphy::PipeLineType::RayTracing:
@@ -487,13 +984,13 @@ namespace Sherphy{
                 VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
                 m_vertex_buffer,
-                m_vertices.data()), VK_SUCCESS, "");
+                vertex_data.data()), VK_SUCCESS, "");
             break;
         default:
             VulkanBuffer staging_buffer;
             SHERPHY_ASSERT(m_device.createBuffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                staging_buffer, m_vertices.data()), VK_SUCCESS, "");
+                staging_buffer, vertex_data.data()), VK_SUCCESS, "");
 
             SHERPHY_ASSERT(m_device.createBuffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
@@ -551,13 +1048,14 @@ namespace Sherphy{
         }
     }
 
+    // buffers are shared between the queue families, so the copy engine can fill them directly
     void VulkanRHI::copyBufferImmediate(VulkanBuffer src_buffer, VulkanBuffer dst_buffer, VkDeviceSize size)
     {
-        VkCommandBuffer command_buffer = m_device.beginSingleTimeCommands();
+        VkCommandBuffer command_buffer = m_device.beginSingleTimeCommands(QueueType::Transfer);
         VkBufferCopy copyRegion{};
         copyRegion.size = size;
         vkCmdCopyBuffer(command_buffer, src_buffer.buffer, dst_buffer.buffer, 1, &copyRegion);
-        m_device.endSingleTimeCommands(command_buffer, m_graphics_queue);
+        m_device.endSingleTimeCommands(command_buffer, QueueType::Transfer);
     }
 
     void VulkanRHI::createRenderPass() 
@@ -566,30 +1064,365 @@ namespace Sherphy{
         return;
     }
 
-    void VulkanRHI::recordCommandBuffer(VkCommandBuffer command_buffer, uint32_t image_index) {
-        VkCommandBufferBeginInfo begin_info{};
-        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    // one command buffer and submit per batch of the graph, batches on other queues are waited on
+    // through their timelines; the swapchain semaphores go with the first and last graphics batch
+    TimelinePoint VulkanRHI::submitFrame(uint32_t image_index,
+                                         const std::vector<BinarySemaphoreWait>& binary_waits,
+                                         const std::vector<VkSemaphore>& binary_signals)
+    {
+        buildRenderGraph(image_index);
+        m_render_graph.compile();
+
+        uint32_t batch_count = m_render_graph.getBatchCount();
+        uint32_t first_graphics = UINT32_MAX;
+        uint32_t last_graphics = UINT32_MAX;
+        uint32_t first_compute = UINT32_MAX;
+        uint32_t last_compute = UINT32_MAX;
+        for (uint32_t i = 0; i < batch_count; i++)
+        {
+            if (m_render_graph.getBatch(i).queue == QueueType::Graphics)
+            {
+                first_graphics = std::min(first_graphics, i);
+                last_graphics = i;
+            }
+            else if (m_render_graph.getBatch(i).queue == QueueType::Compute)
+            {
+                first_compute = std::min(first_compute, i);
+                last_compute = i;
+            }
+        }
+        SHERPHY_EXCEPTION_IF_FALSE((batch_count > 0 && last_graphics == batch_count - 1), "frame graph must end on the graphics queue");
 
-        SHERPHY_EXCEPTION_IF_FALSE(vkBeginCommandBuffer(command_buffer, &begin_info) == VK_SUCCESS, "failed to begin recording command buffer!");
+        std::vector<TimelinePoint> batch_points(batch_count);
+        uint32_t queue_batch_counts[static_cast<uint32_t>(QueueType::Count)] = {};
+        for (uint32_t i = 0; i < batch_count; i++)
+        {
+            const VulkanRenderGraph::Batch& batch = m_render_graph.getBatch(i);
+            uint32_t& queue_batch = queue_batch_counts[static_cast<uint32_t>(batch.queue)];
+            VkCommandBuffer command_buffer = m_device.getFrameCommandBuffer(batch.queue, m_current_frame, queue_batch++);
+            vkResetCommandBuffer(command_buffer, 0);
+
+            VkCommandBufferBeginInfo begin_info{};
+            begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            SHERPHY_EXCEPTION_IF_FALSE(vkBeginCommandBuffer(command_buffer, &begin_info) == VK_SUCCESS, "failed to begin recording command buffer!");
+            // every queue family times its batches into its own query pools
+            VulkanGPUProfiler* profiler = batch.queue == QueueType::Graphics ? &m_gpu_profiler :
+                                          batch.queue == QueueType::Compute ? &m_compute_profiler : nullptr;
+            if (i == first_graphics || i == first_compute)
+            {
+                profiler->beginFrame(command_buffer, m_current_frame);
+            }
+            m_render_graph.executeBatch(i, command_buffer, profiler);
+            if (i == last_graphics || i == last_compute)
+            {
+                profiler->endFrame(command_buffer);
+            }
+            SHERPHY_EXCEPTION_IF_FALSE(vkEndCommandBuffer(command_buffer) == VK_SUCCESS, "failed to record command buffer!");
 
-        VkRenderPassBeginInfo render_pass_info{};
-        render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        render_pass_info.renderPass = m_render_pass;
-        render_pass_info.framebuffer = m_swap_chain_frame_buffers[image_index];
-        render_pass_info.renderArea.offset = { 0, 0 };
-        render_pass_info.renderArea.extent = m_extent;
+            std::vector<TimelineWait> waits;
+            for (const VulkanRenderGraph::BatchWait& wait : batch.waits)
+            {
+                waits.push_back({ batch_points[wait.batch], wait.stage });
+            }
+            // the frame slot is tracked on graphics, so the last graphics batch also covers the other queues
+            if (i == last_graphics)
+            {
+                for (uint32_t j = 0; j < i; j++)
+                {
+                    bool waited = std::any_of(batch.waits.begin(), batch.waits.end(), [j](const VulkanRenderGraph::BatchWait& wait) { return wait.batch == j; });
+                    if (!waited && m_render_graph.getBatch(j).queue != QueueType::Graphics)
+                    {
+                        waits.push_back({ batch_points[j], VK_PIPELINE_STAGE_ALL_COMMANDS_BIT });
+                    }
+                }
+            }
+            if (batch.uses_transients)
+            {
+                for (uint32_t queue_type = 0; queue_type < static_cast<uint32_t>(QueueType::Count); queue_type++)
+                {
+                    if (static_cast<QueueType>(queue_type) != batch.queue)
+                    {
+                        waits.push_back({ m_device.m_timeline_sync.getLastSubmitted(static_cast<QueueType>(queue_type)), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT });
+                    }
+                }
+            }
+            batch_points[i] = m_device.m_timeline_sync.submit(batch.queue, { command_buffer }, waits,
+                i == first_graphics ? binary_waits : std::vector<BinarySemaphoreWait>{},
+                i == last_graphics ? binary_signals : std::vector<VkSemaphore>{});
+        }
+        return batch_points[last_graphics];
+    }
 
+    void VulkanRHI::createRenderGraph()
+    {
+        m_render_graph.init(&m_device, &m_deletion_queue);
+        m_command_cache.init(&m_device, MAX_FRAMES_IN_FLIGHT);
+    }
 
-        std::array<VkClearValue, 2> clear_values{};
-        clear_values[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
-        clear_values[1].depthStencil = { 1.0f, 0 };
+    // passes only declare what they touch, barriers and layout transitions come from the graph
+    void VulkanRHI::buildRenderGraph(uint32_t image_index)
+    {
+        m_render_graph.reset();
+
+        RenderGraphImageDesc color_desc;
+        color_desc.format = m_swap_chain_image_format;
+        color_desc.extent = m_extent;
+        color_desc.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | (m_headless ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+        color_desc.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+        // swapchain images wait on the acquire semaphore at color output, headless ones on the last readback
+        RenderGraphHandle color = m_render_graph.importImage("Backbuffer",
+            m_headless ? m_headless_target.m_images[image_index] : m_swap_chain_images[image_index],
+            m_swap_chain_image_views[image_index],
+            color_desc,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            m_headless ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            m_headless ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+        // the pass that leaves the final image in the backbuffer
+        VulkanRenderGraph::PassBuilder output_pass{};
+        // this frame's residency changes, added first so it runs ahead of every graphics pass sampling the textures
+        if (m_texture_streamer.hasPendingCopies())
+        {
+            m_render_graph.addPass("TextureStreaming", QueueType::Graphics, [this](VkCommandBuffer command_buffer) {
+                m_texture_streamer.recordCopies(command_buffer);
+            })
+                .sideEffects();
+        }
+        if (m_path_tracer.isInitialized())
+        {
+            // refit from this frame's transforms, overlaps the previous frame's graphics work on an async compute queue
+            RenderGraphHandle top_level = m_render_graph.importBuffer("TopLevelAS", m_ray_tracing_scene.getTopLevel(m_current_frame).buffer.buffer);
+            m_render_graph.addPass("TopLevelAS", QueueType::Compute, [this](VkCommandBuffer command_buffer) {
+                m_ray_tracing_scene.recordTopLevel(command_buffer, m_current_frame);
+            })
+                .write(top_level, RenderGraphUsage::AccelerationStructureBuild);
+
+            // the average lives across frames, the previous frame's resolve read it last
+            RenderGraphImageDesc accumulation_desc;
+            accumulation_desc.format = VulkanPathTracer::k_accumulation_format;
+            accumulation_desc.extent = m_path_tracer.m_extent;
+            accumulation_desc.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            accumulation_desc.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+            RenderGraphHandle accumulation = m_render_graph.importImage("Accumulation",
+                m_path_tracer.m_accumulation_image,
+                m_path_tracer.m_accumulation_image_view,
+                accumulation_desc,
+                m_path_tracer.m_accumulation_defined ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                VK_IMAGE_LAYOUT_GENERAL,
+                VK_ACCESS_SHADER_WRITE_BIT);
+
+            // a converged image is only resolved again
+            if (!m_path_tracer.isConverged())
+            {
+                m_render_graph.addPass("PathTrace", QueueType::Graphics, [this](VkCommandBuffer command_buffer) {
+                    m_path_tracer.recordTrace(command_buffer, m_graphics_pipeline, m_pipeline_layout, m_descriptor_sets[m_current_frame], m_ray_tracing_view_offset);
+                })
+                    .read(top_level, RenderGraphUsage::AccelerationStructureRead)
+                    .write(accumulation, RenderGraphUsage::StorageRayTracing);
+            }
+            output_pass = m_render_graph.addPass("PathTraceResolve", QueueType::Graphics, [this, image_index](VkCommandBuffer command_buffer) {
+                m_path_tracer.recordResolve(command_buffer, m_headless ? m_headless_target.m_images[image_index] : m_swap_chain_images[image_index]);
+            })
+                .read(accumulation, RenderGraphUsage::TransferSrc)
+                .write(color, RenderGraphUsage::TransferDst);
+        }
+        else
+        {
+            // the depth pre-pass needs the gpu scene draws and a depth only pipeline
+            bool occlusion_culling = m_occlusion_culling && m_hiz_pyramid.isInitialized() && m_gpu_scene.hasOcclusionCulling() && m_depth_pipeline != VK_NULL_HANDLE;
+
+            RenderGraphImageDesc depth_desc;
+            depth_desc.format = findDepthFormat();
+            depth_desc.extent = m_extent;
+            depth_desc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (occlusion_culling ? VK_IMAGE_USAGE_SAMPLED_BIT : 0);
+            depth_desc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+            RenderGraphHandle depth = m_render_graph.createImage("Depth", depth_desc);
+
+            RenderGraphHandle draw_commands = k_invalid_render_graph_handle;
+            RenderGraphHandle draw_counts = k_invalid_render_graph_handle;
+            RenderGraphHandle visible_instances = k_invalid_render_graph_handle;
+            if (m_gpu_scene.isInitialized())
+            {
+                draw_commands = m_render_graph.importBuffer("DrawCommands", m_gpu_scene.m_draw_command_buffers[m_current_frame].buffer);
+                draw_counts = m_render_graph.importBuffer("DrawCounts", m_gpu_scene.m_draw_count_buffers[m_current_frame].buffer);
+                visible_instances = m_render_graph.importBuffer("VisibleInstances", m_gpu_scene.m_visible_instance_buffers[m_current_frame].buffer);
+            }
+            RenderGraphHandle hiz = k_invalid_render_graph_handle;
+            if (occlusion_culling)
+            {
+                // the pyramid lives across frames and every frame in flight reads the one before it,
+                // so all of its passes stay on the graphics queue in submission order
+                RenderGraphImageDesc hiz_desc;
+                hiz_desc.format = VulkanHiZPyramid::k_format;
+                hiz_desc.extent = m_hiz_pyramid.m_extent;
+                hiz_desc.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+                hiz_desc.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+                hiz = m_render_graph.importImage("HiZ",
+                    m_hiz_pyramid.m_image,
+                    m_hiz_pyramid.m_image_view,
+                    hiz_desc,
+                    m_hiz_pyramid.m_history_valid ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL,
+                    VK_ACCESS_SHADER_WRITE_BIT);
+                RenderGraphHandle draw_slots = m_render_graph.importBuffer("DrawSlots", m_gpu_scene.m_draw_slot_buffers[m_current_frame].buffer);
+                RenderGraphHandle occluded_instances = m_render_graph.importBuffer("OccludedInstances", m_gpu_scene.m_occluded_buffers[m_current_frame].buffer);
+
+                // the early phase tests against last frame's pyramid with the view it was rendered with
+                VkDescriptorSet history_set = m_hiz_pyramid.getOcclusionSet(m_current_frame, m_occlusion_set_layout, m_hiz_pyramid.m_history_view_proj, m_hiz_pyramid.m_history_valid);
+                VkDescriptorSet current_set = m_hiz_pyramid.getOcclusionSet(m_current_frame, m_occlusion_set_layout, m_view_proj, true);
+                m_hiz_pyramid.m_history_view_proj = m_view_proj;
+                m_hiz_pyramid.m_history_valid = true;
+
+                m_render_graph.addPass("EarlyCulling", QueueType::Graphics, [this, history_set](VkCommandBuffer command_buffer) {
+                    m_gpu_scene.recordOcclusionCulling(command_buffer, m_current_frame, m_view_proj, m_camera_position, GPUCullPhase::Early, history_set);
+                })
+                    .read(hiz, RenderGraphUsage::StorageReadCompute)
+                    .write(draw_slots, RenderGraphUsage::StorageWriteCompute)
+                    .write(occluded_instances, RenderGraphUsage::StorageWriteCompute)
+                    .write(draw_commands, RenderGraphUsage::StorageWriteCompute)
+                    .write(draw_counts, RenderGraphUsage::StorageWriteCompute)
+                    .write(visible_instances, RenderGraphUsage::StorageWriteCompute);
+
+                // what was visible last frame is the occluder set
+                m_render_graph.addPass("DepthPrePass", QueueType::Graphics, [this, depth](VkCommandBuffer command_buffer) {
+                    VkRenderPassBeginInfo render_pass_info{};
+                    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                    render_pass_info.renderPass = m_depth_render_pass;
+                    render_pass_info.framebuffer = m_render_graph.getFramebuffer(m_depth_render_pass, { depth });
+                    render_pass_info.renderArea.offset = { 0, 0 };
+                    render_pass_info.renderArea.extent = m_extent;
+
+                    VkClearValue clear_value{};
+                    clear_value.depthStencil = { 1.0f, 0 };
+                    render_pass_info.clearValueCount = 1;
+                    render_pass_info.pClearValues = &clear_value;
+                    vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+                    VkCommandBuffer pre_pass_commands = m_command_cache.get("DepthPrePassDraws", m_current_frame, m_depth_render_pass, 0, getSceneDrawSignature(true),
+                        [this](VkCommandBuffer secondary_command_buffer) {
+                            recordSceneDraws(secondary_command_buffer, true);
+                        });
+                    vkCmdExecuteCommands(command_buffer, 1, &pre_pass_commands);
+                    vkCmdEndRenderPass(command_buffer);
+                })
+                    .read(draw_commands, RenderGraphUsage::IndirectRead)
+                    .read(draw_counts, RenderGraphUsage::IndirectRead)
+                    .read(visible_instances, RenderGraphUsage::StorageReadGraphics)
+                    .write(depth, RenderGraphUsage::DepthAttachment);
+
+                m_render_graph.addPass("HiZ", QueueType::Graphics, [this, depth](VkCommandBuffer command_buffer) {
+                    m_hiz_pyramid.recordBuild(command_buffer, m_current_frame, m_render_graph.getImageView(depth));
+                })
+                    .read(depth, RenderGraphUsage::SampledCompute)
+                    .write(hiz, RenderGraphUsage::StorageWriteCompute);
+
+                // retests what the early phase occluded and packs the survivors of both phases into the final draws
+                m_render_graph.addPass("LateCulling", QueueType::Graphics, [this, current_set](VkCommandBuffer command_buffer) {
+                    m_gpu_scene.recordOcclusionCulling(command_buffer, m_current_frame, m_view_proj, m_camera_position, GPUCullPhase::Late, current_set);
+                })
+                    .read(hiz, RenderGraphUsage::StorageReadCompute)
+                    .read(occluded_instances, RenderGraphUsage::StorageReadCompute)
+                    .write(draw_slots, RenderGraphUsage::StorageWriteCompute)
+                    .write(draw_commands, RenderGraphUsage::StorageWriteCompute)
+                    .write(draw_counts, RenderGraphUsage::StorageWriteCompute)
+                    .write(visible_instances, RenderGraphUsage::StorageWriteCompute);
+            }
+            else if (m_gpu_scene.isInitialized())
+            {
+                m_render_graph.addPass("Culling", QueueType::Compute, [this](VkCommandBuffer command_buffer) {
+                    m_gpu_scene.recordCulling(command_buffer, m_current_frame, m_view_proj, m_camera_position);
+                })
+                    .write(draw_commands, RenderGraphUsage::StorageWriteCompute)
+                    .write(draw_counts, RenderGraphUsage::StorageWriteCompute)
+                    .write(visible_instances, RenderGraphUsage::StorageWriteCompute);
+            }
+
+            RenderGraphHandle cluster_light_counts = k_invalid_render_graph_handle;
+            RenderGraphHandle cluster_light_indices = k_invalid_render_graph_handle;
+            if (m_clustered_lights.isInitialized())
+            {
+                cluster_light_counts = m_render_graph.importBuffer("ClusterLightCounts", m_clustered_lights.m_light_count_buffers[m_current_frame].buffer);
+                cluster_light_indices = m_render_graph.importBuffer("ClusterLightIndices", m_clustered_lights.m_light_index_buffers[m_current_frame].buffer);
+                // only depends on the view and the lights, overlaps the culling and the pre-pass
+                m_render_graph.addPass("LightCulling", QueueType::Compute, [this](VkCommandBuffer command_buffer) {
+                    m_clustered_lights.recordAssignment(command_buffer, m_current_frame, m_view_offset);
+                })
+                    .write(cluster_light_counts, RenderGraphUsage::StorageWriteCompute)
+                    .write(cluster_light_indices, RenderGraphUsage::StorageWriteCompute);
+            }
 
-        //VkClearValue clear_color = { {{1.0f, 1.0f, 1.0f, 1.0f}} };
-        render_pass_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
-        render_pass_info.pClearValues = clear_values.data();
-        vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+            // the pre-pass already cleared and filled the depth
+            VkRenderPass main_render_pass = occlusion_culling ? m_render_pass_depth_load : m_render_pass;
+            auto main_pass = m_render_graph.addPass("MainPass", QueueType::Graphics, [this, color, depth, main_render_pass](VkCommandBuffer command_buffer) {
+                VkRenderPassBeginInfo render_pass_info{};
+                render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                render_pass_info.renderPass = main_render_pass;
+                render_pass_info.framebuffer = m_render_graph.getFramebuffer(main_render_pass, { color, depth });
+                render_pass_info.renderArea.offset = { 0, 0 };
+                render_pass_info.renderArea.extent = m_extent;
+
+                std::array<VkClearValue, 2> clear_values{};
+                clear_values[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+                clear_values[1].depthStencil = { 1.0f, 0 };
+
+                //VkClearValue clear_color = { {{1.0f, 1.0f, 1.0f, 1.0f}} };
+                render_pass_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
+                render_pass_info.pClearValues = clear_values.data();
+                vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+                // static for as long as the signature holds, an idle view replays it without recording;
+                // the depth load variant is compatible with m_render_pass
+                VkCommandBuffer scene_commands = m_command_cache.get("SceneDraws", m_current_frame, m_render_pass, 0, getSceneDrawSignature(),
+                    [this](VkCommandBuffer secondary_command_buffer) {
+                        recordSceneDraws(secondary_command_buffer);
+                    });
+                vkCmdExecuteCommands(command_buffer, 1, &scene_commands);
+                vkCmdEndRenderPass(command_buffer);
+            });
+            main_pass.write(color, RenderGraphUsage::ColorAttachment).write(depth, RenderGraphUsage::DepthAttachment);
+            if (m_gpu_scene.isInitialized())
+            {
+                main_pass.read(draw_commands, RenderGraphUsage::IndirectRead)
+                    .read(draw_counts, RenderGraphUsage::IndirectRead)
+                    .read(visible_instances, RenderGraphUsage::StorageReadGraphics);
+            }
+            if (m_clustered_lights.isInitialized())
+            {
+                main_pass.read(cluster_light_counts, RenderGraphUsage::StorageReadGraphics)
+                    .read(cluster_light_indices, RenderGraphUsage::StorageReadGraphics);
+            }
+            output_pass = main_pass;
+
+            if (occlusion_culling)
+            {
+                // the final depth becomes the history the next frame's early phase tests against
+                m_render_graph.addPass("HiZHistory", QueueType::Graphics, [this, depth](VkCommandBuffer command_buffer) {
+                    m_hiz_pyramid.recordBuild(command_buffer, m_current_frame, m_render_graph.getImageView(depth));
+                })
+                    .read(depth, RenderGraphUsage::SampledCompute)
+                    .write(hiz, RenderGraphUsage::StorageWriteCompute);
+            }
+        }
+
+        if (m_headless)
+        {
+            RenderGraphHandle readback = m_render_graph.importBuffer("Readback", m_headless_target.m_readback_buffer.buffer, true);
+            m_render_graph.addPass("Readback", QueueType::Graphics, [this, image_index](VkCommandBuffer command_buffer) {
+                m_headless_target.recordReadback(command_buffer, image_index);
+            })
+                .read(color, RenderGraphUsage::TransferSrc)
+                .write(readback, RenderGraphUsage::TransferDst);
+        }
+        else
+        {
+            // presentation consumes the backbuffer outside the graph
+            output_pass.sideEffects();
+        }
+    }
 
-        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphics_pipeline);
+    void VulkanRHI::recordSceneDraws(VkCommandBuffer command_buffer, bool depth_pre_pass)
+    {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depth_pre_pass ? m_depth_pipeline : m_graphics_pipeline);
         VkViewport viewport{};
         viewport.x = 0.0f;
         viewport.y = 0.0f;
@@ -609,21 +1442,57 @@ namespace Sherphy{
         vkCmdBindVertexBuffers(command_buffer, 0, 1, &m_vertex_buffer.buffer, offsets);
         vkCmdBindIndexBuffer(command_buffer, m_index_buffer.buffer, 0, VK_INDEX_TYPE_UINT32);
 
+        // dynamic offsets in binding order: view block, instances, lights
+        std::array<uint32_t, 3> dynamic_offsets = { m_view_offset, m_gpu_scene.m_instance_offset, m_clustered_lights.m_light_offset };
         vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 
-            m_pipeline_layout, 0, 1, &m_descriptor_sets[m_current_frame], 0, nullptr);
+            m_pipeline_layout, 0, 1, &m_descriptor_sets[m_current_frame], static_cast<uint32_t>(dynamic_offsets.size()), dynamic_offsets.data());
+        if (m_bindless_table.isInitialized())
+        {
+            m_bindless_table.bind(command_buffer, m_pipeline_layout, 1, m_current_frame);
+        }
 
-        vkCmdDrawIndexed(command_buffer, static_cast<uint32_t>(m_indices.size()), 1, 0, 0, 0);
-        //vkCmdDraw(command_buffer, static_cast<uint32_t>(m_vertices.size()), 1, 0, 0);//TODO abstract command
-        vkCmdEndRenderPass(command_buffer);
-        SHERPHY_EXCEPTION_IF_FALSE(vkEndCommandBuffer(command_buffer) == VK_SUCCESS, "failed to record command buffer!");
+        if (m_gpu_scene.isInitialized())
+        {
+            m_gpu_scene.recordDraw(command_buffer, m_current_frame, 0, depth_pre_pass);
+        }
+        else
+        {
+            vkCmdDrawIndexed(command_buffer, static_cast<uint32_t>(m_indices.size()), 1, 0, 0, 0);
+        }
     }
 
-    void VulkanRHI::createDepthResources()
+    // every input of recordSceneDraws, the dynamic offsets repeat for a frame slot while the
+    // allocations of a frame do not change
+    CommandSignature VulkanRHI::getSceneDrawSignature(bool depth_pre_pass)
     {
-        VkFormat depth_format = findDepthFormat();
-
-        createImage(m_extent.width, m_extent.height, depth_format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depth_image, m_depth_image_memory);
-        m_depth_image_view = createImageView(m_depth_image, depth_format, VK_IMAGE_ASPECT_DEPTH_BIT);
+        CommandSignature signature = {
+            (uint64_t)(depth_pre_pass ? m_depth_render_pass : m_render_pass),
+            (uint64_t)(depth_pre_pass ? m_depth_pipeline : m_graphics_pipeline),
+            (uint64_t)m_pipeline_layout,
+            m_extent.width,
+            m_extent.height,
+            (uint64_t)m_vertex_buffer.buffer,
+            (uint64_t)m_index_buffer.buffer,
+            m_indices.size(),
+            (uint64_t)m_descriptor_sets[m_current_frame],
+            m_view_offset,
+            m_clustered_lights.m_light_offset,
+        };
+        if (m_bindless_table.isInitialized())
+        {
+            signature.push_back((uint64_t)m_bindless_table.m_descriptor_sets[m_current_frame]);
+        }
+        if (m_gpu_scene.isInitialized())
+        {
+            signature.push_back(m_gpu_scene.m_instance_offset);
+            signature.push_back((uint64_t)m_gpu_scene.m_draw_command_buffers[m_current_frame].buffer);
+            signature.push_back((uint64_t)m_gpu_scene.m_draw_count_buffers[m_current_frame].buffer);
+            signature.push_back(m_gpu_scene.m_pipeline_draw_ranges[0][0]);
+            signature.push_back(m_gpu_scene.m_pipeline_draw_ranges[0][1]);
+            // the pre-pass region moves with the slot count
+            signature.push_back(m_gpu_scene.m_draw_slots.size());
+        }
+        return signature;
     }
 
     VkFormat VulkanRHI::findSupportedFormat(VkPhysicalDevice device, const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
@@ -642,44 +1511,46 @@ namespace Sherphy{
         SHERPHY_EXCEPTION_IF_FALSE(false, "failed to find supported format!");
     }
 
+    // occlusion culling samples the depth in the hiz build, a format that allows it is taken first
+    // so the culling can be switched on at any time; without one the pyramid is never created
     VkFormat VulkanRHI::findDepthFormat() {
-        return findSupportedFormat(m_device.m_physical_device,
-            { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+        if (m_depth_format != VK_FORMAT_UNDEFINED)
+        {
+            return m_depth_format;
+        }
+        std::vector<VkFormat> candidates = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT };
+        VkFormatFeatureFlags sampled_features = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+        for (VkFormat format : candidates)
+        {
+            VkFormatProperties props;
+            vkGetPhysicalDeviceFormatProperties(m_device.m_physical_device, format, &props);
+            if ((props.optimalTilingFeatures & sampled_features) == sampled_features)
+            {
+                m_depth_format = format;
+                m_depth_sampled = true;
+                return m_depth_format;
+            }
+        }
+        m_depth_format = findSupportedFormat(m_device.m_physical_device,
+            candidates,
             VK_IMAGE_TILING_OPTIMAL,
             VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
         );
+        return m_depth_format;
     }
 
-    void VulkanRHI::createTextureImage() 
+    uint32_t VulkanRHI::loadStreamedTexture(const char* texture_name, TextureUsage usage)
     {
-        int tex_width, tex_height, tex_channels;
-        unsigned char* pixels = g_miracle_global_context.m_file_system->readImageFile("I:\\SherphyEngine\\resource\\texture\\viking_room.png", tex_width, tex_height, tex_channels);
-        VkDeviceSize image_size = tex_width * tex_height * 4;
-
-        SHERPHY_EXCEPTION_IF_FALSE(pixels, "failed to load texture image!");
-
-        VulkanBuffer staging_buffer;
-        SHERPHY_ASSERT(m_device.createBuffer(image_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer), VK_SUCCESS, "");
-
-        void* data;
-        vkMapMemory(m_device.m_logical_device, staging_buffer.memory, 0, image_size, 0, &data);
-        SHERPHY_MEMCPY(data, pixels, static_cast<size_t>(image_size));
-        vkUnmapMemory(m_device.m_logical_device, staging_buffer.memory);
-
-        g_miracle_global_context.m_file_system->releaseImageAsset(pixels);
-
-        createImage(tex_width, tex_height, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_texture_image, m_texture_image_memory);
+        // mips and block compression come from the offline cook, the streamer uploads levels on demand
+        bool block_compression = m_device_features.textureCompressionBC == VK_TRUE;
+        std::string cooked_path = TextureCooker::getCookedPath(Miracle_COOKED_TEXTURE_PATH, texture_name, usage, block_compression);
 
-        transitionImageLayout(m_texture_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-            copyBufferToImage(staging_buffer.buffer, m_texture_image, static_cast<uint32_t>(tex_width), static_cast<uint32_t>(tex_height));
-        transitionImageLayout(m_texture_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-        staging_buffer.destroy();
+        TextureAsset asset;
+        SHERPHY_EXCEPTION_IF_FALSE(TextureCooker::loadKTX2(cooked_path, asset), "failed to load cooked texture " + cooked_path + ", build the CookTextures target");
+        return m_texture_streamer.addTexture(std::move(asset), m_sampler);
     }
 
-
-    VkImageView VulkanRHI::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags)
+    VkImageView VulkanRHI::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags, uint32_t mip_levels)
     {
         VkImageViewCreateInfo view_info{};
         view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -688,7 +1559,7 @@ namespace Sherphy{
         view_info.format = format;
         view_info.subresourceRange.aspectMask = aspect_flags;
         view_info.subresourceRange.baseMipLevel = 0;
-        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.levelCount = mip_levels;
         view_info.subresourceRange.baseArrayLayer = 0;
         view_info.subresourceRange.layerCount = 1;
 
@@ -698,11 +1569,6 @@ namespace Sherphy{
         return image_view;
     }
 
-    void VulkanRHI::createTextureImageView()
-    {
-        m_texture_image_view = createImageView(m_texture_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
-    }
-
     void VulkanRHI::createTextureSampler()
     {
         VkSamplerCreateInfo sampler_info{};
@@ -719,13 +1585,87 @@ namespace Sherphy{
         sampler_info.compareEnable = VK_FALSE;
         sampler_info.compareOp = VK_COMPARE_OP_ALWAYS;
         sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        sampler_info.minLod = 0.0f;
+        sampler_info.maxLod = VK_LOD_CLAMP_NONE;
 
         SHERPHY_EXCEPTION_IF_FALSE(vkCreateSampler(m_device.m_logical_device, &sampler_info, nullptr, &m_sampler) == VK_SUCCESS, "failed to create texture sampler!");
     }
 
+    void VulkanRHI::createBindlessTable()
+    {
+        m_bindless_table.init(&m_device, MAX_BINDLESS_TEXTURES, MAX_BINDLESS_MATERIALS, MAX_FRAMES_IN_FLIGHT);
+    }
+
+    void VulkanRHI::createGPUProfiler()
+    {
+        m_gpu_profiler.init(&m_device, MAX_FRAMES_IN_FLIGHT, m_device.m_queue_family_indices.graphics_family.value());
+        if (!m_gpu_profiler.m_supported)
+        {
+            SHERPHY_LOG("graphics queue does not support timestamps, gpu profiling is disabled");
+        }
+        // the async compute passes have no frame scope, their batches wait on the graphics queue in between
+        if (m_device.hasDedicatedQueue(QueueType::Compute))
+        {
+            m_compute_profiler.init(&m_device, MAX_FRAMES_IN_FLIGHT, m_device.getQueueFamily(QueueType::Compute), "");
+            if (!m_compute_profiler.m_supported)
+            {
+                SHERPHY_LOG("compute queue does not support timestamps, async compute passes are not profiled");
+            }
+        }
+    }
+
+    void VulkanRHI::releaseTexture(uint32_t bindless_id)
+    {
+        m_texture_streamer.removeTexture(bindless_id);
+    }
+
+    void VulkanRHI::releaseBuffer(VulkanBuffer& buffer)
+    {
+        m_deletion_queue.destroyBuffer(buffer, m_deletion_queue.getFrameNumber());
+        buffer = VulkanBuffer{};
+    }
+
+    std::vector<GPUPassStats> VulkanRHI::getGPUPassStats() const
+    {
+        std::vector<GPUPassStats> stats = m_gpu_profiler.getAllStats();
+        std::vector<GPUPassStats> compute_stats = m_compute_profiler.getAllStats();
+        stats.insert(stats.end(), compute_stats.begin(), compute_stats.end());
+        return stats;
+    }
+
+    void VulkanRHI::createTextureStreamer(PipeLineType type)
+    {
+        SHERPHY_RETURN_IF_FALSE((type != PipeLineType::RayTracing), "RayTracing pipeline does not use bindless textures");
+
+        m_texture_streamer.init(&m_device, &m_bindless_table, &m_deletion_queue, MAX_FRAMES_IN_FLIGHT, TEXTURE_STREAMING_BUDGET, TEXTURE_STREAMING_UPLOAD_PER_FRAME, TEXTURE_STREAMING_STAGING);
+    }
+
+    // cpu side demand: every instance asks for the level its bounding sphere needs on screen
+    void VulkanRHI::updateTextureStreaming(const VkViewUniformObject& view_block)
+    {
+        float projection_scale = std::abs(view_block.proj[1][1]) * static_cast<float>(m_extent.height) * 0.5f;
+        for (const GPUInstanceRecord& instance : m_gpu_scene.m_instances)
+        {
+            const GPUMeshRecord& mesh = m_gpu_scene.m_meshes[instance.mesh_id];
+            const GPUMaterialRecord& material = m_bindless_table.m_materials[instance.material_id];
+            Vec3 center = Vec3(instance.model * Vec4(Vec3(mesh.bounding_sphere), 1.0f));
+            float scale = std::max({ glm::length(Vec3(instance.model[0])), glm::length(Vec3(instance.model[1])), glm::length(Vec3(instance.model[2])) });
+            m_texture_streamer.requestForObject(material.base_color_texture, center, mesh.bounding_sphere.w * scale, m_camera_position, projection_scale);
+        }
+        m_texture_streamer.update();
+    }
+
+    void VulkanRHI::createMaterials(PipeLineType type)
+    {
+        SHERPHY_RETURN_IF_FALSE((type != PipeLineType::RayTracing), "RayTracing pipeline does not use bindless materials");
+
+        // material 0 is the default material every instance starts with
+        GPUMaterialRecord material{};
+        material.base_color_texture = loadStreamedTexture("viking_room", TextureUsage::Color);
+        m_bindless_table.registerMaterial(material);
+    }
+
     void VulkanRHI::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-        VkCommandBuffer command_buffer = m_device.beginSingleTimeCommands();
-
         VkBufferImageCopy region{};
         region.bufferOffset = 0;
         region.bufferRowLength = 0;
@@ -741,9 +1681,16 @@ namespace Sherphy{
             1
         };
 
-        vkCmdCopyBufferToImage(command_buffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        copyBufferToImage(buffer, image, std::vector<VkBufferImageCopy>{ region });
+    }
+
+    void VulkanRHI::copyBufferToImage(VkBuffer buffer, VkImage image, const std::vector<VkBufferImageCopy>& regions)
+    {
+        VkCommandBuffer command_buffer = m_device.beginSingleTimeCommands();
 
-        m_device.endSingleTimeCommands(command_buffer, m_graphics_queue);
+        vkCmdCopyBufferToImage(command_buffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+
+        m_device.endSingleTimeCommands(command_buffer, QueueType::Graphics);
     }
 
     void VulkanRHI::createImage(uint32_t width, 
@@ -753,7 +1700,8 @@ namespace Sherphy{
                                 VkImageUsageFlags usage, 
                                 VkMemoryPropertyFlags properties, 
                                 VkImage& image, 
-                                VkDeviceMemory& image_memory) 
+                                VkDeviceMemory& image_memory,
+                                uint32_t mip_levels) 
     {
         VkImageCreateInfo image_info{};
         image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -761,7 +1709,7 @@ namespace Sherphy{
         image_info.extent.width = width;
         image_info.extent.height = height;
         image_info.extent.depth = 1;
-        image_info.mipLevels = 1;
+        image_info.mipLevels = mip_levels;
         image_info.arrayLayers = 1;
         image_info.format = format;
         image_info.tiling = tiling;
@@ -789,7 +1737,8 @@ namespace Sherphy{
     void VulkanRHI::transitionImageLayout(VkImage image, 
                                           VkFormat format, 
                                           VkImageLayout old_layout, 
-                                          VkImageLayout new_layout)
+                                          VkImageLayout new_layout,
+                                          uint32_t mip_levels)
     {
         VkCommandBuffer command_buffer = m_device.beginSingleTimeCommands();
 
@@ -802,7 +1751,7 @@ namespace Sherphy{
         barrier.image = image;
         barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.levelCount = mip_levels;
         barrier.subresourceRange.baseArrayLayer = 0;
         barrier.subresourceRange.layerCount = 1;
 
@@ -836,29 +1785,7 @@ namespace Sherphy{
             1, &barrier
         );
 
-        m_device.endSingleTimeCommands(command_buffer, m_graphics_queue);
-    }
-
-    void VulkanRHI::createFrameBuffers() 
-    {
-        m_swap_chain_frame_buffers.resize(m_swap_chain_image_views.size());
-
-        for (size_t i = 0; i < m_swap_chain_image_views.size(); i++) {
-            std::array<VkImageView, 2> attachments = {
-                m_swap_chain_image_views[i],
-                m_depth_image_view
-            };
-
-            VkFramebufferCreateInfo frame_buffer_info{};
-            frame_buffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            frame_buffer_info.renderPass = m_render_pass;
-            frame_buffer_info.attachmentCount = static_cast<uint32_t>(attachments.size());
-            frame_buffer_info.pAttachments = attachments.data();
-            frame_buffer_info.width = m_extent.width;
-            frame_buffer_info.height = m_extent.height;
-            frame_buffer_info.layers = 1;
-            SHERPHY_EXCEPTION_IF_FALSE(vkCreateFramebuffer(m_device.m_logical_device, &frame_buffer_info, nullptr, &m_swap_chain_frame_buffers[i]) == VK_SUCCESS, "failed to create framebuffer!");
-        }
+        m_device.endSingleTimeCommands(command_buffer, QueueType::Graphics);
     }
 
     void VulkanRHI::createSurface() {
@@ -888,6 +1815,7 @@ namespace Sherphy{
                 break;
             }
         }
+        SHERPHY_EXCEPTION_IF_FALSE((m_pick_physical_device_id < device_count), "Failed to Find a Suitable Graphic Device\n");
         m_device.m_physical_device = m_physical_devices[m_pick_physical_device_id];
     }
 
@@ -915,6 +1843,8 @@ namespace Sherphy{
         create_info.imageExtent = extent;
         create_info.imageArrayLayers = 1;
         create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        // the path tracer blits its result into the swapchain image
+        create_info.imageUsage |= swap_chain_support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 
         uint32_t queueFamilyIndices[] = { m_device.m_queue_family_indices.graphics_family.value(), m_device.m_queue_family_indices.present_family.value() };
 
@@ -928,7 +1858,8 @@ namespace Sherphy{
         }
         create_info.preTransform = swap_chain_support.capabilities.currentTransform;
         create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-        create_info.oldSwapchain = VK_NULL_HANDLE;
+        // the old swapchain hands over its resources, it is retired by the caller
+        create_info.oldSwapchain = m_swap_chain;
         create_info.presentMode = present_mode;
         create_info.clipped = VK_TRUE;
         
@@ -979,8 +1910,9 @@ namespace Sherphy{
         //LOWTODO stencil test
         color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        // the render graph transitions the attachments around the pass
+        color_attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 
         VkAttachmentReference color_attachment_ref{};
@@ -1004,28 +1936,41 @@ namespace Sherphy{
         depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        depth_attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
         depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
-        VkSubpassDependency dependency{};
-        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.dstSubpass = 0;
-        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        dependency.srcAccessMask = 0;
-        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
         std::array<VkAttachmentDescription, 2> attachments = { color_attachment, depth_attachment };
         VkRenderPassCreateInfo render_pass_info{};
         render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
         render_pass_info.attachmentCount = attachments.size();
         render_pass_info.pAttachments = attachments.data();
         render_pass_info.subpassCount = 1;
-        render_pass_info.dependencyCount = 1;
-        render_pass_info.pDependencies = &dependency;
         render_pass_info.pSubpasses = &subpass;
 
         SHERPHY_EXCEPTION_IF_FALSE(vkCreateRenderPass(m_device.m_logical_device, &render_pass_info, nullptr, &m_render_pass) == VK_SUCCESS, "failed to create render pass!");
+
+        // after a depth pre-pass the main pass keeps its depth and stores it for the next frame's pyramid,
+        // compatible with m_render_pass
+        attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateRenderPass(m_device.m_logical_device, &render_pass_info, nullptr, &m_render_pass_depth_load) == VK_SUCCESS, "failed to create depth load render pass!");
+
+        // the pre-pass only writes depth, stored for the depth pyramid and the main pass
+        VkAttachmentDescription pre_pass_depth_attachment = depth_attachment;
+        pre_pass_depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depth_attachment_ref.attachment = 0;
+        VkSubpassDescription depth_subpass{};
+        depth_subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        depth_subpass.colorAttachmentCount = 0;
+        depth_subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+        VkRenderPassCreateInfo depth_render_pass_info{};
+        depth_render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        depth_render_pass_info.attachmentCount = 1;
+        depth_render_pass_info.pAttachments = &pre_pass_depth_attachment;
+        depth_render_pass_info.subpassCount = 1;
+        depth_render_pass_info.pSubpasses = &depth_subpass;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateRenderPass(m_device.m_logical_device, &depth_render_pass_info, nullptr, &m_depth_render_pass) == VK_SUCCESS, "failed to create depth pre-pass render pass!");
         return;
     }
     
@@ -1042,9 +1987,6 @@ namespace Sherphy{
         case PipeLineType::Normal:
             createGraphicsPipelineNormal(vertex_shader, fragment_shader);
             break;
-        case PipeLineType::Uniform:
-            createGraphicsPipelineUniform(vertex_shader, fragment_shader);
-            break;
         case PipeLineType::RayTracing:
             createGraphicsPipelineRayTracing(vertex_shader, fragment_shader, closest_hit_shader);
             break;
@@ -1075,232 +2017,13 @@ namespace Sherphy{
         return;
     }
 
-    void VulkanRHI::createTopLevelAccelerationStructure() 
-    {
-        VkAccelerationStructureInstanceKHR instance{};
-        instance.transform = m_transform_matrix;
-        instance.instanceCustomIndex = 0;
-        instance.mask = 0xFF;
-        instance.instanceShaderBindingTableRecordOffset = 0;
-        instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
-        instance.accelerationStructureReference = m_bottom_level_AS.device_address;
-
-        // Buffer for instance data
-        VulkanBuffer instances_buffer;
-        SHERPHY_ASSERT(m_device.createBuffer(sizeof(VkAccelerationStructureInstanceKHR),
-            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            instances_buffer), VK_SUCCESS, "");
-
-        VkDeviceOrHostAddressConstKHR instance_data_device_address{};
-        instance_data_device_address.deviceAddress = m_device.getBufferDeviceAddress(instances_buffer);
-
-        VkAccelerationStructureGeometryKHR acceleration_structure_geometry{};
-        acceleration_structure_geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
-        acceleration_structure_geometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
-        acceleration_structure_geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
-        acceleration_structure_geometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
-        acceleration_structure_geometry.geometry.instances.arrayOfPointers = VK_FALSE;
-        acceleration_structure_geometry.geometry.instances.data = instance_data_device_address;
-
-        // Get size info
-        /*
-        The pSrcAccelerationStructure, dstAccelerationStructure, and mode members of pBuildInfo are ignored. Any VkDeviceOrHostAddressKHR members of pBuildInfo are ignored by this command, except that the hostAddress member of VkAccelerationStructureGeometryTrianglesDataKHR::transformData will be examined to check if it is NULL.*
-        */
-        VkAccelerationStructureBuildGeometryInfoKHR acceleration_structure_build_geometry_info{};
-        acceleration_structure_build_geometry_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
-        acceleration_structure_build_geometry_info.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-        acceleration_structure_build_geometry_info.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-        acceleration_structure_build_geometry_info.geometryCount = 1;
-        acceleration_structure_build_geometry_info.pGeometries = &acceleration_structure_geometry;
-
-        uint32_t primitive_count = 1;
-
-        VkAccelerationStructureBuildSizesInfoKHR acceleration_structure_build_sizes_info{};
-        acceleration_structure_build_sizes_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
-        vkGetAccelerationStructureBuildSizesKHR(
-            m_device.m_logical_device,
-            VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-            &acceleration_structure_build_geometry_info,
-            &primitive_count,
-            &acceleration_structure_build_sizes_info);
-
-        createAccelerationStructureBuffer(m_top_level_AS, acceleration_structure_build_sizes_info);
-
-        VkAccelerationStructureCreateInfoKHR acceleration_structure_create_info{};
-        acceleration_structure_create_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
-        acceleration_structure_create_info.buffer = m_top_level_AS.buffer;
-        acceleration_structure_create_info.size = acceleration_structure_build_sizes_info.accelerationStructureSize;
-        acceleration_structure_create_info.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-        vkCreateAccelerationStructureKHR(m_device.m_logical_device, &acceleration_structure_create_info, nullptr, &m_top_level_AS.handle);
-
-        // Create a small scratch buffer used during build of the top level acceleration structure
-        VulkanBuffer scratch_buffer;
-        SHERPHY_ASSERT(m_device.createBuffer(acceleration_structure_build_sizes_info.buildScratchSize,
-                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, scratch_buffer), VK_SUCCESS, "");
-
-        VkAccelerationStructureBuildGeometryInfoKHR acceleration_build_geometry_info{};
-        acceleration_build_geometry_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
-        acceleration_build_geometry_info.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-        acceleration_build_geometry_info.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-        acceleration_build_geometry_info.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-        acceleration_build_geometry_info.dstAccelerationStructure = m_top_level_AS.handle;
-        acceleration_build_geometry_info.geometryCount = 1;
-        acceleration_build_geometry_info.pGeometries = &acceleration_structure_geometry;
-        acceleration_build_geometry_info.scratchData.deviceAddress = m_device.getBufferDeviceAddress(scratch_buffer);
-
-        VkAccelerationStructureBuildRangeInfoKHR acceleration_structure_build_range_info{};
-        acceleration_structure_build_range_info.primitiveCount = 1;
-        acceleration_structure_build_range_info.primitiveOffset = 0;
-        acceleration_structure_build_range_info.firstVertex = 0;
-        acceleration_structure_build_range_info.transformOffset = 0;
-        std::vector<VkAccelerationStructureBuildRangeInfoKHR*> acceleration_build_structure_range_infos = { &acceleration_structure_build_range_info };
-
-        // Build the acceleration structure on the device via a one-time command buffer submission
-        // Some implementations may support acceleration structure building on the host (VkPhysicalDeviceAccelerationStructureFeaturesKHR->accelerationStructureHostCommands), but we prefer device builds
-        VkCommandBuffer command_buffer = m_device.createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-        vkCmdBuildAccelerationStructuresKHR(
-            command_buffer,
-            1,
-            &acceleration_build_geometry_info,
-            acceleration_build_structure_range_infos.data());
-        m_device.endSingleTimeCommands(command_buffer, m_graphics_queue);
-
-        VkAccelerationStructureDeviceAddressInfoKHR acceleration_device_address_info{};
-        acceleration_device_address_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
-        acceleration_device_address_info.accelerationStructure = m_top_level_AS.handle;
-        m_top_level_AS.device_address = vkGetAccelerationStructureDeviceAddressKHR(m_device.m_logical_device, &acceleration_device_address_info);
-
-        scratch_buffer.destroy();
-        instances_buffer.destroy();
-    }
-
-    void VulkanRHI::createAccelerationStructureBuffer(AccelerationStructure& acceleration_structure, VkAccelerationStructureBuildSizesInfoKHR build_size_info)
-    {
-        VkBufferCreateInfo buffer_create_info{};
-        buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        buffer_create_info.size = build_size_info.accelerationStructureSize;
-        buffer_create_info.usage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
-        SHERPHY_ASSERT(vkCreateBuffer(m_device.m_logical_device, &buffer_create_info, nullptr, &acceleration_structure.buffer), VK_SUCCESS, "AccelerationStructureBuffer Faild");
-        VkMemoryRequirements memory_requirements{};
-        vkGetBufferMemoryRequirements(m_device.m_logical_device, acceleration_structure.buffer, &memory_requirements);
-        VkMemoryAllocateFlagsInfo memory_allocate_flags_info{};
-        memory_allocate_flags_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
-        memory_allocate_flags_info.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-        VkMemoryAllocateInfo memory_allocate_info{};
-        memory_allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        memory_allocate_info.pNext = &memory_allocate_flags_info;
-        memory_allocate_info.allocationSize = memory_requirements.size;
-        memory_allocate_info.memoryTypeIndex = m_device.findMemoryType(memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-        SHERPHY_ASSERT(vkAllocateMemory(m_device.m_logical_device, &memory_allocate_info, nullptr, &acceleration_structure.memory), VK_SUCCESS, "AccelerationStructureBuffer AllocateMemory");
-        SHERPHY_ASSERT(vkBindBufferMemory(m_device.m_logical_device, acceleration_structure.buffer, acceleration_structure.memory, 0), VK_SUCCESS, "AccelerationStructureBuffer BindBufferMemory");
-    }
-
-    void VulkanRHI::createBottomLevelAccelerationStructure() 
-    {
-        VkDeviceOrHostAddressConstKHR vertexBufferDeviceAddress{};
-        VkDeviceOrHostAddressConstKHR indexBufferDeviceAddress{};
-        VkDeviceOrHostAddressConstKHR transformBufferDeviceAddress{};
-
-        vertexBufferDeviceAddress.deviceAddress = m_device.getBufferDeviceAddress(m_vertex_buffer);
-        indexBufferDeviceAddress.deviceAddress = m_device.getBufferDeviceAddress(m_index_buffer);
-        transformBufferDeviceAddress.deviceAddress = m_device.getBufferDeviceAddress(m_transform_buffer);
-        // Build
-        VkAccelerationStructureGeometryKHR acceleration_structure_geometry{};
-        acceleration_structure_geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
-        acceleration_structure_geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
-        acceleration_structure_geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
-        acceleration_structure_geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
-        acceleration_structure_geometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
-        acceleration_structure_geometry.geometry.triangles.vertexData = vertexBufferDeviceAddress;
-        acceleration_structure_geometry.geometry.triangles.maxVertex = 3;
-        acceleration_structure_geometry.geometry.triangles.vertexStride = sizeof(Vertex);
-        acceleration_structure_geometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
-        acceleration_structure_geometry.geometry.triangles.indexData = indexBufferDeviceAddress;
-        acceleration_structure_geometry.geometry.triangles.transformData.deviceAddress = 0;
-        acceleration_structure_geometry.geometry.triangles.transformData.hostAddress = nullptr;
-        acceleration_structure_geometry.geometry.triangles.transformData = transformBufferDeviceAddress;
-
-        // Get size info
-        VkAccelerationStructureBuildGeometryInfoKHR acceleration_structure_build_geometry_info{};
-        acceleration_structure_build_geometry_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
-        acceleration_structure_build_geometry_info.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-        acceleration_structure_build_geometry_info.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-        acceleration_structure_build_geometry_info.geometryCount = 1;
-        acceleration_structure_build_geometry_info.pGeometries = &acceleration_structure_geometry;
-
-        const uint32_t num_triangles = 1;// TODO
-        VkAccelerationStructureBuildSizesInfoKHR acceleration_structure_build_sizes_info{};
-        acceleration_structure_build_sizes_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
-        vkGetAccelerationStructureBuildSizesKHR(
-            m_device.m_logical_device,
-            VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-            &acceleration_structure_build_geometry_info,
-            &num_triangles,
-            &acceleration_structure_build_sizes_info);
-
-        createAccelerationStructureBuffer(m_bottom_level_AS, acceleration_structure_build_sizes_info);
-
-        VkAccelerationStructureCreateInfoKHR acceleration_structure_create_info{};
-        acceleration_structure_create_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
-        acceleration_structure_create_info.buffer = m_bottom_level_AS.buffer;
-        acceleration_structure_create_info.size = acceleration_structure_build_sizes_info.accelerationStructureSize;
-        acceleration_structure_create_info.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-        vkCreateAccelerationStructureKHR(m_device.m_logical_device, &acceleration_structure_create_info, nullptr, &m_bottom_level_AS.handle);
-
-        // Create a small scratch buffer used during build of the bottom level acceleration structure
-        VulkanBuffer scratch_buffer;
-        SHERPHY_ASSERT(m_device.createBuffer(acceleration_structure_build_sizes_info.buildScratchSize,
-                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, scratch_buffer), VK_SUCCESS, "");
-
-        VkAccelerationStructureBuildGeometryInfoKHR acceleration_build_geometry_info{};
-        acceleration_build_geometry_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
-        acceleration_build_geometry_info.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-        acceleration_build_geometry_info.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-        acceleration_build_geometry_info.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-        acceleration_build_geometry_info.dstAccelerationStructure = m_bottom_level_AS.handle;
-        acceleration_build_geometry_info.geometryCount = 1;
-        acceleration_build_geometry_info.pGeometries = &acceleration_structure_geometry;
-        acceleration_build_geometry_info.scratchData.deviceAddress = m_device.getBufferDeviceAddress(scratch_buffer);
-
-        VkAccelerationStructureBuildRangeInfoKHR acceleration_structure_build_range_info{};
-        acceleration_structure_build_range_info.primitiveCount = num_triangles;
-        acceleration_structure_build_range_info.primitiveOffset = 0;
-        acceleration_structure_build_range_info.firstVertex = 0;
-        acceleration_structure_build_range_info.transformOffset = 0;
-        std::vector<VkAccelerationStructureBuildRangeInfoKHR*> acceleration_build_structure_range_infos = { &acceleration_structure_build_range_info };
-
-
-        VkCommandBuffer command_buffer = m_device.createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-        vkCmdBuildAccelerationStructuresKHR(
-            command_buffer,
-            1,
-            &acceleration_build_geometry_info,
-            acceleration_build_structure_range_infos.data());
-        m_device.endSingleTimeCommands(command_buffer, m_graphics_queue);
-
-        VkAccelerationStructureDeviceAddressInfoKHR acceleration_device_address_info{};
-        acceleration_device_address_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
-        acceleration_device_address_info.accelerationStructure = m_bottom_level_AS.handle;
-        m_bottom_level_AS.device_address = vkGetAccelerationStructureDeviceAddressKHR(m_device.m_logical_device, &acceleration_device_address_info);
-
-        scratch_buffer.destroy();
-    }
-
     void VulkanRHI::createGraphicsPipelineRayTracing(const std::vector<char>& raygen_shader,
                                                      const std::vector<char>& raymiss_shader,
                                                      const std::vector<char>& closest_hit_shader)
     {
-        createBottomLevelAccelerationStructure();
-        createTopLevelAccelerationStructure();
-
-        VkPipelineLayoutCreateInfo pipeline_layout_create_info{};
-        pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipeline_layout_create_info.setLayoutCount = 1;
-        pipeline_layout_create_info.pSetLayouts = &m_descriptor_set_layout;
-        SHERPHY_EXCEPTION_IF_FALSE(vkCreatePipelineLayout(m_device.m_logical_device, &pipeline_layout_create_info, nullptr, &m_pipeline_layout), "");
+        ShaderReflection reflection = m_shader_library.getReflection(m_pipeline_shaders);
+        SHERPHY_EXCEPTION_IF_FALSE((reflection.push_constant_size == sizeof(PathTracePushConstant)), "push constants of PathTrace.rgen do not match PathTracePushConstant");
+        m_pipeline_layout = createPipelineLayout(reflection);
 
         std::vector<VkPipelineShaderStageCreateInfo> shader_stages;
         std::vector<VkRayTracingShaderGroupCreateInfoKHR> shader_groups;
@@ -1354,142 +2077,10 @@ namespace Sherphy{
         rayTracing_pipeline_CI.layout = m_pipeline_layout;
 
         SHERPHY_EXCEPTION_IF_FALSE(vkCreateRayTracingPipelinesKHR(m_device.m_logical_device, VK_NULL_HANDLE, VK_NULL_HANDLE, 1, &rayTracing_pipeline_CI, nullptr, &m_graphics_pipeline) == VK_SUCCESS, "create RayTracingPipeline Faild");
-    }
-
-    //TODO Uniform Type
-    void VulkanRHI::createGraphicsPipelineUniform(const std::vector<char>& vertex_shader,
-                                                  const std::vector<char>& fragment_shader)
-    {
-        auto uniform_shader = g_miracle_global_context.m_file_system->readBinaryFile("I:/SherphyEngine/resource/public/SherphyShaderLib/SPV/Normal/SimpleTestTriangle_uniform.spv");
-
-        VkShaderModule uniform_shader_module = createShaderModule(uniform_shader);
-
-        VkPipelineShaderStageCreateInfo vert_shader_stage_info{};
-        vert_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        vert_shader_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
-        vert_shader_stage_info.module = uniform_shader_module;
-        vert_shader_stage_info.pName = "vert";
-
-        VkPipelineShaderStageCreateInfo frag_shader_stage_info{};
-        frag_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        frag_shader_stage_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        frag_shader_stage_info.module = uniform_shader_module;
-        frag_shader_stage_info.pName = "frag";
-
-        VkPipelineShaderStageCreateInfo shader_stages[] = { vert_shader_stage_info, frag_shader_stage_info };
-
-        VkPipelineDynamicStateCreateInfo dynamic_state{};
-        dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-        dynamic_state.dynamicStateCount = static_cast<uint32_t>(m_dynamic_states.size());
-        dynamic_state.pDynamicStates = m_dynamic_states.data();
-
-        VkPipelineVertexInputStateCreateInfo vertex_input_info{};
-        vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertex_input_info.vertexBindingDescriptionCount = 0;
-        vertex_input_info.pVertexBindingDescriptions = nullptr; // Optional
-        vertex_input_info.vertexAttributeDescriptionCount = 0;
-        vertex_input_info.pVertexAttributeDescriptions = nullptr; // Optional
-
-        VkPipelineInputAssemblyStateCreateInfo input_assembly{};
-        input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-        input_assembly.primitiveRestartEnable = VK_FALSE;
-
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = (float)m_extent.width;
-        viewport.height = (float)m_extent.height;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-
-        VkRect2D scissor{};
-        scissor.offset = { 0, 0 };
-        scissor.extent = m_extent;
-
-        VkPipelineViewportStateCreateInfo viewport_state{};
-        viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-        viewport_state.viewportCount = 1;
-        viewport_state.pViewports = &viewport;
-        viewport_state.scissorCount = 1;
-        viewport_state.pScissors = &scissor;
-
-        VkPipelineRasterizationStateCreateInfo rasterizer{};
-        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-        rasterizer.depthClampEnable = VK_FALSE;
-        rasterizer.rasterizerDiscardEnable = VK_FALSE;
-        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-        rasterizer.lineWidth = 1.0f;
-        rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-        rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-        rasterizer.depthBiasEnable = VK_FALSE;
-        rasterizer.depthBiasConstantFactor = 0.0f; // Optional
-        rasterizer.depthBiasClamp = 0.0f; // Optional
-        rasterizer.depthBiasSlopeFactor = 0.0f; // Optional
-
-
-        VkPipelineMultisampleStateCreateInfo multisampling{};
-        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-        multisampling.sampleShadingEnable = VK_FALSE;
-        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-        multisampling.minSampleShading = 1.0f; // Optional
-        multisampling.pSampleMask = nullptr; // Optional
-        multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
-        multisampling.alphaToOneEnable = VK_FALSE; // Optional
-
-
-        VkPipelineColorBlendAttachmentState color_blend_attachment{};
-        color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-        color_blend_attachment.blendEnable = VK_FALSE;
-        color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-        color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-        color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD; // Optional
-        color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-        color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-        color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD; // Optional
-
-        VkPipelineColorBlendStateCreateInfo color_blending{};
-        color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-        color_blending.logicOpEnable = VK_FALSE;
-        color_blending.logicOp = VK_LOGIC_OP_COPY; // Optional
-        color_blending.attachmentCount = 1;
-        color_blending.pAttachments = &color_blend_attachment;
-        color_blending.blendConstants[0] = 0.0f; // Optional
-        color_blending.blendConstants[1] = 0.0f; // Optional
-        color_blending.blendConstants[2] = 0.0f; // Optional
-        color_blending.blendConstants[3] = 0.0f; // Optional
-
-        VkPipelineLayoutCreateInfo pipeline_layout_info{};
-        pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipeline_layout_info.setLayoutCount = 0; // Optional
-        pipeline_layout_info.pSetLayouts = nullptr; // Optional
-        pipeline_layout_info.pushConstantRangeCount = 0; // Optional
-        pipeline_layout_info.pPushConstantRanges = nullptr; // Optional
-
-        SHERPHY_EXCEPTION_IF_FALSE(vkCreatePipelineLayout(m_device.m_logical_device, &pipeline_layout_info, nullptr, &m_pipeline_layout) == VK_SUCCESS, "");
-
-        VkGraphicsPipelineCreateInfo pipeline_info{};
-        pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipeline_info.stageCount = 2;
-        pipeline_info.pStages = shader_stages;
-        pipeline_info.pVertexInputState = &vertex_input_info;
-        pipeline_info.pInputAssemblyState = &input_assembly;
-        pipeline_info.pViewportState = &viewport_state;
-        pipeline_info.pRasterizationState = &rasterizer;
-        pipeline_info.pMultisampleState = &multisampling;
-        pipeline_info.pDepthStencilState = nullptr; // Optional
-        pipeline_info.pColorBlendState = &color_blending;
-        pipeline_info.pDynamicState = &dynamic_state;
-        pipeline_info.layout = m_pipeline_layout;
-        pipeline_info.renderPass = m_render_pass;
-        pipeline_info.subpass = 0;
-        pipeline_info.basePipelineHandle = VK_NULL_HANDLE; // Optional
-        pipeline_info.basePipelineIndex = -1; // Optional
-
-        SHERPHY_EXCEPTION_IF_FALSE(vkCreateGraphicsPipelines(m_device.m_logical_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &m_graphics_pipeline) == VK_SUCCESS, "failed to create graphics pipeline!");
 
-        vkDestroyShaderModule(m_device.m_logical_device, uniform_shader_module, nullptr);
-        return;
+        // the handles of the new pipeline go into the table
+        m_path_tracer.m_shader_binding_table.invalidate();
+        updateShaderBindingTable();
     }
 
     void VulkanRHI::createGraphicsPipelineTriangleTest(const std::vector<char>& vertex_shader,
@@ -1593,14 +2184,7 @@ namespace Sherphy{
         color_blending.blendConstants[2] = 0.0f; // Optional
         color_blending.blendConstants[3] = 0.0f; // Optional
 
-        VkPipelineLayoutCreateInfo pipeline_layout_info{};
-        pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipeline_layout_info.setLayoutCount = 0; // Optional
-        pipeline_layout_info.pSetLayouts = nullptr; // Optional
-        pipeline_layout_info.pushConstantRangeCount = 0; // Optional
-        pipeline_layout_info.pPushConstantRanges = nullptr; // Optional
-
-        SHERPHY_EXCEPTION_IF_FALSE(vkCreatePipelineLayout(m_device.m_logical_device, &pipeline_layout_info, nullptr, &m_pipeline_layout) == VK_SUCCESS, "");
+        m_pipeline_layout = m_layout_cache.getPipelineLayout({}, {});
 
         VkGraphicsPipelineCreateInfo pipeline_info{};
         pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -1652,15 +2236,18 @@ namespace Sherphy{
         dynamic_state.dynamicStateCount = static_cast<uint32_t>(m_dynamic_states.size());
         dynamic_state.pDynamicStates = m_dynamic_states.data();
 
-        auto bindingDescription = VkVertex::getBindingDescription();
-        auto attributeDescriptions = VkVertex::getAttributeDescriptions();
+        // vertex input and layout follow the shaders
+        ShaderReflection reflection = m_shader_library.getReflection(m_pipeline_shaders);
+        VkVertexInputBindingDescription binding_description{};
+        std::vector<VkVertexInputAttributeDescription> attribute_descriptions;
+        getVertexInputState(reflection, binding_description, attribute_descriptions);
 
         VkPipelineVertexInputStateCreateInfo vertex_input_info{};
         vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
         vertex_input_info.vertexBindingDescriptionCount = 1;
-        vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-        vertex_input_info.pVertexBindingDescriptions = &bindingDescription;
-        vertex_input_info.pVertexAttributeDescriptions = attributeDescriptions.data();
+        vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_descriptions.size());
+        vertex_input_info.pVertexBindingDescriptions = &binding_description;
+        vertex_input_info.pVertexAttributeDescriptions = attribute_descriptions.data();
 
         VkPipelineInputAssemblyStateCreateInfo input_assembly{};
         input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -1713,7 +2300,8 @@ namespace Sherphy{
         depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
         depth_stencil.depthTestEnable = VK_TRUE;
         depth_stencil.depthWriteEnable = VK_TRUE;
-        depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS;
+        // equal passes what the depth pre-pass already wrote
+        depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
         depth_stencil.depthBoundsTestEnable = VK_FALSE;
         depth_stencil.stencilTestEnable = VK_FALSE;
 
@@ -1738,14 +2326,8 @@ namespace Sherphy{
         color_blending.blendConstants[2] = 0.0f; // Optional
         color_blending.blendConstants[3] = 0.0f; // Optional
 
-        VkPipelineLayoutCreateInfo pipeline_layout_info{};
-        pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipeline_layout_info.setLayoutCount = 1;
-        pipeline_layout_info.pSetLayouts = &m_descriptor_set_layout;
-        pipeline_layout_info.pushConstantRangeCount = 0; // Optional
-        pipeline_layout_info.pPushConstantRanges = nullptr; // Optional
-
-        SHERPHY_EXCEPTION_IF_FALSE(vkCreatePipelineLayout(m_device.m_logical_device, &pipeline_layout_info, nullptr, &m_pipeline_layout) == VK_SUCCESS, "");
+        // set 0 per frame data, set 1 bindless textures and materials
+        m_pipeline_layout = createPipelineLayout(reflection);
 
         VkGraphicsPipelineCreateInfo pipeline_info{};
         pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -1767,6 +2349,13 @@ namespace Sherphy{
 
         SHERPHY_EXCEPTION_IF_FALSE(vkCreateGraphicsPipelines(m_device.m_logical_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &m_graphics_pipeline) == VK_SUCCESS, "failed to create graphics pipeline!");
 
+        // the depth pre-pass runs the same vertex shader without a fragment stage, so both passes write the same depth
+        depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS;
+        color_blending.attachmentCount = 0;
+        pipeline_info.stageCount = 1;
+        pipeline_info.renderPass = m_depth_render_pass;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateGraphicsPipelines(m_device.m_logical_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &m_depth_pipeline) == VK_SUCCESS, "failed to create depth pre-pass pipeline!");
+
         vkDestroyShaderModule(m_device.m_logical_device, vert_shader_module, nullptr);
         vkDestroyShaderModule(m_device.m_logical_device, frag_shader_module, nullptr);
         return;
@@ -1779,12 +2368,20 @@ namespace Sherphy{
 
         bool extension_supported = checkDeviceExtensionSupport(device);
 
-        bool swap_chain_adequate = false;
-        if (extension_supported) {
+        // headless needs no presentation, so software devices without a surface qualify
+        bool swap_chain_adequate = m_headless;
+        if (extension_supported && !m_headless) {
             SwapChainSupportDetails swap_chain_support = querySwapChainSupport(device);
             swap_chain_adequate = !swap_chain_support.formats.empty() && !swap_chain_support.present_modes.empty();
         }
 
+        VkPhysicalDeviceVulkan12Features supported_vulkan12_features{};
+        supported_vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 supported_features2{};
+        supported_features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supported_features2.pNext = &supported_vulkan12_features;
+        vkGetPhysicalDeviceFeatures2(device, &supported_features2);
+
         bool nv_device = false;
         VkPhysicalDeviceProperties prop;
         vkGetPhysicalDeviceProperties(device, &prop);
@@ -1797,7 +2394,10 @@ namespace Sherphy{
         VkPhysicalDeviceFeatures supported_features;
         vkGetPhysicalDeviceFeatures(device, &supported_features);
 
-        return indices.isComplete() && extension_supported && swap_chain_adequate && nv_device && supported_features.samplerAnisotropy;
+        bool gpu_driven_supported = supported_vulkan12_features.drawIndirectCount && supported_features.multiDrawIndirect && supported_features.drawIndirectFirstInstance;
+        bool bindless_supported = VulkanBindlessTable::isSupported(supported_vulkan12_features);
+
+        return indices.isComplete() && extension_supported && swap_chain_adequate && nv_device && supported_features.samplerAnisotropy && gpu_driven_supported && bindless_supported;
     }
 
     VkSurfaceFormatKHR VulkanRHI::chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& available_formats) {
@@ -1810,11 +2410,24 @@ namespace Sherphy{
     }
 
     VkPresentModeKHR VulkanRHI::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
+        VkPresentModeKHR wanted_mode = VK_PRESENT_MODE_FIFO_KHR;
+        switch (m_frame_pacing.present_mode)
+        {
+        case PresentMode::Mailbox:
+            wanted_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+            break;
+        case PresentMode::Immediate:
+            wanted_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            break;
+        default:
+            break;
+        }
         for (const auto& availablePresentMode : availablePresentModes) {
-            if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+            if (availablePresentMode == wanted_mode) {
                 return availablePresentMode;
             }
         }
+        // fifo is the only mode every surface supports
         return VK_PRESENT_MODE_FIFO_KHR;
     }
 
@@ -1884,44 +2497,188 @@ namespace Sherphy{
     {
         m_image_available_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
         m_render_finished_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        m_in_flight_fences.resize(MAX_FRAMES_IN_FLIGHT);
+        m_frame_points.assign(MAX_FRAMES_IN_FLIGHT, TimelinePoint{});
 
         VkSemaphoreCreateInfo semaphore_info{};
         semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        VkFenceCreateInfo fence_info{};
-        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
             SHERPHY_EXCEPTION_IF_FALSE(vkCreateSemaphore(m_device.m_logical_device, &semaphore_info, nullptr, &m_image_available_semaphores[i]) == VK_SUCCESS, "failed to create image semaphore for a frame!");
             SHERPHY_EXCEPTION_IF_FALSE(vkCreateSemaphore(m_device.m_logical_device, &semaphore_info, nullptr, &m_render_finished_semaphores[i]) == VK_SUCCESS, "failed to create render finish semaphore for a frame!");
-            SHERPHY_EXCEPTION_IF_FALSE(vkCreateFence(m_device.m_logical_device, &fence_info, nullptr, &m_in_flight_fences[i]) == VK_SUCCESS, "failed to create fence for a frame!");
         }
+        m_frame_telemetry.init(MAX_FRAMES_IN_FLIGHT);
 
         return;
     }
 
-    void VulkanRHI::recreateSwapChain() {
+    // frames in flight may still render to or present the old images, so they go to the
+    // deletion queue with the frame being recorded instead of idling the device
+    bool VulkanRHI::recreateSwapChain() {
         int width = 0, height = 0;
-        while (width == 0 || height == 0) {
-            g_miracle_global_context.m_display_system->getFramebufferSize(width, height);
-            g_miracle_global_context.m_display_system->waitEvents();
+        g_miracle_global_context.m_display_system->getFramebufferSize(width, height);
+        SwapChainSupportDetails swap_chain_support = querySwapChainSupport(m_physical_devices[m_pick_physical_device_id]);
+        if (width == 0 || height == 0 || swap_chain_support.capabilities.currentExtent.width == 0 || swap_chain_support.capabilities.currentExtent.height == 0)
+        {
+            m_swap_chain_dirty = true;
+            return false;
         }
+        m_swap_chain_dirty = false;
 
-        vkDeviceWaitIdle(m_device.m_logical_device);
-
-        cleanupSwapChain();
-
+        VkSwapchainKHR old_swap_chain = m_swap_chain;
+        retireSwapChainResources();
         createSwapChain(m_physical_devices[m_pick_physical_device_id]);
+        VkDevice logical_device = m_device.m_logical_device;
+        m_deletion_queue.push([logical_device, old_swap_chain]() {
+            vkDestroySwapchainKHR(logical_device, old_swap_chain, nullptr);
+        });
+
         createImageViews();
-        createDepthResources();
-        createFrameBuffers();
+        m_command_cache.invalidate();
+        if (m_path_tracer.isInitialized())
+        {
+            m_path_tracer.resize(m_extent);
+        }
+        if (m_hiz_pyramid.isInitialized())
+        {
+            m_hiz_pyramid.resize(m_extent);
+        }
+        return true;
+    }
+
+    void VulkanRHI::retireSwapChainResources()
+    {
+        VkDevice logical_device = m_device.m_logical_device;
+        std::vector<VkImageView> image_views = m_swap_chain_image_views;
+        // cached framebuffers reference the old views, the depth transient follows the new extent on its own
+        m_render_graph.retireFramebuffers(false);
+        m_deletion_queue.push([logical_device, image_views]() {
+            for (VkImageView image_view : image_views) {
+                vkDestroyImageView(logical_device, image_view, nullptr);
+            }
+        });
+        m_swap_chain_image_views.clear();
+    }
+
+    void VulkanRHI::setFramePacing(const FramePacingSettings& settings)
+    {
+        m_requested_frame_pacing = settings;
+        m_requested_frame_pacing.frames_in_flight = std::clamp(settings.frames_in_flight, (uint32_t)1, (uint32_t)MAX_FRAMES_IN_FLIGHT);
+        if (m_frame_points.empty())
+        {
+            m_frame_pacing = m_requested_frame_pacing;
+            return;
+        }
+        m_frame_pacing_dirty = true;
+    }
+
+    FramePacingStats VulkanRHI::getFramePacingStats() const
+    {
+        return m_frame_telemetry.getStats();
+    }
+
+    void VulkanRHI::waitForInputSampling()
+    {
+        if (m_frame_pacing.low_latency)
+        {
+            waitForFrame(m_last_submitted_frame);
+        }
+        pollCompletedFrames();
+        m_frame_telemetry.markInputSampled();
+    }
+
+    void VulkanRHI::waitForFrame(uint32_t frame)
+    {
+        m_device.m_timeline_sync.wait(m_frame_points[frame]);
+    }
+
+    bool VulkanRHI::isFrameComplete(uint32_t frame)
+    {
+        return m_device.m_timeline_sync.isComplete(m_frame_points[frame]);
+    }
+
+    void VulkanRHI::pollCompletedFrames()
+    {
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            if (m_frame_telemetry.m_slot_pending[i] && isFrameComplete(i))
+            {
+                m_frame_telemetry.markCompleted(i);
+            }
+        }
+    }
+
+    // hands out every frame still in the readback ring in submission order
+    void VulkanRHI::flushHeadlessFrames()
+    {
+        std::vector<uint32_t> slots;
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            if (m_headless_target.m_frame_numbers[i] != UINT64_MAX)
+            {
+                slots.push_back(i);
+            }
+        }
+        std::sort(slots.begin(), slots.end(), [this](uint32_t a, uint32_t b) {
+            return m_headless_target.m_frame_numbers[a] < m_headless_target.m_frame_numbers[b];
+        });
+        for (uint32_t slot : slots)
+        {
+            HeadlessFrame frame;
+            if (m_headless_frame_callback && m_headless_target.acquireFrame(slot, frame))
+            {
+                m_headless_frame_callback(frame);
+            }
+            m_headless_target.markSubmitted(slot, UINT64_MAX);
+        }
+    }
+
+    // changing the slot count drains every frame in flight once, a new present mode rebuilds the swapchain
+    void VulkanRHI::applyFramePacing()
+    {
+        if (!m_frame_pacing_dirty)
+        {
+            return;
+        }
+        m_frame_pacing_dirty = false;
+        FramePacingSettings previous = m_frame_pacing;
+        m_frame_pacing = m_requested_frame_pacing;
+
+        if (previous.frames_in_flight != m_frame_pacing.frames_in_flight)
+        {
+            m_device.m_timeline_sync.wait(m_frame_points);
+            pollCompletedFrames();
+            if (m_headless)
+            {
+                flushHeadlessFrames();
+            }
+            m_current_frame %= m_frame_pacing.frames_in_flight;
+        }
+        if (previous.present_mode != m_frame_pacing.present_mode && !m_headless)
+        {
+            recreateSwapChain();
+        }
     }
 
     void VulkanRHI::drawFrame() 
     {
-        vkWaitForFences(m_device.m_logical_device, 1, &m_in_flight_fences[m_current_frame], VK_TRUE, UINT64_MAX);
+        applyFramePacing();
+        // minimized, nothing is rendered but the caller keeps simulating
+        if (m_swap_chain_dirty && !recreateSwapChain())
+        {
+            return;
+        }
+        m_frame_telemetry.markFrameStart();
+        waitForFrame(m_current_frame);
+        pollCompletedFrames();
+        m_deletion_queue.collect();
+        m_descriptor_allocator.resetFrame(m_current_frame);
+        reloadShaders();
+
+        if (m_headless)
+        {
+            drawFrameHeadless();
+            return;
+        }
 
         uint32_t image_index;
         VkResult result = vkAcquireNextImageKHR(m_device.m_logical_device, m_swap_chain, UINT64_MAX, m_image_available_semaphores[m_current_frame], VK_NULL_HANDLE, &image_index);
@@ -1936,28 +2693,14 @@ namespace Sherphy{
 
         updateUniformBuffer(m_current_frame);
 
-        vkResetFences(m_device.m_logical_device, 1, &m_in_flight_fences[m_current_frame]);
-
-        vkResetCommandBuffer(m_device.m_command_buffers[m_current_frame], /*VkCommandBufferResetFlagBits*/ 0);
-        recordCommandBuffer(m_device.m_command_buffers[m_current_frame], image_index);
-
-        VkSubmitInfo submit_info{};
-        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-        VkSemaphore wait_semaphores[] = { m_image_available_semaphores[m_current_frame] };
-        VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-        submit_info.waitSemaphoreCount = 1;
-        submit_info.pWaitSemaphores = wait_semaphores;
-        submit_info.pWaitDstStageMask = wait_stages;
-
-        submit_info.commandBufferCount = 1;
-        submit_info.pCommandBuffers = &m_device.m_command_buffers[m_current_frame];
-
+        // the swapchain only speaks binary semaphores, the frame slot itself is tracked on the graphics timeline
         VkSemaphore signal_semaphores[] = { m_render_finished_semaphores[m_current_frame] };
-        submit_info.signalSemaphoreCount = 1;
-        submit_info.pSignalSemaphores = signal_semaphores;
-
-        SHERPHY_EXCEPTION_IF_FALSE(vkQueueSubmit(m_graphics_queue, 1, &submit_info, m_in_flight_fences[m_current_frame]) == VK_SUCCESS, "failed to submit draw command buffer!");
+        m_frame_points[m_current_frame] = submitFrame(image_index,
+            { { m_image_available_semaphores[m_current_frame], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT } },
+            { m_render_finished_semaphores[m_current_frame] });
+        m_deletion_queue.endFrame(m_frame_points[m_current_frame]);
+        m_frame_telemetry.markSubmitted(m_current_frame);
+        m_last_submitted_frame = m_current_frame;
 
         VkPresentInfoKHR present_info{};
         present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1983,21 +2726,41 @@ namespace Sherphy{
             SHERPHY_EXCEPTION_IF_FALSE(result == VK_SUCCESS, "failed to present swap chain image!");
         }
 
-        m_current_frame = (m_current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+        m_current_frame = (m_current_frame + 1) % m_frame_pacing.frames_in_flight;
+    }
+
+    // the frame slot was waited on, so its readback region holds a finished frame
+    void VulkanRHI::drawFrameHeadless()
+    {
+        HeadlessFrame frame;
+        if (m_headless_frame_callback && m_headless_target.acquireFrame(m_current_frame, frame))
+        {
+            m_headless_frame_callback(frame);
+        }
+
+        updateUniformBuffer(m_current_frame);
+
+        m_frame_points[m_current_frame] = submitFrame(m_current_frame);
+        m_deletion_queue.endFrame(m_frame_points[m_current_frame]);
+        m_headless_target.markSubmitted(m_current_frame, m_frame_number++);
+        m_frame_telemetry.markSubmitted(m_current_frame);
+        m_last_submitted_frame = m_current_frame;
+
+        m_current_frame = (m_current_frame + 1) % m_frame_pacing.frames_in_flight;
     }
 
     void VulkanRHI::cleanupSwapChain() {
+        m_render_graph.destroy();
+        if (m_headless)
+        {
+            m_headless_target.destroy();
+            return;
+        }
+
         for (auto image_view : m_swap_chain_image_views) {
             vkDestroyImageView(m_device.m_logical_device, image_view, nullptr);
         }
 
-        vkDestroyImageView(m_device.m_logical_device, m_depth_image_view, nullptr);
-        vkDestroyImage(m_device.m_logical_device, m_depth_image, nullptr);
-        vkFreeMemory(m_device.m_logical_device, m_depth_image_memory, nullptr);
-
-        for (auto frame_buffer : m_swap_chain_frame_buffers) {
-            vkDestroyFramebuffer(m_device.m_logical_device, frame_buffer, nullptr);
-        }
         vkDestroySwapchainKHR(m_device.m_logical_device, m_swap_chain, nullptr);
         return;
     }
@@ -2008,38 +2771,51 @@ namespace Sherphy{
         cleanupSwapChain();
 
         cleanShader();
+        m_shader_library.destroy();
         vkDestroyPipeline(m_device.m_logical_device, m_graphics_pipeline, nullptr);
-        vkDestroyPipelineLayout(m_device.m_logical_device, m_pipeline_layout, nullptr);
+        vkDestroyPipeline(m_device.m_logical_device, m_depth_pipeline, nullptr);
         vkDestroyRenderPass(m_device.m_logical_device, m_render_pass, nullptr);
-
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            m_uniform_buffers[i].destroy();
-        }
-        vkDestroyDescriptorPool(m_device.m_logical_device, m_descriptor_pool, nullptr);
+        vkDestroyRenderPass(m_device.m_logical_device, m_render_pass_depth_load, nullptr);
+        vkDestroyRenderPass(m_device.m_logical_device, m_depth_render_pass, nullptr);
+
+        m_frame_allocator.destroy();
+        m_descriptor_allocator.destroy();
+        m_texture_streamer.destroy();
+        m_deletion_queue.destroy();
+        m_command_cache.destroy();
+        m_bindless_table.destroy();
+        m_gpu_profiler.destroy();
+        m_compute_profiler.destroy();
 
         vkDestroySampler(m_device.m_logical_device, m_sampler, nullptr);
-        vkDestroyImage(m_device.m_logical_device, m_texture_image, nullptr);
-        vkFreeMemory(m_device.m_logical_device, m_texture_image_memory, nullptr);
 
-        vkDestroyDescriptorSetLayout(m_device.m_logical_device, m_descriptor_set_layout, nullptr);
+        m_layout_cache.destroy();
         
         m_vertex_buffer.destroy();
         m_index_buffer.destroy();
         m_transform_buffer.destroy();
+        m_gpu_scene.destroy();
+        m_ray_tracing_scene.destroy();
+        m_path_tracer.destroy();
+        m_hiz_pyramid.destroy();
+        m_clustered_lights.destroy();
 
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
             vkDestroySemaphore(m_device.m_logical_device, m_render_finished_semaphores[i], nullptr);
             vkDestroySemaphore(m_device.m_logical_device, m_image_available_semaphores[i], nullptr);
-            vkDestroyFence(m_device.m_logical_device, m_in_flight_fences[i], nullptr);
         }
-        vkDestroyCommandPool(m_device.m_logical_device, m_device.m_command_pool, nullptr);
+        m_device.m_timeline_sync.destroy();
+        m_device.destroyCommandPools();
 
         vkDestroyDevice(m_device.m_logical_device, nullptr);
         if (m_enable_validation_layer) {
             vkDestroyDebugUtilsMessengerEXT(m_instance, m_debug_messenger, nullptr);
         }
 
-        vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+        if (!m_headless)
+        {
+            vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+        }
         vkDestroyInstance(m_instance, nullptr);
     }
 }
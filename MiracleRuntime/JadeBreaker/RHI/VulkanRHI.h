@@ -1,9 +1,27 @@
 #pragma once
 
 #include "RenderingMath.h"
+#include "VulkanBindlessTable.h"
 #include "VulkanBuffer.h"
+#include "VulkanClusteredLights.h"
+#include "VulkanCommandCache.h"
+#include "VulkanDeletionQueue.h"
+#include "VulkanDescriptorAllocator.h"
 #include "VulkanDevice.h"
+#include "VulkanFrameAllocator.h"
+#include "VulkanFramePacing.h"
+#include "VulkanGPUProfiler.h"
+#include "VulkanGPUScene.h"
+#include "VulkanHeadlessTarget.h"
+#include "VulkanHiZPyramid.h"
+#include "VulkanLayoutCache.h"
+#include "VulkanPathTracer.h"
+#include "VulkanRayTracingScene.h"
+#include "VulkanRenderGraph.h"
+#include "VulkanTextureStreamer.h"
+#include "VulkanVertexFormat.h"
 #include "World/Scene.h"
+#include "JadeBreaker/Shader/ShaderLibrary.h"
 
 #include <vector>
 #include <cstdio>
@@ -14,7 +32,6 @@ namespace Sherphy{
     enum class PipeLineType {
         TriangleTest,
         Normal,
-        Uniform,
         RayTracing
     };
 
@@ -25,19 +42,65 @@ namespace Sherphy{
         std::vector<VkPresentModeKHR> present_modes{};
     };
 
-    struct AccelerationStructure {
-        VkAccelerationStructureKHR handle;
-        uint64_t device_address = 0;
-        VkDeviceMemory memory;
-        VkBuffer buffer;
+    // a mesh inside the vertex, index and meshlet data, indices are relative to first_vertex
+    struct MeshRange
+    {
+        uint32_t first_vertex;
+        uint32_t vertex_count;
+        uint32_t first_index;
+        uint32_t index_count;
+        uint32_t first_meshlet;
+        uint32_t meshlet_count;
+    };
+
+    struct MeshInstance
+    {
+        uint32_t mesh_id;
+        Mat4x4 model;
+        uint32_t material_id;
     };
 
     class VulkanRHI
     {
     public:
         void initVulkan(PipeLineType type);
-        std::vector<VkVertex>& getVerticesWrite();
+        // render offscreen without a window, surface or swapchain, call before initVulkan
+        void enableHeadless(uint32_t width, uint32_t height);
+        bool isHeadless() const { return m_headless; }
+        // receives every finished offscreen frame, frames in flight frames after it was submitted
+        void setHeadlessFrameCallback(HeadlessFrameCallback callback);
+        // waits for the frames in flight and hands the ones still in the readback ring to the callback, call after the last drawFrame
+        void finishHeadless();
+        // gpu time of the render graph passes on the graphics and the async compute queue, results lag the
+        // frames in flight behind; the draws replay cached secondary command buffers and count towards their pass
+        std::vector<GPUPassStats> getGPUPassStats() const;
+        // applied at the start of the next frame, before initVulkan it sets the initial state
+        void setFramePacing(const FramePacingSettings& settings);
+        const FramePacingSettings& getFramePacing() const { return m_frame_pacing; }
+        // call right before input is sampled for the next frame, blocks in low latency mode
+        void waitForInputSampling();
+        FramePacingStats getFramePacingStats() const;
+        // depth pre-pass and two phase culling against the depth pyramid, on by default with the gpu scene
+        void setOcclusionCulling(bool enabled);
+        bool isOcclusionCulling() const { return m_occlusion_culling; }
+        // the raster pipelines encode vertices into it, defaults to VulkanVertexFormat::createCompressed;
+        // call before initVulkan, the path tracer always reads float vertices
+        void setVertexFormat(const VulkanVertexFormat& vertex_format);
+        const VulkanVertexFormat& getVertexFormat() const { return m_vertex_format; }
+        std::vector<Vertex>& getVerticesWrite();
         std::vector<uint32_t>& getIndicesWrite();
+        std::vector<Meshlet>& getMeshletsWrite();
+        // appends a mesh to the vertex, index and meshlet data, call before initVulkan
+        uint32_t addMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<Meshlet>& meshlets);
+        // before initVulkan instances are kept until the scene is created, ids stay the same
+        uint32_t addMeshInstance(uint32_t mesh_id, const Mat4x4& model, uint32_t material_id = 0);
+        void setMeshInstanceTransform(uint32_t instance_id, const Mat4x4& model);
+        // point and spot lights, assigned to the light clusters every frame; ids stay the same across initVulkan
+        uint32_t addLight(const LightComponent& light, const Vec3& position);
+        void setLight(uint32_t light_id, const LightComponent& light, const Vec3& position);
+        // mid-run releases, the gpu memory is freed once no frame in flight uses it
+        void releaseTexture(uint32_t bindless_id);
+        void releaseBuffer(VulkanBuffer& buffer);
         void drawFrame();
         void cleanUp();
     private:
@@ -53,17 +116,26 @@ namespace Sherphy{
         void getEnabledFeaturesRayTracing();
 
         void createSwapChain(VkPhysicalDevice deivce);
-        void recreateSwapChain();
+        void createHeadlessTarget();
+        void drawFrameHeadless();
+        void applyFramePacing();
+        void pollCompletedFrames();
+        void flushHeadlessFrames();
+        // returns false while the window has no area, the frame is skipped then
+        bool recreateSwapChain();
+        void retireSwapChainResources();
         void cleanupSwapChain();
 
         void createImageViews();
         void createRenderPass();
         void createDescriptorSetLayout(PipeLineType type);
-        void createDescriptorSetLayoutNormal();
-        void createDescriptorSetLayoutRayTracing();
-        void createDescriptorPool(PipeLineType type);
-        void createDescriptorPoolNormal();
-        void createDescriptorPoolRayTracing();
+        std::vector<VkDescriptorSetLayoutBinding> getFrameSetBindings(const ShaderReflection& reflection);
+        bool isFrameSetCompatible(const ShaderReflection& reflection);
+        VkPipelineLayout createPipelineLayout(const ShaderReflection& reflection);
+        void getVertexInputState(const ShaderReflection& reflection,
+                                 VkVertexInputBindingDescription& binding_description,
+                                 std::vector<VkVertexInputAttributeDescription>& attribute_descriptions);
+        void createDescriptorAllocator();
         void createDescriptorSets(PipeLineType type);
         void createDescriptorSetsNormal();
         void createDescriptorSetsRayTracing();
@@ -75,19 +147,29 @@ namespace Sherphy{
                                           const std::vector<char>& fragment_shader);
         void createGraphicsPipelineTriangleTest(const std::vector<char>& vertex_shader,
                                                 const std::vector<char>& fragment_shader);
-        void createGraphicsPipelineUniform(const std::vector<char>& vertex_shader,
-                                           const std::vector<char>& fragment_shader);
         void createGraphicsPipelineRayTracing(const std::vector<char>& raygen_shader,
                                               const std::vector<char>& raymiss_shader,
                                               const std::vector<char>& closest_hit_shader);
         VkPipelineShaderStageCreateInfo loadShader(const std::vector<char>& shader, VkShaderStageFlagBits stage);
         VkShaderModule createShaderModule(const std::vector<char>& code);
         void cleanShader();
-
-        void createTextureImage();
-        VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags);
-        void createTextureImageView();
+        void createShaderLibrary();
+        // compiles the shaders of the pipeline type, their reflection drives the layouts
+        void loadPipelineShaders(PipeLineType type);
+        void createMainPipeline();
+        void createCullingPipeline();
+        // swaps the pipelines whose shaders changed on disk, frames in flight keep the old ones
+        void reloadShaders();
+
+        VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags, uint32_t mip_levels = 1);
         void createTextureSampler();
+        void createBindlessTable();
+        void createTextureStreamer(PipeLineType type);
+        void createGPUProfiler();
+        // loads the cooked KTX2 of the texture, see TextureCooker
+        uint32_t loadStreamedTexture(const char* texture_name, TextureUsage usage);
+        void updateTextureStreaming(const VkViewUniformObject& view_block);
+        void createMaterials(PipeLineType type);
         void createImage(uint32_t width, 
                          uint32_t height, 
                          VkFormat format, 
@@ -95,40 +177,54 @@ namespace Sherphy{
                          VkImageUsageFlags usage, 
                          VkMemoryPropertyFlags properties, 
                          VkImage& image, 
-                         VkDeviceMemory& image_memory);
+                         VkDeviceMemory& image_memory,
+                         uint32_t mip_levels = 1);
         void copyBufferToImage(VkBuffer buffer, 
                                VkImage image, 
                                uint32_t width, 
                                uint32_t height);
+        void copyBufferToImage(VkBuffer buffer, 
+                               VkImage image, 
+                               const std::vector<VkBufferImageCopy>& regions);
         void transitionImageLayout(VkImage image, 
                                    VkFormat format, 
                                    VkImageLayout old_layout, 
-                                   VkImageLayout new_layout);
-        void createFrameBuffers();
+                                   VkImageLayout new_layout,
+                                   uint32_t mip_levels = 1);
         void createVertexBuffer(PipeLineType type);
         void createIndexBuffer(PipeLineType type);
         void createTransformBuffer(PipeLineType type);
-        void createDepthResources();
+        void createGPUScene(PipeLineType type);
+        void createHiZPyramid(PipeLineType type);
+        void createClusteredLights(PipeLineType type);
         VkFormat findDepthFormat();
         VkFormat findSupportedFormat(VkPhysicalDevice device, const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
-        void createUniformBuffers();
+        void createFrameAllocator();
         void updateUniformBuffer(uint32_t current_image);
 
         void copyBufferImmediate(VulkanBuffer src_buffer,
                                  VulkanBuffer dst_buffer,
                                  VkDeviceSize size);
 
-        void recordCommandBuffer(VkCommandBuffer command_buffer,
-                                 uint32_t image_index);
+        TimelinePoint submitFrame(uint32_t image_index,
+                                  const std::vector<BinarySemaphoreWait>& binary_waits = {},
+                                  const std::vector<VkSemaphore>& binary_signals = {});
+        void createRenderGraph();
+        void buildRenderGraph(uint32_t image_index);
+        // the depth pre-pass draws what the early culling phase kept with the depth only pipeline
+        void recordSceneDraws(VkCommandBuffer command_buffer, bool depth_pre_pass = false);
+        CommandSignature getSceneDrawSignature(bool depth_pre_pass = false);
 
         void createSyncObjects();
 
         void createRenderPassNormal();
         //------------------- Acceleration Structure --------------------------
-        void createAccelerationStructureBuffer(AccelerationStructure& acceleration_structure, VkAccelerationStructureBuildSizesInfoKHR build_size_info);
-        void createBottomLevelAccelerationStructure();
-        void createTopLevelAccelerationStructure();
+        void createRayTracingScene(PipeLineType type);
+        void createPathTracer(PipeLineType type);
+        // one hit record per instance, rebuilt when instances come or go
+        void updateShaderBindingTable();
+        void updateRayTracingDescriptorSet(uint32_t current_frame);
 
         //------------------- Check Pick --------------------------------------
         bool isDeviceSuitable(VkPhysicalDevice& device);
@@ -175,14 +271,16 @@ namespace Sherphy{
         float m_queue_prioity = 1.0f;
         VkPhysicalDeviceFeatures m_device_features{};
         VkQueue m_graphics_queue;
+        VkQueue m_compute_queue;
+        VkQueue m_transfer_queue;
 
 
         //------------------ Vk Platform Surface -----------------------------
-        VkSurfaceKHR m_surface;
+        VkSurfaceKHR m_surface = VK_NULL_HANDLE;
         VkQueue m_present_queue;
 
         //------------------ Vk Swap Chain -----------------------------------
-        VkSwapchainKHR m_swap_chain;
+        VkSwapchainKHR m_swap_chain = VK_NULL_HANDLE;
         std::vector<VkImage> m_swap_chain_images;
 
         VkFormat m_swap_chain_image_format;
@@ -190,7 +288,13 @@ namespace Sherphy{
         VkExtent2D m_extent;
 
         std::vector<VkImageView> m_swap_chain_image_views;
-        std::vector<VkFramebuffer> m_swap_chain_frame_buffers;
+
+        //------------------ Headless ----------------------------------------
+        // offscreen images stand in for the swapchain images, one per frame in flight
+        bool m_headless = false;
+        VulkanHeadlessTarget m_headless_target;
+        HeadlessFrameCallback m_headless_frame_callback;
+        uint64_t m_frame_number = 0;
 
         //------------------ Graphics PipeLine -------------------------------
         std::vector<VkDynamicState> m_dynamic_states = {
@@ -200,13 +304,57 @@ namespace Sherphy{
         VkRenderPass m_render_pass;
         VkPipelineLayout m_pipeline_layout;
         VkPipeline m_graphics_pipeline;
+        // depth only pass over the occluders and the main pass variant that keeps its depth
+        VkRenderPass m_depth_render_pass = VK_NULL_HANDLE;
+        VkRenderPass m_render_pass_depth_load = VK_NULL_HANDLE;
+        VkPipeline m_depth_pipeline = VK_NULL_HANDLE;
+
+        //------------------ GPU Driven Scene --------------------------------
+        VulkanGPUScene m_gpu_scene;
+        Mat4x4 m_view_proj{ 1.0f };
+        Vec3 m_camera_position{ 0.0f };
+        // farthest depth pyramid, set 1 of the occlusion culling shader binds it
+        VulkanHiZPyramid m_hiz_pyramid;
+        VkDescriptorSetLayout m_occlusion_set_layout = VK_NULL_HANDLE; // owned by the layout cache
+        bool m_occlusion_culling = true;
+        // picked once, the render passes and the graph depth image share it; the pyramid build samples it
+        VkFormat m_depth_format = VK_FORMAT_UNDEFINED;
+        bool m_depth_sampled = false;
+        // lights binned into view space froxels, the forward shader reads the lists of its froxel
+        VulkanClusteredLights m_clustered_lights;
+
+        //------------------ Bindless Resources ------------------------------
+        VulkanBindlessTable m_bindless_table;
+        VulkanTextureStreamer m_texture_streamer;
+
+        //------------------ Profiling ---------------------------------------
+        VulkanGPUProfiler m_gpu_profiler;
+        // passes on a dedicated compute queue, left uninitialized when compute shares the graphics queue
+        VulkanGPUProfiler m_compute_profiler;
+
+        //------------------ Render Graph ------------------------------------
+        // rebuilt every frame, owns the depth buffer and the framebuffers
+        VulkanRenderGraph m_render_graph;
+        // secondary command buffers of the scene draws, replayed while nothing changes
+        VulkanCommandCache m_command_cache;
 
         //------------------ Shader Asset -------------------------------------
         std::vector<VkShaderModule> m_managed_shader_modules;
+        // compiled from GLSL at startup and again whenever a source changes
+        ShaderLibrary m_shader_library;
+        PipeLineType m_pipeline_type = PipeLineType::Normal;
+        // stages of m_graphics_pipeline in createGraphicsPipeline order
+        std::vector<ShaderHandle> m_pipeline_shaders;
+        std::vector<ShaderHandle> m_culling_shaders;
+        // set layouts and pipeline layouts derived from shader reflection, shared between pipelines
+        VulkanLayoutCache m_layout_cache;
 
         //------------------ Global Buffers Pipeline ----------------------------------
         VkDescriptorSetLayout m_descriptor_set_layout;
-        VkDescriptorPool m_descriptor_pool;
+        std::vector<VkDescriptorSetLayoutBinding> m_frame_set_bindings;
+        // set 0 buffers bound at an offset into the frame allocator
+        std::vector<uint32_t> m_dynamic_frame_bindings;
+        VulkanDescriptorAllocator m_descriptor_allocator;
         std::vector<VkDescriptorSet> m_descriptor_sets;
 
         //------------------ Rendering Buffers -------------------------------
@@ -217,18 +365,16 @@ namespace Sherphy{
         //VkBuffer m_index_buffer;
         //VkDeviceMemory m_index_buffer_memory;
         VulkanBuffer m_transform_buffer;
-        std::vector<VulkanBuffer> m_uniform_buffers;
+        // per frame ring for the view block and per object data
+        VulkanFrameAllocator m_frame_allocator;
+        uint32_t m_view_offset = 0;
         //std::vector<VkBuffer> m_uniform_buffers;
         //std::vector<VkDeviceMemory> m_uniform_buffers_memory;
         //std::vector<void*> m_uniform_buffers_mapped;
 
-        VkImage m_depth_image;
-        VkDeviceMemory m_depth_image_memory;
-        VkImageView m_depth_image_view;
-
         //------------------ Submit data -------------------------------------
 #if defined(SHERPHY_DEUBG_RAW)
-        const std::vector<VkVertex> m_vertices = {
+        const std::vector<Vertex> m_vertices = {
             {{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f}},
             {{0.5f, -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
             {{0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}},
@@ -249,35 +395,60 @@ namespace Sherphy{
             0.0f, 0.0f, 1.0f, 0.0f
         };
 #else 
-        std::vector<VkVertex> m_vertices;
+        std::vector<Vertex> m_vertices;
         std::vector<uint32_t> m_indices;
+        std::vector<Meshlet> m_meshlets;
+        // empty when everything written through getVerticesWrite is one mesh
+        std::vector<MeshRange> m_mesh_ranges;
+        // layout of the vertex buffer, every mesh range is quantized against its own bounds
+        VulkanVertexFormat m_vertex_format;
+        std::vector<VertexQuantization> m_mesh_quantizations;
+        // instances added before the scenes exist, empty means one spinning instance of mesh 0
+        std::vector<MeshInstance> m_mesh_instances;
         VkTransformMatrixKHR m_transform_matrix = {
             1.0f, 0.0f, 0.0f, 0.0f,
             0.0f, 1.0f, 0.0f, 0.0f,
             0.0f, 0.0f, 1.0f, 0.0f
         };
 #endif
-        VkImage m_texture_image;
-        VkImageView m_texture_image_view;
         VkSampler m_sampler;
-        VkDeviceMemory m_texture_image_memory;
 
         //------------------ Draw Frame --------------------------------------
         std::vector<VkSemaphore> m_image_available_semaphores;
         std::vector<VkSemaphore> m_render_finished_semaphores;
-        std::vector<VkFence> m_in_flight_fences;
+        // graphics timeline point each frame slot signals, the slot is free once it is reached
+        std::vector<TimelinePoint> m_frame_points;
         uint32_t m_current_frame = 0;
+        uint32_t m_last_submitted_frame = 0;
         bool m_frame_buffer_resized = false;
+        bool m_swap_chain_dirty = false; // recreation is retried every frame while minimized
+
+        void waitForFrame(uint32_t frame);
+        bool isFrameComplete(uint32_t frame);
+
+        //------------------ Deferred Destruction ----------------------------
+        VulkanDeletionQueue m_deletion_queue;
+
+        //------------------ Frame Pacing ------------------------------------
+        // sync objects and per frame resources exist for MAX_FRAMES_IN_FLIGHT slots,
+        // only the first frames_in_flight of them are cycled
+        FramePacingSettings m_frame_pacing;
+        FramePacingSettings m_requested_frame_pacing;
+        bool m_frame_pacing_dirty = false;
+        FrameTelemetry m_frame_telemetry;
 
         //------------------ Debug -------------------------------------------
         VkDebugUtilsMessengerEXT m_debug_messenger;
 
 
         //------------------ RayTracingLine ----------------------------------
-        AccelerationStructure m_bottom_level_AS{};
-        AccelerationStructure m_top_level_AS{};
+        // a compacted bottom level structure per mesh, the top level one is refit every frame
+        VulkanRayTracingScene m_ray_tracing_scene;
+        // accumulates one sample per pixel and frame until the camera or the scene changes
+        VulkanPathTracer m_path_tracer;
+        uint32_t m_ray_tracing_view_offset = 0;
 
-        VkPhysicalDeviceBufferDeviceAddressFeatures m_enabled_buffer_device_addres_features{};
+        VkPhysicalDeviceVulkan12Features m_enabled_vulkan12_features{};
         VkPhysicalDeviceRayTracingPipelineFeaturesKHR m_enabled_ray_tracing_pipeline_features{};
         VkPhysicalDeviceAccelerationStructureFeaturesKHR m_enabled_acceleration_structure_features{};
     };
@@ -0,0 +1,419 @@
+#include "VulkanRayTracingScene.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <volk.h>
+#include <algorithm>
+#include <string>
+
+namespace Sherphy
+{
+    uint32_t VulkanRayTracingScene::registerMesh(uint32_t first_vertex, uint32_t vertex_count, uint32_t first_index, uint32_t index_count)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE((vertex_count > 0 && index_count >= 3), "ray tracing mesh has no triangles");
+
+        RayTracingMesh mesh{};
+        mesh.first_vertex = first_vertex;
+        mesh.vertex_count = vertex_count;
+        mesh.first_index = first_index;
+        mesh.index_count = index_count;
+        m_meshes.push_back(mesh);
+        return static_cast<uint32_t>(m_meshes.size() - 1);
+    }
+
+    uint32_t VulkanRayTracingScene::addInstance(uint32_t mesh_id, const Mat4x4& model, uint32_t custom_index)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE((mesh_id < m_meshes.size()), "ray tracing instance refers to unknown mesh");
+        SHERPHY_EXCEPTION_IF_FALSE((m_max_instances == 0 || m_instances.size() < m_max_instances), "ray tracing instance capacity exceeded");
+
+        RayTracingInstance instance{};
+        instance.model = model;
+        instance.mesh_id = mesh_id;
+        instance.custom_index = custom_index;
+        m_instances.push_back(instance);
+        return static_cast<uint32_t>(m_instances.size() - 1);
+    }
+
+    void VulkanRayTracingScene::setInstanceTransform(uint32_t instance_id, const Mat4x4& model)
+    {
+        m_instances[instance_id].model = model;
+    }
+
+    void VulkanRayTracingScene::setInstance(uint32_t instance_id, uint32_t mesh_id, const Mat4x4& model, uint32_t custom_index)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE((instance_id < m_instances.size()), "ray tracing instance does not exist");
+        SHERPHY_EXCEPTION_IF_FALSE((mesh_id < m_meshes.size()), "ray tracing instance refers to unknown mesh");
+
+        m_instances[instance_id].model = model;
+        m_instances[instance_id].mesh_id = mesh_id;
+        m_instances[instance_id].custom_index = custom_index;
+        // another bottom level structure, every frame slot rebuilds instead of refitting
+        m_built_instance_counts.assign(m_built_instance_counts.size(), UINT32_MAX);
+    }
+
+    void VulkanRayTracingScene::init(VulkanDevice* device, VkBuffer vertex_buffer, uint32_t vertex_stride, VkBuffer index_buffer, uint32_t frame_count, uint32_t max_instances)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE((m_meshes.size() > 0), "ray tracing scene has no mesh registered");
+        m_device = device;
+        m_vertex_buffer = vertex_buffer;
+        m_vertex_stride = vertex_stride;
+        m_index_buffer = index_buffer;
+        m_frame_count = frame_count;
+        m_max_instances = std::max<uint32_t>(max_instances, static_cast<uint32_t>(m_instances.size()));
+
+        VkPhysicalDeviceAccelerationStructurePropertiesKHR acceleration_structure_properties{};
+        acceleration_structure_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+        VkPhysicalDeviceProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &acceleration_structure_properties;
+        vkGetPhysicalDeviceProperties2(m_device->m_physical_device, &properties2);
+        m_scratch_alignment = std::max<VkDeviceSize>(acceleration_structure_properties.minAccelerationStructureScratchOffsetAlignment, 1);
+
+        buildBottomLevels();
+
+        // the top level structures are sized once for the instance capacity, refits and rebuilds never reallocate
+        VkAccelerationStructureGeometryKHR geometry{};
+        geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+        geometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+        geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+        geometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+        geometry.geometry.instances.arrayOfPointers = VK_FALSE;
+
+        VkAccelerationStructureBuildGeometryInfoKHR build_info{};
+        build_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+        build_info.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+        build_info.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+        build_info.geometryCount = 1;
+        build_info.pGeometries = &geometry;
+
+        VkAccelerationStructureBuildSizesInfoKHR build_sizes{};
+        build_sizes.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+        vkGetAccelerationStructureBuildSizesKHR(m_device->m_logical_device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &build_info, &m_max_instances, &build_sizes);
+        VkDeviceSize scratch_size = std::max(build_sizes.buildScratchSize, build_sizes.updateScratchSize) + m_scratch_alignment;
+
+        m_top_levels.resize(m_frame_count);
+        m_instance_buffers.resize(m_frame_count);
+        m_top_level_scratch_buffers.resize(m_frame_count);
+        m_built_instance_counts.assign(m_frame_count, UINT32_MAX);
+        m_refit_counts.assign(m_frame_count, 0);
+        for (uint32_t i = 0; i < m_frame_count; i++)
+        {
+            createAccelerationStructure(m_top_levels[i], VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, build_sizes.accelerationStructureSize);
+
+            SHERPHY_ASSERT(m_device->createBuffer(sizeof(VkAccelerationStructureInstanceKHR) * std::max<uint32_t>(m_max_instances, 1),
+                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                m_instance_buffers[i]), VK_SUCCESS, "");
+            SHERPHY_ASSERT(m_instance_buffers[i].map(), VK_SUCCESS, "");
+
+            SHERPHY_ASSERT(m_device->createBuffer(scratch_size,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                m_top_level_scratch_buffers[i]), VK_SUCCESS, "");
+        }
+    }
+
+    // meshes are grouped greedily into batches whose scratch fits the budget, a mesh larger
+    // than the budget is a batch of its own; the scratch buffer is sized for the largest batch
+    void VulkanRayTracingScene::buildBottomLevels()
+    {
+        SHERPHY_EXCEPTION_IF_FALSE(isInitialized(), "ray tracing scene is not initialized");
+        uint32_t first_mesh = m_built_meshes;
+        uint32_t mesh_count = static_cast<uint32_t>(m_meshes.size()) - first_mesh;
+        if (mesh_count == 0)
+        {
+            return;
+        }
+
+        std::vector<VkAccelerationStructureBuildSizesInfoKHR> build_sizes(mesh_count);
+        for (uint32_t i = 0; i < mesh_count; i++)
+        {
+            const RayTracingMesh& mesh = m_meshes[first_mesh + i];
+            VkAccelerationStructureGeometryKHR geometry = getMeshGeometry(mesh);
+            VkAccelerationStructureBuildGeometryInfoKHR build_info{};
+            build_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+            build_info.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+            build_info.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+            build_info.geometryCount = 1;
+            build_info.pGeometries = &geometry;
+
+            uint32_t triangle_count = mesh.index_count / 3;
+            build_sizes[i].sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+            vkGetAccelerationStructureBuildSizesKHR(m_device->m_logical_device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &build_info, &triangle_count, &build_sizes[i]);
+        }
+
+        std::vector<uint32_t> batch_begins;
+        VkDeviceSize batch_scratch = 0;
+        VkDeviceSize max_batch_scratch = 0;
+        for (uint32_t i = 0; i < mesh_count; i++)
+        {
+            VkDeviceSize scratch = alignScratch(build_sizes[i].buildScratchSize);
+            if (batch_begins.empty() || batch_scratch + scratch > k_scratch_budget)
+            {
+                batch_begins.push_back(i);
+                batch_scratch = 0;
+            }
+            batch_scratch += scratch;
+            max_batch_scratch = std::max(max_batch_scratch, batch_scratch);
+        }
+        batch_begins.push_back(mesh_count);
+
+        VulkanBuffer scratch_buffer;
+        SHERPHY_ASSERT(m_device->createBuffer(max_batch_scratch + m_scratch_alignment,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            scratch_buffer), VK_SUCCESS, "");
+        uint64_t scratch_address = getScratchAddress(scratch_buffer);
+
+        for (size_t batch = 0; batch + 1 < batch_begins.size(); batch++)
+        {
+            std::vector<VkAccelerationStructureBuildSizesInfoKHR> batch_sizes(build_sizes.begin() + batch_begins[batch], build_sizes.begin() + batch_begins[batch + 1]);
+            buildBottomLevelBatch(first_mesh + batch_begins[batch], batch_sizes, scratch_address);
+        }
+        // every batch waited for its submission, nothing uses the scratch anymore
+        scratch_buffer.destroy();
+        m_built_meshes = static_cast<uint32_t>(m_meshes.size());
+
+        SHERPHY_LOG("bottom level structures " + std::to_string(mesh_count) + " in " + std::to_string(batch_begins.size() - 1) + " batches, "
+            + std::to_string(m_built_bytes / 1024) + " KB compacted to " + std::to_string(m_compacted_bytes / 1024) + " KB");
+    }
+
+    // one build command for the whole batch, the compacted sizes are read back once it finished
+    // and every structure is copied into a buffer of exactly that size
+    void VulkanRayTracingScene::buildBottomLevelBatch(uint32_t first_mesh,
+                                                      const std::vector<VkAccelerationStructureBuildSizesInfoKHR>& build_sizes,
+                                                      uint64_t scratch_address)
+    {
+        uint32_t mesh_count = static_cast<uint32_t>(build_sizes.size());
+        std::vector<AccelerationStructure> built(mesh_count);
+        std::vector<VkAccelerationStructureKHR> built_handles(mesh_count);
+        std::vector<VkAccelerationStructureGeometryKHR> geometries(mesh_count);
+        std::vector<VkAccelerationStructureBuildGeometryInfoKHR> build_infos(mesh_count);
+        std::vector<VkAccelerationStructureBuildRangeInfoKHR> build_ranges(mesh_count);
+        std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> build_range_pointers(mesh_count);
+
+        VkDeviceSize scratch_offset = 0;
+        for (uint32_t i = 0; i < mesh_count; i++)
+        {
+            const RayTracingMesh& mesh = m_meshes[first_mesh + i];
+            createAccelerationStructure(built[i], VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, build_sizes[i].accelerationStructureSize);
+            built_handles[i] = built[i].handle;
+            m_built_bytes += build_sizes[i].accelerationStructureSize;
+
+            geometries[i] = getMeshGeometry(mesh);
+            build_infos[i].sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+            build_infos[i].type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+            build_infos[i].flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+            build_infos[i].mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+            build_infos[i].dstAccelerationStructure = built[i].handle;
+            build_infos[i].geometryCount = 1;
+            build_infos[i].pGeometries = &geometries[i];
+            // builds of one command run concurrently, so each gets its own part of the scratch
+            build_infos[i].scratchData.deviceAddress = scratch_address + scratch_offset;
+            scratch_offset += alignScratch(build_sizes[i].buildScratchSize);
+
+            build_ranges[i].primitiveCount = mesh.index_count / 3;
+            build_ranges[i].primitiveOffset = 0;
+            build_ranges[i].firstVertex = 0;
+            build_ranges[i].transformOffset = 0;
+            build_range_pointers[i] = &build_ranges[i];
+        }
+
+        VkQueryPoolCreateInfo query_pool_info{};
+        query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        query_pool_info.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+        query_pool_info.queryCount = mesh_count;
+        VkQueryPool query_pool;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateQueryPool(m_device->m_logical_device, &query_pool_info, nullptr, &query_pool) == VK_SUCCESS, "failed to create compaction query pool!");
+
+        VkCommandBuffer command_buffer = m_device->beginSingleTimeCommands();
+        vkCmdResetQueryPool(command_buffer, query_pool, 0, mesh_count);
+        vkCmdBuildAccelerationStructuresKHR(command_buffer, mesh_count, build_infos.data(), build_range_pointers.data());
+        // the compacted size is only known once the build finished writing
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+        barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+        vkCmdPipelineBarrier(command_buffer,
+            VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+        vkCmdWriteAccelerationStructuresPropertiesKHR(command_buffer, mesh_count, built_handles.data(),
+            VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, query_pool, 0);
+        m_device->endSingleTimeCommands(command_buffer);
+
+        std::vector<VkDeviceSize> compacted_sizes(mesh_count);
+        SHERPHY_EXCEPTION_IF_FALSE(vkGetQueryPoolResults(m_device->m_logical_device, query_pool, 0, mesh_count,
+            sizeof(VkDeviceSize) * mesh_count, compacted_sizes.data(), sizeof(VkDeviceSize),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) == VK_SUCCESS, "failed to read compacted sizes!");
+        vkDestroyQueryPool(m_device->m_logical_device, query_pool, nullptr);
+
+        command_buffer = m_device->beginSingleTimeCommands();
+        for (uint32_t i = 0; i < mesh_count; i++)
+        {
+            AccelerationStructure& compacted = m_meshes[first_mesh + i].bottom_level;
+            createAccelerationStructure(compacted, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, compacted_sizes[i]);
+            m_compacted_bytes += compacted_sizes[i];
+
+            VkCopyAccelerationStructureInfoKHR copy_info{};
+            copy_info.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+            copy_info.src = built[i].handle;
+            copy_info.dst = compacted.handle;
+            copy_info.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+            vkCmdCopyAccelerationStructureKHR(command_buffer, &copy_info);
+        }
+        m_device->endSingleTimeCommands(command_buffer);
+
+        for (AccelerationStructure& acceleration_structure : built)
+        {
+            destroyAccelerationStructure(acceleration_structure);
+        }
+        m_build_batches++;
+    }
+
+    // the frame slot was waited on, so its instance buffer, scratch and structure are free to change
+    void VulkanRayTracingScene::recordTopLevel(VkCommandBuffer command_buffer, uint32_t current_frame)
+    {
+        uint32_t instance_count = static_cast<uint32_t>(m_instances.size());
+        VkAccelerationStructureInstanceKHR* records = static_cast<VkAccelerationStructureInstanceKHR*>(m_instance_buffers[current_frame].mapped);
+        for (uint32_t i = 0; i < instance_count; i++)
+        {
+            const RayTracingInstance& instance = m_instances[i];
+            SHERPHY_EXCEPTION_IF_FALSE((instance.mesh_id < m_built_meshes), "ray tracing instance refers to a mesh without bottom level structure");
+
+            VkAccelerationStructureInstanceKHR record{};
+            // row major 3x4, glm is column major
+            for (int row = 0; row < 3; row++)
+            {
+                for (int column = 0; column < 4; column++)
+                {
+                    record.transform.matrix[row][column] = instance.model[column][row];
+                }
+            }
+            record.instanceCustomIndex = instance.custom_index;
+            record.mask = 0xFF;
+            record.instanceShaderBindingTableRecordOffset = i;
+            record.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+            record.accelerationStructureReference = m_meshes[instance.mesh_id].bottom_level.device_address;
+            records[i] = record;
+        }
+
+        // an update needs the same instance count as the build it starts from
+        bool refit = m_built_instance_counts[current_frame] == instance_count && m_refit_counts[current_frame] < k_max_refits;
+
+        VkAccelerationStructureGeometryKHR geometry{};
+        geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+        geometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+        geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+        geometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+        geometry.geometry.instances.arrayOfPointers = VK_FALSE;
+        geometry.geometry.instances.data.deviceAddress = m_device->getBufferDeviceAddress(m_instance_buffers[current_frame]);
+
+        const AccelerationStructure& top_level = m_top_levels[current_frame];
+        VkAccelerationStructureBuildGeometryInfoKHR build_info{};
+        build_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+        build_info.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+        build_info.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+        build_info.mode = refit ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+        build_info.srcAccelerationStructure = refit ? top_level.handle : VK_NULL_HANDLE;
+        build_info.dstAccelerationStructure = top_level.handle;
+        build_info.geometryCount = 1;
+        build_info.pGeometries = &geometry;
+        build_info.scratchData.deviceAddress = getScratchAddress(m_top_level_scratch_buffers[current_frame]);
+
+        VkAccelerationStructureBuildRangeInfoKHR build_range{};
+        build_range.primitiveCount = instance_count;
+        const VkAccelerationStructureBuildRangeInfoKHR* build_range_pointer = &build_range;
+        vkCmdBuildAccelerationStructuresKHR(command_buffer, 1, &build_info, &build_range_pointer);
+
+        m_refit_counts[current_frame] = refit ? m_refit_counts[current_frame] + 1 : 0;
+        m_built_instance_counts[current_frame] = instance_count;
+    }
+
+    RayTracingHitRecord VulkanRayTracingScene::getHitRecord(uint32_t instance_id)
+    {
+        const RayTracingMesh& mesh = m_meshes[m_instances[instance_id].mesh_id];
+        RayTracingHitRecord hit_record{};
+        hit_record.vertex_address = m_device->getBufferDeviceAddress(m_vertex_buffer) + static_cast<VkDeviceSize>(m_vertex_stride) * mesh.first_vertex;
+        hit_record.index_address = m_device->getBufferDeviceAddress(m_index_buffer) + sizeof(uint32_t) * mesh.first_index;
+        return hit_record;
+    }
+
+    void VulkanRayTracingScene::destroy()
+    {
+        if (!isInitialized())
+        {
+            return;
+        }
+        for (RayTracingMesh& mesh : m_meshes)
+        {
+            destroyAccelerationStructure(mesh.bottom_level);
+        }
+        for (uint32_t i = 0; i < m_frame_count; i++)
+        {
+            destroyAccelerationStructure(m_top_levels[i]);
+            m_instance_buffers[i].unmap();
+            m_instance_buffers[i].destroy();
+            m_top_level_scratch_buffers[i].destroy();
+        }
+        m_device = nullptr;
+    }
+
+    void VulkanRayTracingScene::createAccelerationStructure(AccelerationStructure& acceleration_structure, VkAccelerationStructureTypeKHR type, VkDeviceSize size)
+    {
+        SHERPHY_ASSERT(m_device->createBuffer(size,
+            VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            acceleration_structure.buffer), VK_SUCCESS, "AccelerationStructureBuffer Faild");
+        acceleration_structure.size = size;
+
+        VkAccelerationStructureCreateInfoKHR create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+        create_info.buffer = acceleration_structure.buffer.buffer;
+        create_info.size = size;
+        create_info.type = type;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateAccelerationStructureKHR(m_device->m_logical_device, &create_info, nullptr, &acceleration_structure.handle) == VK_SUCCESS, "failed to create acceleration structure!");
+
+        VkAccelerationStructureDeviceAddressInfoKHR address_info{};
+        address_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+        address_info.accelerationStructure = acceleration_structure.handle;
+        acceleration_structure.device_address = vkGetAccelerationStructureDeviceAddressKHR(m_device->m_logical_device, &address_info);
+    }
+
+    void VulkanRayTracingScene::destroyAccelerationStructure(AccelerationStructure& acceleration_structure)
+    {
+        if (acceleration_structure.handle == VK_NULL_HANDLE)
+        {
+            return;
+        }
+        vkDestroyAccelerationStructureKHR(m_device->m_logical_device, acceleration_structure.handle, nullptr);
+        acceleration_structure.buffer.destroy();
+        acceleration_structure = AccelerationStructure{};
+    }
+
+    // positions are the first element of the float vertex format, the mesh transform lives in its instances
+    VkAccelerationStructureGeometryKHR VulkanRayTracingScene::getMeshGeometry(const RayTracingMesh& mesh)
+    {
+        VkAccelerationStructureGeometryKHR geometry{};
+        geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+        geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+        geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+        geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+        geometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+        geometry.geometry.triangles.vertexData.deviceAddress = m_device->getBufferDeviceAddress(m_vertex_buffer) + static_cast<VkDeviceSize>(m_vertex_stride) * mesh.first_vertex;
+        geometry.geometry.triangles.maxVertex = mesh.vertex_count - 1;
+        geometry.geometry.triangles.vertexStride = m_vertex_stride;
+        geometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
+        geometry.geometry.triangles.indexData.deviceAddress = m_device->getBufferDeviceAddress(m_index_buffer) + sizeof(uint32_t) * mesh.first_index;
+        geometry.geometry.triangles.transformData.deviceAddress = 0;
+        return geometry;
+    }
+
+    VkDeviceSize VulkanRayTracingScene::alignScratch(VkDeviceSize size) const
+    {
+        return (size + m_scratch_alignment - 1) / m_scratch_alignment * m_scratch_alignment;
+    }
+
+    uint64_t VulkanRayTracingScene::getScratchAddress(const VulkanBuffer& scratch_buffer) const
+    {
+        return alignScratch(m_device->getBufferDeviceAddress(scratch_buffer.buffer));
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "RenderingMath.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+
+#include <vector>
+
+namespace Sherphy
+{
+	struct AccelerationStructure
+	{
+		VkAccelerationStructureKHR handle = VK_NULL_HANDLE;
+		uint64_t device_address = 0;
+		VulkanBuffer buffer;
+		VkDeviceSize size = 0;
+	};
+
+	// a mesh of the shared vertex and index buffers, indices are relative to first_vertex
+	struct RayTracingMesh
+	{
+		uint32_t first_vertex;
+		uint32_t vertex_count;
+		uint32_t first_index;
+		uint32_t index_count;
+		AccelerationStructure bottom_level;
+	};
+
+	struct RayTracingInstance
+	{
+		Mat4x4 model;
+		uint32_t mesh_id;
+		uint32_t custom_index; // gl_InstanceCustomIndexEXT
+	};
+
+	// shaderRecordEXT of PathTrace.rchit, the mesh of the instance in the shared buffers
+	struct RayTracingHitRecord
+	{
+		uint64_t vertex_address;
+		uint64_t index_address;
+	};
+
+	// Acceleration structures of the ray traced scene. Every mesh gets its own bottom
+	// level structure. They are built in batches that share one scratch buffer, up to
+	// a scratch budget per batch, and are compacted right after the build to the size
+	// the driver reports through compaction queries.
+	// The top level structure is recorded every frame from the instance transforms.
+	// Each frame in flight owns a top level structure, an instance buffer and a scratch
+	// buffer, all sized for max_instances. While the instance count stays the same the
+	// structure is refit in place. It is rebuilt when instances come or go, and every
+	// k_max_refits frames so the quality does not drift.
+	struct VulkanRayTracingScene
+	{
+		static const VkDeviceSize k_scratch_budget = 64ull * 1024 * 1024;
+		static const uint32_t k_max_refits = 64;
+
+		VulkanDevice* m_device = nullptr;
+		uint32_t m_frame_count = 0;
+		uint32_t m_max_instances = 0;
+		VkDeviceSize m_scratch_alignment = 0;
+
+		VkBuffer m_vertex_buffer = VK_NULL_HANDLE;
+		uint32_t m_vertex_stride = 0; // float positions first
+		VkBuffer m_index_buffer = VK_NULL_HANDLE;
+		std::vector<RayTracingMesh> m_meshes;
+		uint32_t m_built_meshes = 0; // meshes below this have a bottom level structure
+		std::vector<RayTracingInstance> m_instances;
+
+		std::vector<AccelerationStructure> m_top_levels;
+		std::vector<VulkanBuffer> m_instance_buffers; // host visible, mapped
+		std::vector<VulkanBuffer> m_top_level_scratch_buffers;
+		std::vector<uint32_t> m_built_instance_counts; // UINT32_MAX before the first build
+		std::vector<uint32_t> m_refit_counts;
+
+		// statistics of the bottom level builds
+		VkDeviceSize m_built_bytes = 0;
+		VkDeviceSize m_compacted_bytes = 0;
+		uint32_t m_build_batches = 0;
+
+		uint32_t registerMesh(uint32_t first_vertex, uint32_t vertex_count, uint32_t first_index, uint32_t index_count);
+		uint32_t addInstance(uint32_t mesh_id, const Mat4x4& model, uint32_t custom_index = 0);
+		void setInstanceTransform(uint32_t instance_id, const Mat4x4& model);
+		// replaces an instance in place, its id stays the same
+		void setInstance(uint32_t instance_id, uint32_t mesh_id, const Mat4x4& model, uint32_t custom_index = 0);
+
+		bool isInitialized() const { return m_device != nullptr; }
+		// the buffers need device address and acceleration structure build input usage
+		void init(VulkanDevice* device, VkBuffer vertex_buffer, uint32_t vertex_stride, VkBuffer index_buffer, uint32_t frame_count, uint32_t max_instances);
+		// builds and compacts the bottom level structures of every mesh registered since the last call, blocks
+		void buildBottomLevels();
+		// writes the instances of the frame slot and builds or refits its top level structure
+		void recordTopLevel(VkCommandBuffer command_buffer, uint32_t current_frame);
+		const AccelerationStructure& getTopLevel(uint32_t current_frame) const { return m_top_levels[current_frame]; }
+		uint32_t getInstanceCount() const { return static_cast<uint32_t>(m_instances.size()); }
+		// instance i uses hit record i of the shader binding table
+		RayTracingHitRecord getHitRecord(uint32_t instance_id);
+		void destroy();
+
+		void buildBottomLevelBatch(uint32_t first_mesh,
+								   const std::vector<VkAccelerationStructureBuildSizesInfoKHR>& build_sizes,
+								   uint64_t scratch_address);
+		void createAccelerationStructure(AccelerationStructure& acceleration_structure, VkAccelerationStructureTypeKHR type, VkDeviceSize size);
+		void destroyAccelerationStructure(AccelerationStructure& acceleration_structure);
+		VkAccelerationStructureGeometryKHR getMeshGeometry(const RayTracingMesh& mesh);
+		VkDeviceSize alignScratch(VkDeviceSize size) const;
+		// scratch addresses must be aligned beyond what buffers guarantee
+		uint64_t getScratchAddress(const VulkanBuffer& scratch_buffer) const;
+	};
+}
@@ -0,0 +1,818 @@
+#include "VulkanRenderGraph.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <volk.h>
+
+#include <algorithm>
+
+namespace Sherphy
+{
+    static const VkAccessFlags k_write_access_mask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT |
+        VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+
+    VulkanRenderGraph::PassBuilder& VulkanRenderGraph::PassBuilder::read(RenderGraphHandle resource, RenderGraphUsage usage)
+    {
+        graph->m_passes[pass].uses.push_back({ resource, usage, false });
+        return *this;
+    }
+
+    VulkanRenderGraph::PassBuilder& VulkanRenderGraph::PassBuilder::write(RenderGraphHandle resource, RenderGraphUsage usage)
+    {
+        graph->m_passes[pass].uses.push_back({ resource, usage, true });
+        return *this;
+    }
+
+    VulkanRenderGraph::PassBuilder& VulkanRenderGraph::PassBuilder::sideEffects()
+    {
+        graph->m_passes[pass].side_effects = true;
+        return *this;
+    }
+
+    VulkanRenderGraph::UsageInfo VulkanRenderGraph::getUsageInfo(RenderGraphUsage usage)
+    {
+        switch (usage)
+        {
+        case RenderGraphUsage::ColorAttachment:
+            return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                     VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                     VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+        case RenderGraphUsage::DepthAttachment:
+            return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                     VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+        case RenderGraphUsage::SampledFragment:
+            return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        case RenderGraphUsage::SampledCompute:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        case RenderGraphUsage::StorageReadCompute:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL };
+        case RenderGraphUsage::StorageWriteCompute:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+        case RenderGraphUsage::StorageReadGraphics:
+            return { VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL };
+        case RenderGraphUsage::StorageRayTracing:
+            return { VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+        case RenderGraphUsage::IndirectRead:
+            return { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+        case RenderGraphUsage::TransferSrc:
+            return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+        case RenderGraphUsage::TransferDst:
+            return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+        case RenderGraphUsage::AccelerationStructureBuild:
+            return { VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                     VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+                     VK_IMAGE_LAYOUT_UNDEFINED };
+        case RenderGraphUsage::AccelerationStructureRead:
+            return { VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR, VK_IMAGE_LAYOUT_UNDEFINED };
+        default:
+            return { VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+        }
+    }
+
+    void VulkanRenderGraph::init(VulkanDevice* device, VulkanDeletionQueue* deletion_queue)
+    {
+        m_device = device;
+        m_deletion_queue = deletion_queue;
+        m_frame = 0;
+    }
+
+    void VulkanRenderGraph::reset()
+    {
+        m_resources.clear();
+        m_passes.clear();
+        m_order.clear();
+        m_batches.clear();
+    }
+
+    RenderGraphHandle VulkanRenderGraph::importImage(const std::string& name,
+                                                     VkImage image,
+                                                     VkImageView image_view,
+                                                     const RenderGraphImageDesc& desc,
+                                                     VkImageLayout initial_layout,
+                                                     VkPipelineStageFlags initial_stages,
+                                                     VkImageLayout final_layout,
+                                                     VkAccessFlags initial_access)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.is_image = true;
+        resource.imported = true;
+        resource.exported = final_layout != VK_IMAGE_LAYOUT_UNDEFINED;
+        resource.desc = desc;
+        resource.image = image;
+        resource.image_view = image_view;
+        resource.initial_state.layout = initial_layout;
+        resource.initial_state.write_stages = initial_stages;
+        resource.initial_state.write_access = initial_access;
+        resource.final_layout = final_layout;
+        m_resources.push_back(resource);
+        return static_cast<RenderGraphHandle>(m_resources.size() - 1);
+    }
+
+    RenderGraphHandle VulkanRenderGraph::importBuffer(const std::string& name, VkBuffer buffer, bool exported)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.is_image = false;
+        resource.imported = true;
+        resource.exported = exported;
+        resource.buffer = buffer;
+        m_resources.push_back(resource);
+        return static_cast<RenderGraphHandle>(m_resources.size() - 1);
+    }
+
+    RenderGraphHandle VulkanRenderGraph::createImage(const std::string& name, const RenderGraphImageDesc& desc)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.is_image = true;
+        resource.desc = desc;
+        m_resources.push_back(resource);
+        return static_cast<RenderGraphHandle>(m_resources.size() - 1);
+    }
+
+    VulkanRenderGraph::PassBuilder VulkanRenderGraph::addPass(const std::string& name, QueueType queue, ExecuteFunction execute)
+    {
+        Pass pass;
+        pass.name = name;
+        pass.queue = queue;
+        pass.execute = std::move(execute);
+        m_passes.push_back(std::move(pass));
+        return PassBuilder{ this, static_cast<uint32_t>(m_passes.size() - 1) };
+    }
+
+    void VulkanRenderGraph::compile()
+    {
+        SHERPHY_EXCEPTION_IF_FALSE(isInitialized(), "render graph is not initialized");
+        m_frame++;
+        cullPasses();
+        orderPasses();
+        buildBatches();
+        allocateTransients();
+        buildBarriers();
+        retireFramebuffers(true);
+    }
+
+    // passes are declared in submission order, so walking them backwards sees every
+    // consumer of a resource before its producers
+    void VulkanRenderGraph::cullPasses()
+    {
+        std::vector<bool> needed(m_resources.size(), false);
+        for (size_t i = m_passes.size(); i-- > 0;)
+        {
+            Pass& pass = m_passes[i];
+            bool alive = pass.side_effects;
+            for (const ResourceUse& use : pass.uses)
+            {
+                alive |= use.write && (m_resources[use.resource].exported || needed[use.resource]);
+            }
+            pass.culled = !alive;
+            if (!alive)
+            {
+                continue;
+            }
+            for (const ResourceUse& use : pass.uses)
+            {
+                needed[use.resource] = true;
+            }
+        }
+    }
+
+    // a pass depends on every earlier pass that wrote what it touches, and on earlier
+    // readers of what it writes; among the passes that are ready compute goes first
+    void VulkanRenderGraph::orderPasses()
+    {
+        uint32_t pass_count = static_cast<uint32_t>(m_passes.size());
+        std::vector<std::vector<uint32_t>> dependents(pass_count);
+        std::vector<uint32_t> dependency_counts(pass_count, 0);
+        std::vector<uint32_t> last_writer(m_resources.size(), UINT32_MAX);
+        std::vector<std::vector<uint32_t>> readers(m_resources.size());
+
+        auto addEdge = [&](uint32_t from, uint32_t to) {
+            if (from == UINT32_MAX || from == to)
+            {
+                return;
+            }
+            if (std::find(dependents[from].begin(), dependents[from].end(), to) == dependents[from].end())
+            {
+                dependents[from].push_back(to);
+                dependency_counts[to]++;
+            }
+        };
+
+        for (uint32_t i = 0; i < pass_count; i++)
+        {
+            if (m_passes[i].culled)
+            {
+                continue;
+            }
+            for (const ResourceUse& use : m_passes[i].uses)
+            {
+                addEdge(last_writer[use.resource], i);
+                if (use.write)
+                {
+                    for (uint32_t reader : readers[use.resource])
+                    {
+                        addEdge(reader, i);
+                    }
+                }
+            }
+            for (const ResourceUse& use : m_passes[i].uses)
+            {
+                if (use.write)
+                {
+                    last_writer[use.resource] = i;
+                    readers[use.resource].clear();
+                }
+                else
+                {
+                    readers[use.resource].push_back(i);
+                }
+            }
+        }
+
+        std::vector<uint32_t> ready;
+        for (uint32_t i = 0; i < pass_count; i++)
+        {
+            m_passes[i].level = 0;
+            if (!m_passes[i].culled && dependency_counts[i] == 0)
+            {
+                ready.push_back(i);
+            }
+        }
+        m_order.clear();
+        while (!ready.empty())
+        {
+            auto next = std::min_element(ready.begin(), ready.end(), [this](uint32_t a, uint32_t b) {
+                bool a_compute = m_passes[a].queue == QueueType::Compute;
+                bool b_compute = m_passes[b].queue == QueueType::Compute;
+                return a_compute != b_compute ? a_compute : a < b;
+            });
+            uint32_t pass = *next;
+            ready.erase(next);
+            m_order.push_back(pass);
+            for (uint32_t dependent : dependents[pass])
+            {
+                m_passes[dependent].level = std::max(m_passes[dependent].level, m_passes[pass].level + 1);
+                if (--dependency_counts[dependent] == 0)
+                {
+                    ready.push_back(dependent);
+                }
+            }
+        }
+    }
+
+    // passes of queue types without a dedicated queue run on graphics and merge into its batches
+    void VulkanRenderGraph::buildBatches()
+    {
+        m_batches.clear();
+        for (uint32_t pass_index : m_order)
+        {
+            Pass& pass = m_passes[pass_index];
+            if (!m_device->hasDedicatedQueue(pass.queue))
+            {
+                pass.queue = QueueType::Graphics;
+            }
+            if (m_batches.empty() || m_batches.back().queue != pass.queue)
+            {
+                Batch batch;
+                batch.queue = pass.queue;
+                m_batches.push_back(batch);
+            }
+            pass.batch = static_cast<uint32_t>(m_batches.size() - 1);
+            m_batches.back().passes.push_back(pass_index);
+        }
+    }
+
+    void VulkanRenderGraph::addBatchWait(uint32_t batch, uint32_t wait_batch, VkPipelineStageFlags stage)
+    {
+        if (wait_batch == UINT32_MAX || m_batches[wait_batch].queue == m_batches[batch].queue)
+        {
+            return;
+        }
+        for (BatchWait& wait : m_batches[batch].waits)
+        {
+            if (wait.batch == wait_batch)
+            {
+                wait.stage |= stage;
+                return;
+            }
+        }
+        m_batches[batch].waits.push_back({ wait_batch, stage });
+    }
+
+    // transients used by overlapping pass ranges need separate memory, the others share
+    // blocks; largest first so a block is sized by its first occupant
+    void VulkanRenderGraph::allocateTransients()
+    {
+        std::vector<TransientImage> wanted;
+        std::vector<RenderGraphHandle> wanted_resources;
+        for (uint32_t position = 0; position < m_order.size(); position++)
+        {
+            for (const ResourceUse& use : m_passes[m_order[position]].uses)
+            {
+                Resource& resource = m_resources[use.resource];
+                if (resource.imported)
+                {
+                    continue;
+                }
+                if (resource.transient == UINT32_MAX)
+                {
+                    resource.transient = static_cast<uint32_t>(wanted.size());
+                    TransientImage transient;
+                    transient.desc = resource.desc;
+                    transient.first_pass = position;
+                    transient.last_pass = position;
+                    wanted.push_back(transient);
+                    wanted_resources.push_back(use.resource);
+                }
+                wanted[resource.transient].last_pass = position;
+            }
+        }
+
+        bool reuse = wanted.size() == m_transients.size();
+        for (size_t i = 0; reuse && i < wanted.size(); i++)
+        {
+            reuse = wanted[i].desc == m_transients[i].desc &&
+                wanted[i].first_pass == m_transients[i].first_pass &&
+                wanted[i].last_pass == m_transients[i].last_pass;
+        }
+        if (!reuse)
+        {
+            releaseTransients();
+            m_transients = wanted;
+            m_transient_bytes = 0;
+            for (TransientImage& transient : m_transients)
+            {
+                VkImageCreateInfo image_info{};
+                image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                image_info.imageType = VK_IMAGE_TYPE_2D;
+                image_info.extent = { transient.desc.extent.width, transient.desc.extent.height, 1 };
+                image_info.mipLevels = 1;
+                image_info.arrayLayers = 1;
+                image_info.format = transient.desc.format;
+                image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+                image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                image_info.usage = transient.desc.usage;
+                image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+                image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+                SHERPHY_EXCEPTION_IF_FALSE(vkCreateImage(m_device->m_logical_device, &image_info, nullptr, &transient.image) == VK_SUCCESS, "failed to create transient image!");
+                vkGetImageMemoryRequirements(m_device->m_logical_device, transient.image, &transient.requirements);
+                m_transient_bytes += transient.requirements.size;
+            }
+
+            std::vector<uint32_t> by_size(m_transients.size());
+            for (uint32_t i = 0; i < by_size.size(); i++)
+            {
+                by_size[i] = i;
+            }
+            std::sort(by_size.begin(), by_size.end(), [this](uint32_t a, uint32_t b) {
+                return m_transients[a].requirements.size > m_transients[b].requirements.size;
+            });
+            for (uint32_t index : by_size)
+            {
+                TransientImage& transient = m_transients[index];
+                for (uint32_t block_index = 0; block_index < m_blocks.size() && transient.block == UINT32_MAX; block_index++)
+                {
+                    MemoryBlock& block = m_blocks[block_index];
+                    bool fits = (transient.requirements.memoryTypeBits & (1u << block.memory_type)) != 0 && transient.requirements.size <= block.size;
+                    for (uint32_t other : block.transients)
+                    {
+                        fits &= transient.last_pass < m_transients[other].first_pass || m_transients[other].last_pass < transient.first_pass;
+                    }
+                    if (fits)
+                    {
+                        transient.block = block_index;
+                        block.transients.push_back(index);
+                    }
+                }
+                if (transient.block == UINT32_MAX)
+                {
+                    MemoryBlock block;
+                    block.size = transient.requirements.size;
+                    block.memory_type = m_device->findMemoryType(transient.requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                    block.transients.push_back(index);
+                    transient.block = static_cast<uint32_t>(m_blocks.size());
+                    m_blocks.push_back(block);
+                }
+            }
+
+            m_allocated_bytes = 0;
+            for (MemoryBlock& block : m_blocks)
+            {
+                VkMemoryAllocateInfo alloc_info{};
+                alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+                alloc_info.allocationSize = block.size;
+                alloc_info.memoryTypeIndex = block.memory_type;
+                SHERPHY_EXCEPTION_IF_FALSE(vkAllocateMemory(m_device->m_logical_device, &alloc_info, nullptr, &block.memory) == VK_SUCCESS, "failed to allocate transient memory!");
+                m_allocated_bytes += block.size;
+                std::sort(block.transients.begin(), block.transients.end(), [this](uint32_t a, uint32_t b) {
+                    return m_transients[a].first_pass < m_transients[b].first_pass;
+                });
+            }
+            for (TransientImage& transient : m_transients)
+            {
+                vkBindImageMemory(m_device->m_logical_device, transient.image, m_blocks[transient.block].memory, 0);
+                VkImageViewCreateInfo view_info{};
+                view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                view_info.image = transient.image;
+                view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                view_info.format = transient.desc.format;
+                view_info.subresourceRange = { transient.desc.aspect, 0, 1, 0, 1 };
+                SHERPHY_EXCEPTION_IF_FALSE(vkCreateImageView(m_device->m_logical_device, &view_info, nullptr, &transient.image_view) == VK_SUCCESS, "failed to create transient image view!");
+            }
+        }
+
+        for (uint32_t i = 0; i < wanted_resources.size(); i++)
+        {
+            Resource& resource = m_resources[wanted_resources[i]];
+            resource.image = m_transients[i].image;
+            resource.image_view = m_transients[i].image_view;
+        }
+    }
+
+    void VulkanRenderGraph::addBarrier(uint32_t pass_index, const Resource& resource, ResourceState& state, RenderGraphUsage usage, bool write)
+    {
+        Pass& pass = m_passes[pass_index];
+        UsageInfo info = getUsageInfo(usage);
+        VkImageLayout layout = resource.is_image ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+        uint32_t last_pass = state.last_pass;
+        state.last_pass = pass_index;
+        state.last_batch = pass.batch;
+
+        if (state.queue != pass.queue)
+        {
+            // the semaphore wait on the other queue orders and flushes everything before it
+            addBatchWait(pass.batch, m_passes[last_pass == UINT32_MAX ? pass_index : last_pass].batch, info.stages);
+            if (last_pass != UINT32_MAX && resource.is_image && state.layout != VK_IMAGE_LAYOUT_UNDEFINED)
+            {
+                // the image keeps its contents, the old family releases it after its last use
+                // and this pass acquires it, both with the same layout transition
+                VkImageMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.oldLayout = state.layout;
+                barrier.newLayout = layout;
+                barrier.srcQueueFamilyIndex = m_device->getQueueFamily(state.queue);
+                barrier.dstQueueFamilyIndex = m_device->getQueueFamily(pass.queue);
+                barrier.image = resource.image;
+                barrier.subresourceRange = { resource.desc.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+
+                Pass& release_pass = m_passes[last_pass];
+                VkPipelineStageFlags release_stages = state.write_stages | state.read_stages;
+                release_pass.release_src_stages |= release_stages != 0 ? release_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+                barrier.srcAccessMask = state.write_access;
+                barrier.dstAccessMask = 0;
+                release_pass.release_barriers.push_back(barrier);
+
+                pass.src_stages |= info.stages;
+                pass.dst_stages |= info.stages;
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = info.access;
+                pass.image_barriers.push_back(barrier);
+
+                state.layout = layout;
+                state.write_stages = info.stages;
+                state.write_access = write ? (info.access & k_write_access_mask) : 0;
+                state.read_stages = write ? 0 : info.stages;
+                state.read_access = write ? 0 : info.access;
+                state.queue = pass.queue;
+                return;
+            }
+            state.write_stages = 0;
+            state.write_access = 0;
+            state.read_stages = 0;
+            state.read_access = 0;
+            state.queue = pass.queue;
+        }
+
+        bool layout_change = resource.is_image && state.layout != layout;
+        VkPipelineStageFlags src_stages = 0;
+        VkAccessFlags src_access = 0;
+
+        if (write || layout_change)
+        {
+            // write after read needs the readers to finish, write after write the writer to be flushed
+            src_stages = state.write_stages | state.read_stages;
+            src_access = state.write_access;
+            if (src_stages == 0 && !layout_change)
+            {
+                state.layout = layout;
+                state.write_stages = info.stages;
+                state.write_access = info.access & k_write_access_mask;
+                return;
+            }
+            state.write_stages = info.stages;
+            state.write_access = write ? (info.access & k_write_access_mask) : 0;
+            state.read_stages = write ? 0 : info.stages;
+            state.read_access = write ? 0 : info.access;
+        }
+        else
+        {
+            // reads after reads, or reads that an earlier barrier already covered, need nothing
+            if (state.write_access == 0 ||
+                ((state.read_stages & info.stages) == info.stages && (state.read_access & info.access) == info.access))
+            {
+                state.read_stages |= info.stages;
+                state.read_access |= info.access;
+                return;
+            }
+            src_stages = state.write_stages;
+            src_access = state.write_access;
+            state.read_stages |= info.stages;
+            state.read_access |= info.access;
+        }
+
+        pass.src_stages |= src_stages != 0 ? src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        pass.dst_stages |= info.stages;
+        if (resource.is_image)
+        {
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = src_access;
+            barrier.dstAccessMask = info.access;
+            barrier.oldLayout = state.layout;
+            barrier.newLayout = layout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = resource.image;
+            barrier.subresourceRange = { resource.desc.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+            pass.image_barriers.push_back(barrier);
+            state.layout = layout;
+        }
+        else
+        {
+            VkBufferMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = src_access;
+            barrier.dstAccessMask = info.access;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.buffer = resource.buffer;
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+            pass.buffer_barriers.push_back(barrier);
+        }
+    }
+
+    void VulkanRenderGraph::buildBarriers()
+    {
+        // last use of every transient, the next occupant of its memory waits on it; the
+        // first occupant of a block waits on the last one of the previous frame
+        std::vector<ResourceState> transient_end(m_transients.size());
+        for (uint32_t position = 0; position < m_order.size(); position++)
+        {
+            uint32_t pass_index = m_order[position];
+            Pass& pass = m_passes[pass_index];
+            for (const ResourceUse& use : pass.uses)
+            {
+                const Resource& resource = m_resources[use.resource];
+                if (resource.imported)
+                {
+                    continue;
+                }
+                UsageInfo info = getUsageInfo(use.usage);
+                ResourceState& end = transient_end[resource.transient];
+                end.write_stages = info.stages;
+                end.write_access = use.write ? (info.access & k_write_access_mask) : 0;
+                end.queue = pass.queue;
+                end.last_pass = pass_index;
+                end.last_batch = pass.batch;
+                m_batches[pass.batch].uses_transients = true;
+            }
+        }
+
+        std::vector<ResourceState> states(m_resources.size());
+        for (uint32_t i = 0; i < m_resources.size(); i++)
+        {
+            Resource& resource = m_resources[i];
+            if (resource.imported)
+            {
+                states[i] = resource.initial_state;
+                continue;
+            }
+            if (resource.transient == UINT32_MAX)
+            {
+                continue;
+            }
+            const TransientImage& transient = m_transients[resource.transient];
+            const MemoryBlock& block = m_blocks[transient.block];
+            auto occupant = std::find(block.transients.begin(), block.transients.end(), resource.transient);
+            uint32_t previous = occupant == block.transients.begin() ? block.transients.back() : *(occupant - 1);
+            const ResourceState& previous_end = transient_end[previous];
+            Pass& first_pass = m_passes[m_order[transient.first_pass]];
+
+            // contents are discarded, only the memory hazard against the previous user remains
+            ResourceState& state = states[i];
+            state.queue = first_pass.queue;
+            if (previous_end.queue != first_pass.queue)
+            {
+                // earlier this frame the semaphore covers it, from the last frame uses_transients does
+                if (occupant != block.transients.begin())
+                {
+                    addBatchWait(first_pass.batch, previous_end.last_batch, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+                }
+                continue;
+            }
+            state.write_stages = previous_end.write_stages;
+            state.write_access = previous_end.write_access;
+            if (previous != resource.transient)
+            {
+                // a different image used this memory before, its writes must land first
+                VkMemoryBarrier alias_barrier{};
+                alias_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                alias_barrier.srcAccessMask = previous_end.write_access;
+                alias_barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+                first_pass.memory_barriers.push_back(alias_barrier);
+                first_pass.src_stages |= previous_end.write_stages;
+                first_pass.dst_stages |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+            }
+        }
+
+        for (uint32_t pass_index : m_order)
+        {
+            for (const ResourceUse& use : m_passes[pass_index].uses)
+            {
+                addBarrier(pass_index, m_resources[use.resource], states[use.resource], use.usage, use.write);
+            }
+        }
+
+        for (uint32_t i = 0; i < m_resources.size(); i++)
+        {
+            const Resource& resource = m_resources[i];
+            const ResourceState& state = states[i];
+            if (!resource.is_image || state.last_batch == UINT32_MAX ||
+                resource.final_layout == VK_IMAGE_LAYOUT_UNDEFINED || resource.final_layout == state.layout)
+            {
+                continue;
+            }
+            SHERPHY_ASSERT((state.queue == QueueType::Graphics), true, "exported image does not end on the graphics queue");
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = state.write_access;
+            barrier.dstAccessMask = 0;
+            barrier.oldLayout = state.layout;
+            barrier.newLayout = resource.final_layout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = resource.image;
+            barrier.subresourceRange = { resource.desc.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+            Batch& batch = m_batches[state.last_batch];
+            batch.final_barriers.push_back(barrier);
+            batch.final_src_stages |= state.write_stages | state.read_stages;
+        }
+    }
+
+    void VulkanRenderGraph::executeBatch(uint32_t batch_index, VkCommandBuffer command_buffer, VulkanGPUProfiler* profiler)
+    {
+        const Batch& batch = m_batches[batch_index];
+        for (uint32_t pass_index : batch.passes)
+        {
+            Pass& pass = m_passes[pass_index];
+            if (!pass.memory_barriers.empty() || !pass.buffer_barriers.empty() || !pass.image_barriers.empty())
+            {
+                vkCmdPipelineBarrier(command_buffer, pass.src_stages, pass.dst_stages, 0,
+                    static_cast<uint32_t>(pass.memory_barriers.size()), pass.memory_barriers.data(),
+                    static_cast<uint32_t>(pass.buffer_barriers.size()), pass.buffer_barriers.data(),
+                    static_cast<uint32_t>(pass.image_barriers.size()), pass.image_barriers.data());
+            }
+            if (profiler != nullptr)
+            {
+                GPUProfileScope pass_scope(*profiler, command_buffer, pass.name);
+                pass.execute(command_buffer);
+            }
+            else
+            {
+                pass.execute(command_buffer);
+            }
+            if (!pass.release_barriers.empty())
+            {
+                vkCmdPipelineBarrier(command_buffer, pass.release_src_stages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                    0, nullptr, 0, nullptr,
+                    static_cast<uint32_t>(pass.release_barriers.size()), pass.release_barriers.data());
+            }
+        }
+        if (!batch.final_barriers.empty())
+        {
+            vkCmdPipelineBarrier(command_buffer, batch.final_src_stages != 0 ? batch.final_src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr,
+                static_cast<uint32_t>(batch.final_barriers.size()), batch.final_barriers.data());
+        }
+    }
+
+    VkImage VulkanRenderGraph::getImage(RenderGraphHandle resource) const
+    {
+        return m_resources[resource].image;
+    }
+
+    VkImageView VulkanRenderGraph::getImageView(RenderGraphHandle resource) const
+    {
+        return m_resources[resource].image_view;
+    }
+
+    VkFramebuffer VulkanRenderGraph::getFramebuffer(VkRenderPass render_pass, const std::vector<RenderGraphHandle>& attachments)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE(!attachments.empty(), "framebuffer without attachments");
+        std::vector<VkImageView> image_views;
+        for (RenderGraphHandle attachment : attachments)
+        {
+            image_views.push_back(m_resources[attachment].image_view);
+        }
+        VkExtent2D extent = m_resources[attachments[0]].desc.extent;
+
+        for (FramebufferEntry& entry : m_framebuffers)
+        {
+            if (entry.render_pass == render_pass && entry.image_views == image_views &&
+                entry.extent.width == extent.width && entry.extent.height == extent.height)
+            {
+                entry.last_used_frame = m_frame;
+                return entry.framebuffer;
+            }
+        }
+
+        VkFramebufferCreateInfo frame_buffer_info{};
+        frame_buffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        frame_buffer_info.renderPass = render_pass;
+        frame_buffer_info.attachmentCount = static_cast<uint32_t>(image_views.size());
+        frame_buffer_info.pAttachments = image_views.data();
+        frame_buffer_info.width = extent.width;
+        frame_buffer_info.height = extent.height;
+        frame_buffer_info.layers = 1;
+        FramebufferEntry entry{ render_pass, image_views, extent, VK_NULL_HANDLE, m_frame };
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateFramebuffer(m_device->m_logical_device, &frame_buffer_info, nullptr, &entry.framebuffer) == VK_SUCCESS, "failed to create framebuffer!");
+        m_framebuffers.push_back(entry);
+        return entry.framebuffer;
+    }
+
+    // framebuffers of recreated swapchains or reallocated transients stop being looked up
+    void VulkanRenderGraph::retireFramebuffers(bool idle_only)
+    {
+        VkDevice logical_device = m_device->m_logical_device;
+        auto retired = std::partition(m_framebuffers.begin(), m_framebuffers.end(), [this, idle_only](const FramebufferEntry& entry) {
+            return idle_only && entry.last_used_frame + k_framebuffer_idle_frames > m_frame;
+        });
+        for (auto entry = retired; entry != m_framebuffers.end(); ++entry)
+        {
+            VkFramebuffer framebuffer = entry->framebuffer;
+            m_deletion_queue->push([logical_device, framebuffer]() {
+                vkDestroyFramebuffer(logical_device, framebuffer, nullptr);
+            });
+        }
+        m_framebuffers.erase(retired, m_framebuffers.end());
+    }
+
+    void VulkanRenderGraph::releaseTransients()
+    {
+        if (m_transients.empty())
+        {
+            return;
+        }
+        // framebuffers may reference the released views
+        retireFramebuffers(false);
+        VkDevice logical_device = m_device->m_logical_device;
+        for (const TransientImage& transient : m_transients)
+        {
+            VkImage image = transient.image;
+            VkImageView image_view = transient.image_view;
+            m_deletion_queue->push([logical_device, image, image_view]() {
+                vkDestroyImageView(logical_device, image_view, nullptr);
+                vkDestroyImage(logical_device, image, nullptr);
+            });
+        }
+        for (const MemoryBlock& block : m_blocks)
+        {
+            VkDeviceMemory memory = block.memory;
+            m_deletion_queue->push([logical_device, memory]() {
+                vkFreeMemory(logical_device, memory, nullptr);
+            });
+        }
+        m_transients.clear();
+        m_blocks.clear();
+    }
+
+    void VulkanRenderGraph::destroy()
+    {
+        if (!isInitialized())
+        {
+            return;
+        }
+        for (const FramebufferEntry& entry : m_framebuffers)
+        {
+            vkDestroyFramebuffer(m_device->m_logical_device, entry.framebuffer, nullptr);
+        }
+        m_framebuffers.clear();
+        for (const TransientImage& transient : m_transients)
+        {
+            vkDestroyImageView(m_device->m_logical_device, transient.image_view, nullptr);
+            vkDestroyImage(m_device->m_logical_device, transient.image, nullptr);
+        }
+        for (const MemoryBlock& block : m_blocks)
+        {
+            vkFreeMemory(m_device->m_logical_device, block.memory, nullptr);
+        }
+        m_transients.clear();
+        m_blocks.clear();
+        reset();
+        m_device = nullptr;
+    }
+}
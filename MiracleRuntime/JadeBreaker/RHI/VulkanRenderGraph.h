@@ -0,0 +1,233 @@
+#pragma once
+#include "VulkanDeletionQueue.h"
+#include "VulkanDevice.h"
+#include "VulkanGPUProfiler.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Sherphy
+{
+	using RenderGraphHandle = uint32_t;
+	const RenderGraphHandle k_invalid_render_graph_handle = UINT32_MAX;
+
+	// how a pass touches a resource, decides stages, access and image layout of the barriers
+	enum class RenderGraphUsage
+	{
+		ColorAttachment,
+		DepthAttachment,
+		SampledFragment,
+		SampledCompute,
+		StorageReadCompute,
+		StorageWriteCompute, // read-write storage access
+		StorageReadGraphics, // storage buffers read by vertex or fragment shaders
+		StorageRayTracing,   // read-write storage images of ray tracing shaders
+		IndirectRead,        // indirect arguments and draw counts
+		TransferSrc,
+		TransferDst,
+		AccelerationStructureBuild, // build or refit of an acceleration structure buffer
+		AccelerationStructureRead,  // traced against in ray tracing shaders
+	};
+
+	struct RenderGraphImageDesc
+	{
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkExtent2D extent{};
+		VkImageUsageFlags usage = 0;
+		VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+
+		bool operator==(const RenderGraphImageDesc& other) const
+		{
+			return format == other.format && extent.width == other.extent.width && extent.height == other.extent.height &&
+				usage == other.usage && aspect == other.aspect;
+		}
+	};
+
+	// Frame graph rebuilt every frame. Passes declare what they read and write,
+	// compile() then drops passes whose results nobody consumes, orders the rest
+	// with compute passes as early as their inputs allow so they can overlap on an
+	// async queue, derives every pipeline barrier and layout transition from the
+	// declared usages, and places transient images with disjoint lifetimes into the
+	// same memory. Transient images and framebuffers are cached between frames and
+	// only rebuilt when their descriptions change; replaced ones go to the deletion
+	// queue.
+	// Consecutive passes on one queue form a batch, submitted as one command buffer.
+	// A batch waits on the batches of other queues it consumes from; images change
+	// queue family ownership along the way, buffers are created shared between the
+	// families. Exported images are expected to end on the graphics queue.
+	struct VulkanRenderGraph
+	{
+		using ExecuteFunction = std::function<void(VkCommandBuffer)>;
+		static const uint64_t k_framebuffer_idle_frames = 8;
+
+		struct UsageInfo
+		{
+			VkPipelineStageFlags stages;
+			VkAccessFlags access;
+			VkImageLayout layout;
+		};
+
+		struct ResourceState
+		{
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags write_stages = 0;
+			VkAccessFlags write_access = 0;
+			VkPipelineStageFlags read_stages = 0; // reads since the last write
+			VkAccessFlags read_access = 0;
+			QueueType queue = QueueType::Graphics; // imported resources start out on graphics
+			uint32_t last_pass = UINT32_MAX;
+			uint32_t last_batch = UINT32_MAX;
+		};
+
+		struct Resource
+		{
+			std::string name;
+			bool is_image = true;
+			bool imported = false;
+			bool exported = false; // consumed outside the graph, keeps its writers alive
+			RenderGraphImageDesc desc;
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView image_view = VK_NULL_HANDLE;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			ResourceState initial_state;
+			VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED; // undefined leaves the last layout
+			uint32_t transient = UINT32_MAX;
+		};
+
+		struct ResourceUse
+		{
+			RenderGraphHandle resource;
+			RenderGraphUsage usage;
+			bool write;
+		};
+
+		struct Pass
+		{
+			std::string name;
+			QueueType queue = QueueType::Graphics;
+			ExecuteFunction execute;
+			std::vector<ResourceUse> uses;
+			bool side_effects = false;
+			bool culled = false;
+			uint32_t level = 0; // longest dependency chain before the pass
+			uint32_t batch = UINT32_MAX;
+
+			VkPipelineStageFlags src_stages = 0;
+			VkPipelineStageFlags dst_stages = 0;
+			std::vector<VkMemoryBarrier> memory_barriers;
+			std::vector<VkBufferMemoryBarrier> buffer_barriers;
+			std::vector<VkImageMemoryBarrier> image_barriers;
+			// ownership releases of images the next use takes to another queue, after the pass
+			VkPipelineStageFlags release_src_stages = 0;
+			std::vector<VkImageMemoryBarrier> release_barriers;
+		};
+
+		struct BatchWait
+		{
+			uint32_t batch;
+			VkPipelineStageFlags stage;
+		};
+
+		struct Batch
+		{
+			QueueType queue = QueueType::Graphics;
+			std::vector<uint32_t> passes;
+			std::vector<BatchWait> waits; // earlier batches on other queues
+			// transients are shared with the previous frame, which may still run on other queues
+			bool uses_transients = false;
+			VkPipelineStageFlags final_src_stages = 0;
+			std::vector<VkImageMemoryBarrier> final_barriers;
+		};
+
+		struct PassBuilder
+		{
+			VulkanRenderGraph* graph;
+			uint32_t pass;
+			PassBuilder& read(RenderGraphHandle resource, RenderGraphUsage usage);
+			PassBuilder& write(RenderGraphHandle resource, RenderGraphUsage usage);
+			// kept even if nothing in the graph reads its results
+			PassBuilder& sideEffects();
+		};
+
+		struct TransientImage
+		{
+			RenderGraphImageDesc desc;
+			uint32_t first_pass;
+			uint32_t last_pass;
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView image_view = VK_NULL_HANDLE;
+			VkMemoryRequirements requirements{};
+			uint32_t block = UINT32_MAX;
+		};
+
+		struct MemoryBlock
+		{
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			uint32_t memory_type = 0;
+			std::vector<uint32_t> transients; // ordered by first use
+		};
+
+		struct FramebufferEntry
+		{
+			VkRenderPass render_pass;
+			std::vector<VkImageView> image_views;
+			VkExtent2D extent;
+			VkFramebuffer framebuffer;
+			uint64_t last_used_frame;
+		};
+
+		VulkanDevice* m_device = nullptr;
+		VulkanDeletionQueue* m_deletion_queue = nullptr;
+		uint64_t m_frame = 0;
+
+		std::vector<Resource> m_resources;
+		std::vector<Pass> m_passes;
+		std::vector<uint32_t> m_order; // pass indices in execution order, culled passes left out
+		std::vector<Batch> m_batches;
+
+		std::vector<TransientImage> m_transients;
+		std::vector<MemoryBlock> m_blocks;
+		VkDeviceSize m_transient_bytes = 0; // what the transients would need without aliasing
+		VkDeviceSize m_allocated_bytes = 0;
+
+		std::vector<FramebufferEntry> m_framebuffers;
+
+		bool isInitialized() const { return m_device != nullptr; }
+		void init(VulkanDevice* device, VulkanDeletionQueue* deletion_queue);
+		// drops the passes and resources of the last frame, cached memory stays
+		void reset();
+		RenderGraphHandle importImage(const std::string& name,
+									  VkImage image,
+									  VkImageView image_view,
+									  const RenderGraphImageDesc& desc,
+									  VkImageLayout initial_layout,
+									  VkPipelineStageFlags initial_stages,
+									  VkImageLayout final_layout,
+									  VkAccessFlags initial_access = 0); // writes of earlier frames to flush
+		RenderGraphHandle importBuffer(const std::string& name, VkBuffer buffer, bool exported = false);
+		RenderGraphHandle createImage(const std::string& name, const RenderGraphImageDesc& desc);
+		PassBuilder addPass(const std::string& name, QueueType queue, ExecuteFunction execute);
+		void compile();
+		uint32_t getBatchCount() const { return static_cast<uint32_t>(m_batches.size()); }
+		const Batch& getBatch(uint32_t batch) const { return m_batches[batch]; }
+		// each pass runs inside a gpu profiler scope of its name when a profiler is given
+		void executeBatch(uint32_t batch, VkCommandBuffer command_buffer, VulkanGPUProfiler* profiler = nullptr);
+		VkImage getImage(RenderGraphHandle resource) const;
+		VkImageView getImageView(RenderGraphHandle resource) const;
+		VkFramebuffer getFramebuffer(VkRenderPass render_pass, const std::vector<RenderGraphHandle>& attachments);
+		void destroy();
+
+		void cullPasses();
+		void orderPasses();
+		void buildBatches();
+		void addBatchWait(uint32_t batch, uint32_t wait_batch, VkPipelineStageFlags stage);
+		void allocateTransients();
+		void buildBarriers();
+		void releaseTransients();
+		void retireFramebuffers(bool idle_only);
+		void addBarrier(uint32_t pass_index, const Resource& resource, ResourceState& state, RenderGraphUsage usage, bool write);
+		static UsageInfo getUsageInfo(RenderGraphUsage usage);
+	};
+}
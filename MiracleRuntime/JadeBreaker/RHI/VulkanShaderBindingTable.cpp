@@ -0,0 +1,160 @@
+#include "VulkanShaderBindingTable.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <volk.h>
+#include <algorithm>
+#include <cstring>
+
+namespace Sherphy
+{
+    void VulkanShaderBindingTable::init(VulkanDevice* device, VulkanDeletionQueue* deletion_queue)
+    {
+        m_device = device;
+        m_deletion_queue = deletion_queue;
+
+        m_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR;
+        VkPhysicalDeviceProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &m_properties;
+        vkGetPhysicalDeviceProperties2(m_device->m_physical_device, &properties2);
+        m_dirty = true;
+    }
+
+    void VulkanShaderBindingTable::setRayGen(uint32_t group)
+    {
+        m_raygen_record.group = group;
+        m_raygen_record.data.clear();
+        m_dirty = true;
+    }
+
+    uint32_t VulkanShaderBindingTable::addMiss(uint32_t group)
+    {
+        Record record;
+        record.group = group;
+        m_miss_records.push_back(record);
+        m_dirty = true;
+        return static_cast<uint32_t>(m_miss_records.size() - 1);
+    }
+
+    uint32_t VulkanShaderBindingTable::addHitRecord(uint32_t group, const void* data, uint32_t data_size)
+    {
+        m_hit_records.emplace_back();
+        setHitRecord(static_cast<uint32_t>(m_hit_records.size() - 1), group, data, data_size);
+        return static_cast<uint32_t>(m_hit_records.size() - 1);
+    }
+
+    void VulkanShaderBindingTable::setHitRecord(uint32_t record, uint32_t group, const void* data, uint32_t data_size)
+    {
+        Record& hit_record = m_hit_records[record];
+        hit_record.group = group;
+        hit_record.data.resize(data_size);
+        if (data_size > 0)
+        {
+            std::memcpy(hit_record.data.data(), data, data_size);
+        }
+        m_dirty = true;
+    }
+
+    void VulkanShaderBindingTable::clearHitRecords()
+    {
+        m_hit_records.clear();
+        m_dirty = true;
+    }
+
+    // regions in raygen, miss, hit order, each aligned to the base alignment; the raygen
+    // region holds exactly one record and its size must equal its stride
+    void VulkanShaderBindingTable::build(VkPipeline pipeline, uint32_t group_count)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE(isInitialized(), "shader binding table is not initialized");
+        if (!m_dirty)
+        {
+            return;
+        }
+
+        uint32_t handle_size = m_properties.shaderGroupHandleSize;
+        VkDeviceSize base_alignment = m_properties.shaderGroupBaseAlignment;
+        std::vector<uint8_t> handles(static_cast<size_t>(group_count) * handle_size);
+        SHERPHY_EXCEPTION_IF_FALSE(vkGetRayTracingShaderGroupHandlesKHR(m_device->m_logical_device, pipeline, 0, group_count, handles.size(), handles.data()) == VK_SUCCESS,
+            "failed to get shader group handles!");
+
+        std::vector<Record> raygen_records = { m_raygen_record };
+        VkDeviceSize raygen_stride = alignUp(getRecordStride(raygen_records), base_alignment);
+        VkDeviceSize miss_stride = getRecordStride(m_miss_records);
+        VkDeviceSize hit_stride = getRecordStride(m_hit_records);
+        SHERPHY_EXCEPTION_IF_FALSE((miss_stride <= m_properties.maxShaderGroupStride && hit_stride <= m_properties.maxShaderGroupStride),
+            "shader record data exceeds the max shader group stride");
+
+        VkDeviceSize raygen_size = raygen_stride;
+        VkDeviceSize miss_size = alignUp(miss_stride * m_miss_records.size(), base_alignment);
+        VkDeviceSize hit_size = alignUp(hit_stride * m_hit_records.size(), base_alignment);
+        // buffers are not guaranteed to start at the base alignment, the table is shifted inside
+        VkDeviceSize buffer_size = base_alignment + raygen_size + miss_size + hit_size;
+
+        if (m_buffer.buffer != VK_NULL_HANDLE)
+        {
+            m_buffer.unmap();
+            m_deletion_queue->destroyBuffer(m_buffer, m_deletion_queue->getFrameNumber());
+            m_buffer = VulkanBuffer{};
+        }
+        SHERPHY_ASSERT(m_device->createBuffer(buffer_size,
+            VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            m_buffer), VK_SUCCESS, "");
+        SHERPHY_ASSERT(m_buffer.map(), VK_SUCCESS, "");
+
+        VkDeviceAddress buffer_address = m_device->getBufferDeviceAddress(m_buffer.buffer);
+        VkDeviceAddress table_address = alignUp(buffer_address, base_alignment);
+        uint8_t* table = static_cast<uint8_t*>(m_buffer.mapped) + (table_address - buffer_address);
+
+        auto write_region = [&](const std::vector<Record>& records, VkDeviceSize offset, VkDeviceSize stride) {
+            for (size_t i = 0; i < records.size(); i++)
+            {
+                SHERPHY_EXCEPTION_IF_FALSE((records[i].group < group_count), "shader record refers to unknown group");
+                uint8_t* record = table + offset + stride * i;
+                std::memcpy(record, handles.data() + static_cast<size_t>(records[i].group) * handle_size, handle_size);
+                if (!records[i].data.empty())
+                {
+                    std::memcpy(record + handle_size, records[i].data.data(), records[i].data.size());
+                }
+            }
+        };
+        write_region(raygen_records, 0, raygen_stride);
+        write_region(m_miss_records, raygen_size, miss_stride);
+        write_region(m_hit_records, raygen_size + miss_size, hit_stride);
+
+        m_raygen_region = { table_address, raygen_stride, raygen_size };
+        m_miss_region = { table_address + raygen_size, miss_stride, miss_size };
+        m_hit_region = { table_address + raygen_size + miss_size, hit_stride, hit_size };
+        m_callable_region = {};
+        m_dirty = false;
+    }
+
+    void VulkanShaderBindingTable::destroy()
+    {
+        if (!isInitialized())
+        {
+            return;
+        }
+        if (m_buffer.buffer != VK_NULL_HANDLE)
+        {
+            m_buffer.unmap();
+            m_buffer.destroy();
+        }
+        m_device = nullptr;
+    }
+
+    VkDeviceSize VulkanShaderBindingTable::getRecordStride(const std::vector<Record>& records) const
+    {
+        size_t data_size = 0;
+        for (const Record& record : records)
+        {
+            data_size = std::max(data_size, record.data.size());
+        }
+        return alignUp(m_properties.shaderGroupHandleSize + data_size, m_properties.shaderGroupHandleAlignment);
+    }
+
+    VkDeviceSize VulkanShaderBindingTable::alignUp(VkDeviceSize size, VkDeviceSize alignment)
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "VulkanBuffer.h"
+#include "VulkanDeletionQueue.h"
+#include "VulkanDevice.h"
+
+#include <vector>
+
+namespace Sherphy
+{
+	// Shader binding table of a ray tracing pipeline. A record is the handle of a shader
+	// group followed by optional inline data (shaderRecordEXT), padded to the handle
+	// alignment; every record of a region has the stride of the largest one and each
+	// region starts at the base alignment. Hit records are meant per instance, an
+	// instance picks its record through instanceShaderBindingTableRecordOffset.
+	// The table is written to a host visible buffer by build() whenever records
+	// changed, into a new buffer so frames in flight keep reading the old one until
+	// the deletion queue releases it.
+	struct VulkanShaderBindingTable
+	{
+		struct Record
+		{
+			uint32_t group = 0;
+			std::vector<uint8_t> data;
+		};
+
+		VulkanDevice* m_device = nullptr;
+		VulkanDeletionQueue* m_deletion_queue = nullptr;
+		VkPhysicalDeviceRayTracingPipelinePropertiesKHR m_properties{};
+
+		Record m_raygen_record;
+		std::vector<Record> m_miss_records;
+		std::vector<Record> m_hit_records;
+		bool m_dirty = true;
+
+		VulkanBuffer m_buffer;
+		VkStridedDeviceAddressRegionKHR m_raygen_region{};
+		VkStridedDeviceAddressRegionKHR m_miss_region{};
+		VkStridedDeviceAddressRegionKHR m_hit_region{};
+		VkStridedDeviceAddressRegionKHR m_callable_region{};
+
+		bool isInitialized() const { return m_device != nullptr; }
+		void init(VulkanDevice* device, VulkanDeletionQueue* deletion_queue);
+		void setRayGen(uint32_t group);
+		uint32_t addMiss(uint32_t group);
+		uint32_t addHitRecord(uint32_t group, const void* data = nullptr, uint32_t data_size = 0);
+		void setHitRecord(uint32_t record, uint32_t group, const void* data = nullptr, uint32_t data_size = 0);
+		uint32_t getHitRecordCount() const { return static_cast<uint32_t>(m_hit_records.size()); }
+		void clearHitRecords();
+		// the pipeline was recreated, its group handles have to be written again
+		void invalidate() { m_dirty = true; }
+		// writes the table when records changed since the last build, group_count is the pipeline's
+		void build(VkPipeline pipeline, uint32_t group_count);
+		void destroy();
+
+		VkDeviceSize getRecordStride(const std::vector<Record>& records) const;
+		static VkDeviceSize alignUp(VkDeviceSize size, VkDeviceSize alignment);
+	};
+}
@@ -0,0 +1,432 @@
+#include "VulkanTextureStreamer.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <volk.h>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace Sherphy
+{
+    void VulkanTextureStreamer::init(VulkanDevice* device,
+                                     VulkanBindlessTable* bindless_table,
+                                     VulkanDeletionQueue* deletion_queue,
+                                     uint32_t frame_count,
+                                     VkDeviceSize budget_bytes,
+                                     VkDeviceSize upload_bytes_per_frame,
+                                     VkDeviceSize staging_bytes)
+    {
+        m_device = device;
+        m_bindless_table = bindless_table;
+        m_deletion_queue = deletion_queue;
+        m_frame_count = frame_count;
+        m_budget_bytes = budget_bytes;
+        m_upload_bytes_per_frame = upload_bytes_per_frame;
+        m_texture_by_bindless_id.assign(m_bindless_table->m_max_textures, UINT32_MAX);
+
+        m_staging_capacity = staging_bytes;
+        m_staging_head = 0;
+        m_staging_used = 0;
+        SHERPHY_ASSERT(m_device->createBuffer(m_staging_capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_staging_buffer), VK_SUCCESS, "");
+        SHERPHY_ASSERT(m_staging_buffer.map(), VK_SUCCESS, "");
+    }
+
+    uint32_t VulkanTextureStreamer::addTexture(TextureAsset&& asset, VkSampler sampler)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE(isInitialized(), "texture streamer is not initialized");
+        SHERPHY_EXCEPTION_IF_FALSE(!asset.levels.empty(), "streamed texture has no levels");
+
+        StreamedTexture texture{};
+        texture.asset = std::move(asset);
+        texture.sampler = sampler;
+        texture.requested_level = UINT32_MAX;
+        texture.tail_level = static_cast<uint32_t>(texture.asset.levels.size()) - 1;
+        while (texture.tail_level > 0 &&
+               std::max(texture.asset.levels[texture.tail_level - 1].width, texture.asset.levels[texture.tail_level - 1].height) <= k_tail_size)
+        {
+            texture.tail_level--;
+        }
+
+        makeResident(texture, texture.tail_level, true);
+        texture.bindless_id = m_bindless_table->registerTexture(texture.image_view, texture.sampler);
+        m_texture_by_bindless_id[texture.bindless_id] = static_cast<uint32_t>(m_textures.size());
+        m_textures.push_back(std::move(texture));
+        return m_textures.back().bindless_id;
+    }
+
+    void VulkanTextureStreamer::removeTexture(uint32_t bindless_id)
+    {
+        if (bindless_id >= m_texture_by_bindless_id.size() || m_texture_by_bindless_id[bindless_id] == UINT32_MAX)
+        {
+            return;
+        }
+        uint32_t index = m_texture_by_bindless_id[bindless_id];
+        retireImage(m_textures[index]);
+        VulkanBindlessTable* bindless_table = m_bindless_table;
+        m_deletion_queue->pushAfterFrame(getLastUseFrame(), [bindless_table, bindless_id]() {
+            bindless_table->releaseTexture(bindless_id);
+        });
+
+        // swap with the last texture to keep the array dense
+        m_texture_by_bindless_id[bindless_id] = UINT32_MAX;
+        if (index + 1 != m_textures.size())
+        {
+            m_textures[index] = std::move(m_textures.back());
+            m_texture_by_bindless_id[m_textures[index].bindless_id] = index;
+        }
+        m_textures.pop_back();
+    }
+
+    void VulkanTextureStreamer::requestLevel(uint32_t bindless_id, uint32_t level)
+    {
+        if (bindless_id >= m_texture_by_bindless_id.size() || m_texture_by_bindless_id[bindless_id] == UINT32_MAX)
+        {
+            return;
+        }
+        StreamedTexture& texture = m_textures[m_texture_by_bindless_id[bindless_id]];
+        texture.requested_level = std::min(texture.requested_level, level);
+    }
+
+    void VulkanTextureStreamer::requestForObject(uint32_t bindless_id, const Vec3& center, float radius, const Vec3& camera_position, float projection_scale)
+    {
+        if (bindless_id >= m_texture_by_bindless_id.size() || m_texture_by_bindless_id[bindless_id] == UINT32_MAX)
+        {
+            return;
+        }
+        const TextureAsset& asset = m_textures[m_texture_by_bindless_id[bindless_id]].asset;
+
+        // assumes the texture is spread once over the object, so its size on screen is the object size
+        float distance = std::max(glm::length(center - camera_position) - radius, 1e-3f);
+        float projected_pixels = std::max(2.0f * radius * projection_scale / distance, 1.0f);
+        float texels_per_pixel = static_cast<float>(std::max(asset.width, asset.height)) / projected_pixels;
+        uint32_t level = texels_per_pixel > 1.0f ? static_cast<uint32_t>(std::floor(std::log2(texels_per_pixel))) : 0;
+        requestLevel(bindless_id, level);
+    }
+
+    void VulkanTextureStreamer::update()
+    {
+        m_frame_index++;
+
+        // requested textures want their requested level, the rest keep what they have
+        std::vector<uint32_t> target_levels(m_textures.size());
+        VkDeviceSize target_bytes = 0;
+        for (size_t i = 0; i < m_textures.size(); i++)
+        {
+            StreamedTexture& texture = m_textures[i];
+            if (texture.requested_level != UINT32_MAX)
+            {
+                texture.last_used_frame = m_frame_index;
+                target_levels[i] = std::min(texture.requested_level, texture.tail_level);
+            }
+            else
+            {
+                target_levels[i] = texture.resident_level;
+            }
+            texture.requested_level = UINT32_MAX;
+            target_bytes += getLevelRangeBytes(texture, target_levels[i]);
+        }
+
+        // over budget: drop the finest mips of the least recently used textures first
+        std::vector<uint32_t> order(m_textures.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+            return m_textures[a].last_used_frame < m_textures[b].last_used_frame;
+        });
+        for (uint32_t i : order)
+        {
+            StreamedTexture& texture = m_textures[i];
+            while (target_bytes > m_budget_bytes && target_levels[i] < texture.tail_level)
+            {
+                target_bytes -= texture.asset.levels[target_levels[i]].size;
+                target_levels[i]++;
+            }
+        }
+
+        // evictions only copy on the gpu and free memory, apply them all before any upload
+        for (size_t i = 0; i < m_textures.size(); i++)
+        {
+            if (target_levels[i] > m_textures[i].resident_level)
+            {
+                makeResident(m_textures[i], target_levels[i]);
+            }
+        }
+
+        // most recently used textures upload first, at least one upload per frame so large levels still land
+        VkDeviceSize uploaded_bytes = 0;
+        for (auto it = order.rbegin(); it != order.rend(); ++it)
+        {
+            StreamedTexture& texture = m_textures[*it];
+            if (target_levels[*it] >= texture.resident_level)
+            {
+                continue;
+            }
+            // the levels already resident are copied on the gpu
+            VkDeviceSize upload_bytes = getLevelRangeBytes(texture, target_levels[*it]) - getLevelRangeBytes(texture, texture.resident_level);
+            if (uploaded_bytes > 0 && uploaded_bytes + upload_bytes > m_upload_bytes_per_frame)
+            {
+                break;
+            }
+            if (!makeResident(texture, target_levels[*it]))
+            {
+                break;
+            }
+            uploaded_bytes += upload_bytes;
+        }
+    }
+
+    VkDeviceSize VulkanTextureStreamer::getLevelRangeBytes(const StreamedTexture& texture, uint32_t first_level) const
+    {
+        VkDeviceSize bytes = 0;
+        for (size_t level = first_level; level < texture.asset.levels.size(); level++)
+        {
+            bytes += texture.asset.levels[level].size;
+        }
+        return bytes;
+    }
+
+    bool VulkanTextureStreamer::makeResident(StreamedTexture& texture, uint32_t first_level, bool required)
+    {
+        const TextureAsset& asset = texture.asset;
+        const TextureLevel& top = asset.levels[first_level];
+        uint32_t level_count = static_cast<uint32_t>(asset.levels.size()) - first_level;
+        VkFormat format = static_cast<VkFormat>(asset.vk_format);
+
+        StreamedTextureCopy copy{};
+        copy.level_count = level_count;
+
+        // levels the current image holds are copied over, only the finer ones are uploaded
+        bool has_image = texture.image != VK_NULL_HANDLE;
+        uint32_t upload_end = has_image ? std::max(texture.resident_level, first_level) : static_cast<uint32_t>(asset.levels.size());
+        if (first_level < upload_end)
+        {
+            // the uploaded levels are one contiguous range of the cooked data, smallest level first
+            size_t base = asset.levels[upload_end - 1].offset;
+            size_t end = top.offset + top.size;
+            VkDeviceSize staging_offset = 0;
+            void* staging_data = nullptr;
+            if (!allocateStaging(end - base, required, copy.staging_buffer, staging_offset, staging_data))
+            {
+                return false;
+            }
+            SHERPHY_MEMCPY(staging_data, asset.data.data() + base, end - base);
+
+            for (uint32_t level = first_level; level < upload_end; level++)
+            {
+                const TextureLevel& source = asset.levels[level];
+                VkBufferImageCopy region{};
+                region.bufferOffset = staging_offset + source.offset - base;
+                region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - first_level, 0, 1 };
+                region.imageExtent = { source.width, source.height, 1 };
+                copy.buffer_copies.push_back(region);
+            }
+        }
+        if (has_image)
+        {
+            copy.source_image = texture.image;
+            copy.source_level_count = static_cast<uint32_t>(asset.levels.size()) - texture.resident_level;
+            for (uint32_t level = upload_end; level < asset.levels.size(); level++)
+            {
+                const TextureLevel& source = asset.levels[level];
+                VkImageCopy region{};
+                region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - texture.resident_level, 0, 1 };
+                region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - first_level, 0, 1 };
+                region.extent = { source.width, source.height, 1 };
+                copy.image_copies.push_back(region);
+            }
+        }
+
+        VkImageCreateInfo image_info{};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.extent = { top.width, top.height, 1 };
+        image_info.mipLevels = level_count;
+        image_info.arrayLayers = 1;
+        image_info.format = format;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        image_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VkImage image;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateImage(m_device->m_logical_device, &image_info, nullptr, &image) == VK_SUCCESS, "failed to create streamed image!");
+
+        VkMemoryRequirements mem_requirements;
+        vkGetImageMemoryRequirements(m_device->m_logical_device, image, &mem_requirements);
+
+        VkMemoryAllocateInfo alloc_info{};
+        alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        alloc_info.allocationSize = mem_requirements.size;
+        alloc_info.memoryTypeIndex = m_device->findMemoryType(mem_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        VkDeviceMemory memory;
+        SHERPHY_EXCEPTION_IF_FALSE(vkAllocateMemory(m_device->m_logical_device, &alloc_info, nullptr, &memory) == VK_SUCCESS, "failed to allocate streamed image memory!");
+        vkBindImageMemory(m_device->m_logical_device, image, memory, 0);
+
+        VkImageViewCreateInfo view_info{};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = format;
+        view_info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, level_count, 0, 1 };
+
+        VkImageView image_view;
+        SHERPHY_EXCEPTION_IF_FALSE(vkCreateImageView(m_device->m_logical_device, &view_info, nullptr, &image_view) == VK_SUCCESS, "failed to create streamed image view!");
+
+        copy.image = image;
+        m_pending_copies.push_back(std::move(copy));
+
+        // the slot reaches this frame's set in beginFrame, after the copies were recorded ahead of the sampling passes;
+        // the old image is read by those copies and retired with the frames in flight
+        if (has_image)
+        {
+            retireImage(texture);
+        }
+        texture.image = image;
+        texture.memory = memory;
+        texture.image_view = image_view;
+        texture.resident_level = first_level;
+        texture.resident_bytes = mem_requirements.size;
+        m_resident_bytes += texture.resident_bytes;
+        if (has_image)
+        {
+            m_bindless_table->updateTexture(texture.bindless_id, texture.image_view, texture.sampler);
+        }
+        return true;
+    }
+
+    bool VulkanTextureStreamer::allocateStaging(VkDeviceSize size, bool required, VkBuffer& buffer, VkDeviceSize& offset, void*& mapped)
+    {
+        VkDeviceSize aligned_size = (size + k_staging_alignment - 1) / k_staging_alignment * k_staging_alignment;
+        if (m_staging_used == 0)
+        {
+            m_staging_head = 0;
+        }
+        // a range never wraps, the bytes left at the end go with it
+        VkDeviceSize begin = m_staging_head;
+        VkDeviceSize skipped = 0;
+        if (begin + aligned_size > m_staging_capacity)
+        {
+            skipped = m_staging_capacity - begin;
+            begin = 0;
+        }
+        if (m_staging_used + skipped + aligned_size <= m_staging_capacity)
+        {
+            VkDeviceSize reserved = skipped + aligned_size;
+            m_staging_used += reserved;
+            m_staging_head = begin + aligned_size;
+            // frames finish in order, so the ring always frees from the oldest range
+            m_deletion_queue->push([this, reserved]() {
+                m_staging_used -= reserved;
+            });
+            buffer = m_staging_buffer.buffer;
+            offset = begin;
+            mapped = static_cast<uint8_t*>(m_staging_buffer.mapped) + begin;
+            return true;
+        }
+        if (!required && aligned_size <= m_staging_capacity)
+        {
+            return false;
+        }
+
+        VulkanBuffer staging_buffer;
+        SHERPHY_ASSERT(m_device->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer), VK_SUCCESS, "");
+        SHERPHY_ASSERT(staging_buffer.map(), VK_SUCCESS, "");
+        m_deletion_queue->destroyBuffer(staging_buffer, m_deletion_queue->getFrameNumber());
+        buffer = staging_buffer.buffer;
+        offset = 0;
+        mapped = staging_buffer.mapped;
+        return true;
+    }
+
+    // one change after the other, a change may copy from the image an earlier one of the frame filled
+    void VulkanTextureStreamer::recordCopies(VkCommandBuffer command_buffer)
+    {
+        for (const StreamedTextureCopy& copy : m_pending_copies)
+        {
+            VkImageMemoryBarrier barriers[2]{};
+            for (VkImageMemoryBarrier& barrier : barriers)
+            {
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            }
+            uint32_t barrier_count = copy.source_image != VK_NULL_HANDLE ? 2 : 1;
+
+            barriers[0].image = copy.image;
+            barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, copy.level_count, 0, 1 };
+            barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barriers[0].srcAccessMask = 0;
+            barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            // earlier frames may still sample the source
+            barriers[1].image = copy.source_image;
+            barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, copy.source_level_count, 0, 1 };
+            barriers[1].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0, 0, nullptr, 0, nullptr, barrier_count, barriers);
+
+            if (!copy.buffer_copies.empty())
+            {
+                vkCmdCopyBufferToImage(command_buffer, copy.staging_buffer, copy.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    static_cast<uint32_t>(copy.buffer_copies.size()), copy.buffer_copies.data());
+            }
+            if (!copy.image_copies.empty())
+            {
+                vkCmdCopyImage(command_buffer, copy.source_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, copy.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    static_cast<uint32_t>(copy.image_copies.size()), copy.image_copies.data());
+            }
+
+            barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+            barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barriers[1].srcAccessMask = 0;
+            barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0, 0, nullptr, 0, nullptr, barrier_count, barriers);
+        }
+        m_pending_copies.clear();
+    }
+
+    void VulkanTextureStreamer::retireImage(StreamedTexture& texture)
+    {
+        m_deletion_queue->destroyImage(texture.image, texture.memory, texture.image_view, getLastUseFrame());
+        m_resident_bytes -= texture.resident_bytes;
+        texture.image = VK_NULL_HANDLE;
+        texture.memory = VK_NULL_HANDLE;
+        texture.image_view = VK_NULL_HANDLE;
+        texture.resident_bytes = 0;
+    }
+
+    // a rewritten bindless slot reaches each frame slot when that slot begins its next
+    // frame, so the old image may be sampled until every frame slot was recorded once more
+    uint64_t VulkanTextureStreamer::getLastUseFrame() const
+    {
+        return m_deletion_queue->getFrameNumber() + m_frame_count - 1;
+    }
+
+    void VulkanTextureStreamer::destroy()
+    {
+        if (!isInitialized())
+        {
+            return;
+        }
+        for (StreamedTexture& texture : m_textures)
+        {
+            if (texture.image != VK_NULL_HANDLE)
+            {
+                retireImage(texture);
+            }
+        }
+        m_textures.clear();
+        m_pending_copies.clear();
+        m_deletion_queue->destroyBuffer(m_staging_buffer, m_deletion_queue->getFrameNumber());
+        m_staging_buffer = {};
+    }
+}
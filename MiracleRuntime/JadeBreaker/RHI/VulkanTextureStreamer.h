@@ -0,0 +1,111 @@
+#pragma once
+#include "RenderingMath.h"
+#include "VulkanBindlessTable.h"
+#include "VulkanDeletionQueue.h"
+#include "VulkanDevice.h"
+#include "Resource/TextureCooker.h"
+
+#include <vector>
+
+namespace Sherphy
+{
+	// a cooked texture with the mip range currently on the gpu
+	struct StreamedTexture
+	{
+		TextureAsset asset; // every cooked level stays in system memory
+		VkSampler sampler = VK_NULL_HANDLE;
+		uint32_t bindless_id = 0;
+
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView image_view = VK_NULL_HANDLE;
+		VkDeviceSize resident_bytes = 0;
+
+		uint32_t resident_level = 0;  // finest level on the gpu, every coarser level is resident too
+		uint32_t tail_level = 0;      // levels from here on are never evicted
+		uint32_t requested_level = 0; // finest level any object asked for this frame
+		uint64_t last_used_frame = 0;
+	};
+
+	// the copies that fill the new image of a residency change, recorded into the frame
+	struct StreamedTextureCopy
+	{
+		VkImage image = VK_NULL_HANDLE;
+		uint32_t level_count = 0;
+		// finer levels come from the staging buffer
+		VkBuffer staging_buffer = VK_NULL_HANDLE;
+		std::vector<VkBufferImageCopy> buffer_copies;
+		// levels the previous image already held are copied from it on the gpu
+		VkImage source_image = VK_NULL_HANDLE;
+		uint32_t source_level_count = 0;
+		std::vector<VkImageCopy> image_copies;
+	};
+
+	// Streams mip levels of bindless textures. Every texture starts with only its
+	// small mip tail resident. Each frame objects request the finest level they
+	// need, computed on the cpu from their distance and screen size; requested
+	// levels are uploaded within a per frame byte budget. When the resident set
+	// would exceed the memory budget, the finest mips of the least recently used
+	// textures are dropped first. A residency change builds a new image holding
+	// the resident range and swaps the bindless slot; the old image waits in the
+	// deletion queue until no frame in flight can sample it. Nothing blocks: the
+	// copies are recorded into the frame ahead of every pass that samples, levels
+	// the old image holds are copied on the gpu and only finer levels are staged,
+	// through a ring whose regions are reused once their frame finished.
+	struct VulkanTextureStreamer
+	{
+		static const uint32_t k_tail_size = 64; // mips up to this size are always resident
+		static const VkDeviceSize k_staging_alignment = 16; // copy offsets are multiples of the texel block
+
+		VulkanDevice* m_device = nullptr;
+		VulkanBindlessTable* m_bindless_table = nullptr;
+		VulkanDeletionQueue* m_deletion_queue = nullptr;
+		uint32_t m_frame_count = 0;
+		uint64_t m_frame_index = 0;
+
+		VkDeviceSize m_budget_bytes = 0;
+		VkDeviceSize m_upload_bytes_per_frame = 0;
+		VkDeviceSize m_resident_bytes = 0;
+
+		std::vector<StreamedTexture> m_textures;
+		std::vector<uint32_t> m_texture_by_bindless_id;
+
+		// host visible and mapped, the used range runs from head - used to head with wrap around
+		VulkanBuffer m_staging_buffer;
+		VkDeviceSize m_staging_capacity = 0;
+		VkDeviceSize m_staging_head = 0;
+		VkDeviceSize m_staging_used = 0;
+		std::vector<StreamedTextureCopy> m_pending_copies;
+
+		bool isInitialized() const { return m_device != nullptr; }
+		void init(VulkanDevice* device,
+				  VulkanBindlessTable* bindless_table,
+				  VulkanDeletionQueue* deletion_queue,
+				  uint32_t frame_count,
+				  VkDeviceSize budget_bytes,
+				  VkDeviceSize upload_bytes_per_frame,
+				  VkDeviceSize staging_bytes);
+		// returns the bindless texture id, only the mip tail is uploaded here
+		uint32_t addTexture(TextureAsset&& asset, VkSampler sampler);
+		// frees the gpu image and the bindless slot once no frame in flight can sample them
+		void removeTexture(uint32_t bindless_id);
+		void requestLevel(uint32_t bindless_id, uint32_t level);
+		// level that gives about one texel per pixel for an object of the given bounding
+		// sphere, projection_scale is proj[1][1] * viewport height / 2
+		void requestForObject(uint32_t bindless_id, const Vec3& center, float radius, const Vec3& camera_position, float projection_scale);
+		// call once per frame after the frame slot was waited on
+		void update();
+		bool hasPendingCopies() const { return !m_pending_copies.empty(); }
+		// a graphics pass of the frame the residency changes were made in, ahead of every pass sampling the textures
+		void recordCopies(VkCommandBuffer command_buffer);
+		void destroy();
+
+		VkDeviceSize getLevelRangeBytes(const StreamedTexture& texture, uint32_t first_level) const;
+		// false when the staging ring has no room this frame, a new texture always gets its levels
+		bool makeResident(StreamedTexture& texture, uint32_t first_level, bool required = false);
+		// a region of the ring, or a buffer of its own when the size never fits or a required one does not fit now
+		bool allocateStaging(VkDeviceSize size, bool required, VkBuffer& buffer, VkDeviceSize& offset, void*& mapped);
+		void retireImage(StreamedTexture& texture);
+		uint64_t getLastUseFrame() const;
+	};
+}
@@ -0,0 +1,184 @@
+#include "VulkanTimelineSync.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <volk.h>
+
+namespace Sherphy
+{
+    void VulkanTimelineSync::init(VkDevice logical_device, VkQueue graphics_queue, VkQueue compute_queue, VkQueue transfer_queue)
+    {
+        m_logical_device = logical_device;
+        VkQueue queues[] = { graphics_queue, compute_queue, transfer_queue };
+
+        VkSemaphoreTypeCreateInfo type_info{};
+        type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        type_info.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphore_info{};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphore_info.pNext = &type_info;
+
+        for (uint32_t i = 0; i < static_cast<uint32_t>(QueueType::Count); i++)
+        {
+            m_timelines[i].queue = queues[i];
+            m_timelines[i].last_submitted = 0;
+            m_timelines[i].last_completed = 0;
+            SHERPHY_EXCEPTION_IF_FALSE(vkCreateSemaphore(m_logical_device, &semaphore_info, nullptr, &m_timelines[i].semaphore) == VK_SUCCESS, "failed to create timeline semaphore!");
+        }
+    }
+
+    TimelinePoint VulkanTimelineSync::submit(QueueType queue_type,
+                                             const std::vector<VkCommandBuffer>& command_buffers,
+                                             const std::vector<TimelineWait>& waits,
+                                             const std::vector<BinarySemaphoreWait>& binary_waits,
+                                             const std::vector<VkSemaphore>& binary_signals)
+    {
+        QueueTimeline& timeline = getTimeline(queue_type);
+        TimelinePoint signal_point{ queue_type, timeline.last_submitted + 1 };
+
+        // values of binary semaphores are ignored but the arrays must line up with the semaphores
+        std::vector<VkSemaphore> wait_semaphores;
+        std::vector<uint64_t> wait_values;
+        std::vector<VkPipelineStageFlags> wait_stages;
+        for (const TimelineWait& wait : waits)
+        {
+            if (wait.point.value == 0)
+            {
+                continue;
+            }
+            wait_semaphores.push_back(getTimeline(wait.point.queue).semaphore);
+            wait_values.push_back(wait.point.value);
+            wait_stages.push_back(wait.stage);
+        }
+        for (const BinarySemaphoreWait& wait : binary_waits)
+        {
+            wait_semaphores.push_back(wait.semaphore);
+            wait_values.push_back(0);
+            wait_stages.push_back(wait.stage);
+        }
+
+        std::vector<VkSemaphore> signal_semaphores = { timeline.semaphore };
+        std::vector<uint64_t> signal_values = { signal_point.value };
+        for (VkSemaphore semaphore : binary_signals)
+        {
+            signal_semaphores.push_back(semaphore);
+            signal_values.push_back(0);
+        }
+
+        VkTimelineSemaphoreSubmitInfo timeline_info{};
+        timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timeline_info.waitSemaphoreValueCount = static_cast<uint32_t>(wait_values.size());
+        timeline_info.pWaitSemaphoreValues = wait_values.data();
+        timeline_info.signalSemaphoreValueCount = static_cast<uint32_t>(signal_values.size());
+        timeline_info.pSignalSemaphoreValues = signal_values.data();
+
+        VkSubmitInfo submit_info{};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.pNext = &timeline_info;
+        submit_info.waitSemaphoreCount = static_cast<uint32_t>(wait_semaphores.size());
+        submit_info.pWaitSemaphores = wait_semaphores.data();
+        submit_info.pWaitDstStageMask = wait_stages.data();
+        submit_info.commandBufferCount = static_cast<uint32_t>(command_buffers.size());
+        submit_info.pCommandBuffers = command_buffers.data();
+        submit_info.signalSemaphoreCount = static_cast<uint32_t>(signal_semaphores.size());
+        submit_info.pSignalSemaphores = signal_semaphores.data();
+        SHERPHY_EXCEPTION_IF_FALSE(vkQueueSubmit(timeline.queue, 1, &submit_info, VK_NULL_HANDLE) == VK_SUCCESS, "failed to submit to queue timeline!");
+
+        timeline.last_submitted = signal_point.value;
+        return signal_point;
+    }
+
+    TimelinePoint VulkanTimelineSync::getLastSubmitted(QueueType queue_type) const
+    {
+        return TimelinePoint{ queue_type, getTimeline(queue_type).last_submitted };
+    }
+
+    VkQueue VulkanTimelineSync::getQueue(QueueType queue_type) const
+    {
+        return getTimeline(queue_type).queue;
+    }
+
+    uint64_t VulkanTimelineSync::getCompletedValue(QueueType queue_type)
+    {
+        QueueTimeline& timeline = getTimeline(queue_type);
+        uint64_t value = 0;
+        if (vkGetSemaphoreCounterValue(m_logical_device, timeline.semaphore, &value) == VK_SUCCESS && value > timeline.last_completed)
+        {
+            timeline.last_completed = value;
+        }
+        return timeline.last_completed;
+    }
+
+    bool VulkanTimelineSync::isComplete(const TimelinePoint& point)
+    {
+        if (point.value <= getTimeline(point.queue).last_completed)
+        {
+            return true;
+        }
+        return point.value <= getCompletedValue(point.queue);
+    }
+
+    void VulkanTimelineSync::wait(const TimelinePoint& point)
+    {
+        wait(std::vector<TimelinePoint>{ point });
+    }
+
+    void VulkanTimelineSync::wait(const std::vector<TimelinePoint>& points)
+    {
+        std::vector<VkSemaphore> semaphores;
+        std::vector<uint64_t> values;
+        for (const TimelinePoint& point : points)
+        {
+            if (isComplete(point))
+            {
+                continue;
+            }
+            semaphores.push_back(getTimeline(point.queue).semaphore);
+            values.push_back(point.value);
+        }
+        if (semaphores.empty())
+        {
+            return;
+        }
+
+        VkSemaphoreWaitInfo wait_info{};
+        wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        wait_info.semaphoreCount = static_cast<uint32_t>(semaphores.size());
+        wait_info.pSemaphores = semaphores.data();
+        wait_info.pValues = values.data();
+        SHERPHY_EXCEPTION_IF_FALSE(vkWaitSemaphores(m_logical_device, &wait_info, UINT64_MAX) == VK_SUCCESS, "failed to wait on queue timeline!");
+        for (const TimelinePoint& point : points)
+        {
+            QueueTimeline& timeline = getTimeline(point.queue);
+            if (point.value > timeline.last_completed)
+            {
+                timeline.last_completed = point.value;
+            }
+        }
+    }
+
+    void VulkanTimelineSync::waitIdle()
+    {
+        std::vector<TimelinePoint> points;
+        for (uint32_t i = 0; i < static_cast<uint32_t>(QueueType::Count); i++)
+        {
+            points.push_back(getLastSubmitted(static_cast<QueueType>(i)));
+        }
+        wait(points);
+    }
+
+    void VulkanTimelineSync::destroy()
+    {
+        if (!isInitialized())
+        {
+            return;
+        }
+        for (QueueTimeline& timeline : m_timelines)
+        {
+            vkDestroySemaphore(m_logical_device, timeline.semaphore, nullptr);
+            timeline.semaphore = VK_NULL_HANDLE;
+        }
+        m_logical_device = VK_NULL_HANDLE;
+    }
+}
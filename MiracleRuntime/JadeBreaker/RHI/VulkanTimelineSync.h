@@ -0,0 +1,75 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+namespace Sherphy
+{
+	enum class QueueType : uint32_t
+	{
+		Graphics = 0,
+		Compute,
+		Transfer,
+		Count
+	};
+
+	// a value on the timeline of a queue, reached once every submission up to it finished
+	struct TimelinePoint
+	{
+		QueueType queue = QueueType::Graphics;
+		uint64_t value = 0; // 0 is reached from the start
+	};
+
+	struct TimelineWait
+	{
+		TimelinePoint point;
+		VkPipelineStageFlags stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	};
+
+	// binary semaphores are still needed for the swapchain, they ride along in a timeline submit
+	struct BinarySemaphoreWait
+	{
+		VkSemaphore semaphore = VK_NULL_HANDLE;
+		VkPipelineStageFlags stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	};
+
+	// One timeline semaphore per queue type, counting up with every submit to it.
+	// A submit returns the point it signals; the cpu waits on points instead of
+	// fences and other queues wait on them through the submit, so transfer,
+	// compute and graphics work can depend on each other without fence objects.
+	// Queue types without a dedicated queue share the graphics queue but keep
+	// their own timeline.
+	struct VulkanTimelineSync
+	{
+		struct QueueTimeline
+		{
+			VkQueue queue = VK_NULL_HANDLE;
+			VkSemaphore semaphore = VK_NULL_HANDLE;
+			uint64_t last_submitted = 0;
+			uint64_t last_completed = 0; // cached, only grows
+		};
+
+		VkDevice m_logical_device = VK_NULL_HANDLE;
+		QueueTimeline m_timelines[static_cast<uint32_t>(QueueType::Count)];
+
+		bool isInitialized() const { return m_logical_device != VK_NULL_HANDLE; }
+		void init(VkDevice logical_device, VkQueue graphics_queue, VkQueue compute_queue, VkQueue transfer_queue);
+		TimelinePoint submit(QueueType queue_type,
+							 const std::vector<VkCommandBuffer>& command_buffers,
+							 const std::vector<TimelineWait>& waits = {},
+							 const std::vector<BinarySemaphoreWait>& binary_waits = {},
+							 const std::vector<VkSemaphore>& binary_signals = {});
+		// reached once everything submitted to the queue type so far finished
+		TimelinePoint getLastSubmitted(QueueType queue_type) const;
+		VkQueue getQueue(QueueType queue_type) const;
+		uint64_t getCompletedValue(QueueType queue_type);
+		bool isComplete(const TimelinePoint& point);
+		void wait(const TimelinePoint& point);
+		void wait(const std::vector<TimelinePoint>& points);
+		void waitIdle();
+		void destroy();
+
+		QueueTimeline& getTimeline(QueueType queue_type) { return m_timelines[static_cast<uint32_t>(queue_type)]; }
+		const QueueTimeline& getTimeline(QueueType queue_type) const { return m_timelines[static_cast<uint32_t>(queue_type)]; }
+	};
+}
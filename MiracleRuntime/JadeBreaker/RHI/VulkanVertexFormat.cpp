@@ -0,0 +1,217 @@
+#include "VulkanVertexFormat.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <gtc/packing.hpp>
+
+#include <cmath>
+
+namespace Sherphy
+{
+    // the unit octahedron unfolded onto [-1, 1]^2, the lower half folds over the diagonals
+    static Vec2 encodeOctahedral(const Vec3& direction)
+    {
+        float length = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+        if (length <= 0.0f)
+        {
+            return Vec2(0.0f);
+        }
+        Vec3 normal = direction / length;
+        if (normal.z >= 0.0f)
+        {
+            return Vec2(normal.x, normal.y);
+        }
+        return Vec2((1.0f - std::abs(normal.y)) * (normal.x >= 0.0f ? 1.0f : -1.0f),
+                    (1.0f - std::abs(normal.x)) * (normal.y >= 0.0f ? 1.0f : -1.0f));
+    }
+
+    VulkanVertexFormat VulkanVertexFormat::create(const std::vector<std::pair<VertexAttribute, VertexEncoding>>& elements)
+    {
+        VulkanVertexFormat format;
+        for (const auto& element : elements)
+        {
+            SHERPHY_EXCEPTION_IF_FALSE((format.find(element.first) == nullptr), "vertex format lists an attribute twice");
+            SHERPHY_EXCEPTION_IF_FALSE((element.second != VertexEncoding::QuantizedPosition || element.first == VertexAttribute::Position), "only positions can be quantized");
+            format.m_elements.push_back({ element.first, element.second, format.m_stride });
+            format.m_stride += getSize(element.second);
+        }
+        return format;
+    }
+
+    VulkanVertexFormat VulkanVertexFormat::createFloat()
+    {
+        return create({
+            { VertexAttribute::Position, VertexEncoding::Float3 },
+            { VertexAttribute::Color, VertexEncoding::Float3 },
+            { VertexAttribute::TexCoord, VertexEncoding::Float2 }
+        });
+    }
+
+    VulkanVertexFormat VulkanVertexFormat::createCompressed()
+    {
+        return create({
+            { VertexAttribute::Position, VertexEncoding::QuantizedPosition },
+            { VertexAttribute::Normal, VertexEncoding::Octahedral },
+            { VertexAttribute::Tangent, VertexEncoding::OctahedralSigned },
+            { VertexAttribute::TexCoord, VertexEncoding::Half2 }
+        });
+    }
+
+    VkFormat VulkanVertexFormat::getFormat(VertexEncoding encoding)
+    {
+        switch (encoding)
+        {
+        case VertexEncoding::Float2:
+            return VK_FORMAT_R32G32_SFLOAT;
+        case VertexEncoding::Float3:
+            return VK_FORMAT_R32G32B32_SFLOAT;
+        case VertexEncoding::QuantizedPosition:
+            return VK_FORMAT_R16G16B16A16_SNORM;
+        case VertexEncoding::Octahedral:
+            return VK_FORMAT_R16G16_SNORM;
+        case VertexEncoding::OctahedralSigned:
+            return VK_FORMAT_R8G8B8A8_SNORM;
+        case VertexEncoding::Half2:
+            return VK_FORMAT_R16G16_SFLOAT;
+        case VertexEncoding::Unorm4x8:
+            return VK_FORMAT_R8G8B8A8_UNORM;
+        }
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    uint32_t VulkanVertexFormat::getSize(VertexEncoding encoding)
+    {
+        switch (encoding)
+        {
+        case VertexEncoding::Float2:
+            return 8;
+        case VertexEncoding::Float3:
+            return 12;
+        case VertexEncoding::QuantizedPosition:
+            return 8;
+        case VertexEncoding::Octahedral:
+        case VertexEncoding::OctahedralSigned:
+        case VertexEncoding::Half2:
+        case VertexEncoding::Unorm4x8:
+            return 4;
+        }
+        return 0;
+    }
+
+    const VertexElement* VulkanVertexFormat::find(VertexAttribute attribute) const
+    {
+        for (const VertexElement& element : m_elements)
+        {
+            if (element.attribute == attribute)
+            {
+                return &element;
+            }
+        }
+        return nullptr;
+    }
+
+    // snorm positions span [-1, 1], so the offset is the center of the bounds and the scale half their size
+    VertexQuantization VulkanVertexFormat::getQuantization(const Vertex* vertices, size_t count) const
+    {
+        VertexQuantization quantization{};
+        const VertexElement* position = find(VertexAttribute::Position);
+        if (position == nullptr || position->encoding != VertexEncoding::QuantizedPosition || count == 0)
+        {
+            return quantization;
+        }
+        Vec3 min_pos = vertices[0].pos;
+        Vec3 max_pos = vertices[0].pos;
+        for (size_t i = 1; i < count; i++)
+        {
+            min_pos = glm::min(min_pos, vertices[i].pos);
+            max_pos = glm::max(max_pos, vertices[i].pos);
+        }
+        Vec3 half_extent = (max_pos - min_pos) * 0.5f;
+        // a flat axis keeps a unit scale, every position on it decodes to the center
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (half_extent[axis] <= 0.0f)
+            {
+                half_extent[axis] = 1.0f;
+            }
+        }
+        quantization.position_offset = Vec4((min_pos + max_pos) * 0.5f, 0.0f);
+        quantization.position_scale = Vec4(half_extent, 1.0f);
+        return quantization;
+    }
+
+    void VulkanVertexFormat::encode(const Vertex* vertices, size_t count, const VertexQuantization& quantization, uint8_t* destination) const
+    {
+        Vec3 position_offset = Vec3(quantization.position_offset);
+        Vec3 inverse_scale = 1.0f / Vec3(quantization.position_scale);
+        for (size_t i = 0; i < count; i++)
+        {
+            const Vertex& vertex = vertices[i];
+            uint8_t* vertex_data = destination + i * m_stride;
+            for (const VertexElement& element : m_elements)
+            {
+                Vec4 value{ 0.0f };
+                switch (element.attribute)
+                {
+                case VertexAttribute::Position:
+                    value = Vec4(vertex.pos, 1.0f);
+                    break;
+                case VertexAttribute::Normal:
+                    value = Vec4(vertex.normal, 0.0f);
+                    break;
+                case VertexAttribute::Tangent:
+                    value = vertex.tangent;
+                    break;
+                case VertexAttribute::TexCoord:
+                    value = Vec4(vertex.tex_coord, 0.0f, 0.0f);
+                    break;
+                case VertexAttribute::Color:
+                    value = Vec4(vertex.color, 1.0f);
+                    break;
+                }
+
+                uint8_t* element_data = vertex_data + element.offset;
+                switch (element.encoding)
+                {
+                case VertexEncoding::Float2:
+                    SHERPHY_MEMCPY(element_data, &value, sizeof(float) * 2);
+                    break;
+                case VertexEncoding::Float3:
+                    SHERPHY_MEMCPY(element_data, &value, sizeof(float) * 3);
+                    break;
+                case VertexEncoding::QuantizedPosition:
+                {
+                    Vec3 relative = (Vec3(value) - position_offset) * inverse_scale;
+                    uint64_t packed = glm::packSnorm4x16(Vec4(relative, 1.0f));
+                    SHERPHY_MEMCPY(element_data, &packed, sizeof(packed));
+                    break;
+                }
+                case VertexEncoding::Octahedral:
+                {
+                    uint32_t packed = glm::packSnorm2x16(encodeOctahedral(Vec3(value)));
+                    SHERPHY_MEMCPY(element_data, &packed, sizeof(packed));
+                    break;
+                }
+                case VertexEncoding::OctahedralSigned:
+                {
+                    Vec2 octahedral = encodeOctahedral(Vec3(value));
+                    uint32_t packed = glm::packSnorm4x8(Vec4(octahedral, 0.0f, value.w < 0.0f ? -1.0f : 1.0f));
+                    SHERPHY_MEMCPY(element_data, &packed, sizeof(packed));
+                    break;
+                }
+                case VertexEncoding::Half2:
+                {
+                    uint32_t packed = glm::packHalf2x16(Vec2(value));
+                    SHERPHY_MEMCPY(element_data, &packed, sizeof(packed));
+                    break;
+                }
+                case VertexEncoding::Unorm4x8:
+                {
+                    uint32_t packed = glm::packUnorm4x8(value);
+                    SHERPHY_MEMCPY(element_data, &packed, sizeof(packed));
+                    break;
+                }
+                }
+            }
+        }
+    }
+}
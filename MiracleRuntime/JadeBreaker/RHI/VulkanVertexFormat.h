@@ -0,0 +1,69 @@
+#pragma once
+#include "RenderingMath.h"
+
+#include <utility>
+#include <vector>
+
+namespace Sherphy
+{
+	// what a vertex shader input reads, the value is its input location
+	enum class VertexAttribute : uint32_t
+	{
+		Position = 0,
+		Normal = 1,
+		Tangent = 2,
+		TexCoord = 3,
+		Color = 4
+	};
+
+	enum class VertexEncoding : uint32_t
+	{
+		Float2,            // R32G32_SFLOAT
+		Float3,            // R32G32B32_SFLOAT
+		QuantizedPosition, // R16G16B16A16_SNORM relative to the bounds of the mesh, w is 1
+		Octahedral,        // R16G16_SNORM octahedral unit vector
+		OctahedralSigned,  // R8G8B8A8_SNORM octahedral unit vector in xy, the sign of w in w
+		Half2,             // R16G16_SFLOAT
+		Unorm4x8           // R8G8B8A8_UNORM, w is 1
+	};
+
+	struct VertexElement
+	{
+		VertexAttribute attribute;
+		VertexEncoding encoding;
+		uint32_t offset;
+	};
+
+	// mesh space position = offset + decoded position * scale, mirrors the tail of GPUMesh
+	struct VertexQuantization
+	{
+		Vec4 position_offset{ 0.0f };
+		Vec4 position_scale{ 1.0f };
+	};
+
+	// An interleaved vertex layout described as data. Source vertices are encoded
+	// into it once at upload, and the pipeline vertex input is generated from it:
+	// every input location of the vertex shader reads the element of the same
+	// attribute, whatever encoding and offset the format gives it.
+	struct VulkanVertexFormat
+	{
+		std::vector<VertexElement> m_elements;
+		uint32_t m_stride = 0;
+
+		// elements are packed in the given order, every encoding is a multiple of 4 bytes
+		static VulkanVertexFormat create(const std::vector<std::pair<VertexAttribute, VertexEncoding>>& elements);
+		// 32 bytes, float position, color and uv; the path tracer reads this layout
+		static VulkanVertexFormat createFloat();
+		// 20 bytes, quantized position, octahedral normal and tangent, half float uv
+		static VulkanVertexFormat createCompressed();
+		static VkFormat getFormat(VertexEncoding encoding);
+		static uint32_t getSize(VertexEncoding encoding);
+
+		bool isEmpty() const { return m_elements.empty(); }
+		const VertexElement* find(VertexAttribute attribute) const;
+		// the bounds quantized positions are relative to, identity for float positions
+		VertexQuantization getQuantization(const Vertex* vertices, size_t count) const;
+		// writes count vertices m_stride apart
+		void encode(const Vertex* vertices, size_t count, const VertexQuantization& quantization, uint8_t* destination) const;
+	};
+}
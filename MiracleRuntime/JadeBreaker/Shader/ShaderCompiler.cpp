@@ -0,0 +1,286 @@
+#include "ShaderCompiler.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <shaderc/shaderc.hpp>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace Sherphy
+{
+    namespace
+    {
+        // bump when the compile options change, old cache files stop matching
+        const uint64_t k_compiler_salt = 1;
+
+        bool readTextFile(const std::filesystem::path& path, std::string& text, std::filesystem::file_time_type& write_time)
+        {
+            std::error_code error;
+            write_time = std::filesystem::last_write_time(path, error);
+            std::ifstream file(path, std::ios::binary);
+            if (error || !file.is_open())
+            {
+                return false;
+            }
+            std::stringstream stream;
+            stream << file.rdbuf();
+            text = stream.str();
+            return true;
+        }
+
+        shaderc_shader_kind getShaderKind(VkShaderStageFlagBits stage)
+        {
+            switch (stage)
+            {
+            case VK_SHADER_STAGE_VERTEX_BIT: return shaderc_vertex_shader;
+            case VK_SHADER_STAGE_FRAGMENT_BIT: return shaderc_fragment_shader;
+            case VK_SHADER_STAGE_COMPUTE_BIT: return shaderc_compute_shader;
+            case VK_SHADER_STAGE_RAYGEN_BIT_KHR: return shaderc_raygen_shader;
+            case VK_SHADER_STAGE_MISS_BIT_KHR: return shaderc_miss_shader;
+            case VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR: return shaderc_closesthit_shader;
+            case VK_SHADER_STAGE_ANY_HIT_BIT_KHR: return shaderc_anyhit_shader;
+            default: return shaderc_glsl_infer_from_source;
+            }
+        }
+
+        // includes relative to the including file, <...> includes relative to the shader root
+        class ShaderIncluder : public shaderc::CompileOptions::IncluderInterface
+        {
+        public:
+            struct Include
+            {
+                shaderc_include_result result;
+                std::string name;
+                std::string content;
+            };
+
+            ShaderIncluder(const std::string& root, ShaderCompileResult* compile_result)
+                : m_root(root), m_compile_result(compile_result)
+            {
+            }
+
+            shaderc_include_result* GetInclude(const char* requested_source,
+                                               shaderc_include_type type,
+                                               const char* requesting_source,
+                                               size_t include_depth) override
+            {
+                std::filesystem::path path = type == shaderc_include_type_relative
+                    ? std::filesystem::path(requesting_source).parent_path() / requested_source
+                    : std::filesystem::path(m_root) / requested_source;
+
+                Include* include = new Include();
+                std::filesystem::file_time_type write_time;
+                if (readTextFile(path, include->content, write_time))
+                {
+                    include->name = path.lexically_normal().generic_string();
+                    addDependency(include->name, write_time);
+                }
+                else
+                {
+                    // an empty name tells shaderc the include failed, the content is the error
+                    include->content = "cannot open include " + path.generic_string();
+                }
+                include->result.source_name = include->name.c_str();
+                include->result.source_name_length = include->name.size();
+                include->result.content = include->content.c_str();
+                include->result.content_length = include->content.size();
+                include->result.user_data = include;
+                return &include->result;
+            }
+
+            void ReleaseInclude(shaderc_include_result* data) override
+            {
+                delete static_cast<Include*>(data->user_data);
+            }
+
+        private:
+            // preprocessing and compiling both walk the includes
+            void addDependency(const std::string& name, std::filesystem::file_time_type write_time)
+            {
+                for (const std::string& dependency : m_compile_result->dependencies)
+                {
+                    if (dependency == name)
+                    {
+                        return;
+                    }
+                }
+                m_compile_result->dependencies.push_back(name);
+                m_compile_result->dependency_times.push_back(write_time);
+            }
+
+            std::string m_root;
+            ShaderCompileResult* m_compile_result;
+        };
+    }
+
+    void ShaderCompiler::init(const std::string& root, const std::string& cache_dir)
+    {
+        m_root = root;
+        m_cache_dir = cache_dir;
+        std::error_code error;
+        std::filesystem::create_directories(m_cache_dir, error);
+        if (error)
+        {
+            SHERPHY_LOG("shader cache directory " + m_cache_dir + " is not writable, spirv is cached in memory only");
+            m_cache_dir.clear();
+        }
+    }
+
+    ShaderCompileResult ShaderCompiler::compile(const ShaderSource& source)
+    {
+        ShaderCompileResult compile_result;
+        std::string path = resolvePath(source.path);
+        VkShaderStageFlagBits stage = getStage(path);
+
+        std::string text;
+        std::filesystem::file_time_type write_time;
+        if (!readTextFile(path, text, write_time))
+        {
+            compile_result.error = "cannot open shader " + path;
+            return compile_result;
+        }
+        compile_result.dependencies.push_back(path);
+        compile_result.dependency_times.push_back(write_time);
+
+        shaderc::CompileOptions options;
+        for (const ShaderDefine& define : source.defines)
+        {
+            options.AddMacroDefinition(define.name, define.value);
+        }
+        options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+        options.SetTargetSpirv(shaderc_spirv_version_1_5);
+        options.SetOptimizationLevel(shaderc_optimization_level_performance);
+        options.SetIncluder(std::make_unique<ShaderIncluder>(m_root, &compile_result));
+
+        shaderc::Compiler compiler;
+        shaderc_shader_kind kind = getShaderKind(stage);
+        shaderc::PreprocessedSourceCompilationResult preprocessed = compiler.PreprocessGlsl(text, kind, path.c_str(), options);
+        if (preprocessed.GetCompilationStatus() != shaderc_compilation_status_success)
+        {
+            compile_result.error = preprocessed.GetErrorMessage();
+            return compile_result;
+        }
+
+        // defines and includes are already applied to the preprocessed text
+        std::string preprocessed_text(preprocessed.cbegin(), preprocessed.cend());
+        compile_result.key = hash(preprocessed_text.data(), preprocessed_text.size(), hash(&stage, sizeof(stage), hash(&k_compiler_salt, sizeof(k_compiler_salt))));
+        if (loadCached(compile_result.key, compile_result.spirv))
+        {
+            compile_result.success = true;
+            compile_result.from_cache = true;
+            return compile_result;
+        }
+
+        shaderc::SpvCompilationResult module = compiler.CompileGlslToSpv(text, kind, path.c_str(), options);
+        if (module.GetCompilationStatus() != shaderc_compilation_status_success)
+        {
+            compile_result.error = module.GetErrorMessage();
+            return compile_result;
+        }
+        const char* words = reinterpret_cast<const char*>(module.cbegin());
+        compile_result.spirv.assign(words, words + (module.cend() - module.cbegin()) * sizeof(uint32_t));
+        compile_result.success = true;
+        storeCached(compile_result.key, compile_result.spirv);
+        return compile_result;
+    }
+
+    std::string ShaderCompiler::resolvePath(const std::string& path) const
+    {
+        std::filesystem::path resolved(path);
+        if (resolved.is_relative())
+        {
+            resolved = std::filesystem::path(m_root) / resolved;
+        }
+        return resolved.lexically_normal().generic_string();
+    }
+
+    bool ShaderCompiler::loadCached(uint64_t key, std::vector<char>& spirv)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_cache_mutex);
+            auto cached = m_cache.find(key);
+            if (cached != m_cache.end())
+            {
+                spirv = cached->second;
+                return true;
+            }
+        }
+        if (m_cache_dir.empty())
+        {
+            return false;
+        }
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.spv", static_cast<unsigned long long>(key));
+        std::ifstream file(std::filesystem::path(m_cache_dir) / name, std::ios::ate | std::ios::binary);
+        if (!file.is_open())
+        {
+            return false;
+        }
+        spirv.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(spirv.data(), spirv.size());
+        if (!file || spirv.empty() || spirv.size() % sizeof(uint32_t) != 0)
+        {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(m_cache_mutex);
+        m_cache[key] = spirv;
+        return true;
+    }
+
+    void ShaderCompiler::storeCached(uint64_t key, const std::vector<char>& spirv)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_cache_mutex);
+            m_cache[key] = spirv;
+        }
+        if (m_cache_dir.empty())
+        {
+            return;
+        }
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.spv", static_cast<unsigned long long>(key));
+        // written aside and renamed, a concurrent reader never sees half a module
+        std::filesystem::path path = std::filesystem::path(m_cache_dir) / name;
+        std::filesystem::path temp_path = path;
+        temp_path += ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            file.write(spirv.data(), spirv.size());
+        }
+        std::error_code error;
+        std::filesystem::rename(temp_path, path, error);
+        if (error)
+        {
+            std::filesystem::remove(temp_path, error);
+        }
+    }
+
+    VkShaderStageFlagBits ShaderCompiler::getStage(const std::string& path)
+    {
+        std::string extension = std::filesystem::path(path).extension().string();
+        if (extension == ".vert") return VK_SHADER_STAGE_VERTEX_BIT;
+        if (extension == ".frag") return VK_SHADER_STAGE_FRAGMENT_BIT;
+        if (extension == ".comp") return VK_SHADER_STAGE_COMPUTE_BIT;
+        if (extension == ".rgen") return VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+        if (extension == ".rmiss") return VK_SHADER_STAGE_MISS_BIT_KHR;
+        if (extension == ".rchit") return VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
+        if (extension == ".rahit") return VK_SHADER_STAGE_ANY_HIT_BIT_KHR;
+        SHERPHY_EXCEPTION_IF_FALSE(false, "unknown shader stage of " + path);
+        return VK_SHADER_STAGE_ALL;
+    }
+
+    // fnv-1a
+    uint64_t ShaderCompiler::hash(const void* data, size_t size, uint64_t seed)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        uint64_t value = seed;
+        for (size_t i = 0; i < size; i++)
+        {
+            value ^= bytes[i];
+            value *= 1099511628211ull;
+        }
+        return value;
+    }
+}
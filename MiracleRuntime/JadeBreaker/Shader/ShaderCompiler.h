@@ -0,0 +1,57 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Sherphy
+{
+	struct ShaderDefine
+	{
+		std::string name;
+		std::string value;
+	};
+
+	struct ShaderSource
+	{
+		std::string path; // the extension picks the stage, .vert .frag .comp .rgen .rmiss .rchit
+		std::vector<ShaderDefine> defines;
+	};
+
+	struct ShaderCompileResult
+	{
+		bool success = false;
+		bool from_cache = false;
+		uint64_t key = 0;
+		std::vector<char> spirv;
+		std::string error;
+		// the source and every file it includes, with the write time seen before reading it
+		std::vector<std::string> dependencies;
+		std::vector<std::filesystem::file_time_type> dependency_times;
+	};
+
+	// GLSL to SPIR-V in process through shaderc. The cache key hashes the preprocessed
+	// source, so the source, the defines and every included file are part of it; results
+	// are kept in memory and as <key>.spv in the cache directory, a warm start reads them
+	// back without compiling. compile() may run on several threads at once.
+	struct ShaderCompiler
+	{
+		std::string m_root; // #include <...> and relative source paths resolve against it
+		std::string m_cache_dir;
+		std::mutex m_cache_mutex;
+		std::unordered_map<uint64_t, std::vector<char>> m_cache;
+
+		void init(const std::string& root, const std::string& cache_dir);
+		ShaderCompileResult compile(const ShaderSource& source);
+		std::string resolvePath(const std::string& path) const;
+
+		bool loadCached(uint64_t key, std::vector<char>& spirv);
+		void storeCached(uint64_t key, const std::vector<char>& spirv);
+		static VkShaderStageFlagBits getStage(const std::string& path);
+		static uint64_t hash(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+	};
+}
@@ -0,0 +1,205 @@
+#include "ShaderLibrary.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <algorithm>
+
+namespace Sherphy
+{
+    void ShaderLibrary::init(const std::string& root, const std::string& cache_dir)
+    {
+        m_compiler.init(root, cache_dir);
+        m_stopping = false;
+        uint32_t worker_count = std::clamp(std::thread::hardware_concurrency() / 2, 1u, k_max_workers);
+        for (uint32_t i = 0; i < worker_count; i++)
+        {
+            m_workers.emplace_back(&ShaderLibrary::workerLoop, this);
+        }
+        m_last_poll = std::chrono::steady_clock::now();
+    }
+
+    ShaderHandle ShaderLibrary::load(const std::string& path, const std::vector<ShaderDefine>& defines)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE(isInitialized(), "shader library is not initialized");
+        Entry entry;
+        entry.source.path = m_compiler.resolvePath(path);
+        entry.source.defines = defines;
+        entry.stage = ShaderCompiler::getStage(entry.source.path);
+        m_entries.push_back(entry);
+
+        ShaderHandle handle = static_cast<ShaderHandle>(m_entries.size() - 1);
+        queueCompile(handle);
+        return handle;
+    }
+
+    void ShaderLibrary::wait()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_job_done.wait(lock, [this]() { return m_jobs.empty() && m_running_jobs == 0; });
+        }
+        std::vector<ShaderHandle> changed;
+        applyFinishedJobs(changed);
+        for (const Entry& entry : m_entries)
+        {
+            SHERPHY_EXCEPTION_IF_FALSE((entry.version > 0), "failed to compile shader " + entry.source.path);
+        }
+    }
+
+    std::vector<ShaderHandle> ShaderLibrary::update()
+    {
+        std::vector<ShaderHandle> changed;
+        applyFinishedJobs(changed);
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - m_last_poll >= k_poll_interval)
+        {
+            m_last_poll = now;
+            pollFiles();
+        }
+        return changed;
+    }
+
+    ShaderReflection ShaderLibrary::getReflection(const std::vector<ShaderHandle>& handles) const
+    {
+        ShaderReflection reflection;
+        for (ShaderHandle handle : handles)
+        {
+            reflection.merge(m_entries[handle].reflection);
+        }
+        return reflection;
+    }
+
+    void ShaderLibrary::destroy()
+    {
+        if (!isInitialized())
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+            m_jobs.clear();
+        }
+        m_job_ready.notify_all();
+        for (std::thread& worker : m_workers)
+        {
+            worker.join();
+        }
+        m_workers.clear();
+        m_finished_jobs.clear();
+        m_entries.clear();
+    }
+
+    void ShaderLibrary::queueCompile(ShaderHandle handle)
+    {
+        m_entries[handle].pending = true;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.push_back({ handle, m_entries[handle].source });
+        }
+        m_job_ready.notify_one();
+    }
+
+    void ShaderLibrary::applyFinishedJobs(std::vector<ShaderHandle>& changed)
+    {
+        std::vector<FinishedJob> finished_jobs;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            finished_jobs.swap(m_finished_jobs);
+        }
+        for (FinishedJob& finished_job : finished_jobs)
+        {
+            Entry& entry = m_entries[finished_job.handle];
+            ShaderCompileResult& result = finished_job.result;
+            entry.pending = false;
+            // a failed compile keeps watching what it read, fixing any of it retries
+            if (!result.dependencies.empty())
+            {
+                entry.dependencies = std::move(result.dependencies);
+                entry.dependency_times = std::move(result.dependency_times);
+            }
+            if (!result.success)
+            {
+                LogMessage("shader " + entry.source.path + " failed to compile:\n" + result.error, WarningStage::Medium);
+                continue;
+            }
+            if (result.from_cache)
+            {
+                m_cache_hit_count++;
+            }
+            else
+            {
+                m_compiled_count++;
+            }
+            // saving a file without changing what the compiler sees is not a change
+            if (entry.version > 0 && result.key == entry.key)
+            {
+                continue;
+            }
+            if (entry.version > 0)
+            {
+                m_reload_count++;
+                SHERPHY_LOG("reloaded shader " + entry.source.path);
+            }
+            entry.reflection = reflectSpirv(result.spirv, entry.stage);
+            entry.spirv = std::move(result.spirv);
+            entry.key = result.key;
+            entry.version++;
+            if (std::find(changed.begin(), changed.end(), finished_job.handle) == changed.end())
+            {
+                changed.push_back(finished_job.handle);
+            }
+        }
+    }
+
+    void ShaderLibrary::pollFiles()
+    {
+        for (ShaderHandle handle = 0; handle < m_entries.size(); handle++)
+        {
+            Entry& entry = m_entries[handle];
+            if (entry.pending)
+            {
+                continue;
+            }
+            for (size_t i = 0; i < entry.dependencies.size(); i++)
+            {
+                std::error_code error;
+                std::filesystem::file_time_type write_time = std::filesystem::last_write_time(entry.dependencies[i], error);
+                // editors replace files on save, a missing file is waited out
+                if (!error && write_time != entry.dependency_times[i])
+                {
+                    queueCompile(handle);
+                    break;
+                }
+            }
+        }
+    }
+
+    void ShaderLibrary::workerLoop()
+    {
+        while (true)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_job_ready.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+                if (m_stopping)
+                {
+                    return;
+                }
+                job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+                m_running_jobs++;
+            }
+
+            ShaderCompileResult result = m_compiler.compile(job.source);
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_finished_jobs.push_back({ job.handle, std::move(result) });
+                m_running_jobs--;
+            }
+            m_job_done.notify_all();
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "ShaderCompiler.h"
+#include "ShaderReflection.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+namespace Sherphy
+{
+	using ShaderHandle = uint32_t;
+
+	// Owns every shader the renderer uses. Compiles run on worker threads, load() only
+	// queues one and wait() blocks until the queue drained. update() is called once a
+	// frame by the owner: it polls the write time of every source and include, queues
+	// the shaders whose files changed and hands back the ones that got new SPIR-V, so
+	// the owner can rebuild the pipelines using them. A failed recompile is logged and
+	// keeps the last good SPIR-V, only the first compile of a shader has to succeed.
+	struct ShaderLibrary
+	{
+		static const uint32_t k_max_workers = 4;
+		static constexpr std::chrono::milliseconds k_poll_interval{ 250 };
+
+		struct Entry
+		{
+			ShaderSource source;
+			VkShaderStageFlagBits stage;
+			std::vector<char> spirv;
+			ShaderReflection reflection; // of the current spirv
+			uint64_t key = 0;
+			uint32_t version = 0; // bumped by every new spirv, 0 until the first compile
+			bool pending = false;
+			std::vector<std::string> dependencies;
+			std::vector<std::filesystem::file_time_type> dependency_times;
+		};
+
+		struct Job
+		{
+			ShaderHandle handle;
+			ShaderSource source;
+		};
+
+		struct FinishedJob
+		{
+			ShaderHandle handle;
+			ShaderCompileResult result;
+		};
+
+		ShaderCompiler m_compiler;
+		std::vector<Entry> m_entries; // owner thread only
+		std::chrono::steady_clock::time_point m_last_poll{};
+
+		std::vector<std::thread> m_workers;
+		std::mutex m_mutex;
+		std::condition_variable m_job_ready;
+		std::condition_variable m_job_done;
+		std::deque<Job> m_jobs;
+		std::vector<FinishedJob> m_finished_jobs;
+		uint32_t m_running_jobs = 0;
+		bool m_stopping = false;
+
+		// compile and cache statistics
+		uint32_t m_compiled_count = 0;
+		uint32_t m_cache_hit_count = 0;
+		uint32_t m_reload_count = 0;
+
+		bool isInitialized() const { return !m_workers.empty(); }
+		void init(const std::string& root, const std::string& cache_dir);
+		// relative paths resolve against the shader root
+		ShaderHandle load(const std::string& path, const std::vector<ShaderDefine>& defines = {});
+		// blocks until every queued compile finished and applies the results
+		void wait();
+		// polls the files and applies finished compiles, returns the shaders with new spirv
+		std::vector<ShaderHandle> update();
+		const std::vector<char>& getSpirv(ShaderHandle handle) const { return m_entries[handle].spirv; }
+		VkShaderStageFlagBits getStage(ShaderHandle handle) const { return m_entries[handle].stage; }
+		const ShaderReflection& getReflection(ShaderHandle handle) const { return m_entries[handle].reflection; }
+		// the interface of several stages merged, e.g. the stages of one pipeline
+		ShaderReflection getReflection(const std::vector<ShaderHandle>& handles) const;
+		void destroy();
+
+		void queueCompile(ShaderHandle handle);
+		void applyFinishedJobs(std::vector<ShaderHandle>& changed);
+		void pollFiles();
+		void workerLoop();
+	};
+}
@@ -0,0 +1,408 @@
+#include "ShaderReflection.h"
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace Sherphy
+{
+    namespace
+    {
+        // the few parts of the SPIR-V grammar the interface needs
+        const uint32_t k_spirv_magic = 0x07230203;
+        const uint32_t k_spirv_header_words = 5;
+
+        enum SpirvOp : uint32_t
+        {
+            OpDecorate = 71,
+            OpMemberDecorate = 72,
+            OpTypeInt = 21,
+            OpTypeFloat = 22,
+            OpTypeVector = 23,
+            OpTypeMatrix = 24,
+            OpTypeImage = 25,
+            OpTypeSampler = 26,
+            OpTypeSampledImage = 27,
+            OpTypeArray = 28,
+            OpTypeRuntimeArray = 29,
+            OpTypeStruct = 30,
+            OpTypePointer = 32,
+            OpConstant = 43,
+            OpSpecConstant = 50,
+            OpVariable = 59,
+            OpTypeAccelerationStructureKHR = 5341,
+        };
+
+        enum SpirvDecoration : uint32_t
+        {
+            DecorationBlock = 2,
+            DecorationBufferBlock = 3,
+            DecorationArrayStride = 6,
+            DecorationMatrixStride = 7,
+            DecorationBuiltIn = 11,
+            DecorationLocation = 30,
+            DecorationBinding = 33,
+            DecorationDescriptorSet = 34,
+            DecorationOffset = 35,
+        };
+
+        enum SpirvStorageClass : uint32_t
+        {
+            StorageClassUniformConstant = 0,
+            StorageClassInput = 1,
+            StorageClassUniform = 2,
+            StorageClassPushConstant = 9,
+            StorageClassStorageBuffer = 12,
+        };
+
+        const uint32_t k_dim_buffer = 5;
+        const uint32_t k_dim_subpass_data = 6;
+        const uint32_t k_invalid = UINT32_MAX;
+
+        struct SpirvId
+        {
+            uint32_t op = 0;
+            std::vector<uint32_t> operands; // without the result id
+            uint32_t set = k_invalid;
+            uint32_t binding = k_invalid;
+            uint32_t location = k_invalid;
+            uint32_t array_stride = 0;
+            bool block = false;
+            bool buffer_block = false;
+            bool built_in = false;
+            std::vector<uint32_t> member_offsets;
+            std::vector<uint32_t> member_matrix_strides;
+        };
+
+        struct SpirvModule
+        {
+            std::unordered_map<uint32_t, SpirvId> ids;
+
+            const SpirvId& get(uint32_t id) const
+            {
+                auto found = ids.find(id);
+                SHERPHY_EXCEPTION_IF_FALSE((found != ids.end()), "spirv refers to an unknown id");
+                return found->second;
+            }
+
+            uint32_t getConstant(uint32_t id) const
+            {
+                const SpirvId& constant = get(id);
+                SHERPHY_EXCEPTION_IF_FALSE((constant.op == OpConstant || constant.op == OpSpecConstant), "spirv array length is not a constant");
+                // operands are result type and the low word of the value
+                return constant.operands[1];
+            }
+
+            uint32_t getTypeSize(uint32_t type_id, uint32_t matrix_stride = 0) const
+            {
+                const SpirvId& type = get(type_id);
+                switch (type.op)
+                {
+                case OpTypeInt:
+                case OpTypeFloat:
+                    return type.operands[0] / 8;
+                case OpTypeVector:
+                    return getTypeSize(type.operands[0]) * type.operands[1];
+                case OpTypeMatrix:
+                    return (matrix_stride > 0 ? matrix_stride : getTypeSize(type.operands[0])) * type.operands[1];
+                case OpTypeArray:
+                    return (type.array_stride > 0 ? type.array_stride : getTypeSize(type.operands[0])) * getConstant(type.operands[1]);
+                case OpTypeStruct:
+                {
+                    uint32_t size = 0;
+                    for (size_t i = 0; i < type.operands.size(); i++)
+                    {
+                        uint32_t offset = i < type.member_offsets.size() ? type.member_offsets[i] : 0;
+                        uint32_t stride = i < type.member_matrix_strides.size() ? type.member_matrix_strides[i] : 0;
+                        size = std::max(size, offset + getTypeSize(type.operands[i], stride));
+                    }
+                    return size;
+                }
+                default:
+                    return 0;
+                }
+            }
+
+            VkFormat getInputFormat(uint32_t type_id, uint32_t& size) const
+            {
+                const SpirvId& type = get(type_id);
+                uint32_t component_count = 1;
+                const SpirvId* component = &type;
+                if (type.op == OpTypeVector)
+                {
+                    component_count = type.operands[1];
+                    component = &get(type.operands[0]);
+                }
+                size = component_count * 4;
+                SHERPHY_EXCEPTION_IF_FALSE((component->operands[0] == 32), "only 32 bit vertex inputs are reflected");
+                static const VkFormat k_float_formats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+                static const VkFormat k_int_formats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+                static const VkFormat k_uint_formats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+                if (component->op == OpTypeFloat)
+                {
+                    return k_float_formats[component_count - 1];
+                }
+                return component->operands[1] ? k_int_formats[component_count - 1] : k_uint_formats[component_count - 1];
+            }
+        };
+
+        VkDescriptorType getDescriptorType(const SpirvModule& module, const SpirvId& type, uint32_t storage_class)
+        {
+            if (storage_class == StorageClassStorageBuffer)
+            {
+                return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            }
+            if (storage_class == StorageClassUniform)
+            {
+                return type.buffer_block ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            }
+            switch (type.op)
+            {
+            case OpTypeSampler:
+                return VK_DESCRIPTOR_TYPE_SAMPLER;
+            case OpTypeSampledImage:
+            {
+                const SpirvId& image = module.get(type.operands[0]);
+                return image.operands[1] == k_dim_buffer ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            }
+            case OpTypeImage:
+            {
+                // operands: sampled type, dim, depth, arrayed, ms, sampled, format
+                uint32_t dim = type.operands[1];
+                bool storage = type.operands[5] == 2;
+                if (dim == k_dim_subpass_data)
+                {
+                    return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+                }
+                if (dim == k_dim_buffer)
+                {
+                    return storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+                }
+                return storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+            }
+            case OpTypeAccelerationStructureKHR:
+                return VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+            default:
+                SHERPHY_EXCEPTION_IF_FALSE(false, "spirv resource of unknown descriptor type");
+                return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+            }
+        }
+    }
+
+    ShaderReflection reflectSpirv(const std::vector<char>& spirv, VkShaderStageFlagBits stage)
+    {
+        SHERPHY_EXCEPTION_IF_FALSE((spirv.size() % sizeof(uint32_t) == 0 && spirv.size() >= k_spirv_header_words * sizeof(uint32_t)), "spirv is not a word stream");
+        std::vector<uint32_t> words(spirv.size() / sizeof(uint32_t));
+        std::memcpy(words.data(), spirv.data(), spirv.size());
+        SHERPHY_EXCEPTION_IF_FALSE((words[0] == k_spirv_magic), "spirv magic number mismatch");
+
+        // types, constants and decorations by id, variables in declaration order
+        SpirvModule module;
+        std::vector<uint32_t> variables;
+        for (size_t word = k_spirv_header_words; word < words.size();)
+        {
+            uint32_t op = words[word] & 0xFFFF;
+            uint32_t word_count = words[word] >> 16;
+            SHERPHY_EXCEPTION_IF_FALSE((word_count > 0 && word + word_count <= words.size()), "spirv instruction runs past the module");
+            const uint32_t* operands = &words[word + 1];
+            uint32_t operand_count = word_count - 1;
+
+            switch (op)
+            {
+            case OpDecorate:
+            {
+                SpirvId& target = module.ids[operands[0]];
+                uint32_t value = operand_count > 2 ? operands[2] : 0;
+                switch (operands[1])
+                {
+                case DecorationBlock: target.block = true; break;
+                case DecorationBufferBlock: target.buffer_block = true; break;
+                case DecorationArrayStride: target.array_stride = value; break;
+                case DecorationBuiltIn: target.built_in = true; break;
+                case DecorationLocation: target.location = value; break;
+                case DecorationBinding: target.binding = value; break;
+                case DecorationDescriptorSet: target.set = value; break;
+                default: break;
+                }
+                break;
+            }
+            case OpMemberDecorate:
+            {
+                SpirvId& target = module.ids[operands[0]];
+                uint32_t member = operands[1];
+                uint32_t value = operand_count > 3 ? operands[3] : 0;
+                if (operands[2] == DecorationOffset)
+                {
+                    target.member_offsets.resize(std::max<size_t>(target.member_offsets.size(), member + 1), 0);
+                    target.member_offsets[member] = value;
+                }
+                else if (operands[2] == DecorationMatrixStride)
+                {
+                    target.member_matrix_strides.resize(std::max<size_t>(target.member_matrix_strides.size(), member + 1), 0);
+                    target.member_matrix_strides[member] = value;
+                }
+                else if (operands[2] == DecorationBuiltIn)
+                {
+                    target.built_in = true;
+                }
+                break;
+            }
+            case OpTypeInt:
+            case OpTypeFloat:
+            case OpTypeVector:
+            case OpTypeMatrix:
+            case OpTypeImage:
+            case OpTypeSampler:
+            case OpTypeSampledImage:
+            case OpTypeArray:
+            case OpTypeRuntimeArray:
+            case OpTypeStruct:
+            case OpTypePointer:
+            case OpTypeAccelerationStructureKHR:
+            {
+                SpirvId& type = module.ids[operands[0]];
+                type.op = op;
+                type.operands.assign(operands + 1, operands + operand_count);
+                break;
+            }
+            case OpConstant:
+            case OpSpecConstant:
+            {
+                // result type comes before the result id
+                SpirvId& constant = module.ids[operands[1]];
+                constant.op = op;
+                constant.operands = { operands[0], operand_count > 2 ? operands[2] : 0 };
+                break;
+            }
+            case OpVariable:
+            {
+                SpirvId& variable = module.ids[operands[1]];
+                variable.op = op;
+                variable.operands = { operands[0], operands[2] };
+                variables.push_back(operands[1]);
+                break;
+            }
+            default:
+                break;
+            }
+            word += word_count;
+        }
+
+        ShaderReflection reflection;
+        reflection.stages = stage;
+        for (uint32_t variable_id : variables)
+        {
+            const SpirvId& variable = module.get(variable_id);
+            uint32_t storage_class = variable.operands[1];
+            const SpirvId& pointer = module.get(variable.operands[0]);
+            uint32_t type_id = pointer.operands[1];
+
+            if (storage_class == StorageClassPushConstant)
+            {
+                reflection.push_constant_size = std::max(reflection.push_constant_size, module.getTypeSize(type_id));
+                reflection.push_constant_stages = stage;
+                continue;
+            }
+            if (storage_class == StorageClassInput)
+            {
+                if (stage == VK_SHADER_STAGE_VERTEX_BIT && !variable.built_in && !module.get(type_id).built_in && variable.location != k_invalid)
+                {
+                    ReflectedInput input{};
+                    input.location = variable.location;
+                    input.format = module.getInputFormat(type_id, input.size);
+                    reflection.inputs.push_back(input);
+                }
+                continue;
+            }
+            if (storage_class != StorageClassUniformConstant && storage_class != StorageClassUniform && storage_class != StorageClassStorageBuffer)
+            {
+                continue;
+            }
+
+            // arrays of resources become the descriptor count
+            uint32_t count = 1;
+            const SpirvId* type = &module.get(type_id);
+            while (type->op == OpTypeArray || type->op == OpTypeRuntimeArray)
+            {
+                count = type->op == OpTypeArray ? count * module.getConstant(type->operands[1]) : 0;
+                type = &module.get(type->operands[0]);
+            }
+
+            ReflectedBinding binding{};
+            binding.set = variable.set == k_invalid ? 0 : variable.set;
+            binding.binding = variable.binding == k_invalid ? 0 : variable.binding;
+            binding.type = getDescriptorType(module, *type, storage_class);
+            binding.count = count;
+            binding.stages = stage;
+            reflection.bindings.push_back(binding);
+        }
+
+        std::sort(reflection.bindings.begin(), reflection.bindings.end(), [](const ReflectedBinding& a, const ReflectedBinding& b) {
+            return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+        });
+        std::sort(reflection.inputs.begin(), reflection.inputs.end(), [](const ReflectedInput& a, const ReflectedInput& b) {
+            return a.location < b.location;
+        });
+        return reflection;
+    }
+
+    void ShaderReflection::merge(const ShaderReflection& other)
+    {
+        stages |= other.stages;
+        for (const ReflectedBinding& other_binding : other.bindings)
+        {
+            auto found = std::find_if(bindings.begin(), bindings.end(), [&other_binding](const ReflectedBinding& binding) {
+                return binding.set == other_binding.set && binding.binding == other_binding.binding;
+            });
+            if (found == bindings.end())
+            {
+                bindings.push_back(other_binding);
+                continue;
+            }
+            SHERPHY_EXCEPTION_IF_FALSE((found->type == other_binding.type),
+                "stages disagree on the type of set " + std::to_string(other_binding.set) + " binding " + std::to_string(other_binding.binding));
+            found->stages |= other_binding.stages;
+            // a runtime array in any stage keeps the binding variable sized
+            found->count = (found->count == 0 || other_binding.count == 0) ? 0 : std::max(found->count, other_binding.count);
+        }
+        std::sort(bindings.begin(), bindings.end(), [](const ReflectedBinding& a, const ReflectedBinding& b) {
+            return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+        });
+
+        // every stage shares one range, blocks of different stages overlap from offset 0
+        if (other.push_constant_size > 0)
+        {
+            push_constant_size = std::max(push_constant_size, other.push_constant_size);
+            push_constant_stages |= other.push_constant_stages;
+        }
+        if (!other.inputs.empty())
+        {
+            inputs = other.inputs;
+        }
+    }
+
+    uint32_t ShaderReflection::getSetCount() const
+    {
+        return bindings.empty() ? 0 : bindings.back().set + 1;
+    }
+
+    std::vector<VkDescriptorSetLayoutBinding> ShaderReflection::getSetBindings(uint32_t set) const
+    {
+        std::vector<VkDescriptorSetLayoutBinding> set_bindings;
+        for (const ReflectedBinding& binding : bindings)
+        {
+            if (binding.set != set)
+            {
+                continue;
+            }
+            VkDescriptorSetLayoutBinding layout_binding{};
+            layout_binding.binding = binding.binding;
+            layout_binding.descriptorType = binding.type;
+            layout_binding.descriptorCount = binding.count;
+            layout_binding.stageFlags = binding.stages;
+            set_bindings.push_back(layout_binding);
+        }
+        return set_bindings;
+    }
+}
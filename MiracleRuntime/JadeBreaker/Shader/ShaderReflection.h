@@ -0,0 +1,44 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Sherphy
+{
+	struct ReflectedBinding
+	{
+		uint32_t set;
+		uint32_t binding;
+		VkDescriptorType type;
+		uint32_t count; // 0 for runtime sized arrays
+		VkShaderStageFlags stages;
+	};
+
+	struct ReflectedInput
+	{
+		uint32_t location;
+		VkFormat format;
+		uint32_t size;
+	};
+
+	// The resource interface of one or more shader stages read from SPIR-V: descriptor
+	// bindings, the push constant block and the vertex inputs. Buffers come out as plain
+	// uniform or storage buffers, whether they are bound with a dynamic offset is up to
+	// the owner of the set.
+	struct ShaderReflection
+	{
+		VkShaderStageFlags stages = 0;
+		std::vector<ReflectedBinding> bindings; // sorted by set, then binding
+		uint32_t push_constant_size = 0;
+		VkShaderStageFlags push_constant_stages = 0;
+		std::vector<ReflectedInput> inputs; // vertex stage only, sorted by location
+
+		// stages sharing a binding must agree on its type
+		void merge(const ShaderReflection& other);
+		uint32_t getSetCount() const;
+		std::vector<VkDescriptorSetLayoutBinding> getSetBindings(uint32_t set) const;
+	};
+
+	ShaderReflection reflectSpirv(const std::vector<char>& spirv, VkShaderStageFlagBits stage);
+}
@@ -1,9 +0,0 @@
-#pragma once
-//#include <glslang/Public/ShaderLang.h>
-
-namespace Sherphy 
-{
-	void GLSL2SPVCode(const char* const glsl_code) 
-	{
-	}
-}
\ No newline at end of file
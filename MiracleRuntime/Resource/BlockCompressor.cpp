@@ -0,0 +1,511 @@
+#include "BlockCompressor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Sherphy
+{
+	namespace
+	{
+		// principal axis of up to 4 dimensional points by power iteration on the covariance
+		void computePrincipalAxis(const float points[16][4], uint32_t dims, float mean[4], float axis[4])
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				mean[c] = 0.0f;
+				axis[c] = 0.0f;
+			}
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				for (uint32_t c = 0; c < dims; c++)
+				{
+					mean[c] += points[i][c] / 16.0f;
+				}
+			}
+
+			float covariance[4][4]{};
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				for (uint32_t a = 0; a < dims; a++)
+				{
+					for (uint32_t b = 0; b < dims; b++)
+					{
+						covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+					}
+				}
+			}
+
+			// start from the largest extent so flat blocks converge immediately
+			float min_value[4] = { 255.0f, 255.0f, 255.0f, 255.0f };
+			float max_value[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				for (uint32_t c = 0; c < dims; c++)
+				{
+					min_value[c] = std::min(min_value[c], points[i][c]);
+					max_value[c] = std::max(max_value[c], points[i][c]);
+				}
+			}
+			for (uint32_t c = 0; c < dims; c++)
+			{
+				axis[c] = max_value[c] - min_value[c];
+			}
+
+			for (uint32_t iteration = 0; iteration < 8; iteration++)
+			{
+				float next[4]{};
+				for (uint32_t a = 0; a < dims; a++)
+				{
+					for (uint32_t b = 0; b < dims; b++)
+					{
+						next[a] += covariance[a][b] * axis[b];
+					}
+				}
+				float length = 0.0f;
+				for (uint32_t c = 0; c < dims; c++)
+				{
+					length += next[c] * next[c];
+				}
+				if (length < 1e-12f)
+				{
+					break;
+				}
+				length = std::sqrt(length);
+				for (uint32_t c = 0; c < dims; c++)
+				{
+					axis[c] = next[c] / length;
+				}
+			}
+		}
+
+		// endpoints at the extremes of the block projected onto its principal axis
+		void findEndpoints(const float points[16][4], uint32_t dims, float start[4], float end[4])
+		{
+			float mean[4], axis[4];
+			computePrincipalAxis(points, dims, mean, axis);
+
+			float min_t = 0.0f;
+			float max_t = 0.0f;
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				float t = 0.0f;
+				for (uint32_t c = 0; c < dims; c++)
+				{
+					t += (points[i][c] - mean[c]) * axis[c];
+				}
+				min_t = std::min(min_t, t);
+				max_t = std::max(max_t, t);
+			}
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				start[c] = c < dims ? std::clamp(mean[c] + axis[c] * min_t, 0.0f, 255.0f) : 255.0f;
+				end[c] = c < dims ? std::clamp(mean[c] + axis[c] * max_t, 0.0f, 255.0f) : 255.0f;
+			}
+		}
+
+		// least squares endpoints for fixed interpolation weights, each texel is start + (end - start) * weight
+		bool refineEndpoints(const float points[16][4], uint32_t dims, const float weights[16], float start[4], float end[4])
+		{
+			float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+			float ax[4]{}, bx[4]{};
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				float a = 1.0f - weights[i];
+				float b = weights[i];
+				aa += a * a;
+				ab += a * b;
+				bb += b * b;
+				for (uint32_t c = 0; c < dims; c++)
+				{
+					ax[c] += a * points[i][c];
+					bx[c] += b * points[i][c];
+				}
+			}
+			float determinant = aa * bb - ab * ab;
+			if (std::abs(determinant) < 1e-6f)
+			{
+				return false;
+			}
+			for (uint32_t c = 0; c < dims; c++)
+			{
+				start[c] = std::clamp((bb * ax[c] - ab * bx[c]) / determinant, 0.0f, 255.0f);
+				end[c] = std::clamp((aa * bx[c] - ab * ax[c]) / determinant, 0.0f, 255.0f);
+			}
+			return true;
+		}
+
+		// little endian bit stream, bc formats store their fields from the lowest bit up
+		struct BlockBitWriter
+		{
+			uint8_t* data;
+			uint32_t position = 0;
+
+			void write(uint32_t value, uint32_t bit_count)
+			{
+				for (uint32_t i = 0; i < bit_count; i++, position++)
+				{
+					if ((value >> i) & 1u)
+					{
+						data[position >> 3] |= static_cast<uint8_t>(1u << (position & 7u));
+					}
+				}
+			}
+		};
+
+		uint16_t packRGB565(const float color[4])
+		{
+			uint32_t r = static_cast<uint32_t>(std::lround(color[0] * 31.0f / 255.0f));
+			uint32_t g = static_cast<uint32_t>(std::lround(color[1] * 63.0f / 255.0f));
+			uint32_t b = static_cast<uint32_t>(std::lround(color[2] * 31.0f / 255.0f));
+			return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+		}
+
+		void unpackRGB565(uint16_t packed, int color[3])
+		{
+			int r = (packed >> 11) & 31;
+			int g = (packed >> 5) & 63;
+			int b = packed & 31;
+			color[0] = (r << 3) | (r >> 2);
+			color[1] = (g << 2) | (g >> 4);
+			color[2] = (b << 3) | (b >> 2);
+		}
+
+		const int k_bc7_weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+	}
+
+	uint32_t BlockCompressor::getBlockBytes(TextureCompression format)
+	{
+		switch (format)
+		{
+		case TextureCompression::BC1:
+			return 8;
+		case TextureCompression::BC5:
+		case TextureCompression::BC7:
+			return 16;
+		default:
+			return 0;
+		}
+	}
+
+	size_t BlockCompressor::getImageBytes(TextureCompression format, uint32_t width, uint32_t height)
+	{
+		if (format == TextureCompression::RGBA8)
+		{
+			return static_cast<size_t>(width) * height * 4;
+		}
+		size_t blocks = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+		return blocks * getBlockBytes(format);
+	}
+
+	void BlockCompressor::compressImage(const uint8_t* rgba,
+										uint32_t width,
+										uint32_t height,
+										TextureCompression format,
+										std::vector<uint8_t>& blocks)
+	{
+		blocks.assign(getImageBytes(format, width, height), 0);
+		if (format == TextureCompression::RGBA8)
+		{
+			std::memcpy(blocks.data(), rgba, blocks.size());
+			return;
+		}
+
+		uint32_t block_bytes = getBlockBytes(format);
+		uint8_t* out = blocks.data();
+		for (uint32_t block_y = 0; block_y < height; block_y += 4)
+		{
+			for (uint32_t block_x = 0; block_x < width; block_x += 4)
+			{
+				uint8_t block[64];
+				for (uint32_t y = 0; y < 4; y++)
+				{
+					for (uint32_t x = 0; x < 4; x++)
+					{
+						uint32_t source_x = std::min(block_x + x, width - 1);
+						uint32_t source_y = std::min(block_y + y, height - 1);
+						std::memcpy(&block[(y * 4 + x) * 4], &rgba[(static_cast<size_t>(source_y) * width + source_x) * 4], 4);
+					}
+				}
+
+				switch (format)
+				{
+				case TextureCompression::BC1:
+					compressBlockBC1(block, out);
+					break;
+				case TextureCompression::BC5:
+					compressBlockBC5(block, out);
+					break;
+				case TextureCompression::BC7:
+					compressBlockBC7(block, out);
+					break;
+				default:
+					break;
+				}
+				out += block_bytes;
+			}
+		}
+	}
+
+	void BlockCompressor::compressBlockBC1(const uint8_t block[64], uint8_t out[8])
+	{
+		float points[16][4];
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				points[i][c] = block[i * 4 + c];
+			}
+		}
+
+		float start[4], end[4];
+		findEndpoints(points, 3, start, end);
+
+		int best_error = INT32_MAX;
+		for (uint32_t pass = 0; pass < 2; pass++)
+		{
+			uint16_t color0 = packRGB565(end);
+			uint16_t color1 = packRGB565(start);
+			// color0 > color1 selects the four color mode
+			if (color0 < color1)
+			{
+				std::swap(color0, color1);
+			}
+
+			int palette[4][3];
+			unpackRGB565(color0, palette[0]);
+			unpackRGB565(color1, palette[1]);
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+
+			// equal endpoints would switch to the three color mode, index 0 is right for every texel then
+			uint32_t palette_size = color0 == color1 ? 1 : 4;
+			uint32_t indices = 0;
+			int total_error = 0;
+			float weights[16];
+			const float k_palette_weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t best_index = 0;
+				int best_texel_error = INT32_MAX;
+				for (uint32_t p = 0; p < palette_size; p++)
+				{
+					int error = 0;
+					for (uint32_t c = 0; c < 3; c++)
+					{
+						int diff = block[i * 4 + c] - palette[p][c];
+						error += diff * diff;
+					}
+					if (error < best_texel_error)
+					{
+						best_texel_error = error;
+						best_index = p;
+					}
+				}
+				indices |= best_index << (i * 2);
+				total_error += best_texel_error;
+				weights[i] = k_palette_weights[best_index];
+			}
+
+			if (total_error < best_error)
+			{
+				best_error = total_error;
+				out[0] = static_cast<uint8_t>(color0 & 0xff);
+				out[1] = static_cast<uint8_t>(color0 >> 8);
+				out[2] = static_cast<uint8_t>(color1 & 0xff);
+				out[3] = static_cast<uint8_t>(color1 >> 8);
+				out[4] = static_cast<uint8_t>(indices & 0xff);
+				out[5] = static_cast<uint8_t>((indices >> 8) & 0xff);
+				out[6] = static_cast<uint8_t>((indices >> 16) & 0xff);
+				out[7] = static_cast<uint8_t>(indices >> 24);
+			}
+
+			// weights run from color1 to color0, so the refit end point is the next color0
+			if (palette_size == 1 || !refineEndpoints(points, 3, weights, start, end))
+			{
+				break;
+			}
+		}
+	}
+
+	void BlockCompressor::compressBlockBC4(const uint8_t values[16], uint8_t out[8])
+	{
+		uint8_t min_value = 255;
+		uint8_t max_value = 0;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			min_value = std::min(min_value, values[i]);
+			max_value = std::max(max_value, values[i]);
+		}
+
+		std::memset(out, 0, 8);
+		// red0 > red1 selects the eight value mode
+		out[0] = max_value;
+		out[1] = min_value;
+		if (max_value == min_value)
+		{
+			return;
+		}
+
+		int palette[8];
+		palette[0] = max_value;
+		palette[1] = min_value;
+		for (int i = 1; i < 7; i++)
+		{
+			palette[i + 1] = ((7 - i) * max_value + i * min_value) / 7;
+		}
+
+		BlockBitWriter writer{ out, 16 };
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			uint32_t best_index = 0;
+			int best_error = INT32_MAX;
+			for (uint32_t p = 0; p < 8; p++)
+			{
+				int error = std::abs(values[i] - palette[p]);
+				if (error < best_error)
+				{
+					best_error = error;
+					best_index = p;
+				}
+			}
+			writer.write(best_index, 3);
+		}
+	}
+
+	void BlockCompressor::compressBlockBC5(const uint8_t block[64], uint8_t out[16])
+	{
+		uint8_t red[16];
+		uint8_t green[16];
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			red[i] = block[i * 4 + 0];
+			green[i] = block[i * 4 + 1];
+		}
+		compressBlockBC4(red, out);
+		compressBlockBC4(green, out + 8);
+	}
+
+	void BlockCompressor::compressBlockBC7(const uint8_t block[64], uint8_t out[16])
+	{
+		float points[16][4];
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				points[i][c] = block[i * 4 + c];
+			}
+		}
+
+		float start[4], end[4];
+		findEndpoints(points, 4, start, end);
+
+		// endpoints are 7 bits per channel plus one shared p bit per endpoint, try every p bit pair,
+		// then refit the endpoints to the chosen indices once and try again
+		uint32_t best_endpoints[2][4]{};
+		uint32_t best_pbits[2]{};
+		uint32_t best_indices[16]{};
+		int best_total_error = INT32_MAX;
+		for (uint32_t pass = 0; pass < 2; pass++)
+		{
+			for (uint32_t pbits = 0; pbits < 4; pbits++)
+			{
+				uint32_t pbit[2] = { pbits & 1u, pbits >> 1 };
+				uint32_t endpoints[2][4];
+				int palette[16][4];
+				int expanded[2][4];
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					const float* source[2] = { start, end };
+					for (uint32_t e = 0; e < 2; e++)
+					{
+						int quantized = static_cast<int>(std::lround((source[e][c] - static_cast<float>(pbit[e])) / 2.0f));
+						endpoints[e][c] = static_cast<uint32_t>(std::clamp(quantized, 0, 127));
+						expanded[e][c] = static_cast<int>((endpoints[e][c] << 1) | pbit[e]);
+					}
+				}
+				for (uint32_t p = 0; p < 16; p++)
+				{
+					for (uint32_t c = 0; c < 4; c++)
+					{
+						palette[p][c] = ((64 - k_bc7_weights4[p]) * expanded[0][c] + k_bc7_weights4[p] * expanded[1][c] + 32) >> 6;
+					}
+				}
+
+				uint32_t indices[16];
+				int total_error = 0;
+				for (uint32_t i = 0; i < 16; i++)
+				{
+					int best_error = INT32_MAX;
+					for (uint32_t p = 0; p < 16; p++)
+					{
+						int error = 0;
+						for (uint32_t c = 0; c < 4; c++)
+						{
+							int diff = block[i * 4 + c] - palette[p][c];
+							error += diff * diff;
+						}
+						if (error < best_error)
+						{
+							best_error = error;
+							indices[i] = p;
+						}
+					}
+					total_error += best_error;
+				}
+
+				if (total_error < best_total_error)
+				{
+					best_total_error = total_error;
+					std::memcpy(best_endpoints, endpoints, sizeof(endpoints));
+					best_pbits[0] = pbit[0];
+					best_pbits[1] = pbit[1];
+					std::memcpy(best_indices, indices, sizeof(indices));
+				}
+			}
+
+			float weights[16];
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				weights[i] = static_cast<float>(k_bc7_weights4[best_indices[i]]) / 64.0f;
+			}
+			if (!refineEndpoints(points, 4, weights, start, end))
+			{
+				break;
+			}
+		}
+
+		// the anchor texel stores only 3 index bits, its top bit must be zero
+		if (best_indices[0] & 8u)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				std::swap(best_endpoints[0][c], best_endpoints[1][c]);
+			}
+			std::swap(best_pbits[0], best_pbits[1]);
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				best_indices[i] = 15 - best_indices[i];
+			}
+		}
+
+		std::memset(out, 0, 16);
+		BlockBitWriter writer{ out, 0 };
+		writer.write(1u << 6, 7);
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			writer.write(best_endpoints[0][c], 7);
+			writer.write(best_endpoints[1][c], 7);
+		}
+		writer.write(best_pbits[0], 1);
+		writer.write(best_pbits[1], 1);
+		writer.write(best_indices[0], 3);
+		for (uint32_t i = 1; i < 16; i++)
+		{
+			writer.write(best_indices[i], 4);
+		}
+	}
+}
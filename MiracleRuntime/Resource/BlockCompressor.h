@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <vector>
+
+namespace Sherphy
+{
+	enum class TextureCompression
+	{
+		RGBA8,
+		BC1, // rgb, 4 bpp, opaque color
+		BC5, // two channels, 8 bpp, tangent space normal maps
+		BC7  // rgba, 8 bpp, color
+	};
+
+	// cpu encoders for the block compressed formats of the texture cook,
+	// every block is 4x4 texels given as rgba8 in row order
+	class BlockCompressor
+	{
+	public:
+		static uint32_t getBlockBytes(TextureCompression format);
+		static size_t getImageBytes(TextureCompression format, uint32_t width, uint32_t height);
+
+		// edge blocks of images that are not a multiple of four repeat the last row and column
+		static void compressImage(const uint8_t* rgba,
+								  uint32_t width,
+								  uint32_t height,
+								  TextureCompression format,
+								  std::vector<uint8_t>& blocks);
+
+		static void compressBlockBC1(const uint8_t block[64], uint8_t out[8]);
+		static void compressBlockBC4(const uint8_t values[16], uint8_t out[8]);
+		static void compressBlockBC5(const uint8_t block[64], uint8_t out[16]);
+		// mode 6 only: one subset, rgba endpoints, 4 bit indices
+		static void compressBlockBC7(const uint8_t block[64], uint8_t out[16]);
+	};
+}
@@ -6,6 +6,8 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
+#include <cmath>
+
 namespace Sherphy 
 {
 	std::vector<char> FileSystem::readBinaryFile(const char* filename) {
@@ -46,6 +48,7 @@ namespace Sherphy
 		SHERPHY_EXCEPTION_IF_FALSE(tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, model_path), warn + err);
 
 		std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+		bool has_normals = !attrib.normals.empty();
 
 		for (const auto& shape : shapes)
 		{
@@ -66,6 +69,15 @@ namespace Sherphy
 
 				vertex.color = { 1.0f, 1.0f, 1.0f };
 
+				if (has_normals && index.normal_index >= 0)
+				{
+					vertex.normal = {
+						attrib.normals[3 * index.normal_index + 0],
+						attrib.normals[3 * index.normal_index + 1],
+						attrib.normals[3 * index.normal_index + 2]
+					};
+				}
+
 				if (uniqueVertices.find(vertex) == uniqueVertices.end()) {
 					uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
 					vertices.push_back(vertex);
@@ -74,6 +86,76 @@ namespace Sherphy
 				indices.push_back(uniqueVertices[vertex]);
 			}
 		}
+
+		if (!has_normals)
+		{
+			generateNormals(vertices, indices);
+		}
+		generateTangents(vertices, indices);
+	}
+
+	// area weighted face normals, the cross product length is twice the triangle area
+	void FileSystem::generateNormals(std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+	{
+		std::vector<Vec3> normals(vertices.size(), Vec3(0.0f));
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			const Vec3& p0 = vertices[indices[i]].pos;
+			Vec3 face_normal = glm::cross(vertices[indices[i + 1]].pos - p0, vertices[indices[i + 2]].pos - p0);
+			normals[indices[i]] += face_normal;
+			normals[indices[i + 1]] += face_normal;
+			normals[indices[i + 2]] += face_normal;
+		}
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			float length = glm::length(normals[i]);
+			vertices[i].normal = length > 0.0f ? normals[i] / length : Vec3(0.0f, 0.0f, 1.0f);
+		}
+	}
+
+	// tangents along the u direction of the triangles, orthogonalized against the vertex normal
+	void FileSystem::generateTangents(std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+	{
+		std::vector<Vec3> tangents(vertices.size(), Vec3(0.0f));
+		std::vector<Vec3> bitangents(vertices.size(), Vec3(0.0f));
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			const Vertex& v0 = vertices[indices[i]];
+			const Vertex& v1 = vertices[indices[i + 1]];
+			const Vertex& v2 = vertices[indices[i + 2]];
+			Vec3 edge1 = v1.pos - v0.pos;
+			Vec3 edge2 = v2.pos - v0.pos;
+			Vec2 delta_uv1 = v1.tex_coord - v0.tex_coord;
+			Vec2 delta_uv2 = v2.tex_coord - v0.tex_coord;
+			float determinant = delta_uv1.x * delta_uv2.y - delta_uv2.x * delta_uv1.y;
+			if (std::abs(determinant) < 1e-12f)
+			{
+				continue;
+			}
+			float inverse_determinant = 1.0f / determinant;
+			Vec3 tangent = (edge1 * delta_uv2.y - edge2 * delta_uv1.y) * inverse_determinant;
+			Vec3 bitangent = (edge2 * delta_uv1.x - edge1 * delta_uv2.x) * inverse_determinant;
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				tangents[indices[i + corner]] += tangent;
+				bitangents[indices[i + corner]] += bitangent;
+			}
+		}
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			const Vec3& normal = vertices[i].normal;
+			Vec3 tangent = tangents[i] - normal * glm::dot(normal, tangents[i]);
+			float length = glm::length(tangent);
+			if (length < 1e-12f)
+			{
+				// no uv gradient, any direction perpendicular to the normal
+				tangent = std::abs(normal.x) < 0.9f ? glm::cross(normal, Vec3(1.0f, 0.0f, 0.0f)) : glm::cross(normal, Vec3(0.0f, 1.0f, 0.0f));
+				length = glm::length(tangent);
+			}
+			tangent /= length;
+			float handedness = glm::dot(glm::cross(normal, tangent), bitangents[i]) < 0.0f ? -1.0f : 1.0f;
+			vertices[i].tangent = Vec4(tangent, handedness);
+		}
 	}
  
 
@@ -13,7 +13,7 @@ namespace std
 	template<> struct hash<Sherphy::Vertex> {
 		size_t operator()(Sherphy::Vertex const& vertex) const
 		{
-			return ((hash<Sherphy::Vec3>()(vertex.pos) ^ (hash<Sherphy::Vec3>()(vertex.color) << 1)) >> 1) ^ (hash<Sherphy::Vec2>()(vertex.tex_coord) << 1);
+			return ((((hash<Sherphy::Vec3>()(vertex.pos) ^ (hash<Sherphy::Vec3>()(vertex.color) << 1)) >> 1) ^ (hash<Sherphy::Vec2>()(vertex.tex_coord) << 1)) >> 1) ^ (hash<Sherphy::Vec3>()(vertex.normal) << 1);
 		}
 	};
 }
@@ -26,6 +26,10 @@ namespace Sherphy
 		std::vector<char> readBinaryFile(const char* filename);
 		unsigned char* readImageFile(const char* filename, int& tex_width, int& tex_height, int& tex_channels);
 		void releaseImageAsset(unsigned char* asset);
+		// keeps the normals of the file, or derives them from the faces when it has none; tangents follow the uvs
 		void loadObjFile(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const char* model_path);
+	private:
+		static void generateNormals(std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+		static void generateTangents(std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
 	};
 }
\ No newline at end of file
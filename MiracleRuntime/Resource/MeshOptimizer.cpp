@@ -0,0 +1,306 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace Sherphy
+{
+	void MeshOptimizer::optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t cache_size)
+	{
+		SHERPHY_EXCEPTION_IF_FALSE((indices.size() % 3 == 0), "mesh optimization needs a triangle list");
+		if (indices.empty())
+		{
+			return;
+		}
+		VertexCacheStats before = analyzeVertexCache(indices, vertices.size(), cache_size);
+
+		std::vector<uint32_t> clusters = optimizeVertexCache(indices, vertices.size(), cache_size);
+		optimizeOverdraw(vertices, indices, clusters, cache_size);
+		optimizeVertexFetch(vertices, indices);
+
+		VertexCacheStats after = analyzeVertexCache(indices, vertices.size(), cache_size);
+		SHERPHY_LOG("mesh optimization, " + std::to_string(indices.size() / 3) + " triangles"
+			+ ", acmr " + std::to_string(before.acmr) + " -> " + std::to_string(after.acmr)
+			+ ", atvr " + std::to_string(before.atvr) + " -> " + std::to_string(after.atvr));
+	}
+
+	// Tipsify, Sander et al. 2007: fans around one vertex at a time and moves on to the
+	// neighbour that is still in the cache and whose remaining triangles fit into it
+	std::vector<uint32_t> MeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertex_count, uint32_t cache_size)
+	{
+		SHERPHY_EXCEPTION_IF_FALSE((indices.size() % 3 == 0), "vertex cache optimization needs a triangle list");
+		std::vector<uint32_t> clusters;
+		const uint32_t triangle_count = static_cast<uint32_t>(indices.size() / 3);
+		if (triangle_count == 0)
+		{
+			return clusters;
+		}
+
+		// triangles around every vertex, one row per vertex
+		std::vector<uint32_t> live_triangles(vertex_count, 0);
+		for (uint32_t index : indices)
+		{
+			live_triangles[index]++;
+		}
+		std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+		for (size_t vertex = 0; vertex < vertex_count; vertex++)
+		{
+			adjacency_offsets[vertex + 1] = adjacency_offsets[vertex] + live_triangles[vertex];
+		}
+		std::vector<uint32_t> adjacency(indices.size());
+		std::vector<uint32_t> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+		for (uint32_t triangle = 0; triangle < triangle_count; triangle++)
+		{
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				adjacency[fill[indices[triangle * 3 + corner]]++] = triangle;
+			}
+		}
+
+		// a vertex is in the cache while fewer than cache_size vertices entered after it
+		std::vector<uint32_t> cache_time(vertex_count, 0);
+		uint32_t time = cache_size + 1;
+		std::vector<bool> emitted(triangle_count, false);
+		std::vector<uint32_t> dead_ends;
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> output;
+		output.reserve(indices.size());
+		dead_ends.reserve(indices.size());
+
+		uint32_t cursor = 0;
+		clusters.push_back(0);
+		uint32_t fanning = skipDeadEnd(dead_ends, live_triangles, cursor);
+		while (fanning != UINT32_MAX)
+		{
+			candidates.clear();
+			for (uint32_t adjacent = adjacency_offsets[fanning]; adjacent < adjacency_offsets[fanning + 1]; adjacent++)
+			{
+				uint32_t triangle = adjacency[adjacent];
+				if (emitted[triangle])
+				{
+					continue;
+				}
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					uint32_t vertex = indices[triangle * 3 + corner];
+					output.push_back(vertex);
+					dead_ends.push_back(vertex);
+					candidates.push_back(vertex);
+					live_triangles[vertex]--;
+					if (time - cache_time[vertex] > cache_size)
+					{
+						cache_time[vertex] = time;
+						time++;
+					}
+				}
+				emitted[triangle] = true;
+			}
+
+			// the oldest candidate that stays cached while its remaining triangles are fanned
+			uint32_t next = UINT32_MAX;
+			int64_t best_priority = -1;
+			for (uint32_t vertex : candidates)
+			{
+				if (live_triangles[vertex] == 0)
+				{
+					continue;
+				}
+				int64_t priority = 0;
+				if (time - cache_time[vertex] + 2 * live_triangles[vertex] <= cache_size)
+				{
+					priority = time - cache_time[vertex];
+				}
+				if (priority > best_priority)
+				{
+					best_priority = priority;
+					next = vertex;
+				}
+			}
+			if (next == UINT32_MAX)
+			{
+				next = skipDeadEnd(dead_ends, live_triangles, cursor);
+				if (next != UINT32_MAX)
+				{
+					clusters.push_back(static_cast<uint32_t>(output.size() / 3));
+				}
+			}
+			fanning = next;
+		}
+
+		indices.swap(output);
+		return clusters;
+	}
+
+	// the most recently used vertex with triangles left, else the next one in input order
+	uint32_t MeshOptimizer::skipDeadEnd(std::vector<uint32_t>& dead_ends, const std::vector<uint32_t>& live_triangles, uint32_t& cursor)
+	{
+		while (!dead_ends.empty())
+		{
+			uint32_t vertex = dead_ends.back();
+			dead_ends.pop_back();
+			if (live_triangles[vertex] > 0)
+			{
+				return vertex;
+			}
+		}
+		for (; cursor < live_triangles.size(); cursor++)
+		{
+			if (live_triangles[cursor] > 0)
+			{
+				return cursor;
+			}
+		}
+		return UINT32_MAX;
+	}
+
+	// clusters are split further where they already cache well on their own, then sorted
+	// by how far out along their own normal they sit from the mesh centroid
+	void MeshOptimizer::optimizeOverdraw(const std::vector<Vertex>& vertices,
+										 std::vector<uint32_t>& indices,
+										 const std::vector<uint32_t>& clusters,
+										 uint32_t cache_size,
+										 float threshold)
+	{
+		const uint32_t triangle_count = static_cast<uint32_t>(indices.size() / 3);
+		if (triangle_count == 0 || clusters.empty())
+		{
+			return;
+		}
+		float mesh_acmr = analyzeVertexCache(indices, vertices.size(), cache_size).acmr;
+
+		// every cluster starts with a cold FIFO cache, it may be drawn after any other
+		std::vector<uint32_t> cluster_starts;
+		std::vector<uint32_t> cache_stamp(vertices.size(), 0);
+		uint32_t misses = cache_size + 1;
+		for (size_t cluster = 0; cluster < clusters.size(); cluster++)
+		{
+			uint32_t begin = clusters[cluster];
+			uint32_t end = cluster + 1 < clusters.size() ? clusters[cluster + 1] : triangle_count;
+			uint32_t start = begin;
+			uint32_t cluster_misses = 0;
+			misses += cache_size + 1;
+			cluster_starts.push_back(begin);
+			for (uint32_t triangle = begin; triangle < end; triangle++)
+			{
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					uint32_t vertex = indices[triangle * 3 + corner];
+					if (misses - cache_stamp[vertex] > cache_size)
+					{
+						cache_stamp[vertex] = misses;
+						misses++;
+						cluster_misses++;
+					}
+				}
+				uint32_t cluster_triangles = triangle + 1 - start;
+				if (triangle + 1 < end && static_cast<float>(cluster_misses) / cluster_triangles <= mesh_acmr * threshold)
+				{
+					start = triangle + 1;
+					cluster_misses = 0;
+					misses += cache_size + 1;
+					cluster_starts.push_back(start);
+				}
+			}
+		}
+
+		// area weighted, a cross product is twice the triangle area
+		struct ClusterSort
+		{
+			uint32_t begin;
+			uint32_t end;
+			float key;
+		};
+		Vec3 mesh_centroid(0.0f);
+		float mesh_area = 0.0f;
+		std::vector<ClusterSort> sorted(cluster_starts.size());
+		std::vector<Vec3> cluster_centroids(cluster_starts.size(), Vec3(0.0f));
+		std::vector<Vec3> cluster_normals(cluster_starts.size(), Vec3(0.0f));
+		for (size_t cluster = 0; cluster < cluster_starts.size(); cluster++)
+		{
+			sorted[cluster].begin = cluster_starts[cluster];
+			sorted[cluster].end = cluster + 1 < cluster_starts.size() ? cluster_starts[cluster + 1] : triangle_count;
+			float cluster_area = 0.0f;
+			for (uint32_t triangle = sorted[cluster].begin; triangle < sorted[cluster].end; triangle++)
+			{
+				const Vec3& p0 = vertices[indices[triangle * 3]].pos;
+				const Vec3& p1 = vertices[indices[triangle * 3 + 1]].pos;
+				const Vec3& p2 = vertices[indices[triangle * 3 + 2]].pos;
+				Vec3 normal = glm::cross(p1 - p0, p2 - p0);
+				float area = glm::length(normal);
+				Vec3 centroid = (p0 + p1 + p2) / 3.0f;
+				cluster_centroids[cluster] += centroid * area;
+				cluster_normals[cluster] += normal;
+				cluster_area += area;
+			}
+			mesh_centroid += cluster_centroids[cluster];
+			mesh_area += cluster_area;
+			cluster_centroids[cluster] = cluster_area > 0.0f ? cluster_centroids[cluster] / cluster_area : Vec3(0.0f);
+		}
+		mesh_centroid = mesh_area > 0.0f ? mesh_centroid / mesh_area : Vec3(0.0f);
+		for (size_t cluster = 0; cluster < sorted.size(); cluster++)
+		{
+			float normal_length = glm::length(cluster_normals[cluster]);
+			sorted[cluster].key = normal_length > 0.0f ? glm::dot(cluster_centroids[cluster] - mesh_centroid, cluster_normals[cluster] / normal_length) : 0.0f;
+		}
+		std::stable_sort(sorted.begin(), sorted.end(), [](const ClusterSort& lhs, const ClusterSort& rhs) {
+			return lhs.key > rhs.key;
+		});
+
+		std::vector<uint32_t> output;
+		output.reserve(indices.size());
+		for (const ClusterSort& cluster : sorted)
+		{
+			output.insert(output.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+		}
+		indices.swap(output);
+	}
+
+	void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+		std::vector<Vertex> reordered;
+		reordered.reserve(vertices.size());
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == UINT32_MAX)
+			{
+				remap[index] = static_cast<uint32_t>(reordered.size());
+				reordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		vertices.swap(reordered);
+	}
+
+	VertexCacheStats MeshOptimizer::analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertex_count, uint32_t cache_size)
+	{
+		VertexCacheStats stats{};
+		if (indices.empty())
+		{
+			return stats;
+		}
+		// FIFO by stamps: a vertex is cached while fewer than cache_size misses came after its own
+		std::vector<uint32_t> cache_stamp(vertex_count, 0);
+		std::vector<bool> referenced(vertex_count, false);
+		uint32_t referenced_count = 0;
+		uint32_t misses = cache_size + 1;
+		for (uint32_t index : indices)
+		{
+			if (misses - cache_stamp[index] > cache_size)
+			{
+				cache_stamp[index] = misses;
+				misses++;
+				stats.transformed_vertices++;
+			}
+			if (!referenced[index])
+			{
+				referenced[index] = true;
+				referenced_count++;
+			}
+		}
+		stats.acmr = static_cast<float>(stats.transformed_vertices) / static_cast<float>(indices.size() / 3);
+		stats.atvr = static_cast<float>(stats.transformed_vertices) / static_cast<float>(referenced_count);
+		return stats;
+	}
+}
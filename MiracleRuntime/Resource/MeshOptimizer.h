@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <vector>
+
+namespace Sherphy
+{
+	// post-transform vertex cache behaviour of an index list under a FIFO cache
+	struct VertexCacheStats
+	{
+		uint32_t transformed_vertices = 0;
+		float acmr = 0.0f; // transformed vertices per triangle, 0.5 at best for large meshes
+		float atvr = 0.0f; // transformed vertices per referenced vertex, 1.0 at best
+	};
+
+	// Import time reordering of a triangle list, the rendered result is the same.
+	// Triangles are ordered for the post-transform vertex cache with Tipsify, the
+	// clusters it produces are sorted so that outward facing ones on the outside of
+	// the mesh are drawn first and occlude the rest, and finally vertices are
+	// renumbered in the order the index list first uses them so fetches walk the
+	// vertex buffer forward. Run it before the meshlets are built, they follow the
+	// index order.
+	class MeshOptimizer
+	{
+	public:
+		static const uint32_t k_cache_size = 16;
+		// a cluster is split once its own ACMR is within this factor of the whole mesh
+		static constexpr float k_overdraw_threshold = 1.05f;
+
+		// all three passes, logs the ACMR and ATVR before and after
+		static void optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t cache_size = k_cache_size);
+		// returns the triangle starts where the walk hit a dead end, the first is 0
+		static std::vector<uint32_t> optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertex_count, uint32_t cache_size = k_cache_size);
+		// reorders the clusters of optimizeVertexCache, triangles inside a cluster keep their order
+		static void optimizeOverdraw(const std::vector<Vertex>& vertices,
+									 std::vector<uint32_t>& indices,
+									 const std::vector<uint32_t>& clusters,
+									 uint32_t cache_size = k_cache_size,
+									 float threshold = k_overdraw_threshold);
+		// vertices no index refers to are dropped
+		static void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+		static VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertex_count, uint32_t cache_size = k_cache_size);
+	private:
+		static uint32_t skipDeadEnd(std::vector<uint32_t>& dead_ends, const std::vector<uint32_t>& live_triangles, uint32_t& cursor);
+	};
+}
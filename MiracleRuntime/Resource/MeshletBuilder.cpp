@@ -0,0 +1,132 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Sherphy 
+{
+	void MeshletBuilder::buildMeshlets(const std::vector<Vertex>& vertices,
+									   const std::vector<uint32_t>& indices,
+									   std::vector<Meshlet>& meshlets,
+									   uint32_t max_vertices,
+									   uint32_t max_triangles)
+	{
+		SHERPHY_EXCEPTION_IF_FALSE((indices.size() % 3 == 0), "meshlet build needs a triangle list");
+		SHERPHY_EXCEPTION_IF_FALSE((max_vertices >= 3 && max_triangles >= 1), "meshlet limits too small");
+		meshlets.clear();
+
+		// stamp of the meshlet that last used a vertex, avoids clearing a set per meshlet
+		std::vector<uint32_t> vertex_stamp(vertices.size(), UINT32_MAX);
+
+		Meshlet meshlet{};
+		uint32_t meshlet_id = 0;
+		for (size_t triangle = 0; triangle < indices.size() / 3; triangle++)
+		{
+			const uint32_t* corner = &indices[triangle * 3];
+			uint32_t new_vertices = 0;
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				bool seen = vertex_stamp[corner[i]] == meshlet_id;
+				for (uint32_t j = 0; j < i; j++)
+				{
+					seen = seen || corner[j] == corner[i];
+				}
+				new_vertices += seen ? 0 : 1;
+			}
+
+			if (meshlet.vertex_count + new_vertices > max_vertices || meshlet.index_count / 3 + 1 > max_triangles)
+			{
+				computeMeshletBounds(vertices, indices, meshlet);
+				meshlets.push_back(meshlet);
+				meshlet = {};
+				meshlet.first_index = static_cast<uint32_t>(triangle * 3);
+				meshlet_id++;
+			}
+
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				if (vertex_stamp[corner[i]] != meshlet_id)
+				{
+					vertex_stamp[corner[i]] = meshlet_id;
+					meshlet.vertex_count++;
+				}
+			}
+			meshlet.index_count += 3;
+		}
+
+		if (meshlet.index_count > 0)
+		{
+			computeMeshletBounds(vertices, indices, meshlet);
+			meshlets.push_back(meshlet);
+		}
+	}
+
+	void MeshletBuilder::computeMeshletBounds(const std::vector<Vertex>& vertices,
+											  const std::vector<uint32_t>& indices,
+											  Meshlet& meshlet)
+	{
+		const uint32_t begin = meshlet.first_index;
+		const uint32_t end = meshlet.first_index + meshlet.index_count;
+
+		Vec3 min_pos = vertices[indices[begin]].pos;
+		Vec3 max_pos = min_pos;
+		for (uint32_t i = begin; i < end; i++)
+		{
+			min_pos = glm::min(min_pos, vertices[indices[i]].pos);
+			max_pos = glm::max(max_pos, vertices[indices[i]].pos);
+		}
+		Vec3 center = (min_pos + max_pos) * 0.5f;
+		float radius = 0.0f;
+		for (uint32_t i = begin; i < end; i++)
+		{
+			radius = std::max(radius, glm::length(vertices[indices[i]].pos - center));
+		}
+		meshlet.bounding_sphere = Vec4(center, radius);
+
+		// normal cone from the face normals, vertices carry no normal
+		std::vector<Vec3> normals;
+		normals.reserve(meshlet.index_count / 3);
+		Vec3 axis(0.0f);
+		for (uint32_t i = begin; i < end; i += 3)
+		{
+			Vec3 p0 = vertices[indices[i + 0]].pos;
+			Vec3 p1 = vertices[indices[i + 1]].pos;
+			Vec3 p2 = vertices[indices[i + 2]].pos;
+			Vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(normal);
+			if (area <= 1e-12f)
+			{
+				continue;
+			}
+			normal /= area;
+			normals.push_back(normal);
+			axis += normal;
+		}
+
+		// no usable normals or they cancel out, keep the cluster out of backface culling
+		float axis_length = glm::length(axis);
+		if (normals.empty() || axis_length <= 1e-6f)
+		{
+			meshlet.cone_axis_cutoff = Vec4(0.0f, 0.0f, 1.0f, 1.0f);
+			return;
+		}
+		axis /= axis_length;
+
+		float min_dot = 1.0f;
+		for (const Vec3& normal : normals)
+		{
+			min_dot = std::min(min_dot, glm::dot(axis, normal));
+		}
+
+		// wider than ~84 degrees the cone is never fully backfacing
+		if (min_dot <= 0.1f)
+		{
+			meshlet.cone_axis_cutoff = Vec4(axis, 1.0f);
+			return;
+		}
+
+		// the backfacing region is the normal cone widened by 90 degrees and inverted:
+		// -cos(a + 90) = sin(a) = sqrt(1 - cos(a)^2)
+		meshlet.cone_axis_cutoff = Vec4(axis, std::sqrt(1.0f - min_dot * min_dot));
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Soul/PreCompile/SoulGlobal.h"
+
+#include <vector>
+
+namespace Sherphy 
+{
+	class MeshletBuilder
+	{
+	public:
+		static const uint32_t k_max_vertices = 64;
+		static const uint32_t k_max_triangles = 124;
+
+		// splits the index list into meshlets in index order, so every meshlet is a
+		// contiguous index range and the index buffer can be drawn as is
+		static void buildMeshlets(const std::vector<Vertex>& vertices,
+								  const std::vector<uint32_t>& indices,
+								  std::vector<Meshlet>& meshlets,
+								  uint32_t max_vertices = k_max_vertices,
+								  uint32_t max_triangles = k_max_triangles);
+	private:
+		static void computeMeshletBounds(const std::vector<Vertex>& vertices,
+										 const std::vector<uint32_t>& indices,
+										 Meshlet& meshlet);
+	};
+}
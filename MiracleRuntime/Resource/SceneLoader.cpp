@@ -2,6 +2,8 @@
 #include "World/Scene.h"
 #include "World/WorldDataBase.h"
 #include "Resource/FileSystem.h"
+#include "Resource/MeshletBuilder.h"
+#include "Resource/MeshOptimizer.h"
 #include "Soul/GlobalContext/GlobalContext.h"
 
 namespace Sherphy 
@@ -25,10 +27,35 @@ namespace Sherphy
 					Function::GetObjectComponent<RenderMeshComponent>(obj_id, data_base->getComponentDataBase(ComponentType::rendermesh));
 
 				g_miracle_global_context.m_file_system->loadObjFile(ren_comp->m_vertices, ren_comp->m_indices, "I:\\SherphyEngine\\resource\\model\\viking_room.obj");
+				MeshOptimizer::optimize(ren_comp->m_vertices, ren_comp->m_indices);
+				MeshletBuilder::buildMeshlets(ren_comp->m_vertices, ren_comp->m_indices, ren_comp->m_meshlets);
 				PositionComponent* pos_comp = 
 					Function::GetObjectComponent<PositionComponent>(obj_id, data_base->getComponentDataBase(ComponentType::position));
 
 				pos_comp->pos = { 0, 0, 0 };
 			}
+
+			// a warm point light and a spot light looking down at the model
+			{
+				SOBJ_ID light_id = data_base->addOneObject({ ComponentType::position, ComponentType::light });
+				data_base->addComponent<PositionComponent>(ComponentType::position, light_id);
+				data_base->addComponent<LightComponent>(ComponentType::light, light_id);
+				Function::GetObjectComponent<PositionComponent>(light_id, data_base->getComponentDataBase(ComponentType::position))->pos = { 1.5f, -1.0f, 1.5f };
+				LightComponent* light_comp = Function::GetObjectComponent<LightComponent>(light_id, data_base->getComponentDataBase(ComponentType::light));
+				light_comp->m_color = { 1.0f, 0.85f, 0.7f };
+				light_comp->m_intensity = 4.0f;
+				light_comp->m_range = 6.0f;
+			}
+			{
+				SOBJ_ID light_id = data_base->addOneObject({ ComponentType::position, ComponentType::light });
+				data_base->addComponent<PositionComponent>(ComponentType::position, light_id);
+				data_base->addComponent<LightComponent>(ComponentType::light, light_id);
+				Function::GetObjectComponent<PositionComponent>(light_id, data_base->getComponentDataBase(ComponentType::position))->pos = { 0.0f, 0.0f, 3.0f };
+				LightComponent* light_comp = Function::GetObjectComponent<LightComponent>(light_id, data_base->getComponentDataBase(ComponentType::light));
+				light_comp->m_type = LightType::Spot;
+				light_comp->m_intensity = 6.0f;
+				light_comp->m_range = 5.0f;
+				light_comp->m_direction = { 0.0f, 0.0f, -1.0f };
+			}
 	}
 }
\ No newline at end of file
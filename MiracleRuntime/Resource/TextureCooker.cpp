@@ -0,0 +1,473 @@
+#include "TextureCooker.h"
+#include "Resource/FileSystem.h"
+#include "Soul/GlobalContext/GlobalContext.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace Sherphy
+{
+	namespace
+	{
+		// VkFormat values, the cook does not depend on vulkan headers
+		const uint32_t k_format_r8g8b8a8_unorm = 37;
+		const uint32_t k_format_r8g8b8a8_srgb = 43;
+		const uint32_t k_format_bc1_rgb_srgb = 132;
+		const uint32_t k_format_bc5_unorm = 141;
+		const uint32_t k_format_bc7_srgb = 146;
+
+		const uint8_t k_ktx2_identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+		const size_t k_ktx2_header_bytes = 80;
+		const size_t k_ktx2_level_index_bytes = 24;
+
+		// khronos data format descriptor values
+		const uint32_t k_dfd_model_rgbsda = 1;
+		const uint32_t k_dfd_model_bc1a = 128;
+		const uint32_t k_dfd_model_bc5 = 132;
+		const uint32_t k_dfd_model_bc7 = 134;
+		const uint32_t k_dfd_primaries_bt709 = 1;
+		const uint32_t k_dfd_transfer_linear = 1;
+		const uint32_t k_dfd_transfer_srgb = 2;
+		const uint32_t k_dfd_sample_linear = 0x10;
+
+		struct DFDSample
+		{
+			uint32_t channel;
+			uint32_t bit_offset;
+			uint32_t bit_length;
+			uint32_t lower;
+			uint32_t upper;
+		};
+
+		float srgbToLinear(uint8_t value)
+		{
+			float c = static_cast<float>(value) / 255.0f;
+			return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+
+		uint8_t linearToSrgb(float value)
+		{
+			float c = std::clamp(value, 0.0f, 1.0f);
+			c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+			return static_cast<uint8_t>(std::lround(c * 255.0f));
+		}
+
+		uint8_t unormToByte(float value)
+		{
+			return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+		}
+
+		bool isSrgbFormat(uint32_t vk_format)
+		{
+			return vk_format == k_format_r8g8b8a8_srgb || vk_format == k_format_bc1_rgb_srgb || vk_format == k_format_bc7_srgb;
+		}
+
+		// bc blocks are 8 or 16 bytes, both already multiples of 4
+		uint32_t getTexelBlockBytes(uint32_t vk_format)
+		{
+			switch (vk_format)
+			{
+			case k_format_bc1_rgb_srgb:
+				return 8;
+			case k_format_bc5_unorm:
+			case k_format_bc7_srgb:
+				return 16;
+			default:
+				return 4;
+			}
+		}
+
+		template<typename T>
+		void appendValue(std::vector<uint8_t>& bytes, T value)
+		{
+			size_t position = bytes.size();
+			bytes.resize(position + sizeof(T));
+			std::memcpy(&bytes[position], &value, sizeof(T));
+		}
+
+		template<typename T>
+		T readValue(const std::vector<char>& bytes, size_t position)
+		{
+			T value;
+			std::memcpy(&value, &bytes[position], sizeof(T));
+			return value;
+		}
+
+		// basic descriptor block, one sample per channel or per compressed plane
+		std::vector<uint8_t> buildDataFormatDescriptor(uint32_t vk_format)
+		{
+			uint32_t color_model = k_dfd_model_rgbsda;
+			uint32_t block_dimension = 0;
+			uint32_t bytes_plane = 4;
+			std::vector<DFDSample> samples;
+			switch (vk_format)
+			{
+			case k_format_bc1_rgb_srgb:
+				color_model = k_dfd_model_bc1a;
+				block_dimension = 3 | (3 << 8);
+				bytes_plane = 8;
+				samples.push_back({ 0, 0, 64, 0, UINT32_MAX });
+				break;
+			case k_format_bc5_unorm:
+				color_model = k_dfd_model_bc5;
+				block_dimension = 3 | (3 << 8);
+				bytes_plane = 16;
+				samples.push_back({ 0, 0, 64, 0, UINT32_MAX });
+				samples.push_back({ 1, 64, 64, 0, UINT32_MAX });
+				break;
+			case k_format_bc7_srgb:
+				color_model = k_dfd_model_bc7;
+				block_dimension = 3 | (3 << 8);
+				bytes_plane = 16;
+				samples.push_back({ 0, 0, 128, 0, UINT32_MAX });
+				break;
+			default:
+				// alpha is never srgb encoded
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					uint32_t channel = c == 3 ? 15 : c;
+					if (c == 3 && isSrgbFormat(vk_format))
+					{
+						channel |= k_dfd_sample_linear;
+					}
+					samples.push_back({ channel, c * 8, 8, 0, 255 });
+				}
+				break;
+			}
+
+			uint32_t block_bytes = 24 + 16 * static_cast<uint32_t>(samples.size());
+			uint32_t transfer = isSrgbFormat(vk_format) ? k_dfd_transfer_srgb : k_dfd_transfer_linear;
+
+			std::vector<uint8_t> dfd;
+			appendValue<uint32_t>(dfd, 4 + block_bytes);
+			appendValue<uint32_t>(dfd, 0);
+			appendValue<uint32_t>(dfd, 2 | (block_bytes << 16));
+			appendValue<uint32_t>(dfd, color_model | (k_dfd_primaries_bt709 << 8) | (transfer << 16));
+			appendValue<uint32_t>(dfd, block_dimension);
+			appendValue<uint32_t>(dfd, bytes_plane);
+			appendValue<uint32_t>(dfd, 0);
+			for (const DFDSample& sample : samples)
+			{
+				appendValue<uint32_t>(dfd, sample.bit_offset | ((sample.bit_length - 1) << 16) | (sample.channel << 24));
+				appendValue<uint32_t>(dfd, 0);
+				appendValue<uint32_t>(dfd, sample.lower);
+				appendValue<uint32_t>(dfd, sample.upper);
+			}
+			return dfd;
+		}
+	}
+
+	TextureCompression TextureCooker::getCompression(TextureUsage usage, bool block_compression)
+	{
+		if (!block_compression)
+		{
+			return TextureCompression::RGBA8;
+		}
+		switch (usage)
+		{
+		case TextureUsage::ColorOpaque:
+			return TextureCompression::BC1;
+		case TextureUsage::Normal:
+			return TextureCompression::BC5;
+		default:
+			return TextureCompression::BC7;
+		}
+	}
+
+	uint32_t TextureCooker::getVkFormat(TextureUsage usage, TextureCompression compression)
+	{
+		switch (compression)
+		{
+		case TextureCompression::BC1:
+			return k_format_bc1_rgb_srgb;
+		case TextureCompression::BC5:
+			return k_format_bc5_unorm;
+		case TextureCompression::BC7:
+			return k_format_bc7_srgb;
+		default:
+			return usage == TextureUsage::Normal ? k_format_r8g8b8a8_unorm : k_format_r8g8b8a8_srgb;
+		}
+	}
+
+	std::string TextureCooker::getCookedPath(const std::string& cook_directory, const std::string& texture_name, TextureUsage usage, bool block_compression)
+	{
+		std::string base_path = (std::filesystem::path(cook_directory) / texture_name).string();
+		switch (getVkFormat(usage, getCompression(usage, block_compression)))
+		{
+		case k_format_bc1_rgb_srgb:
+			return base_path + ".bc1.ktx2";
+		case k_format_bc5_unorm:
+			return base_path + ".bc5.ktx2";
+		case k_format_bc7_srgb:
+			return base_path + ".bc7.ktx2";
+		case k_format_r8g8b8a8_unorm:
+			return base_path + ".rgba8.ktx2";
+		default:
+			return base_path + ".srgb8_alpha8.ktx2";
+		}
+	}
+
+	TextureUsage TextureCooker::getUsage(const std::string& texture_name)
+	{
+		auto ends_with = [&texture_name](const std::string& suffix) {
+			return texture_name.size() >= suffix.size() && texture_name.compare(texture_name.size() - suffix.size(), suffix.size(), suffix) == 0;
+		};
+		return ends_with("_n") || ends_with("_normal") ? TextureUsage::Normal : TextureUsage::Color;
+	}
+
+	void TextureCooker::generateMipChain(const uint8_t* rgba,
+										 uint32_t width,
+										 uint32_t height,
+										 TextureUsage usage,
+										 std::vector<std::vector<uint8_t>>& levels)
+	{
+		levels.clear();
+		levels.emplace_back(rgba, rgba + static_cast<size_t>(width) * height * 4);
+
+		while (width > 1 || height > 1)
+		{
+			uint32_t next_width = std::max(width / 2, 1u);
+			uint32_t next_height = std::max(height / 2, 1u);
+			const std::vector<uint8_t>& source = levels.back();
+			std::vector<uint8_t> next(static_cast<size_t>(next_width) * next_height * 4);
+
+			for (uint32_t y = 0; y < next_height; y++)
+			{
+				for (uint32_t x = 0; x < next_width; x++)
+				{
+					// odd sizes clamp the second tap to the last row or column
+					uint32_t source_x[2] = { x * 2, std::min(x * 2 + 1, width - 1) };
+					uint32_t source_y[2] = { y * 2, std::min(y * 2 + 1, height - 1) };
+					float sum[4]{};
+					for (uint32_t tap = 0; tap < 4; tap++)
+					{
+						const uint8_t* texel = &source[(static_cast<size_t>(source_y[tap >> 1]) * width + source_x[tap & 1]) * 4];
+						for (uint32_t c = 0; c < 4; c++)
+						{
+							if (usage == TextureUsage::Normal)
+							{
+								sum[c] += c < 3 ? static_cast<float>(texel[c]) / 127.5f - 1.0f : static_cast<float>(texel[c]) / 255.0f;
+							}
+							else
+							{
+								sum[c] += c < 3 ? srgbToLinear(texel[c]) : static_cast<float>(texel[c]) / 255.0f;
+							}
+						}
+					}
+
+					uint8_t* out = &next[(static_cast<size_t>(y) * next_width + x) * 4];
+					if (usage == TextureUsage::Normal)
+					{
+						// averaged normals get shorter, keep them unit length
+						float length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+						length = length > 1e-6f ? length : 1.0f;
+						for (uint32_t c = 0; c < 3; c++)
+						{
+							out[c] = unormToByte(sum[c] / length * 0.5f + 0.5f);
+						}
+					}
+					else
+					{
+						for (uint32_t c = 0; c < 3; c++)
+						{
+							out[c] = linearToSrgb(sum[c] / 4.0f);
+						}
+					}
+					out[3] = unormToByte(sum[3] / 4.0f);
+				}
+			}
+
+			levels.push_back(std::move(next));
+			width = next_width;
+			height = next_height;
+		}
+	}
+
+	uint32_t TextureCooker::cookDirectory(const std::string& source_directory, const std::string& cook_directory)
+	{
+		std::error_code error;
+		SHERPHY_EXCEPTION_IF_FALSE((std::filesystem::is_directory(source_directory, error)), "texture source directory missing " + source_directory);
+		std::filesystem::create_directories(cook_directory, error);
+		SHERPHY_EXCEPTION_IF_FALSE((!error), "failed to create cook directory " + cook_directory);
+
+		uint32_t texture_count = 0;
+		for (const auto& entry : std::filesystem::directory_iterator(source_directory))
+		{
+			std::string extension = entry.path().extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+			if (!entry.is_regular_file() || (extension != ".png" && extension != ".jpg" && extension != ".jpeg" && extension != ".tga"))
+			{
+				continue;
+			}
+			std::string source_path = entry.path().string();
+			std::string texture_name = entry.path().stem().string();
+			TextureUsage usage = getUsage(texture_name);
+			cookTexture(source_path, getCookedPath(cook_directory, texture_name, usage, true), usage, true);
+			cookTexture(source_path, getCookedPath(cook_directory, texture_name, usage, false), usage, false);
+			texture_count++;
+		}
+		return texture_count;
+	}
+
+	void TextureCooker::cookTexture(const std::string& source_path, const std::string& cooked_path, TextureUsage usage, bool block_compression)
+	{
+		std::error_code error;
+		SHERPHY_EXCEPTION_IF_FALSE((std::filesystem::exists(source_path, error)), "texture source missing " + source_path);
+		if (std::filesystem::exists(cooked_path, error) &&
+			std::filesystem::last_write_time(cooked_path, error) >= std::filesystem::last_write_time(source_path, error))
+		{
+			return;
+		}
+
+		FileSystem file_system;
+		int width, height, channels;
+		unsigned char* pixels = file_system.readImageFile(source_path.c_str(), width, height, channels);
+		SHERPHY_EXCEPTION_IF_FALSE(pixels, "failed to load texture image " + source_path);
+
+		std::vector<std::vector<uint8_t>> mips;
+		generateMipChain(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), usage, mips);
+		file_system.releaseImageAsset(pixels);
+
+		TextureCompression compression = getCompression(usage, block_compression);
+		TextureAsset asset{};
+		asset.vk_format = getVkFormat(usage, compression);
+		uint32_t block_bytes = getTexelBlockBytes(asset.vk_format);
+		asset.width = static_cast<uint32_t>(width);
+		asset.height = static_cast<uint32_t>(height);
+		std::vector<uint8_t> blocks;
+		for (size_t level = 0; level < mips.size(); level++)
+		{
+			TextureLevel mip{};
+			mip.width = std::max(asset.width >> level, 1u);
+			mip.height = std::max(asset.height >> level, 1u);
+			BlockCompressor::compressImage(mips[level].data(), mip.width, mip.height, compression, blocks);
+			// every level starts on a multiple of the block size, copies need that alignment
+			mip.offset = (asset.data.size() + block_bytes - 1) / block_bytes * block_bytes;
+			mip.size = blocks.size();
+			asset.data.resize(mip.offset);
+			asset.data.insert(asset.data.end(), blocks.begin(), blocks.end());
+			asset.levels.push_back(mip);
+		}
+
+		SHERPHY_EXCEPTION_IF_FALSE(writeKTX2(cooked_path, asset), "failed to write cooked texture " + cooked_path);
+		SHERPHY_LOG("cooked " + cooked_path);
+	}
+
+	bool TextureCooker::writeKTX2(const std::string& path, const TextureAsset& asset)
+	{
+		uint32_t level_count = static_cast<uint32_t>(asset.levels.size());
+		std::vector<uint8_t> dfd = buildDataFormatDescriptor(asset.vk_format);
+		size_t dfd_offset = k_ktx2_header_bytes + k_ktx2_level_index_bytes * level_count;
+
+		// level data is stored smallest mip first, aligned to lcm(block size, 4)
+		uint32_t alignment = getTexelBlockBytes(asset.vk_format);
+		std::vector<uint64_t> level_offsets(level_count);
+		size_t end = dfd_offset + dfd.size();
+		for (uint32_t level = level_count; level-- > 0;)
+		{
+			end = (end + alignment - 1) / alignment * alignment;
+			level_offsets[level] = end;
+			end += asset.levels[level].size;
+		}
+
+		std::vector<uint8_t> bytes;
+		bytes.reserve(end);
+		bytes.insert(bytes.end(), k_ktx2_identifier, k_ktx2_identifier + sizeof(k_ktx2_identifier));
+		appendValue<uint32_t>(bytes, asset.vk_format);
+		appendValue<uint32_t>(bytes, 1);
+		appendValue<uint32_t>(bytes, asset.width);
+		appendValue<uint32_t>(bytes, asset.height);
+		appendValue<uint32_t>(bytes, 0);
+		appendValue<uint32_t>(bytes, 0);
+		appendValue<uint32_t>(bytes, 1);
+		appendValue<uint32_t>(bytes, level_count);
+		appendValue<uint32_t>(bytes, 0);
+		appendValue<uint32_t>(bytes, static_cast<uint32_t>(dfd_offset));
+		appendValue<uint32_t>(bytes, static_cast<uint32_t>(dfd.size()));
+		appendValue<uint32_t>(bytes, 0);
+		appendValue<uint32_t>(bytes, 0);
+		appendValue<uint64_t>(bytes, 0);
+		appendValue<uint64_t>(bytes, 0);
+		for (uint32_t level = 0; level < level_count; level++)
+		{
+			appendValue<uint64_t>(bytes, level_offsets[level]);
+			appendValue<uint64_t>(bytes, asset.levels[level].size);
+			appendValue<uint64_t>(bytes, asset.levels[level].size);
+		}
+		bytes.insert(bytes.end(), dfd.begin(), dfd.end());
+		for (uint32_t level = level_count; level-- > 0;)
+		{
+			bytes.resize(level_offsets[level], 0);
+			const uint8_t* level_data = &asset.data[asset.levels[level].offset];
+			bytes.insert(bytes.end(), level_data, level_data + asset.levels[level].size);
+		}
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+		return file.good();
+	}
+
+	bool TextureCooker::loadKTX2(const std::string& path, TextureAsset& asset)
+	{
+		std::error_code error;
+		if (!std::filesystem::exists(path, error))
+		{
+			LogMessage(ERROR_MARK("missing KTX2 file " + path), WarningStage::Medium);
+			return false;
+		}
+		std::vector<char> bytes = g_miracle_global_context.m_file_system->readBinaryFile(path.c_str());
+		if (bytes.size() < k_ktx2_header_bytes || std::memcmp(bytes.data(), k_ktx2_identifier, sizeof(k_ktx2_identifier)) != 0)
+		{
+			LogMessage(ERROR_MARK("not a KTX2 file " + path), WarningStage::Medium);
+			return false;
+		}
+
+		asset = TextureAsset{};
+		asset.vk_format = readValue<uint32_t>(bytes, 12);
+		asset.width = readValue<uint32_t>(bytes, 20);
+		asset.height = readValue<uint32_t>(bytes, 24);
+		uint32_t depth = readValue<uint32_t>(bytes, 28);
+		uint32_t layer_count = readValue<uint32_t>(bytes, 32);
+		uint32_t face_count = readValue<uint32_t>(bytes, 36);
+		uint32_t level_count = std::max(readValue<uint32_t>(bytes, 40), 1u);
+		uint32_t supercompression = readValue<uint32_t>(bytes, 44);
+		if (depth != 0 || layer_count > 1 || face_count != 1 || supercompression != 0 ||
+			bytes.size() < k_ktx2_header_bytes + k_ktx2_level_index_bytes * level_count)
+		{
+			LogMessage(ERROR_MARK("unsupported KTX2 layout " + path), WarningStage::Medium);
+			return false;
+		}
+
+		// level data is rebased so the smallest offset in the file becomes zero
+		size_t base = bytes.size();
+		for (uint32_t level = 0; level < level_count; level++)
+		{
+			base = std::min(base, static_cast<size_t>(readValue<uint64_t>(bytes, k_ktx2_header_bytes + k_ktx2_level_index_bytes * level)));
+		}
+		for (uint32_t level = 0; level < level_count; level++)
+		{
+			size_t entry = k_ktx2_header_bytes + k_ktx2_level_index_bytes * level;
+			TextureLevel mip{};
+			mip.width = std::max(asset.width >> level, 1u);
+			mip.height = std::max(asset.height >> level, 1u);
+			mip.offset = static_cast<size_t>(readValue<uint64_t>(bytes, entry)) - base;
+			mip.size = static_cast<size_t>(readValue<uint64_t>(bytes, entry + 8));
+			if (base + mip.offset + mip.size > bytes.size())
+			{
+				LogMessage(ERROR_MARK("truncated KTX2 file " + path), WarningStage::Medium);
+				return false;
+			}
+			asset.levels.push_back(mip);
+		}
+		asset.data.assign(bytes.begin() + base, bytes.end());
+		return true;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Soul/PreCompile/SoulGlobal.h"
+#include "BlockCompressor.h"
+
+#include <string>
+#include <vector>
+
+namespace Sherphy
+{
+	enum class TextureUsage
+	{
+		Color,       // srgb rgba, bc7
+		ColorOpaque, // srgb rgb, bc1
+		Normal       // linear tangent space xy, bc5
+	};
+
+	struct TextureLevel
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		size_t offset = 0; // into TextureAsset::data
+		size_t size = 0;
+	};
+
+	// a cooked texture as it is uploaded, vk_format holds a VkFormat value
+	struct TextureAsset
+	{
+		uint32_t vk_format = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<TextureLevel> levels; // level 0 is the full resolution image
+		std::vector<uint8_t> data;
+	};
+
+	// Offline texture cook: builds the full mip chain of a source image, block
+	// compresses every level and stores the result as KTX2. It runs as a build step
+	// (the CookTextures target, `--cook-textures <source dir> <cook dir>`) and writes
+	// into the cook directory, never next to the sources. A cooked file is rebuilt
+	// only when it is missing or older than its source. The runtime only loads the
+	// KTX2, it never decodes png or generates mips.
+	class TextureCooker
+	{
+	public:
+		// cooks every image of the source directory into the cook directory, both the
+		// block compressed and the rgba8 variant so the runtime can pick by device support;
+		// returns the number of textures
+		static uint32_t cookDirectory(const std::string& source_directory, const std::string& cook_directory);
+		// without block compression the levels are kept as rgba8
+		static void cookTexture(const std::string& source_path, const std::string& cooked_path, TextureUsage usage, bool block_compression);
+		static bool loadKTX2(const std::string& path, TextureAsset& asset);
+		static bool writeKTX2(const std::string& path, const TextureAsset& asset);
+
+		static TextureCompression getCompression(TextureUsage usage, bool block_compression);
+		static uint32_t getVkFormat(TextureUsage usage, TextureCompression compression);
+		// texture_name is the source file name without extension
+		static std::string getCookedPath(const std::string& cook_directory, const std::string& texture_name, TextureUsage usage, bool block_compression);
+		// sources ending in _n or _normal are tangent space normal maps, everything else is color
+		static TextureUsage getUsage(const std::string& texture_name);
+
+		// box filtered chain down to 1x1, color is averaged in linear space
+		static void generateMipChain(const uint8_t* rgba,
+									 uint32_t width,
+									 uint32_t height,
+									 TextureUsage usage,
+									 std::vector<std::vector<uint8_t>>& levels);
+	};
+}
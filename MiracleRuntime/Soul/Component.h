@@ -1,6 +1,7 @@
 #pragma once 
 #include "Soul/Math/Vector.h"
 #include "Soul/Math/Quaternion.h"
+#include "Soul/Math/Meshlet.h"
 #include <vector>
 
 namespace Sherphy 
@@ -59,10 +60,26 @@ namespace Sherphy
 		};
 	};
 
+	enum class LightType : uint32_t
+	{
+		Point = 0,
+		Spot = 1
+	};
+
+	// the light sits at the PositionComponent of its object
 	struct LightComponent : public Component 
 	{
 		LightComponent() : Component(ComponentType::light){
 		}
+		LightType m_type{ LightType::Point };
+		Vec3 m_color{ 1.0f, 1.0f, 1.0f };
+		float m_intensity{ 1.0f };
+		// no contribution beyond it, bounds the clusters the light is assigned to
+		float m_range{ 5.0f };
+		// spot lights only, the cone angles are half angles in radians
+		Vec3 m_direction{ 0.0f, 0.0f, -1.0f };
+		float m_inner_cone_angle{ 0.3f };
+		float m_outer_cone_angle{ 0.5f };
 	};
 
 	struct RenderMeshComponent : Component 
@@ -72,6 +89,7 @@ namespace Sherphy
 		}
 		std::vector<Vertex> m_vertices{};
 		std::vector<uint32_t> m_indices{};
+		std::vector<Meshlet> m_meshlets{};
 	};
 
 	struct PhysicalComponent : Component 
@@ -4,4 +4,5 @@
 #include "Quaternion.h"
 #include "Vector.h"
 
-#include "Vertex.h"
\ No newline at end of file
+#include "Vertex.h"
+#include "Meshlet.h"
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Vector.h"
+
+#include <cstdint>
+
+namespace Sherphy 
+{
+	// a cluster of at most 64 vertices and 124 triangles whose triangles are
+	// contiguous in the mesh index buffer, laid out to be uploaded as is (std430)
+	struct Meshlet 
+	{
+		Vec4 bounding_sphere;  // xyz center, w radius, mesh space
+		Vec4 cone_axis_cutoff; // xyz average normal, w cutoff, cutoff >= 1 means never backface culled
+		uint32_t first_index;  // relative to the first index of the mesh
+		uint32_t index_count;
+		uint32_t vertex_count;
+		uint32_t padding;
+	};
+}
@@ -4,14 +4,17 @@
 
 namespace Sherphy 
 {
+	// full precision source vertex, the rhi encodes it into the vertex format of its pipeline
 	struct Vertex 
 	{
 		Vec3 pos;
 		Vec3 color;
 		Vec2 tex_coord;
+		Vec3 normal{ 0.0f, 0.0f, 1.0f };
+		Vec4 tangent{ 1.0f, 0.0f, 0.0f, 1.0f }; // w is the handedness of the bitangent
 
 		bool operator==(const Vertex& other) const {
-			return pos == other.pos && color == other.color && tex_coord == other.tex_coord;
+			return pos == other.pos && color == other.color && tex_coord == other.tex_coord && normal == other.normal && tangent == other.tangent;
 		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,36 @@
+// light records and the froxel grid shared by the light assignment pass and the forward shaders,
+// the grid constants live in the view block, see VulkanClusteredLights
+
+// matches k_max_lights_per_cluster in VulkanClusteredLights.h
+#define MAX_LIGHTS_PER_CLUSTER 128u
+
+#define LIGHT_TYPE_POINT 0u
+#define LIGHT_TYPE_SPOT 1u
+
+struct GPULight {
+    vec4 position_range;  // xyz world position, w range
+    vec4 color_intensity; // xyz color, w intensity
+    vec4 direction_type;  // xyz spot direction, w light type
+    vec4 cone;            // x cos of the outer half angle, y cos of the inner half angle
+};
+
+// depth is the positive view space distance along the view direction,
+// cluster_depth holds near, far, slice scale and slice bias
+uint getClusterSlice(float depth, vec4 cluster_depth, uint slice_count)
+{
+    float slice = log(max(depth, cluster_depth.x)) * cluster_depth.z - cluster_depth.w;
+    return min(uint(max(slice, 0.0)), slice_count - 1u);
+}
+
+uint getClusterIndex(uvec3 cluster, uvec3 grid)
+{
+    return cluster.x + grid.x * (cluster.y + grid.y * cluster.z);
+}
+
+// smooth falloff that reaches zero at the range
+float getLightAttenuation(float distance, float range)
+{
+    float ratio = distance / range;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return window * window / (distance * distance + 1.0);
+}
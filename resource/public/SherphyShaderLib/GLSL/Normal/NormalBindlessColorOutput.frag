@@ -0,0 +1,82 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_GOOGLE_include_directive : require
+
+#include <Common/ClusteredLights.glsl>
+
+layout(binding = 0) uniform ViewUniformObject {
+    mat4 view;
+    mat4 proj;
+    mat4 view_proj;
+    vec4 camera_position;
+    vec4 cluster_depth;
+    vec4 cluster_tile;
+    uvec4 cluster_grid;
+} view;
+
+// this frame's lights, bound with a dynamic offset into the frame allocator
+layout(std430, binding = 3) readonly buffer LightBuffer {
+    GPULight lights[];
+};
+
+// written by the light assignment pass, MAX_LIGHTS_PER_CLUSTER indices per cluster
+layout(std430, binding = 4) readonly buffer ClusterLightCountBuffer {
+    uint cluster_light_counts[];
+};
+
+layout(std430, binding = 5) readonly buffer ClusterLightIndexBuffer {
+    uint cluster_light_indices[];
+};
+
+struct GPUMaterial {
+    vec4 base_color_factor;
+    uint base_color_texture;
+    uint padding0;
+    uint padding1;
+    uint padding2;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer MaterialBuffer {
+    GPUMaterial materials[];
+};
+
+layout(set = 1, binding = 1) uniform sampler2D textures[];
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragMaterialId;
+layout(location = 3) in vec3 fragWorldPosition;
+
+layout(location = 0) out vec4 outColor;
+
+// keeps surfaces outside every light visible
+const vec3 AMBIENT = vec3(0.1);
+
+void main() {
+    GPUMaterial material = materials[fragMaterialId];
+    vec4 albedo = texture(textures[nonuniformEXT(material.base_color_texture)], fragTexCoord) * material.base_color_factor;
+
+    vec3 normal = normalize(fragNormal);
+
+    // only the lights assigned to the froxel of this fragment
+    uvec3 grid = view.cluster_grid.xyz;
+    float depth = -(view.view * vec4(fragWorldPosition, 1.0)).z;
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / view.cluster_tile.xy), grid.xy - 1u);
+    uint cluster_index = getClusterIndex(uvec3(tile, getClusterSlice(depth, view.cluster_depth, grid.z)), grid);
+    uint light_count = cluster_light_counts[cluster_index];
+    uint list_base = cluster_index * MAX_LIGHTS_PER_CLUSTER;
+
+    vec3 lighting = AMBIENT;
+    for (uint i = 0u; i < light_count; i++) {
+        GPULight light = lights[cluster_light_indices[list_base + i]];
+        vec3 to_light = light.position_range.xyz - fragWorldPosition;
+        float distance = length(to_light);
+        vec3 light_direction = to_light / max(distance, 1e-4);
+        float attenuation = getLightAttenuation(distance, light.position_range.w);
+        if (uint(light.direction_type.w) == LIGHT_TYPE_SPOT) {
+            attenuation *= smoothstep(light.cone.x, light.cone.y, dot(-light_direction, light.direction_type.xyz));
+        }
+        lighting += light.color_intensity.rgb * light.color_intensity.w * attenuation * max(dot(normal, light_direction), 0.0);
+    }
+    outColor = vec4(albedo.rgb * lighting, albedo.a);
+}
@@ -0,0 +1,80 @@
+#version 450
+
+// per frame block, bound with a dynamic offset into the frame allocator
+layout(binding = 0) uniform ViewUniformObject {
+    mat4 view;
+    mat4 proj;
+    mat4 view_proj;
+    vec4 camera_position;
+    vec4 cluster_depth;
+    vec4 cluster_tile;
+    uvec4 cluster_grid;
+} view;
+
+struct GPUMesh {
+    uint index_count;
+    uint first_index;
+    int vertex_offset;
+    uint first_meshlet;
+    uint meshlet_count;
+    uint padding0;
+    uint padding1;
+    uint padding2;
+    vec4 bounding_sphere;
+    // mesh space position = position_offset + decoded position * position_scale
+    vec4 position_offset;
+    vec4 position_scale;
+};
+
+struct GPUInstance {
+    mat4 model;
+    mat4 normal_model; // inverse transpose of model
+    uint mesh_id;
+    uint material_id;
+    uint batch_id;
+    uint padding;
+};
+
+layout(std430, binding = 1) readonly buffer InstanceBuffer {
+    GPUInstance instances[];
+};
+
+// written by the culling pass, gl_InstanceIndex walks the visible instances of a batch
+layout(std430, binding = 2) readonly buffer VisibleInstanceBuffer {
+    uint visible_instances[];
+};
+
+layout(std430, binding = 6) readonly buffer MeshBuffer {
+    GPUMesh meshes[];
+};
+
+// locations are VertexAttribute values, the vertex format decides the encoding behind them
+layout(location = 0) in vec4 inPosition; // snorm relative to the mesh bounds, or plain floats
+layout(location = 1) in vec2 inNormal;   // octahedral
+layout(location = 3) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragMaterialId;
+layout(location = 3) out vec3 fragWorldPosition;
+
+vec3 decodeOctahedral(vec2 encoded)
+{
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0.0);
+    normal.xy += vec2(normal.x >= 0.0 ? -fold : fold, normal.y >= 0.0 ? -fold : fold);
+    return normalize(normal);
+}
+
+void main() 
+{
+    GPUInstance instance = instances[visible_instances[gl_InstanceIndex]];
+    GPUMesh mesh = meshes[instance.mesh_id];
+    vec3 position = mesh.position_offset.xyz + inPosition.xyz * mesh.position_scale.xyz;
+    vec4 world_position = instance.model * vec4(position, 1.0);
+    gl_Position = view.view_proj * world_position;
+    fragNormal = normalize(mat3(instance.normal_model) * decodeOctahedral(inNormal));
+    fragTexCoord = inTexCoord;
+    fragMaterialId = instance.material_id;
+    fragWorldPosition = world_position.xyz;
+}
@@ -1,6 +0,0 @@
-I:\SherphyEngine\3rdparty\VulkanSDK\bin\glslc.exe I:\SherphyEngine\resource\public\SherphyShaderLib\GLSL\Normal\SimpleTestTriangle.vert -o I:\SherphyEngine\resource\public\SherphyShaderLib\SPV\Normal\SimpleTestTriangle_vert.spv
-I:\SherphyEngine\3rdparty\VulkanSDK\bin\glslc.exe I:\SherphyEngine\resource\public\SherphyShaderLib\GLSL\Normal\NormalColorOutput.frag -o I:\SherphyEngine\resource\public\SherphyShaderLib\SPV\Normal\NormalColorOutput_frag.spv
-I:\SherphyEngine\3rdparty\VulkanSDK\bin\glslc.exe I:\SherphyEngine\resource\public\SherphyShaderLib\GLSL\Normal\NormalShader.vert -o I:\SherphyEngine\resource\public\SherphyShaderLib\SPV\Normal\NormalShader_vert.spv
-I:\SherphyEngine\3rdparty\VulkanSDK\bin\glslc.exe I:\SherphyEngine\resource\public\SherphyShaderLib\GLSL\Normal\SimpleTestTriangle.uniform -o I:\SherphyEngine\resource\public\SherphyShaderLib\SPV\Normal\SimpleTestTriangle_uniform.spv
-I:\SherphyEngine\3rdparty\VulkanSDK\bin\glslc.exe I:\SherphyEngine\resource\public\SherphyShaderLib\GLSL\Normal\TextureTest.vert -o I:\SherphyEngine\resource\public\SherphyShaderLib\SPV\Normal\TextureTest_vert.spv
-I:\SherphyEngine\3rdparty\VulkanSDK\bin\glslc.exe I:\SherphyEngine\resource\public\SherphyShaderLib\GLSL\Normal\TextureTest.frag -o I:\SherphyEngine\resource\public\SherphyShaderLib\SPV\Normal\TextureTest_frag.spv
\ No newline at end of file